@@ -3,8 +3,10 @@ import requests
 import hashlib
 import sys
 import os
+import time
 
 from tomviz.jsonrpc import jsonrpc_message
+from tomviz.acquisition.frames import decode_frames
 
 # Add mock modules to path
 mock_dir = os.path.join(os.path.dirname(__file__), '..', 'tomviz',
@@ -116,3 +118,44 @@ def test_acquisition_params(fei_acquisition_server):
         'units': 'nm'
     }
     assert response.json()['result']['size'] == expected
+
+
+def test_stream_throughput(fei_acquisition_server):
+    # The mock API answers at once, so this measures the transport alone.
+    count = 20
+    batch = [jsonrpc_message({
+        'id': 0,
+        'method': 'connect'
+    })]
+    for i in range(count):
+        batch.append(jsonrpc_message({
+            'id': 2 * i + 1,
+            'method': 'tilt_params',
+            'params': {
+                'angle': -60.0 + 6.0 * i
+            }
+        }))
+        batch.append(jsonrpc_message({
+            'id': 2 * i + 2,
+            'method': 'stem_acquire'
+        }))
+
+    url = '%s/stream' % fei_acquisition_server.url
+    start = time.time()
+    response = requests.post(url, json=batch, stream=True)
+    assert response.status_code == 200
+
+    received = []
+    pending = b''
+    for chunk in response.iter_content(chunk_size=65536):
+        (frames, pending) = decode_frames(pending + chunk)
+        received += frames
+    elapsed = time.time() - start
+
+    assert pending == b''
+    assert [frame[0] for frame in received] == list(range(2 * count + 1))
+    images = [frame[2] for frame in received if frame[1] == 'image/tiff']
+    assert len(images) == count
+    size = sum(len(image) for image in images)
+    print('Streamed %d images, %d bytes, in %.2f s (%.1f images/s)'
+          % (count, size, elapsed, count / elapsed))
@@ -0,0 +1,52 @@
+import pytest
+
+from tomviz.acquisition.frames import (encode_frame, decode_frames,
+                                       FrameBuffer, HEADER)
+
+
+def test_round_trip():
+    data = encode_frame(0, 'application/json', b'{"result": 1}') \
+        + encode_frame(1, 'image/tiff', b'\x00\x01\x02')
+    assert len(data) == 2 * HEADER.size + 16 + 13 + 10 + 3
+
+    (frames, rest) = decode_frames(data)
+    assert frames == [
+        (0, 'application/json', b'{"result": 1}'),
+        (1, 'image/tiff', b'\x00\x01\x02')
+    ]
+    assert rest == b''
+
+
+def test_partial_frames():
+    data = encode_frame(7, 'image/tiff', b'abcdef')
+    received = []
+    pending = b''
+    # Feed a byte at a time
+    for i in range(len(data)):
+        (frames, pending) = decode_frames(pending + data[i:i + 1])
+        received += frames
+    assert received == [(7, 'image/tiff', b'abcdef')]
+    assert pending == b''
+
+
+def test_invalid_frame():
+    with pytest.raises(ValueError):
+        decode_frames(b'X' * HEADER.size)
+
+
+def test_frame_buffer_is_bounded():
+    buffer = FrameBuffer(max_frames=3, max_bytes=10)
+    for i in range(5):
+        buffer['frame_%d' % i] = b'ab'
+    assert len(buffer) == 3
+    assert 'frame_1' not in buffer
+    assert buffer['frame_4'] == b'ab'
+
+    buffer['large'] = b'x' * 9
+    assert len(buffer) == 1
+    assert buffer.size == 9
+
+    # The latest is kept even if it is over the limit
+    buffer['larger'] = b'x' * 20
+    assert len(buffer) == 1
+    assert buffer['larger'] == b'x' * 20
@@ -147,3 +147,41 @@ def test_method_list_params(handler):
     })
 
     assert response == expected
+
+
+def test_batch(handler):
+    calls = []
+
+    def test(value):
+        calls.append(value)
+        return value * 2
+
+    handler.add_method('test', test)
+
+    requests = [
+        jsonrpc_message({
+            'id': 1,
+            'method': 'test',
+            'params': [1]
+        }),
+        jsonrpc_message({
+            'id': 2,
+            'method': 'foo'
+        }),
+        jsonrpc_message({
+            'id': 3,
+            'method': 'test',
+            'params': {
+                'value': 3
+            }
+        })
+    ]
+    responses = handler.batch(requests)
+    assert calls == [1, 3]
+    assert [response['id'] for response in responses] == [1, 2, 3]
+    assert responses[0]['result'] == 2
+    assert responses[1]['error']['code'] == -32601
+    assert responses[2]['result'] == 6
+
+    response = handler.batch([])
+    assert response['error']['code'] == -32600
@@ -1,10 +1,13 @@
 import requests
 import hashlib
+import json
 import os
 import tempfile
 import pytest
 
 from tomviz.jsonrpc import jsonrpc_message
+from tomviz.acquisition.frames import (decode_frames, JSON_MIME_TYPE,
+                                       STREAM_MIME_TYPE)
 from tests.mock.source import ApiAdapter
 
 
@@ -268,6 +271,73 @@ def test_describe(acquisition_server):
     assert error == expected
 
 
+def test_batch(acquisition_server):
+    batch = [
+        jsonrpc_message({
+            'id': 1,
+            'method': 'tilt_params',
+            'params': {
+                'angle': 23
+            }
+        }),
+        jsonrpc_message({
+            'id': 2,
+            'method': 'acquisition_params'
+        })
+    ]
+
+    response = requests.post(acquisition_server.url, json=batch)
+    assert response.status_code == 200
+    responses = response.json()
+    assert [r['id'] for r in responses] == [1, 2]
+    assert responses[0]['result'] == 23
+    assert 'test' in responses[1]['result']
+
+
+def test_stream(acquisition_server):
+    batch = [
+        jsonrpc_message({
+            'id': 1,
+            'method': 'tilt_params',
+            'params': {
+                'angle': 0
+            }
+        }),
+        jsonrpc_message({
+            'id': 2,
+            'method': 'stem_acquire'
+        }),
+        jsonrpc_message({
+            'id': 3,
+            'method': 'test'
+        })
+    ]
+
+    url = '%s/stream' % acquisition_server.url
+    response = requests.post(url, json=batch, stream=True)
+    assert response.status_code == 200
+    assert response.headers['Content-Type'] == STREAM_MIME_TYPE
+
+    (frames, rest) = decode_frames(response.content)
+    assert rest == b''
+    assert [frame[0] for frame in frames] == [0, 1, 2]
+
+    (_, mime_type, payload) = frames[0]
+    assert mime_type == JSON_MIME_TYPE
+    assert json.loads(payload.decode('utf8'))['result'] == 1
+
+    # The image is sent in the stream rather than as a URL to fetch it from
+    (_, mime_type, payload) = frames[1]
+    assert mime_type == 'image/tiff'
+    md5 = hashlib.md5()
+    md5.update(payload)
+    assert md5.hexdigest() == '7d185cd48e077baefaf7bc216488ee49'
+
+    (_, mime_type, payload) = frames[2]
+    assert mime_type == JSON_MIME_TYPE
+    assert json.loads(payload.decode('utf8'))['error']['code'] == -32601
+
+
 @pytest.fixture(scope='function')
 def sentinel_path1():
     path = os.path.join(tempfile.tempdir, 'adapter_sentinel1')
@@ -14,6 +14,9 @@ def main():
                         action='store_true')
     parser.add_argument('-e', '--dev', help='turn on dev mode',
                         action='store_true')
+    parser.add_argument('-m', '--mock',
+                        help='run the adapter against its mock instrument API',
+                        action='store_true')
     parser.add_argument('-r', '--redirect',
                         help='redirect stdout/stderr to log',
                         action='store_true')
@@ -0,0 +1,84 @@
+import struct
+from collections import OrderedDict
+
+# Each frame of a stream is a header of the magic, the index of the call the
+# frame answers, the length of the mime type and the length of the payload,
+# followed by the mime type and the payload.
+MAGIC = b'TVZF'
+HEADER = struct.Struct('<4sIII')
+
+STREAM_MIME_TYPE = 'application/x-tomviz-frames'
+JSON_MIME_TYPE = 'application/json'
+
+
+def encode_frame(index, mime_type, payload):
+    mime_type = mime_type.encode('ascii')
+
+    return HEADER.pack(MAGIC, index, len(mime_type), len(payload)) \
+        + mime_type + payload
+
+
+def decode_frames(data):
+    """
+    Splits data into frames.
+
+    :param data: The bytes received so far.
+    :type data: bytes
+    :returns: A list of the complete frames, as (index, mime type, payload)
+        tuples, and the bytes left over.
+    """
+    frames = []
+    offset = 0
+    while len(data) - offset >= HEADER.size:
+        (magic, index, mime_length, length) = \
+            HEADER.unpack_from(data, offset)
+        if magic != MAGIC:
+            raise ValueError('Invalid frame at offset %d.' % offset)
+
+        end = offset + HEADER.size + mime_length + length
+        if len(data) < end:
+            break
+
+        start = offset + HEADER.size
+        mime_type = data[start:start + mime_length].decode('ascii')
+        frames.append((index, mime_type, data[start + mime_length:end]))
+        offset = end
+
+    return (frames, data[offset:])
+
+
+class FrameBuffer(object):
+    """
+    The images kept for clients to fetch, the oldest are dropped once there
+    are more than max_frames of them or they take more than max_bytes.
+    """
+    def __init__(self, max_frames=16, max_bytes=256 * 1024 * 1024):
+        self.max_frames = max_frames
+        self.max_bytes = max_bytes
+        self._frames = OrderedDict()
+        self._bytes = 0
+
+    def __contains__(self, id):
+        return id in self._frames
+
+    def __getitem__(self, id):
+        return self._frames[id]
+
+    def __setitem__(self, id, data):
+        if id in self._frames:
+            self._bytes -= len(self._frames.pop(id))
+        self._frames[id] = data
+        self._bytes += len(data)
+
+        # Always keep the latest, even if it is larger than max_bytes
+        while len(self._frames) > 1 and (len(self._frames) > self.max_frames or
+                                         self._bytes > self.max_bytes):
+            (_, oldest) = self._frames.popitem(last=False)
+            self._bytes -= len(oldest)
+
+    def __len__(self):
+        return len(self._frames)
+
+    @property
+    def size(self):
+        return self._bytes
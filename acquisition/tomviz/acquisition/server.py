@@ -1,3 +1,5 @@
+import itertools
+import json
 import os
 import sys
 import tempfile
@@ -12,6 +14,7 @@ import tomviz
 from tomviz import jsonrpc
 from tomviz.utility import inject
 from tomviz.acquisition import AbstractSource
+from tomviz.acquisition import frames
 import shutil
 
 # For python 3
@@ -25,6 +28,9 @@ ADAPTER = 'tests.mock.source.ApiAdapter'
 HOST = 'localhost'
 PORT = 8080
 LOG_BUF_SIZE = 65536
+# The most images, and bytes of them, kept for clients to fetch
+MAX_BUFFERED_FRAMES = 16
+MAX_BUFFERED_BYTES = 256 * 1024 * 1024
 
 logger = logging.getLogger('tomviz')
 app = Bottle()
@@ -49,6 +55,23 @@ def _load_source_adapter(source_adapter):
     return cls
 
 
+def _use_mock_api(source_adapter):
+    """
+    Puts the mock instrument API that comes with the vendor of a source adapter
+    first on the path, so the adapter can be run without an instrument, to
+    develop or measure throughput against.
+    """
+    module = source_adapter.rsplit('.', 1)[0]
+    (parent, vendor) = module.rsplit('.', 1)
+    parent = importlib.import_module(parent)
+    mock_dir = os.path.join(os.path.dirname(parent.__file__), vendor, 'mock')
+    if not os.path.isdir(mock_dir):
+        raise Exception('Adapter %s has no mock API.' % source_adapter)
+
+    logger.info('Using mock API: %s', mock_dir)
+    sys.path.insert(0, mock_dir)
+
+
 def _setup_adapter(source_adapter):
     """
     Setup up the JSON-RPC endpoints for a give source adapter
@@ -63,7 +86,8 @@ def _setup_adapter(source_adapter):
                                AbstractSource.__name__]))
 
     source_adapter = cls()
-    slices = {}
+    slices = frames.FrameBuffer(MAX_BUFFERED_FRAMES, MAX_BUFFERED_BYTES)
+    slice_ids = itertools.count()
 
     @jsonrpc.endpoint(path='/acquisition')
     @inject(source_adapter)
@@ -104,20 +128,70 @@ def _setup_adapter(source_adapter):
         return '%s://%s' % (bottle.request.urlparts.scheme,
                             bottle.request.urlparts.netloc)
 
-    @jsonrpc.endpoint(path='/acquisition')
-    @inject(source_adapter)
-    def preview_scan(source_adapter):
-        id = 'preview_scan_slice'
-        slices[id] = source_adapter.preview_scan()
+    # The methods that return an image
+    image_methods = {
+        'preview_scan': source_adapter.preview_scan,
+        'stem_acquire': source_adapter.stem_acquire
+    }
+
+    def _store(method):
+        id = '%s_slice_%d' % (method, next(slice_ids))
+        slices[id] = image_methods[method]()
+
         return '%s/data/%s' % (_base_url(), id)
 
     @jsonrpc.endpoint(path='/acquisition')
-    @inject(source_adapter)
-    def stem_acquire(source_adapter):
-        id = 'stem_acquire_slice'
-        slices[id] = source_adapter.stem_acquire()
+    def preview_scan():
+        return _store('preview_scan')
 
-        return '%s/data/%s' % (_base_url(), id)
+    @jsonrpc.endpoint(path='/acquisition')
+    def stem_acquire():
+        return _store('stem_acquire')
+
+    def _call(index, request):
+        method = None
+        if isinstance(request, dict):
+            method = request.get('method')
+
+        if method in image_methods:
+            try:
+                image = image_methods[method]()
+            except Exception as ex:
+                logger.exception('%s failed', method)
+                response = jsonrpc.jsonrpc_message({
+                    'id': request.get('id'),
+                    'error': jsonrpc.ServerError(message=str(ex)).to_json()
+                })
+            else:
+                return frames.encode_frame(index, 'image/tiff', image)
+        else:
+            response = jsonrpc.endpoint_map['/acquisition'].rpc(request)
+
+        return frames.encode_frame(index, frames.JSON_MIME_TYPE,
+                                   json.dumps(response).encode('utf8'))
+
+    @route('/acquisition/stream', method='POST')
+    def stream():
+        """
+        Calls each of a batch of JSON-RPC requests in turn, streaming a frame
+        back as each call returns. Images are sent as they are rather than
+        stored to be fetched, and the next call is only made once the frame
+        before it has been written, so at most one image is buffered.
+        """
+        try:
+            requests = json.loads(bottle.request.body.read().decode('utf8'))
+        except ValueError:
+            raise HTTPResponse(body='Invalid JSON.', status=400)
+        if isinstance(requests, dict):
+            requests = [requests]
+        if not isinstance(requests, list):
+            raise HTTPResponse(body='Expected a list of requests.',
+                               status=400)
+
+        bottle.response.content_type = frames.STREAM_MIME_TYPE
+
+        return (_call(index, request) for (index, request)
+                in enumerate(requests))
 
     @route('/data/<id>')
     def data(id):
@@ -213,7 +287,13 @@ def setup(adapter=None, dev=False):
     route('/log/<log>')(_log)
 
 
-def start(host=HOST, port=PORT, debug=True, dev=False, adapter=ADAPTER):
+def start(host=HOST, port=PORT, debug=True, dev=False, adapter=ADAPTER,
+          mock=False):
+    if adapter is None:
+        adapter = ADAPTER
+    if mock:
+        _use_mock_api(adapter)
+
     with app:
         setup(adapter, dev)
         logger.info('Starting HTTP server')
@@ -2,9 +2,12 @@ import sys
 import math
 from tomviz.acquisition import AbstractSource
 from tomviz.acquisition import describe
+try:
+    from StringIO import StringIO as BytesIO
+except ImportError:
+    from io import BytesIO
 import numpy as np
 import scipy.misc
-import StringIO
 import win32com.client
 sys.path.append('c:/titan/Scripting')
 import TemScripting # noqa
@@ -155,7 +158,7 @@ class FeiAdapter(AbstractSource):
         image = image_set(0)
         data = np.array(image.AsSafeArray)
         data = np.fliplr(np.rot90(data, 3))
-        fp = StringIO.StringIO()
+        fp = BytesIO()
         scipy.misc.imsave(fp, data, 'tiff')
 
         return fp.getvalue()
@@ -83,6 +83,12 @@ class JsonRpcHandler(object):
 
     def rpc(self, request):
 
+        if not isinstance(request, dict):
+            return jsonrpc_message({
+                'id': None,
+                'error': InvalidRequest().to_json()
+            })
+
         jsonrpc = request.get('jsonrpc')
         id = request.get('id')
         method = request.get('method')
@@ -116,6 +122,20 @@ class JsonRpcHandler(object):
                 'error': err.to_json()
             })
 
+    def batch(self, requests):
+        """
+        Calls each of a batch of requests in turn.
+
+        :returns: The list of responses, in the order of the requests.
+        """
+        if not requests:
+            return jsonrpc_message({
+                'id': None,
+                'error': InvalidRequest().to_json()
+            })
+
+        return [self.rpc(request) for request in requests]
+
     def _response(self, id, result):
         response = {
             'jsonrpc': JSONRPC_VERSION,
@@ -160,6 +180,13 @@ class endpoint(object):
                             message='Invalid JSON.',
                             data=json.dumps(traceback.format_exc()))
 
+                    # A batch is answered with a list of responses, which
+                    # bottle doesn't serialize itself.
+                    if isinstance(json_body, list):
+                        response = self._endpoint.batch(json_body)
+                        bottle.response.content_type = 'application/json'
+                        return json.dumps(response)
+
                     response = self._endpoint.rpc(json_body)
                     # If we have error set the HTTP status code
                     if 'error' in response:
@@ -169,8 +196,11 @@ class endpoint(object):
 
                     return response
                 except JsonRpcError as err:
+                    id = None
+                    if isinstance(json_body, dict):
+                        id = json_body.get('id')
                     return jsonrpc_message({
-                        'id': json_body.get('id'),
+                        'id': id,
                         'error': err.to_json()
                     })
 
@@ -29,6 +29,7 @@
 #include <QSignalSpy>
 #include <QString>
 #include <QTest>
+#include <QtEndian>
 
 #include "AcquisitionClient.h"
 #include "OperatorPython.h"
@@ -241,6 +242,91 @@ private slots:
     QCOMPARE(fooDescription.toObject(), fooExpected);
   }
 
+  void frameReaderTest()
+  {
+    auto encode = [](int index, const QByteArray& mimeType,
+                     const QByteArray& payload) {
+      QByteArray bytes("TVZF");
+      uchar field[4];
+      foreach (int value, QList<int>()
+                            << index << mimeType.size() << payload.size()) {
+        qToLittleEndian<quint32>(value, field);
+        bytes.append(reinterpret_cast<const char*>(field), 4);
+      }
+      return bytes + mimeType + payload;
+    };
+    QByteArray image(100000, 'x');
+    QByteArray stream = encode(0, "application/json", "{\"result\": 1}") +
+                        encode(1, "image/tiff", image);
+
+    // Frames split at any byte are put back together.
+    foreach (int chunkSize, QList<int>() << 1 << 7 << 4096 << stream.size()) {
+      AcquisitionFrameReader reader;
+      QList<AcquisitionFrameReader::Frame> frames;
+      AcquisitionFrameReader::Frame frame;
+      for (int i = 0; i < stream.size(); i += chunkSize) {
+        reader.append(stream.mid(i, chunkSize));
+        while (reader.takeFrame(frame)) {
+          frames.append(frame);
+        }
+      }
+      QVERIFY(reader.isValid());
+      QVERIFY(!reader.hasPartialFrame());
+      QCOMPARE(frames.size(), 2);
+      QCOMPARE(frames[0].index, 0);
+      QCOMPARE(frames[0].mimeType, QString("application/json"));
+      QCOMPARE(frames[0].payload, QByteArray("{\"result\": 1}"));
+      QCOMPARE(frames[1].index, 1);
+      QCOMPARE(frames[1].mimeType, QString("image/tiff"));
+      QCOMPARE(frames[1].payload, image);
+    }
+
+    AcquisitionFrameReader reader;
+    AcquisitionFrameReader::Frame frame;
+    reader.append(stream.left(AcquisitionFrameReader::headerSize + 4));
+    QVERIFY(!reader.takeFrame(frame));
+    QVERIFY(reader.hasPartialFrame());
+
+    AcquisitionFrameReader invalid;
+    invalid.append(QByteArray(AcquisitionFrameReader::headerSize, 'x'));
+    QVERIFY(!invalid.takeFrame(frame));
+    QVERIFY(!invalid.isValid());
+  }
+
+  void tiltSeriesStreamTest()
+  {
+    AcquisitionClient client(this->url);
+    AcquisitionClientStreamRequest* request =
+      client.tilt_series(QVector<double>() << 0.0 << 3.0);
+
+    QSignalSpy error(request, &AcquisitionClientStreamRequest::error);
+    QSignalSpy results(request,
+                       &AcquisitionClientStreamRequest::resultReceived);
+    QSignalSpy images(request, &AcquisitionClientStreamRequest::imageReceived);
+    QSignalSpy finished(request, &AcquisitionClientStreamRequest::finished);
+    // The mock stage takes a couple of seconds to tilt.
+    finished.wait(20000);
+
+    if (!error.isEmpty()) {
+      qDebug() << error;
+    }
+    QVERIFY(error.isEmpty());
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(results.size(), 2);
+    QCOMPARE(results[0].at(0).toInt(), 0);
+    QCOMPARE(results[0].at(1).toJsonValue().toDouble(), 1.0);
+    QCOMPARE(results[1].at(0).toInt(), 2);
+    QCOMPARE(results[1].at(1).toJsonValue().toDouble(), 3.0);
+
+    QCOMPARE(images.size(), 2);
+    QCOMPARE(images[0].at(0).toInt(), 1);
+    QCOMPARE(images[1].at(0).toInt(), 3);
+    QCOMPARE(images[0].at(1).toString(), QString("image/tiff"));
+    QCryptographicHash hash(QCryptographicHash::Algorithm::Md5);
+    hash.addData(images[0].at(2).toByteArray());
+    QCOMPARE(hash.result().toHex().data(), "7d185cd48e077baefaf7bc216488ee49");
+  }
+
 private:
   QProcess* server;
   bool serverStarted = false;
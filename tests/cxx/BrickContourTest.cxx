@@ -0,0 +1,145 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+#include <array>
+#include <cmath>
+#include <map>
+
+#include "BrickContour.h"
+
+using namespace tomviz;
+
+namespace {
+
+// Distance from the center of a 40 x 50 x 45 volume.
+void makeSphere(vtkImageData* image)
+{
+  image->SetExtent(0, 39, 0, 49, 0, 44);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  for (int z = 0; z < 45; ++z) {
+    for (int y = 0; y < 50; ++y) {
+      for (int x = 0; x < 40; ++x) {
+        *values++ = static_cast<float>(
+          std::sqrt((x - 20.0) * (x - 20.0) + (y - 25.0) * (y - 25.0) +
+                    (z - 22.0) * (z - 22.0)));
+      }
+    }
+  }
+}
+}
+
+TEST(BrickContourTest, bricks_cover_extent)
+{
+  vtkNew<vtkImageData> image;
+  makeSphere(image.Get());
+
+  auto bricks = BrickContour::bricks(image.Get(), 16);
+  // 39, 49 and 44 cells split into bricks of at most 16.
+  ASSERT_EQ(bricks.size(), 3u * 4u * 3u);
+  ASSERT_EQ(bricks[0].extent[0], 0);
+  ASSERT_EQ(bricks[0].extent[1], 16);
+  ASSERT_EQ(bricks[1].extent[0], 16);
+  ASSERT_EQ(bricks.back().extent[1], 39);
+  ASSERT_EQ(bricks.back().extent[3], 49);
+  ASSERT_EQ(bricks.back().extent[5], 44);
+
+  // The first brick runs from its corner nearest the center to the corner
+  // of the volume.
+  ASSERT_FLOAT_EQ(bricks[0].range[0], std::sqrt(4.0f * 4 + 9 * 9 + 6 * 6));
+  ASSERT_FLOAT_EQ(bricks[0].range[1],
+                  std::sqrt(20.0f * 20 + 25 * 25 + 22 * 22));
+}
+
+TEST(BrickContourTest, bricks_match_whole_contour)
+{
+  vtkNew<vtkImageData> image;
+  makeSphere(image.Get());
+  const double value = 15.5;
+
+  vtkNew<vtkFlyingEdges3D> flyingEdges;
+  flyingEdges->SetInputData(image.Get());
+  flyingEdges->SetValue(0, value);
+  flyingEdges->Update();
+  vtkIdType expected = flyingEdges->GetOutput()->GetNumberOfPolys();
+  ASSERT_GT(expected, 0);
+
+  // Each cell is in one brick, so the bricks make the same triangles, and
+  // the bricks outside the value's range make none.
+  vtkIdType polys = 0;
+  int contoured = 0;
+  auto bricks = BrickContour::bricks(image.Get(), 16);
+  for (const auto& brick : bricks) {
+    auto surface = BrickContour::contour(image.Get(), brick.extent, value);
+    if (brick.range[0] <= value && value <= brick.range[1]) {
+      polys += surface->GetNumberOfPolys();
+      ++contoured;
+    } else {
+      ASSERT_EQ(surface->GetNumberOfPolys(), 0);
+    }
+  }
+  ASSERT_EQ(polys, expected);
+  ASSERT_LT(contoured, static_cast<int>(bricks.size()));
+}
+
+TEST(BrickContourTest, shared_points_get_equal_normals)
+{
+  vtkNew<vtkImageData> image;
+  makeSphere(image.Get());
+  const double value = 15.5;
+
+  // Points on the faces between bricks are made by both bricks, from the
+  // same edge, so they must get the same normal or the surface shows seams.
+  std::map<std::array<double, 3>, std::array<double, 3>> normals;
+  int shared = 0;
+  for (const auto& brick : BrickContour::bricks(image.Get(), 16)) {
+    auto surface = BrickContour::contour(image.Get(), brick.extent, value);
+    if (surface->GetNumberOfPoints() == 0) {
+      continue;
+    }
+    vtkDataArray* brickNormals = surface->GetPointData()->GetNormals();
+    ASSERT_NE(brickNormals, nullptr);
+    for (vtkIdType i = 0; i < surface->GetNumberOfPoints(); ++i) {
+      std::array<double, 3> point, normal;
+      surface->GetPoint(i, point.data());
+      brickNormals->GetTuple(i, normal.data());
+      // Normals point down the gradient, into the sphere.
+      double dot = (point[0] - 20.0) * normal[0] +
+                   (point[1] - 25.0) * normal[1] +
+                   (point[2] - 22.0) * normal[2];
+      ASSERT_LT(dot / value, -0.99);
+
+      auto found = normals.find(point);
+      if (found == normals.end()) {
+        normals[point] = normal;
+        continue;
+      }
+      ++shared;
+      for (int j = 0; j < 3; ++j) {
+        ASSERT_NEAR(found->second[j], normal[j], 1e-6);
+      }
+    }
+  }
+  ASSERT_GT(shared, 0);
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include "CopyOnWrite.h"
+
+using namespace tomviz;
+
+TEST(CopyOnWriteTest, detach_copies_shared_arrays_once)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(8, 8, 8);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  vtkNew<vtkFloatArray> angles;
+  angles->SetName("tilt_angles");
+  angles->SetNumberOfTuples(8);
+  image->GetFieldData()->AddArray(angles.Get());
+
+  vtkSmartPointer<vtkDataObject> copy;
+  copy.TakeReference(CopyOnWrite::sharedCopy(image.Get()));
+  vtkImageData* shared = vtkImageData::SafeDownCast(copy);
+  ASSERT_EQ(shared->GetPointData()->GetScalars(),
+            image->GetPointData()->GetScalars());
+  ASSERT_NE(shared->GetFieldData()->GetArray("tilt_angles"), angles.Get());
+
+  // The first detach copies the scalars, and keeps them active.
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  qint64 bytes = static_cast<qint64>(scalars->GetActualMemorySize()) * 1024;
+  ASSERT_EQ(CopyOnWrite::detach(shared), bytes);
+  ASSERT_NE(shared->GetPointData()->GetScalars(),
+            image->GetPointData()->GetScalars());
+  ASSERT_NE(shared->GetPointData()->GetScalars(), nullptr);
+  ASSERT_EQ(CopyOnWrite::detach(shared), 0);
+  ASSERT_EQ(CopyOnWrite::detach(image.Get()), 0);
+}
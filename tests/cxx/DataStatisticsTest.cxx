@@ -0,0 +1,55 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkTable.h>
+
+#include "DataStatistics.h"
+
+using namespace tomviz;
+
+TEST(DataStatisticsTest, statistics_follow_modifications)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(10, 10, 10);
+  image->AllocateScalars(VTK_DOUBLE, 1);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  for (vtkIdType i = 0; i < 1000; ++i) {
+    scalars->SetTuple1(i, i);
+  }
+
+  auto& statistics = DataStatistics::instance();
+  ASSERT_EQ(statistics.histogram(image.Get(), false).Get(), nullptr);
+  auto histogram = statistics.histogram(image.Get());
+  ASSERT_NE(histogram.Get(), nullptr);
+  ASSERT_EQ(statistics.histogram(image.Get(), false).Get(), histogram.Get());
+
+  double range[2];
+  statistics.range(image.Get(), range);
+  ASSERT_EQ(range[0], 0.0);
+  ASSERT_EQ(range[1], 999.0);
+
+  // Modifying the data drops everything computed for it.
+  scalars->SetTuple1(0, -1000.0);
+  scalars->Modified();
+  ASSERT_EQ(statistics.histogram(image.Get(), false).Get(), nullptr);
+  statistics.range(image.Get(), range);
+  ASSERT_EQ(range[0], -1000.0);
+}
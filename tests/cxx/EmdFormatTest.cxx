@@ -0,0 +1,246 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include <QTemporaryDir>
+
+#include "EmdFormat.h"
+
+#include "vtk_hdf5.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace tomviz;
+
+namespace {
+
+// No chunk shape used below divides these, so the chunks on the far edges are
+// partial.
+const int dims[3] = { 37, 29, 23 };
+
+// Unsigned shorts whose bytes both vary from voxel to voxel, so misplaced
+// chunks or shuffled bytes show.
+void createVolume(vtkImageData* image)
+{
+  image->SetDimensions(dims[0], dims[1], dims[2]);
+  image->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto values = static_cast<unsigned short*>(image->GetScalarPointer());
+  for (int i = 0; i < dims[0] * dims[1] * dims[2]; ++i) {
+    values[i] = static_cast<unsigned short>(i * 257 + i / 7);
+  }
+}
+
+// Counts the voxels of image that differ from the voxels of volume, which
+// starts at the origin, in the extent of image.
+int mismatches(vtkImageData* volume, vtkImageData* image)
+{
+  int extent[6];
+  image->GetExtent(extent);
+  auto expected = static_cast<unsigned short*>(volume->GetScalarPointer());
+  auto values = static_cast<unsigned short*>(image->GetScalarPointer());
+  int count = 0;
+  for (int z = extent[4]; z <= extent[5]; ++z) {
+    for (int y = extent[2]; y <= extent[3]; ++y) {
+      for (int x = extent[0]; x <= extent[1]; ++x) {
+        count += *values++ != expected[(z * dims[1] + y) * dims[0] + x];
+      }
+    }
+  }
+  return count;
+}
+
+void expectExtent(vtkImageData* image, const int expected[6])
+{
+  int extent[6];
+  image->GetExtent(extent);
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(extent[i], expected[i]);
+  }
+}
+
+void setAttribute(hid_t objectId, const char* name, int value)
+{
+  hid_t dataspaceId = H5Screate(H5S_SCALAR);
+  hid_t attributeId = H5Acreate(objectId, name, H5T_STD_U32LE, dataspaceId,
+                                H5P_DEFAULT, H5P_DEFAULT);
+  H5Awrite(attributeId, H5T_NATIVE_INT, &value);
+  H5Aclose(attributeId);
+  H5Sclose(dataspaceId);
+}
+}
+
+TEST(EmdFormatTest, round_trip_each_layout)
+{
+  vtkNew<vtkImageData> volume;
+  createVolume(volume.Get());
+  const int full[6] = { 0, dims[0] - 1, 0, dims[1] - 1, 0, dims[2] - 1 };
+
+  typedef EmdFormat::WriteOptions Options;
+  Options chunked;
+  chunked.chunkShape[0] = 16;
+  chunked.chunkShape[1] = 8;
+  chunked.chunkShape[2] = 5;
+  Options deflate = chunked;
+  deflate.compression = Options::Deflate;
+  deflate.shuffle = false;
+  Options shuffle = deflate;
+  shuffle.shuffle = true;
+  // LZ4 when the plugin is there, and a fast deflate otherwise.
+  Options fast = shuffle;
+  fast.compression = Options::Fast;
+  Options contiguous;
+  contiguous.contiguous = true;
+  const Options layouts[] = { chunked, deflate, shuffle, fast, contiguous };
+
+  QTemporaryDir directory;
+  ASSERT_TRUE(directory.isValid());
+  std::string fileName = directory.filePath("volume.emd").toStdString();
+  for (const auto& options : layouts) {
+    EmdFormat writer;
+    ASSERT_TRUE(writer.write(fileName, volume.Get(), options));
+    EmdFormat reader;
+    vtkNew<vtkImageData> image;
+    ASSERT_TRUE(reader.read(fileName, image.Get()));
+    ASSERT_EQ(image->GetScalarType(), VTK_UNSIGNED_SHORT);
+    expectExtent(image.Get(), full);
+    EXPECT_EQ(mismatches(volume.Get(), image.Get()), 0);
+  }
+}
+
+TEST(EmdFormatTest, read_sub_extent)
+{
+  vtkNew<vtkImageData> volume;
+  createVolume(volume.Get());
+
+  typedef EmdFormat::WriteOptions Options;
+  Options chunked;
+  chunked.chunkShape[0] = 16;
+  chunked.chunkShape[1] = 8;
+  chunked.chunkShape[2] = 5;
+  Options deflate = chunked;
+  deflate.compression = Options::Deflate;
+  // Read through a hyperslab by HDF5, and chunk by chunk across threads.
+  const Options layouts[] = { chunked, deflate };
+
+  QTemporaryDir directory;
+  ASSERT_TRUE(directory.isValid());
+  std::string fileName = directory.filePath("volume.emd").toStdString();
+  for (const auto& options : layouts) {
+    EmdFormat writer;
+    ASSERT_TRUE(writer.write(fileName, volume.Get(), options));
+
+    // Starting and ending inside chunks.
+    const int extent[6] = { 5, 30, 3, 17, 7, 20 };
+    EmdFormat reader;
+    vtkNew<vtkImageData> image;
+    ASSERT_TRUE(reader.read(fileName, image.Get(), extent));
+    expectExtent(image.Get(), extent);
+    EXPECT_EQ(mismatches(volume.Get(), image.Get()), 0);
+
+    // Extents reaching outside of the volume are clamped to it.
+    const int beyond[6] = { -4, 12, 20, 100, 22, 40 };
+    const int clamped[6] = { 0, 12, 20, dims[1] - 1, 22, 22 };
+    vtkNew<vtkImageData> edge;
+    ASSERT_TRUE(reader.read(fileName, edge.Get(), beyond));
+    expectExtent(edge.Get(), clamped);
+    EXPECT_EQ(mismatches(volume.Get(), edge.Get()), 0);
+
+    const int outside[6] = { 40, 50, 0, 1, 0, 1 };
+    vtkNew<vtkImageData> empty;
+    EXPECT_FALSE(reader.read(fileName, empty.Get(), outside));
+  }
+}
+
+TEST(EmdFormatTest, read_file_filtered_by_hdf5)
+{
+  vtkNew<vtkImageData> volume;
+  createVolume(volume.Get());
+
+  // Written through the filter pipeline of HDF5 rather than by EmdFormat,
+  // as other programs write their files, with only the first slices of the
+  // volume written and the chunks after them left unallocated.
+  QTemporaryDir directory;
+  ASSERT_TRUE(directory.isValid());
+  std::string fileName = directory.filePath("filtered.emd").toStdString();
+  const int written = 12;
+  hid_t fileId =
+    H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+  ASSERT_GE(fileId, 0);
+  setAttribute(fileId, "version_major", 0);
+  setAttribute(fileId, "version_minor", 2);
+  hid_t dataGroupId =
+    H5Gcreate(fileId, "/data", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  hid_t tomographyId = H5Gcreate(fileId, "/data/tomography", H5P_DEFAULT,
+                                 H5P_DEFAULT, H5P_DEFAULT);
+  setAttribute(tomographyId, "emd_group_type", 1);
+  const hsize_t h5dims[3] = { static_cast<hsize_t>(dims[2]),
+                              static_cast<hsize_t>(dims[1]),
+                              static_cast<hsize_t>(dims[0]) };
+  const hsize_t chunk[3] = { 5, 8, 16 };
+  hid_t propertiesId = H5Pcreate(H5P_DATASET_CREATE);
+  H5Pset_chunk(propertiesId, 3, chunk);
+  H5Pset_shuffle(propertiesId);
+  H5Pset_deflate(propertiesId, 6);
+  hid_t dataspaceId = H5Screate_simple(3, h5dims, nullptr);
+  hid_t datasetId = H5Dcreate(tomographyId, "data", H5T_STD_U16LE,
+                              dataspaceId, H5P_DEFAULT, propertiesId,
+                              H5P_DEFAULT);
+  const hsize_t start[3] = { 0, 0, 0 };
+  const hsize_t count[3] = { written, h5dims[1], h5dims[2] };
+  hid_t memspaceId = H5Screate_simple(3, count, nullptr);
+  H5Sselect_hyperslab(dataspaceId, H5S_SELECT_SET, start, nullptr, count,
+                      nullptr);
+  herr_t status = H5Dwrite(datasetId, H5T_NATIVE_USHORT, memspaceId,
+                           dataspaceId, H5P_DEFAULT,
+                           volume->GetScalarPointer());
+  H5Sclose(memspaceId);
+  H5Dclose(datasetId);
+  H5Sclose(dataspaceId);
+  H5Pclose(propertiesId);
+  H5Gclose(tomographyId);
+  H5Gclose(dataGroupId);
+  H5Fclose(fileId);
+  ASSERT_GE(status, 0);
+
+  // The slices that were not written read as zeros.
+  auto values = static_cast<unsigned short*>(volume->GetScalarPointer());
+  std::fill(values + written * dims[0] * dims[1],
+            values + dims[0] * dims[1] * dims[2], 0);
+
+  EmdFormat reader;
+  int fileDims[3] = { 0, 0, 0 };
+  int valueSize = 0;
+  ASSERT_TRUE(reader.dimensions(fileName, fileDims, valueSize));
+  EXPECT_EQ(fileDims[0], dims[0]);
+  EXPECT_EQ(fileDims[1], dims[1]);
+  EXPECT_EQ(fileDims[2], dims[2]);
+  EXPECT_EQ(valueSize, 2);
+
+  vtkNew<vtkImageData> image;
+  ASSERT_TRUE(reader.read(fileName, image.Get()));
+  EXPECT_EQ(mismatches(volume.Get(), image.Get()), 0);
+
+  const int extent[6] = { 9, 33, 2, 26, 8, 16 };
+  vtkNew<vtkImageData> region;
+  ASSERT_TRUE(reader.read(fileName, region.Get(), extent));
+  expectExtent(region.Get(), extent);
+  EXPECT_EQ(mismatches(volume.Get(), region.Get()), 0);
+}
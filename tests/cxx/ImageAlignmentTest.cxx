@@ -0,0 +1,108 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include "ImageAlignment.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomviz;
+
+namespace {
+
+double pattern(double x, double y)
+{
+  // Blobs at pseudo random positions, so there is a single best match.
+  double value = 0.0;
+  unsigned int seed = 12345;
+  for (int i = 0; i < 200; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    double bx = (seed >> 8) % 1000 - 100.0;
+    seed = seed * 1103515245u + 12345u;
+    double by = (seed >> 8) % 200 - 50.0;
+    double r2 = (x - bx) * (x - bx) + (y - by) * (y - by);
+    value += std::exp(-r2 / 18.0);
+  }
+  return value;
+}
+
+// Fills slice z with the pattern moved by (dx, dy).
+void fill(float* values, int nx, int ny, double dx, double dy)
+{
+  for (int y = 0; y < ny; ++y) {
+    for (int x = 0; x < nx; ++x) {
+      *values++ = static_cast<float>(pattern(x - dx, y - dy));
+    }
+  }
+}
+}
+
+TEST(ImageAlignmentTest, subpixel_shift)
+{
+  const int nx = 96, ny = 80;
+  std::vector<float> image(nx * ny), reference(nx * ny);
+  fill(reference.data(), nx, ny, 0.0, 0.0);
+  fill(image.data(), nx, ny, 4.3, -2.6);
+
+  vtkVector2d shift =
+    ImageAlignment::crossCorrelationShift(image.data(), reference.data(), nx,
+                                          ny);
+  ASSERT_NEAR(shift[0], -4.3, 0.1);
+  ASSERT_NEAR(shift[1], 2.6, 0.1);
+}
+
+TEST(ImageAlignmentTest, tilt_series_on_pyramid)
+{
+  // Wider than the coarsest level, so the shifts are refined on the pyramid.
+  const int nx = ImageAlignment::coarsestSize + 200, ny = 64;
+  const double moved[4][2] = { { 0, 0 }, { 3, -1 }, { -7, 2 }, { 1, 5 } };
+
+  vtkNew<vtkImageData> series;
+  series->SetDimensions(nx, ny, 4);
+  series->AllocateScalars(VTK_FLOAT, 1);
+  vtkNew<vtkFloatArray> angles;
+  angles->SetName("tilt_angles");
+  for (int i = 0; i < 4; ++i) {
+    angles->InsertNextValue(-40.0f + 20.0f * i);
+    fill(static_cast<float*>(series->GetScalarPointer(0, 0, i)), nx, ny,
+         moved[i][0], moved[i][1]);
+  }
+  series->GetFieldData()->AddArray(angles.Get());
+
+  // Slice 2 has the tilt angle closest to zero.
+  ASSERT_EQ(ImageAlignment::referenceSlice(series.Get()), 2);
+  auto shifts = ImageAlignment::alignTiltSeries(series.Get());
+  ASSERT_EQ(shifts.size(), 4u);
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_NEAR(shifts[i][0], moved[2][0] - moved[i][0], 0.1);
+    ASSERT_NEAR(shifts[i][1], moved[2][1] - moved[i][1], 0.1);
+  }
+
+  int calls = 0;
+  auto stopped = ImageAlignment::alignTiltSeries(series.Get(), 0,
+                                                 [&calls](int) {
+                                                   ++calls;
+                                                   return false;
+                                                 });
+  ASSERT_TRUE(stopped.empty());
+  ASSERT_GE(calls, 1);
+}
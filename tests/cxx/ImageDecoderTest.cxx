@@ -0,0 +1,104 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkTIFFWriter.h>
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include "ImageDecoder.h"
+
+using namespace tomviz;
+
+namespace {
+
+void createImage(vtkImageData* image, int scalarType)
+{
+  image->SetDimensions(7, 5, 1);
+  image->AllocateScalars(scalarType, 1);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+    scalars->SetTuple1(i, i * 3 + 1);
+  }
+}
+
+void expectEqual(vtkImageData* image, vtkImageData* decoded)
+{
+  ASSERT_NE(decoded, nullptr);
+  int dims[3];
+  decoded->GetDimensions(dims);
+  ASSERT_EQ(dims[0], 7);
+  ASSERT_EQ(dims[1], 5);
+  ASSERT_EQ(dims[2], 1);
+  vtkDataArray* expected = image->GetPointData()->GetScalars();
+  vtkDataArray* scalars = decoded->GetPointData()->GetScalars();
+  ASSERT_EQ(scalars->GetDataType(), expected->GetDataType());
+  for (vtkIdType i = 0; i < expected->GetNumberOfTuples(); ++i) {
+    ASSERT_EQ(scalars->GetTuple1(i), expected->GetTuple1(i));
+  }
+}
+}
+
+TEST(ImageDecoderTest, raw_round_trip)
+{
+  vtkNew<vtkImageData> image;
+  createImage(image.Get(), VTK_FLOAT);
+  QByteArray raw = ImageDecoder::encodeRaw(image.Get());
+  ASSERT_EQ(raw.size(), ImageDecoder::rawHeaderSize + 7 * 5 * 4);
+
+  QString errorMessage;
+  auto decoded =
+    ImageDecoder::decode(ImageDecoder::rawMimeType, raw, &errorMessage);
+  expectEqual(image.Get(), decoded);
+  ASSERT_TRUE(errorMessage.isEmpty());
+}
+
+TEST(ImageDecoderTest, truncated_raw)
+{
+  vtkNew<vtkImageData> image;
+  createImage(image.Get(), VTK_UNSIGNED_SHORT);
+  QByteArray raw = ImageDecoder::encodeRaw(image.Get());
+  raw.chop(2);
+
+  QString errorMessage;
+  ASSERT_EQ(ImageDecoder::decodeRaw(raw, &errorMessage), nullptr);
+  ASSERT_FALSE(errorMessage.isEmpty());
+  ASSERT_EQ(ImageDecoder::decodeRaw(QByteArray("TVZR")), nullptr);
+}
+
+TEST(ImageDecoderTest, tiff_from_memory)
+{
+  vtkNew<vtkImageData> image;
+  createImage(image.Get(), VTK_UNSIGNED_SHORT);
+  QTemporaryFile file;
+  ASSERT_TRUE(file.open());
+  file.close();
+  vtkNew<vtkTIFFWriter> writer;
+  writer->SetInputData(image.Get());
+  writer->SetFileName(file.fileName().toLatin1().data());
+  writer->Write();
+  ASSERT_TRUE(file.open());
+  QByteArray tiff = file.readAll();
+
+  expectEqual(image.Get(), ImageDecoder::decodeTiff(tiff));
+  ASSERT_EQ(ImageDecoder::decodeTiff(tiff.left(64)), nullptr);
+}
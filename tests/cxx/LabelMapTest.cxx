@@ -0,0 +1,210 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include "LabelMap.h"
+
+#include <cstdlib>
+#include <vector>
+
+using namespace tomviz;
+
+namespace {
+
+const int dims[3] = { 13, 9, 11 };
+
+int index(int x, int y, int z)
+{
+  return (z * dims[1] + y) * dims[0] + x;
+}
+
+bool inElement(LabelMap::Element element, int radius, int dx, int dy, int dz)
+{
+  switch (element) {
+    case LabelMap::Element::Box:
+      return std::abs(dx) <= radius && std::abs(dy) <= radius &&
+             std::abs(dz) <= radius;
+    case LabelMap::Element::Ball:
+      return dx * dx + dy * dy + dz * dz <= radius * radius + radius;
+    case LabelMap::Element::Cross:
+      return (dy == 0 && dz == 0 && std::abs(dx) <= radius) ||
+             (dx == 0 && dz == 0 && std::abs(dy) <= radius) ||
+             (dx == 0 && dy == 0 && std::abs(dz) <= radius);
+  }
+  return false;
+}
+
+// Dilates voxel by voxel over the whole structuring element.
+std::vector<unsigned char> referenceDilate(
+  const std::vector<unsigned char>& mask, LabelMap::Element element,
+  int radius)
+{
+  std::vector<unsigned char> result(mask.size(), 0);
+  for (int z = 0; z < dims[2]; ++z) {
+    for (int y = 0; y < dims[1]; ++y) {
+      for (int x = 0; x < dims[0]; ++x) {
+        for (int dz = -radius; dz <= radius; ++dz) {
+          for (int dy = -radius; dy <= radius; ++dy) {
+            for (int dx = -radius; dx <= radius; ++dx) {
+              int xs = x + dx, ys = y + dy, zs = z + dz;
+              if (xs >= 0 && ys >= 0 && zs >= 0 && xs < dims[0] &&
+                  ys < dims[1] && zs < dims[2] &&
+                  inElement(element, radius, dx, dy, dz) &&
+                  mask[index(xs, ys, zs)]) {
+                result[index(x, y, z)] = 1;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return result;
+}
+
+void createLabelMap(vtkImageData* image)
+{
+  image->SetDimensions(dims[0], dims[1], dims[2]);
+  image->AllocateScalars(VTK_SHORT, 1);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+    scalars->SetTuple1(i, 0);
+  }
+}
+}
+
+TEST(LabelMapTest, dilate_matches_reference)
+{
+  std::srand(3);
+  std::vector<unsigned char> mask(dims[0] * dims[1] * dims[2]);
+  for (auto& value : mask) {
+    value = std::rand() % 100 < 8;
+  }
+  for (auto element : { LabelMap::Element::Box, LabelMap::Element::Ball,
+                        LabelMap::Element::Cross }) {
+    for (int radius = 1; radius <= 3; ++radius) {
+      std::vector<unsigned char> dilated(mask);
+      LabelMap::dilate(dilated, dims, element, radius);
+      ASSERT_EQ(dilated, referenceDilate(mask, element, radius));
+    }
+  }
+}
+
+TEST(LabelMapTest, connected_components_by_size)
+{
+  vtkNew<vtkImageData> image;
+  createLabelMap(image.Get());
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  // A bar of 8 voxels along z, which crosses the slabs labeled separately,
+  // a plate of 6 voxels with two different values, and a single voxel.
+  for (int z = 1; z < 9; ++z) {
+    scalars->SetTuple1(index(1, 1, z), 5);
+  }
+  for (int x = 5; x < 8; ++x) {
+    scalars->SetTuple1(index(x, 4, 2), 1);
+    scalars->SetTuple1(index(x, 5, 2), 2);
+  }
+  scalars->SetTuple1(index(10, 7, 7), 3);
+
+  ASSERT_EQ(LabelMap::connectedComponents(image.Get(), 0), 3);
+  scalars = image->GetPointData()->GetScalars();
+  ASSERT_EQ(scalars->GetDataType(), VTK_UNSIGNED_SHORT);
+  ASSERT_EQ(scalars->GetTuple1(index(10, 7, 7)), 1);
+  ASSERT_EQ(scalars->GetTuple1(index(5, 4, 2)), 2);
+  ASSERT_EQ(scalars->GetTuple1(index(7, 5, 2)), 2);
+  for (int z = 1; z < 9; ++z) {
+    ASSERT_EQ(scalars->GetTuple1(index(1, 1, z)), 3);
+  }
+  ASSERT_EQ(scalars->GetTuple1(index(0, 0, 0)), 0);
+}
+
+TEST(LabelMapTest, measure_objects)
+{
+  vtkNew<vtkImageData> image;
+  createLabelMap(image.Get());
+  image->SetSpacing(0.5, 1.0, 2.0);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  // A 4 by 2 by 1 block, longest along x.
+  for (int x = 2; x < 6; ++x) {
+    for (int y = 3; y < 5; ++y) {
+      scalars->SetTuple1(index(x, y, 4), 7);
+    }
+  }
+  scalars->SetTuple1(index(0, 0, 0), 2);
+
+  std::vector<LabelMap::Object> objects;
+  ASSERT_TRUE(LabelMap::measureObjects(image.Get(), objects));
+  ASSERT_EQ(objects.size(), 2u);
+  ASSERT_EQ(objects[0].label, 2);
+  ASSERT_EQ(objects[1].label, 7);
+
+  const LabelMap::Object& block = objects[1];
+  ASSERT_EQ(block.voxels, 8);
+  ASSERT_DOUBLE_EQ(block.volume, 8 * 0.5 * 1.0 * 2.0);
+  ASSERT_DOUBLE_EQ(block.centroid[0], 3.5 * 0.5);
+  ASSERT_DOUBLE_EQ(block.centroid[1], 3.5);
+  ASSERT_DOUBLE_EQ(block.centroid[2], 8.0);
+
+  double axes[3][3];
+  block.principalAxes(axes);
+  ASSERT_NEAR(std::abs(axes[0][0]), 1.0, 1e-9);
+  ASSERT_NEAR(std::abs(axes[1][1]), 1.0, 1e-9);
+}
+
+TEST(LabelMapTest, sphere_surface_area)
+{
+  // A sphere of radius 5, sampled finer along x than along y and z.
+  const double radius = 5.0;
+  const double spacings[2][3] = { { 0.5, 0.5, 0.5 }, { 0.25, 0.5, 0.5 } };
+  for (const auto& spacing : spacings) {
+    int size[3];
+    for (int k = 0; k < 3; ++k) {
+      size[k] = static_cast<int>(2 * radius / spacing[k]) + 5;
+    }
+    vtkNew<vtkImageData> image;
+    image->SetDimensions(size);
+    image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    auto values = static_cast<unsigned char*>(image->GetScalarPointer());
+    for (int z = 0; z < size[2]; ++z) {
+      for (int y = 0; y < size[1]; ++y) {
+        for (int x = 0; x < size[0]; ++x) {
+          double p[3] = { x * spacing[0], y * spacing[1], z * spacing[2] };
+          double distance = 0.0;
+          for (int k = 0; k < 3; ++k) {
+            double d = p[k] - 0.5 * (size[k] - 1) * spacing[k];
+            distance += d * d;
+          }
+          *values++ = distance <= radius * radius ? 1 : 0;
+        }
+      }
+    }
+
+    std::vector<LabelMap::Object> objects;
+    ASSERT_TRUE(LabelMap::measureObjects(image.Get(), objects));
+    ASSERT_EQ(objects.size(), 1u);
+    // The area of the voxel faces would be half as large again.
+    double area = 4.0 * vtkMath::Pi() * radius * radius;
+    ASSERT_NEAR(objects[0].surfaceArea, area, 0.03 * area);
+  }
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <QtTest>
+
+#include <QTemporaryFile>
+
+#include <pqActiveObjects.h>
+#include <pqApplicationCore.h>
+#include <pqObjectBuilder.h>
+#include <pqPVApplicationCore.h>
+#include <pqServer.h>
+#include <pqServerResource.h>
+#include <pqSettings.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSMPropertyHelper.h>
+#include <vtkSMSessionProxyManager.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkSmartPointer.h>
+#include <vtkTrivialProducer.h>
+
+// Import the generated header to load our custom plugin
+#include "pvextensions/tomvizExtensions_Plugin.h"
+
+#include "ActiveObjects.h"
+#include "DataSource.h"
+#include "LoadDataReaction.h"
+
+#include <vector>
+
+PV_PLUGIN_IMPORT_INIT(tomvizExtensions)
+
+using namespace tomviz;
+
+class LoadDataReactionTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  pqPVApplicationCore* m_core = nullptr;
+  // A 4 x 3 x 2 volume of unsigned shorts, each the index of its voxel.
+  QTemporaryFile m_file;
+
+  vtkSmartPointer<vtkSMProxy> rawReader(bool lowerLeft)
+  {
+    vtkSmartPointer<vtkSMProxy> reader;
+    reader.TakeReference(ActiveObjects::instance().proxyManager()->NewProxy(
+      "sources", "TVRawImageReader"));
+    vtkSMPropertyHelper(reader, "FilePrefix")
+      .Set(m_file.fileName().toLatin1().data());
+    vtkSMPropertyHelper(reader, "DataScalarType").Set(VTK_UNSIGNED_SHORT);
+#ifdef VTK_WORDS_BIGENDIAN
+    vtkSMPropertyHelper(reader, "DataByteOrder").Set(0);
+#else
+    vtkSMPropertyHelper(reader, "DataByteOrder").Set(1);
+#endif
+    int extent[6] = { 0, 3, 0, 2, 0, 1 };
+    vtkSMPropertyHelper(reader, "DataExtent").Set(extent, 6);
+    vtkSMPropertyHelper(reader, "ScalarArrayName").Set("Density");
+    vtkSMPropertyHelper(reader, "FileLowerLeft").Set(lowerLeft ? 1 : 0);
+    reader->UpdateVTKObjects();
+    return reader;
+  }
+
+  vtkImageData* imageData(DataSource* dataSource)
+  {
+    auto tp = vtkTrivialProducer::SafeDownCast(
+      dataSource->producer()->GetClientSideObject());
+    return vtkImageData::SafeDownCast(tp->GetOutputDataObject(0));
+  }
+
+private slots:
+  void initTestCase()
+  {
+    // Settings are kept out of the registry, so nothing outlives the test.
+    static int argc = 2;
+    static char name[] = "LoadDataReactionTest";
+    static char disableRegistry[] = "-dr";
+    static char* argv[] = { name, disableRegistry, nullptr };
+    m_core = new pqPVApplicationCore(argc, argv);
+    PV_PLUGIN_IMPORT(tomvizExtensions)
+
+    pqServer* server =
+      pqApplicationCore::instance()->getObjectBuilder()->createServer(
+        pqServerResource("builtin:"));
+    QVERIFY(server);
+    pqActiveObjects::instance().setActiveServer(server);
+
+    // Map raw volumes however small they are.
+    m_core->settings()->setValue("OutOfCoreLoading", "always");
+
+    std::vector<unsigned short> voxels(24);
+    for (size_t i = 0; i < voxels.size(); ++i) {
+      voxels[i] = static_cast<unsigned short>(i);
+    }
+    QVERIFY(m_file.open());
+    m_file.write(reinterpret_cast<const char*>(voxels.data()), 48);
+    m_file.close();
+  }
+
+  void cleanupTestCase() { delete m_core; }
+
+  void mapLowerLeftRawVolume()
+  {
+    auto reader = rawReader(true);
+    DataSource* dataSource = LoadDataReaction::createDataSourceFromReader(
+      reader);
+    QVERIFY(dataSource);
+    // Mapped data is handed to a producer of its own, not to the reader.
+    QCOMPARE(QString(dataSource->originalDataSource()->GetXMLName()),
+             QString("TrivialProducer"));
+
+    vtkImageData* image = imageData(dataSource);
+    QVERIFY(image);
+    int dims[3];
+    image->GetDimensions(dims);
+    QCOMPARE(dims[0], 4);
+    QCOMPARE(dims[1], 3);
+    QCOMPARE(dims[2], 2);
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    QCOMPARE(QString(scalars->GetName()), QString("Density"));
+    for (vtkIdType i = 0; i < 24; ++i) {
+      QCOMPARE(scalars->GetTuple1(i), static_cast<double>(i));
+    }
+    delete dataSource;
+  }
+
+  void readUpperLeftRawVolume()
+  {
+    // Rows the reader flips can't be mapped, so the reader loads them.
+    auto reader = rawReader(false);
+    DataSource* dataSource = LoadDataReaction::createDataSourceFromReader(
+      reader);
+    QVERIFY(dataSource);
+    QCOMPARE(QString(dataSource->originalDataSource()->GetXMLName()),
+             QString("TVRawImageReader"));
+
+    vtkImageData* image = imageData(dataSource);
+    QVERIFY(image);
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    QCOMPARE(QString(scalars->GetName()), QString("Density"));
+    for (int z = 0; z < 2; ++z) {
+      for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 4; ++x) {
+          QCOMPARE(scalars->GetTuple1(x + 4 * y + 12 * z),
+                   static_cast<double>(x + 4 * (2 - y) + 12 * z));
+        }
+      }
+    }
+    delete dataSource;
+  }
+};
+
+QTEST_MAIN(LoadDataReactionTest)
+#include "LoadDataReactionTest.moc"
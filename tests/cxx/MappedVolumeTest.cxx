@@ -0,0 +1,73 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include <vector>
+
+#include "MappedVolume.h"
+
+using namespace tomviz;
+
+TEST(MappedVolumeTest, map_raw_volume)
+{
+  // A small header followed by a 4 x 3 x 2 volume of unsigned shorts.
+  std::vector<unsigned short> voxels(24);
+  for (size_t i = 0; i < voxels.size(); ++i) {
+    voxels[i] = static_cast<unsigned short>(i * 3);
+  }
+  QTemporaryFile file;
+  ASSERT_TRUE(file.open());
+  file.write("HEADER", 6);
+  file.write(reinterpret_cast<const char*>(voxels.data()), 48);
+  file.close();
+
+  int extent[6] = { 0, 3, 0, 2, 0, 1 };
+  vtkNew<vtkImageData> image;
+  ASSERT_TRUE(MappedVolume::map(file.fileName(), 6, VTK_UNSIGNED_SHORT, 1,
+                                extent, image.Get()));
+  int dims[3];
+  image->GetDimensions(dims);
+  ASSERT_EQ(dims[0], 4);
+  ASSERT_EQ(dims[1], 3);
+  ASSERT_EQ(dims[2], 2);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  ASSERT_EQ(scalars->GetNumberOfTuples(), 24);
+  ASSERT_EQ(scalars->GetTuple1(23), 69);
+
+  // Writes stay private to the process.
+  scalars->SetTuple1(0, 1000);
+  ASSERT_EQ(scalars->GetTuple1(0), 1000);
+  QFile check(file.fileName());
+  ASSERT_TRUE(check.open(QIODevice::ReadOnly));
+  check.seek(6);
+  unsigned short first = 1;
+  check.read(reinterpret_cast<char*>(&first), 2);
+  ASSERT_EQ(first, 0);
+
+  // The file is too short for a larger volume.
+  extent[5] = 2;
+  vtkNew<vtkImageData> tooLarge;
+  ASSERT_FALSE(MappedVolume::map(file.fileName(), 6, VTK_UNSIGNED_SHORT, 1,
+                                 extent, tooLarge.Get()));
+}
@@ -0,0 +1,304 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include <QTemporaryDir>
+
+#include "pvextensions/vtkOMETiffReader.h"
+
+extern "C" {
+#include "vtk_tiff.h"
+}
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace tomviz;
+
+namespace {
+
+// Neither the strips nor the tiles below divide these, so the last strip and
+// the tiles on the far edges are partial.
+const int dims[3] = { 37, 29, 6 };
+const uint32 rowsPerStrip = 4;
+const uint32 tileSize = 16;
+
+struct Layout
+{
+  bool tiled;
+  uint16 orientation;
+  int bits;
+  // Whether a page of half the resolution follows each slice.
+  bool reduced;
+  uint16 photometric;
+};
+
+// The sample at column x of row y of the file, in page z, different in every
+// byte from its neighbors.
+double sample(int x, int y, int z, int bits)
+{
+  int i = (z * dims[1] + y) * dims[0] + x;
+  switch (bits) {
+    case 8:
+      return (i * 7 + z) % 256;
+    case 16:
+      return (i * 263 + z) % 65536;
+    default:
+      return i * 0.5 - 100.25;
+  }
+}
+
+std::string omeXml()
+{
+  std::ostringstream xml;
+  xml << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      << "<OME><Image ID=\"Image:0\"><Pixels DimensionOrder=\"XYZCT\""
+      << " SizeX=\"" << dims[0] << "\" SizeY=\"" << dims[1] << "\""
+      << " SizeZ=\"" << dims[2] << "\" SizeC=\"1\" SizeT=\"1\"/>"
+      << "</Image></OME>";
+  return xml.str();
+}
+
+template <typename T>
+bool writePage(TIFF* tiff, const Layout& layout, int z, bool reduced)
+{
+  const uint32 width = reduced ? dims[0] / 2 : dims[0];
+  const uint32 height = reduced ? dims[1] / 2 : dims[1];
+  TIFFSetField(tiff, TIFFTAG_SUBFILETYPE,
+               static_cast<uint32>(reduced ? FILETYPE_REDUCEDIMAGE : 0));
+  TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, width);
+  TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, height);
+  TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, static_cast<uint16>(1));
+  TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, static_cast<uint16>(layout.bits));
+  TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT,
+               static_cast<uint16>(layout.bits == 32 ? SAMPLEFORMAT_IEEEFP
+                                                     : SAMPLEFORMAT_UINT));
+  TIFFSetField(tiff, TIFFTAG_PLANARCONFIG,
+               static_cast<uint16>(PLANARCONFIG_CONTIG));
+  TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, layout.photometric);
+  TIFFSetField(tiff, TIFFTAG_ORIENTATION, layout.orientation);
+  TIFFSetField(tiff, TIFFTAG_COMPRESSION,
+               static_cast<uint16>(COMPRESSION_ADOBE_DEFLATE));
+  if (z == 0 && !reduced) {
+    std::string description = omeXml();
+    TIFFSetField(tiff, TIFFTAG_IMAGEDESCRIPTION, description.c_str());
+  }
+
+  // Pages of reduced resolution hold values that show if they are read as
+  // slices.
+  std::vector<T> page(width * height);
+  for (uint32 y = 0; y < height; ++y) {
+    for (uint32 x = 0; x < width; ++x) {
+      T value = static_cast<T>(reduced ? 1 : sample(x, y, z, layout.bits));
+      if (layout.photometric == PHOTOMETRIC_MINISWHITE) {
+        value = static_cast<T>(255 - value);
+      }
+      page[y * width + x] = value;
+    }
+  }
+
+  if (layout.tiled) {
+    TIFFSetField(tiff, TIFFTAG_TILEWIDTH, tileSize);
+    TIFFSetField(tiff, TIFFTAG_TILELENGTH, tileSize);
+    std::vector<T> tile(tileSize * tileSize);
+    for (uint32 y0 = 0; y0 < height; y0 += tileSize) {
+      for (uint32 x0 = 0; x0 < width; x0 += tileSize) {
+        std::fill(tile.begin(), tile.end(), T(0));
+        for (uint32 y = y0; y < height && y < y0 + tileSize; ++y) {
+          for (uint32 x = x0; x < width && x < x0 + tileSize; ++x) {
+            tile[(y - y0) * tileSize + x - x0] = page[y * width + x];
+          }
+        }
+        if (TIFFWriteTile(tiff, &tile[0], x0, y0, 0, 0) < 0) {
+          return false;
+        }
+      }
+    }
+  } else {
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
+    for (uint32 y = 0; y < height; ++y) {
+      if (TIFFWriteScanline(tiff, &page[y * width], y, 0) < 0) {
+        return false;
+      }
+    }
+  }
+  return TIFFWriteDirectory(tiff) != 0;
+}
+
+template <typename T>
+bool writeFile(const std::string& fileName, const Layout& layout)
+{
+  TIFF* tiff = TIFFOpen(fileName.c_str(), "w");
+  if (!tiff) {
+    return false;
+  }
+  bool written = true;
+  for (int z = 0; z < dims[2] && written; ++z) {
+    written = writePage<T>(tiff, layout, z, false);
+    if (layout.reduced && written) {
+      written = writePage<T>(tiff, layout, z, true);
+    }
+  }
+  TIFFClose(tiff);
+  return written;
+}
+
+bool write(const std::string& fileName, const Layout& layout)
+{
+  switch (layout.bits) {
+    case 8:
+      return writeFile<unsigned char>(fileName, layout);
+    case 16:
+      return writeFile<unsigned short>(fileName, layout);
+    default:
+      return writeFile<float>(fileName, layout);
+  }
+}
+
+// Counts the voxels of image that differ from the samples of the file, with
+// the rows flipped for files whose origin is at the lower left.
+int mismatches(vtkImageData* image, const Layout& layout)
+{
+  int extent[6];
+  image->GetExtent(extent);
+  int count = 0;
+  for (int z = extent[4]; z <= extent[5]; ++z) {
+    for (int y = extent[2]; y <= extent[3]; ++y) {
+      int row =
+        layout.orientation == ORIENTATION_TOPLEFT ? y : dims[1] - 1 - y;
+      for (int x = extent[0]; x <= extent[1]; ++x) {
+        count += image->GetScalarComponentAsDouble(x, y, z, 0) !=
+                 sample(x, row, z, layout.bits);
+      }
+    }
+  }
+  return count;
+}
+
+int scalarType(int bits)
+{
+  switch (bits) {
+    case 8:
+      return VTK_UNSIGNED_CHAR;
+    case 16:
+      return VTK_UNSIGNED_SHORT;
+    default:
+      return VTK_FLOAT;
+  }
+}
+}
+
+TEST(OMETiffReaderTest, read_pages)
+{
+  const Layout layouts[] = {
+    { false, ORIENTATION_TOPLEFT, 8, false, PHOTOMETRIC_MINISBLACK },
+    { false, ORIENTATION_BOTLEFT, 16, true, PHOTOMETRIC_MINISBLACK },
+    { false, ORIENTATION_BOTLEFT, 32, false, PHOTOMETRIC_MINISBLACK },
+    { true, ORIENTATION_TOPLEFT, 32, true, PHOTOMETRIC_MINISBLACK },
+    { true, ORIENTATION_BOTLEFT, 8, false, PHOTOMETRIC_MINISBLACK },
+    { true, ORIENTATION_TOPLEFT, 16, true, PHOTOMETRIC_MINISBLACK }
+  };
+  const int whole[6] = { 0, dims[0] - 1, 0, dims[1] - 1, 0, dims[2] - 1 };
+  // Starting and ending inside strips and tiles.
+  const int part[6] = { 3, 30, 5, 20, 1, 4 };
+  const int* extents[] = { whole, part };
+
+  QTemporaryDir directory;
+  ASSERT_TRUE(directory.isValid());
+  int index = 0;
+  for (const auto& layout : layouts) {
+    SCOPED_TRACE(index);
+    std::string fileName =
+      directory.filePath(QString("pages%1.tif").arg(index++)).toStdString();
+    ASSERT_TRUE(write(fileName, layout));
+
+    for (int threads : { 1, 4 }) {
+      vtkTypeInt64 decodedWhole = 0;
+      for (const int* extent : extents) {
+        vtkNew<vtkOMETiffReader> reader;
+        reader->SetFileName(fileName.c_str());
+        reader->SetNumberOfThreads(threads);
+        reader->UpdateExtent(extent);
+        vtkImageData* image = reader->GetOutput();
+        ASSERT_EQ(image->GetScalarType(), scalarType(layout.bits));
+        int read[6];
+        image->GetExtent(read);
+        for (int i = 0; i < 6; ++i) {
+          EXPECT_EQ(read[i], extent[i]);
+        }
+        EXPECT_EQ(mismatches(image, layout), 0);
+
+        // Strips and tiles were decoded straight into the output, and only
+        // those holding the extent.
+        EXPECT_GT(reader->GetDecodedBytes(), 0);
+        if (extent == whole) {
+          decodedWhole = reader->GetDecodedBytes();
+        } else {
+          EXPECT_LT(reader->GetDecodedBytes(), decodedWhole);
+        }
+      }
+    }
+  }
+}
+
+TEST(OMETiffReaderTest, match_scanline_path)
+{
+  // The samples of white is zero images are not stored as they are read, so
+  // these go through the scanlines, and should give the same volume.
+  const Layout inverted = { false, ORIENTATION_BOTLEFT, 8, false,
+                            PHOTOMETRIC_MINISWHITE };
+  const Layout direct = { false, ORIENTATION_BOTLEFT, 8, false,
+                          PHOTOMETRIC_MINISBLACK };
+
+  QTemporaryDir directory;
+  ASSERT_TRUE(directory.isValid());
+  std::string invertedName = directory.filePath("inverted.tif").toStdString();
+  std::string directName = directory.filePath("direct.tif").toStdString();
+  ASSERT_TRUE(write(invertedName, inverted));
+  ASSERT_TRUE(write(directName, direct));
+
+  vtkNew<vtkOMETiffReader> scanlineReader;
+  scanlineReader->SetFileName(invertedName.c_str());
+  scanlineReader->Update();
+  EXPECT_EQ(scanlineReader->GetDecodedBytes(), 0);
+  vtkImageData* expected = scanlineReader->GetOutput();
+  EXPECT_EQ(mismatches(expected, inverted), 0);
+
+  for (int threads : { 1, 4 }) {
+    vtkNew<vtkOMETiffReader> reader;
+    reader->SetFileName(directName.c_str());
+    reader->SetNumberOfThreads(threads);
+    reader->Update();
+    EXPECT_GT(reader->GetDecodedBytes(), 0);
+    vtkImageData* image = reader->GetOutput();
+    int count = 0;
+    for (int z = 0; z < dims[2]; ++z) {
+      for (int y = 0; y < dims[1]; ++y) {
+        for (int x = 0; x < dims[0]; ++x) {
+          count += image->GetScalarComponentAsDouble(x, y, z, 0) !=
+                   expected->GetScalarComponentAsDouble(x, y, z, 0);
+        }
+      }
+    }
+    EXPECT_EQ(count, 0);
+  }
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include "CropOperator.h"
+#include "PipelineCache.h"
+
+using namespace tomviz;
+
+class PipelineCacheTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    budget = PipelineCache::instance().memoryBudget();
+    for (int i = 0; i < 3; ++i) {
+      operators << new CropOperator();
+    }
+    image->SetDimensions(64, 64, 64);
+    image->AllocateScalars(VTK_FLOAT, 1);
+  }
+
+  void TearDown() override
+  {
+    PipelineCache::instance().remove(operators);
+    PipelineCache::instance().setMemoryBudget(budget);
+    qDeleteAll(operators);
+  }
+
+  qint64 budget;
+  QList<Operator*> operators;
+  vtkNew<vtkImageData> image;
+};
+
+TEST_F(PipelineCacheTest, keys_change_downstream)
+{
+  QList<quint64> before = PipelineCache::keys(operators);
+  int bounds[6] = { 0, 10, 0, 10, 0, 10 };
+  static_cast<CropOperator*>(operators[1])->setCropBounds(bounds);
+  QList<quint64> after = PipelineCache::keys(operators);
+
+  ASSERT_EQ(before.size(), 3);
+  ASSERT_EQ(before[0], after[0]);
+  ASSERT_NE(before[1], after[1]);
+  ASSERT_NE(before[2], after[2]);
+  ASSERT_EQ(after, PipelineCache::keys(operators));
+}
+
+TEST_F(PipelineCacheTest, least_recently_used_evicted)
+{
+  qint64 bytes = static_cast<qint64>(image->GetActualMemorySize()) * 1024;
+  PipelineCache& cache = PipelineCache::instance();
+  cache.setMemoryBudget(2 * bytes + bytes / 2);
+
+  cache.insert(operators[0], 1, image.Get());
+  cache.insert(operators[1], 2, image.Get());
+  ASSERT_EQ(cache.memoryUsed(), 2 * bytes);
+
+  // A stale key is a miss, using the first entry makes the second the oldest.
+  ASSERT_FALSE(cache.find(operators[0], 3));
+  ASSERT_TRUE(cache.find(operators[0], 1));
+  cache.insert(operators[2], 4, image.Get());
+  ASSERT_TRUE(cache.find(operators[0], 1));
+  ASSERT_FALSE(cache.find(operators[1], 2));
+  ASSERT_TRUE(cache.find(operators[2], 4));
+  ASSERT_EQ(cache.memoryUsed(), 2 * bytes);
+
+  // The snapshot is a copy.
+  ASSERT_NE(cache.find(operators[2], 4).Get(), image.Get());
+
+  cache.setMemoryBudget(0);
+  ASSERT_EQ(cache.memoryUsed(), 0);
+  cache.insert(operators[0], 1, image.Get());
+  ASSERT_FALSE(cache.find(operators[0], 1));
+}
@@ -0,0 +1,90 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <QtTest>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include "ConvertToFloatOperator.h"
+#include "CopyOnWrite.h"
+#include "PipelineWorker.h"
+#include "PointwiseOperator.h"
+
+using namespace tomviz;
+
+class PipelineWorkerTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  vtkSmartPointer<vtkImageData> m_image;
+
+  // Runs op on a copy of the image sharing its arrays, as the data source
+  // hands its data to the pipeline, and returns the bytes the run copied.
+  qint64 run(Operator* op)
+  {
+    vtkDataObject* data = CopyOnWrite::sharedCopy(m_image);
+    PipelineWorker worker;
+    PipelineWorker::Future* future = worker.run(data, op);
+    QSignalSpy finished(future, SIGNAL(finished(bool)));
+    if (!finished.wait(10000)) {
+      return -1;
+    }
+    qint64 bytes = finished.first().first().toBool() ? future->bytesCopied()
+                                                     : -1;
+    future->result()->Delete();
+    delete future;
+    return bytes;
+  }
+
+private slots:
+  void init()
+  {
+    m_image = vtkSmartPointer<vtkImageData>::New();
+    m_image->SetDimensions(32, 32, 32);
+    m_image->AllocateScalars(VTK_SHORT, 1);
+    vtkDataArray* scalars = m_image->GetPointData()->GetScalars();
+    for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+      scalars->SetTuple1(i, i % 100);
+    }
+  }
+
+  void readOnlyOperatorCopiesNothing()
+  {
+    // Writes its output to new arrays, so the shared ones are left alone.
+    ConvertToFloatOperator convert;
+    QCOMPARE(run(&convert), qint64(0));
+  }
+
+  void inPlaceOperatorCopiesArrays()
+  {
+    PointwiseOperator add(PointwiseOperator::Function::AddConstant);
+    add.setConstant(5.0);
+    vtkDataArray* scalars = m_image->GetPointData()->GetScalars();
+    qint64 bytes = static_cast<qint64>(scalars->GetActualMemorySize()) * 1024;
+    QCOMPARE(run(&add), bytes);
+
+    // The operator modified its own copy of the scalars.
+    for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+      QCOMPARE(scalars->GetTuple1(i), static_cast<double>(i % 100));
+    }
+  }
+};
+
+QTEST_GUILESS_MAIN(PipelineWorkerTest)
+#include "PipelineWorkerTest.moc"
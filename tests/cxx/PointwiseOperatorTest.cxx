@@ -0,0 +1,92 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include "PointwiseOperator.h"
+
+using namespace tomviz;
+
+namespace {
+
+void createImage(vtkImageData* image)
+{
+  image->SetDimensions(16, 16, 16);
+  image->AllocateScalars(VTK_SHORT, 1);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+    scalars->SetTuple1(i, i % 200 - 100);
+  }
+}
+}
+
+TEST(PointwiseOperatorTest, fused_matches_sequential)
+{
+  PointwiseOperator add(PointwiseOperator::Function::AddConstant);
+  add.setConstant(5.0);
+  PointwiseOperator clamp(PointwiseOperator::Function::ClampNegative);
+  PointwiseOperator squareRoot(PointwiseOperator::Function::SquareRoot);
+  PointwiseOperator invert(PointwiseOperator::Function::Invert);
+  QList<PointwiseOperator*> ops;
+  ops << &add << &clamp << &squareRoot << &invert;
+
+  vtkNew<vtkImageData> sequential;
+  createImage(sequential.Get());
+  foreach (PointwiseOperator* op, ops) {
+    ASSERT_EQ(op->transform(sequential.Get()), TransformResult::Complete);
+  }
+
+  vtkNew<vtkImageData> fused;
+  createImage(fused.Get());
+  ASSERT_EQ(PointwiseOperator::transformFused(ops, fused.Get(), 4),
+            TransformResult::Complete);
+  foreach (PointwiseOperator* op, ops) {
+    ASSERT_EQ(op->state(), OperatorState::Complete);
+  }
+
+  vtkDataArray* expected = sequential->GetPointData()->GetScalars();
+  vtkDataArray* actual = fused->GetPointData()->GetScalars();
+  ASSERT_EQ(actual->GetDataType(), VTK_FLOAT);
+  ASSERT_EQ(actual->GetNumberOfTuples(), expected->GetNumberOfTuples());
+  for (vtkIdType i = 0; i < actual->GetNumberOfTuples(); ++i) {
+    ASSERT_NEAR(actual->GetTuple1(i), expected->GetTuple1(i), 1e-4);
+  }
+}
+
+TEST(PointwiseOperatorTest, integer_results_keep_type)
+{
+  PointwiseOperator clamp(PointwiseOperator::Function::ClampNegative);
+  PointwiseOperator add(PointwiseOperator::Function::AddConstant);
+  add.setConstant(3.0);
+  QList<PointwiseOperator*> ops;
+  ops << &clamp << &add;
+
+  vtkNew<vtkImageData> image;
+  createImage(image.Get());
+  ASSERT_EQ(PointwiseOperator::transformFused(ops, image.Get(), 2),
+            TransformResult::Complete);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  ASSERT_EQ(scalars->GetDataType(), VTK_SHORT);
+  for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); ++i) {
+    ASSERT_EQ(scalars->GetTuple1(i), std::max<double>(i % 200 - 100, 0) + 3);
+  }
+}
@@ -0,0 +1,171 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <QtTest>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include "OperatorPython.h"
+#include "PythonService.h"
+#include "TomvizTest.h"
+
+using namespace tomviz;
+
+class PythonServiceTest : public QObject
+{
+  Q_OBJECT
+
+private:
+  // A 4 x 3 x 2 volume of floats, each the index of its voxel.
+  vtkSmartPointer<vtkImageData> ramp()
+  {
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(0, 3, 0, 2, 0, 1);
+    image->AllocateScalars(VTK_FLOAT, 1);
+    image->GetPointData()->GetScalars()->SetName("Density");
+    auto values = static_cast<float*>(image->GetScalarPointer());
+    for (int i = 0; i < 24; ++i) {
+      values[i] = static_cast<float>(i);
+    }
+    return image;
+  }
+
+  // An operator running the script of the fixture of the given name.
+  OperatorPython* fixture(const QString& name)
+  {
+    QFile file(QString("%1/fixtures/%2.py").arg(SOURCE_DIR).arg(name));
+    if (!file.open(QIODevice::ReadOnly)) {
+      return nullptr;
+    }
+    OperatorPython* pythonOperator = new OperatorPython();
+    pythonOperator->setLabel(name);
+    pythonOperator->setScript(QString(file.readAll()));
+    return pythonOperator;
+  }
+
+  // Scales and offsets the scalars, failing unless the scale arrives as a
+  // float although it is whole and the offset as an int.
+  void transform(vtkImageData* image, bool inPlace)
+  {
+    OperatorPython* pythonOperator = fixture("scale_scalars");
+    QVERIFY(pythonOperator);
+    QMap<QString, QVariant> arguments;
+    arguments["scale"] = 3.0;
+    arguments["offset"] = 1;
+    arguments["in_place"] = inPlace;
+    pythonOperator->setArguments(arguments);
+    QVERIFY(pythonOperator->transform(image) == TransformResult::Complete);
+    delete pythonOperator;
+  }
+
+private slots:
+  void initTestCase()
+  {
+    // Operators on images only run in a worker when one could be started.
+    OperatorPython touch;
+    QVERIFY(PythonService::instance().isAvailable());
+  }
+
+  void transformInPlace()
+  {
+    vtkSmartPointer<vtkImageData> image = ramp();
+    transform(image, true);
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    QCOMPARE(scalars->GetDataType(), VTK_FLOAT);
+    QCOMPARE(QString(scalars->GetName()), QString("Density"));
+    QCOMPARE(scalars->GetNumberOfTuples(), vtkIdType(24));
+    for (vtkIdType i = 0; i < 24; ++i) {
+      QCOMPARE(scalars->GetTuple1(i), 3.0 * i + 1.0);
+    }
+  }
+
+  void transformToNewScalars()
+  {
+    vtkSmartPointer<vtkImageData> image = ramp();
+    transform(image, false);
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    QCOMPARE(scalars->GetDataType(), VTK_DOUBLE);
+    QCOMPARE(scalars->GetNumberOfTuples(), vtkIdType(24));
+    for (vtkIdType i = 0; i < 24; ++i) {
+      QCOMPARE(scalars->GetTuple1(i), 3.0 * i + 1.0);
+    }
+  }
+
+  void progressFromWorker()
+  {
+    OperatorPython* pythonOperator = fixture("report_progress");
+    QVERIFY(pythonOperator);
+
+    // Progress arrives on the thread of the service.
+    int maximum = 0;
+    QList<int> steps;
+    QString message;
+    connect(pythonOperator, &Operator::totalProgressStepsChanged,
+            [&maximum](int total) { maximum = total; });
+    connect(pythonOperator, &Operator::progressStepChanged,
+            [&steps](int step) { steps.append(step); });
+    connect(pythonOperator, &Operator::progressMessageChanged,
+            [&message](const QString& text) { message = text; });
+
+    vtkSmartPointer<vtkImageData> image = ramp();
+    QVERIFY(pythonOperator->transform(image) == TransformResult::Complete);
+    QCOMPARE(maximum, 4);
+    QCOMPARE(steps, QList<int>() << 0 << 1 << 2 << 3 << 4);
+    QCOMPARE(message, QString("Done"));
+    delete pythonOperator;
+  }
+
+  void cancelWorker()
+  {
+    OperatorPython* pythonOperator = fixture("wait_for_cancel");
+    QVERIFY(pythonOperator);
+
+    // The script waits for half a minute unless canceled, which is done once
+    // it reported progress, so it is known to be running in the worker.
+    connect(pythonOperator, &Operator::progressStepChanged,
+            [pythonOperator](int step) {
+              if (step > 0) {
+                pythonOperator->cancelTransform();
+              }
+            });
+
+    vtkSmartPointer<vtkImageData> image = ramp();
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(pythonOperator->transform(image) == TransformResult::Canceled);
+    QVERIFY(timer.elapsed() < 15000);
+
+    // A canceled transform leaves the scalars as they were.
+    vtkDataArray* scalars = image->GetPointData()->GetScalars();
+    for (vtkIdType i = 0; i < 24; ++i) {
+      QCOMPARE(scalars->GetTuple1(i), static_cast<double>(i));
+    }
+    delete pythonOperator;
+
+    // The worker is still there for the next request.
+    transform(image, true);
+    QCOMPARE(image->GetPointData()->GetScalars()->GetTuple1(1), 4.0);
+  }
+};
+
+QTEST_GUILESS_MAIN(PythonServiceTest)
+#include "PythonServiceTest.moc"
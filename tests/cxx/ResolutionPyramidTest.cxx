@@ -0,0 +1,61 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include "ResolutionPyramid.h"
+
+using namespace tomviz;
+
+TEST(ResolutionPyramidTest, downsample_averages_blocks)
+{
+  vtkNew<vtkImageData> image;
+  image->SetExtent(2, 6, 0, 3, 0, 2);
+  image->SetSpacing(1.0, 2.0, 1.0);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  for (int z = 0; z < 3; ++z) {
+    for (int y = 0; y < 4; ++y) {
+      for (int x = 0; x < 5; ++x) {
+        *values++ = static_cast<float>(x + 10 * y + 100 * z);
+      }
+    }
+  }
+
+  auto coarse = ResolutionPyramid::downsample(image.Get());
+  ASSERT_NE(coarse.Get(), nullptr);
+  int dims[3];
+  coarse->GetDimensions(dims);
+  ASSERT_EQ(dims[0], 3);
+  ASSERT_EQ(dims[1], 2);
+  ASSERT_EQ(dims[2], 2);
+  double* spacing = coarse->GetSpacing();
+  ASSERT_DOUBLE_EQ(spacing[0], 2.0);
+  ASSERT_DOUBLE_EQ(spacing[1], 4.0);
+  double* origin = coarse->GetOrigin();
+  ASSERT_DOUBLE_EQ(origin[0], 2.5);
+  ASSERT_DOUBLE_EQ(origin[1], 1.0);
+
+  auto scalars = coarse->GetPointData()->GetScalars();
+  // The first block averages x in {0, 1}, y in {0, 1} and z in {0, 1}.
+  ASSERT_FLOAT_EQ(scalars->GetTuple1(0), 55.5f);
+  // The last block only has x = 4, y in {2, 3} and z = 2 left.
+  ASSERT_FLOAT_EQ(scalars->GetTuple1(11), 229.0f);
+}
@@ -0,0 +1,96 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include <cmath>
+#include <limits>
+
+#include "SpanSpaceIndex.h"
+
+using namespace tomviz;
+
+namespace {
+
+// Each voxel holds its x coordinate, so bricks along x have disjoint ranges
+// apart from the plane of points they share.
+void makeRamp(vtkImageData* image)
+{
+  image->SetExtent(0, 47, 0, 9, 0, 9);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  for (int z = 0; z < 10; ++z) {
+    for (int y = 0; y < 10; ++y) {
+      for (int x = 0; x < 48; ++x) {
+        *values++ = static_cast<float>(x);
+      }
+    }
+  }
+}
+}
+
+TEST(SpanSpaceIndexTest, queries_match_brick_ranges)
+{
+  vtkNew<vtkImageData> image;
+  makeRamp(image.Get());
+
+  SpanSpaceIndex index;
+  index.build(image.Get(), 16);
+  // 47 cells along x make bricks [0, 16], [16, 32] and [32, 47].
+  ASSERT_EQ(index.bricks().size(), 3u);
+
+  double range[2];
+  ASSERT_TRUE(index.range(range));
+  ASSERT_EQ(range[0], 0.0);
+  ASSERT_EQ(range[1], 47.0);
+
+  ASSERT_EQ(index.bricksContaining(5.0), std::vector<int>({ 0 }));
+  ASSERT_EQ(index.bricksContaining(16.0), std::vector<int>({ 0, 1 }));
+  ASSERT_EQ(index.bricksContaining(47.0), std::vector<int>({ 2 }));
+  ASSERT_TRUE(index.bricksContaining(-1.0).empty());
+  ASSERT_TRUE(index.bricksContaining(48.0).empty());
+
+  ASSERT_EQ(index.bricksOverlapping(20.0, 40.0), std::vector<int>({ 1, 2 }));
+  ASSERT_EQ(index.bricksOverlapping(-10.0, 100.0),
+            std::vector<int>({ 0, 1, 2 }));
+  ASSERT_TRUE(index.bricksOverlapping(50.0, 60.0).empty());
+
+  index.clear();
+  ASSERT_TRUE(index.isEmpty());
+  ASSERT_FALSE(index.range(range));
+}
+
+TEST(SpanSpaceIndexTest, nan_bricks_are_never_found)
+{
+  vtkNew<vtkImageData> image;
+  makeRamp(image.Get());
+  // Fill the last brick, past the point it shares, with NaNs.
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  for (int i = 0; i < 48 * 10 * 10; ++i) {
+    if (i % 48 >= 32) {
+      values[i] = std::numeric_limits<float>::quiet_NaN();
+    }
+  }
+
+  SpanSpaceIndex index;
+  index.build(image.Get(), 16);
+  double range[2];
+  ASSERT_TRUE(index.range(range));
+  ASSERT_EQ(range[1], 31.0);
+  ASSERT_EQ(index.bricksOverlapping(-10.0, 100.0), std::vector<int>({ 0, 1 }));
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include "TiltAxisPreview.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace tomviz;
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+struct Blob
+{
+  double y, z, width, height;
+};
+
+std::vector<Blob> phantom()
+{
+  // Blobs at pseudo random positions in the plane of each slice.
+  std::vector<Blob> blobs;
+  unsigned int seed = 4321;
+  for (int i = 0; i < 30; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    double y = (seed >> 8) % 100 - 50.0;
+    seed = seed * 1103515245u + 12345u;
+    double z = (seed >> 8) % 60 - 30.0;
+    seed = seed * 1103515245u + 12345u;
+    blobs.push_back({ y, z, 1.0 + (seed >> 8) % 4 * 0.5, 1.0 });
+  }
+  return blobs;
+}
+
+// Projects the phantom with the axis of every slice where axis puts it.
+vtkSmartPointer<vtkImageData> tiltSeries(const TiltAxisPreview::Axis& axis)
+{
+  const int slices = 128, rays = 160, tilts = 61;
+  auto image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(slices, rays, tilts);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  vtkNew<vtkDoubleArray> angles;
+  angles->SetName("tilt_angles");
+  for (int t = 0; t < tilts; ++t) {
+    angles->InsertNextValue(-60.0 + 2.0 * t);
+  }
+  image->GetFieldData()->AddArray(angles.Get());
+
+  std::vector<Blob> blobs = phantom();
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  TiltAxisPreview::Sinogram sinogram;
+  sinogram.numberOfSlices = slices;
+  for (int s = 0; s < slices; ++s) {
+    sinogram.slice = s;
+    double position = TiltAxisPreview::axisPosition(sinogram, axis);
+    for (int t = 0; t < tilts; ++t) {
+      double angle = angles->GetValue(t) * pi / 180.0;
+      for (int r = 0; r < rays; ++r) {
+        double value = 0.0;
+        for (const Blob& blob : blobs) {
+          double d = r - rays / 2 - position - blob.y * std::cos(angle) -
+                     blob.z * std::sin(angle);
+          value += blob.height * blob.width *
+                   std::exp(-d * d / (2.0 * blob.width * blob.width));
+        }
+        values[(t * rays + r) * slices + s] = static_cast<float>(value);
+      }
+    }
+  }
+  return image;
+}
+}
+
+TEST(TiltAxisPreviewTest, extract_sinogram)
+{
+  vtkNew<vtkImageData> image;
+  image->SetDimensions(3, 4, 2);
+  image->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+  auto values = static_cast<unsigned short*>(image->GetScalarPointer());
+  for (int i = 0; i < 3 * 4 * 2; ++i) {
+    values[i] = static_cast<unsigned short>(i);
+  }
+  vtkNew<vtkDoubleArray> angles;
+  angles->SetName("tilt_angles");
+  angles->InsertNextValue(-10.0);
+  angles->InsertNextValue(10.0);
+  image->GetFieldData()->AddArray(angles.Get());
+
+  auto sinogram = TiltAxisPreview::extractSinogram(image.Get(), 1);
+  ASSERT_NE(sinogram, nullptr);
+  ASSERT_EQ(sinogram->numberOfRays, 4);
+  ASSERT_EQ(sinogram->numberOfSlices, 3);
+  ASSERT_EQ(sinogram->tiltAngles[1], 10.0);
+  // Ray 2 of tilt 1 is voxel (1, 2, 1).
+  ASSERT_EQ(sinogram->values[1 * 4 + 2], 1 + 2 * 3 + 1 * 12);
+
+  ASSERT_EQ(TiltAxisPreview::extractSinogram(image.Get(), 3), nullptr);
+}
+
+TEST(TiltAxisPreviewTest, search_axis)
+{
+  TiltAxisPreview::Axis truth = { 5.5, 2.0 };
+  auto image = tiltSeries(truth);
+
+  std::vector<TiltAxisPreview::SinogramPtr> sinograms;
+  for (int slice : { 32, 64, 96 }) {
+    sinograms.push_back(TiltAxisPreview::extractSinogram(image, slice));
+  }
+  TiltAxisPreview::Axis axis =
+    TiltAxisPreview::searchAxis(sinograms, { 0.0, 0.0 });
+  ASSERT_NEAR(axis.shift, truth.shift, 1.0);
+  ASSERT_NEAR(axis.angle, truth.angle, 1.0);
+}
@@ -0,0 +1,244 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include "Parallel.h"
+#include "TomographyReconstruction.h"
+
+using namespace tomviz;
+
+class TomographyReconstructionTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    for (int i = 0; i < numOfTilts; ++i) {
+      tiltAngles.push_back(-70.0 + i * 140.0 / (numOfTilts - 1));
+    }
+    // A single bright ray through the rotation axis in every projection.
+    sinogram.resize(numOfTilts * numOfRays, 0.0f);
+    for (int i = 0; i < numOfTilts; ++i) {
+      sinogram[i * numOfRays + numOfRays / 2] = 1.0f;
+    }
+  }
+
+  const int numOfTilts = 41;
+  const int numOfRays = 32;
+  std::vector<double> tiltAngles;
+  std::vector<float> sinogram;
+};
+
+TEST_F(TomographyReconstructionTest, point_source)
+{
+  std::vector<float> recon(numOfRays * numOfRays);
+  TomographyReconstruction::BackProjectionGeometry geometry(
+    tiltAngles.data(), numOfTilts, numOfRays);
+  TomographyReconstruction::unweightedBackProjection2(sinogram.data(),
+                                                      geometry, recon.data());
+
+  // The brightest pixels should be the ones around the rotation axis.
+  auto peak = std::max_element(recon.begin(), recon.end()) - recon.begin();
+  int iy = static_cast<int>(peak) / numOfRays;
+  int iz = static_cast<int>(peak) % numOfRays;
+  ASSERT_NEAR(iy, numOfRays / 2, 1);
+  ASSERT_NEAR(iz, numOfRays / 2, 1);
+}
+
+TEST_F(TomographyReconstructionTest, geometry_matches_angles)
+{
+  std::vector<float> fromAngles(numOfRays * numOfRays);
+  std::vector<float> fromGeometry(numOfRays * numOfRays);
+  TomographyReconstruction::unweightedBackProjection2(
+    sinogram.data(), tiltAngles.data(), fromAngles.data(), numOfTilts,
+    numOfRays);
+  TomographyReconstruction::BackProjectionGeometry geometry(
+    tiltAngles.data(), numOfTilts, numOfRays);
+  TomographyReconstruction::unweightedBackProjection2(
+    sinogram.data(), geometry, fromGeometry.data());
+
+  for (size_t i = 0; i < fromAngles.size(); ++i) {
+    ASSERT_FLOAT_EQ(fromAngles[i], fromGeometry[i]);
+  }
+}
+
+TEST_F(TomographyReconstructionTest, ramp_filter_impulse)
+{
+  // Filtering an impulse gives back the spatial ramp kernel.
+  std::vector<float> row(numOfRays, 0.0f);
+  int center = numOfRays / 2;
+  row[center] = 1.0f;
+  TomographyReconstruction::SinogramFilter filter(
+    TomographyReconstruction::FilterType::Ramp, numOfRays);
+  ASSERT_GE(filter.paddedSize(), 2 * numOfRays);
+  filter.apply(row.data(), 1);
+
+  const double pi = 3.14159265359;
+  ASSERT_NEAR(row[center], 0.5, 1e-5);
+  ASSERT_NEAR(row[center + 1], -2.0 / (pi * pi), 1e-5);
+  ASSERT_NEAR(row[center - 1], -2.0 / (pi * pi), 1e-5);
+  ASSERT_NEAR(row[center + 2], 0.0, 1e-5);
+}
+
+TEST_F(TomographyReconstructionTest, unfiltered_is_unchanged)
+{
+  std::vector<float> filtered = sinogram;
+  TomographyReconstruction::SinogramFilter filter(
+    TomographyReconstruction::FilterType::None, numOfRays);
+  filter.apply(filtered.data(), numOfTilts);
+  ASSERT_EQ(filtered, sinogram);
+}
+
+TEST_F(TomographyReconstructionTest, parallel_for_range)
+{
+  std::vector<std::atomic<int>> visits(1000);
+  for (auto& v : visits) {
+    v = 0;
+  }
+  Parallel::forRange(0, static_cast<int>(visits.size()), 7,
+                     [&](int begin, int end) {
+                       for (int i = begin; i < end; ++i) {
+                         ++visits[i];
+                       }
+                     });
+  for (auto& v : visits) {
+    ASSERT_EQ(v, 1);
+  }
+}
+
+TEST_F(TomographyReconstructionTest, projector_is_adjoint)
+{
+  TomographyReconstruction::RayProjector projector(tiltAngles.data(),
+                                                   numOfTilts, numOfRays);
+  std::vector<float> slice(numOfRays * numOfRays);
+  std::vector<float> projection(numOfTilts * numOfRays);
+  for (size_t i = 0; i < slice.size(); ++i) {
+    slice[i] = static_cast<float>((i * 7919) % 13) / 13.0f;
+  }
+  std::vector<float> forward(projection.size());
+  std::vector<float> back(slice.size());
+  projector.forward(slice.data(), forward.data());
+  projector.back(sinogram.data(), back.data());
+
+  double forwardDot = 0.0;
+  for (size_t i = 0; i < forward.size(); ++i) {
+    forwardDot += forward[i] * sinogram[i];
+  }
+  double backDot = 0.0;
+  for (size_t i = 0; i < back.size(); ++i) {
+    backDot += back[i] * slice[i];
+  }
+  ASSERT_NEAR(forwardDot, backDot, 1e-4 * std::abs(forwardDot));
+
+  // Without tilt every ray crosses one full row of the slice.
+  double zero = 0.0;
+  TomographyReconstruction::RayProjector untilted(&zero, 1, numOfRays);
+  for (int j = 0; j < numOfRays; ++j) {
+    ASSERT_NEAR(untilted.rowNorms()[j], numOfRays, 1e-4);
+  }
+}
+
+TEST_F(TomographyReconstructionTest, iterative_methods_converge)
+{
+  using TomographyReconstruction::IterativeMethod;
+  TomographyReconstruction::RayProjector projector(tiltAngles.data(),
+                                                   numOfTilts, numOfRays);
+  std::vector<float> phantom(numOfRays * numOfRays, 0.0f);
+  for (int iy = 10; iy < 20; ++iy) {
+    for (int iz = 12; iz < 18; ++iz) {
+      phantom[iy * numOfRays + iz] = 1.0f;
+    }
+  }
+  std::vector<float> projections(numOfTilts * numOfRays);
+  projector.forward(phantom.data(), projections.data());
+
+  IterativeMethod methods[] = { IterativeMethod::ART,
+                                IterativeMethod::Landweber,
+                                IterativeMethod::Cimmino,
+                                IterativeMethod::ComponentAveraging };
+  for (auto method : methods) {
+    for (int tvSteps : { 0, 10 }) {
+      TomographyReconstruction::IterativeOptions options;
+      options.method = method;
+      options.tvSteps = tvSteps;
+      TomographyReconstruction::IterativeSolver solver(projector, options);
+      std::vector<float> slice(phantom.size(), 0.0f);
+      double first = solver.iterate(projections.data(), slice.data(), 0);
+      double last = first;
+      for (int i = 1; i < options.iterations; ++i) {
+        last = solver.iterate(projections.data(), slice.data(), i);
+      }
+      ASSERT_LT(last, 0.9 * first);
+    }
+  }
+}
+
+TEST_F(TomographyReconstructionTest, streaming_matches_batch)
+{
+  // A few slices, each a scaled copy of the sinogram plus a ramp across the
+  // rays so the slices differ.
+  const int numOfSlices = 3;
+  vtkNew<vtkImageData> tiltSeries;
+  tiltSeries->SetDimensions(numOfSlices, numOfRays, numOfTilts);
+  tiltSeries->AllocateScalars(VTK_FLOAT, 1);
+  auto values = static_cast<float*>(tiltSeries->GetScalarPointer());
+  for (int t = 0; t < numOfTilts; ++t) {
+    for (int r = 0; r < numOfRays; ++r) {
+      for (int s = 0; s < numOfSlices; ++s) {
+        values[(t * numOfRays + r) * numOfSlices + s] =
+          (s + 1) * sinogram[t * numOfRays + r] + 0.01f * s * r;
+      }
+    }
+  }
+  vtkNew<vtkDoubleArray> angles;
+  angles->SetName("tilt_angles");
+  angles->SetNumberOfTuples(numOfTilts);
+  for (int t = 0; t < numOfTilts; ++t) {
+    angles->SetValue(t, tiltAngles[t]);
+  }
+  tiltSeries->GetFieldData()->AddArray(angles.Get());
+
+  vtkNew<vtkImageData> batch;
+  TomographyReconstruction::weightedBackProjection3(tiltSeries.Get(),
+                                                    batch.Get());
+  auto expected = static_cast<float*>(batch->GetScalarPointer());
+
+  TomographyReconstruction::StreamingBackProjection streaming(numOfSlices,
+                                                              numOfRays);
+  std::vector<float> recon(streaming.reconstructionSize());
+  ASSERT_EQ(recon.size(), static_cast<size_t>(batch->GetNumberOfPoints()));
+  const size_t projectionSize = numOfSlices * numOfRays;
+  for (int t = 0; t < numOfTilts; ++t) {
+    streaming.addProjection(values + t * projectionSize, tiltAngles[t],
+                            recon.data(), recon.data());
+  }
+  ASSERT_EQ(streaming.numberOfProjections(), numOfTilts);
+
+  float largest = *std::max_element(expected, expected + recon.size());
+  for (size_t i = 0; i < recon.size(); ++i) {
+    ASSERT_NEAR(recon[i], expected[i], 1e-4 * largest);
+  }
+}
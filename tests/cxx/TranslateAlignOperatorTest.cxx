@@ -0,0 +1,104 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include <gtest/gtest.h>
+
+#include <vtkImageData.h>
+#include <vtkNew.h>
+
+#include <QVector>
+
+#include "TranslateAlignOperator.h"
+
+using namespace tomviz;
+
+namespace {
+
+const int nx = 12, ny = 10;
+
+// Three slices holding the same ramp, x + 100 * y, to be shifted by
+// nothing, by whole pixels and by half a pixel.
+void createRamp(vtkImageData* image)
+{
+  image->SetDimensions(nx, ny, 3);
+  image->AllocateScalars(VTK_FLOAT, 1);
+  auto values = static_cast<float*>(image->GetScalarPointer());
+  for (int z = 0; z < 3; ++z) {
+    for (int y = 0; y < ny; ++y) {
+      for (int x = 0; x < nx; ++x) {
+        *values++ = static_cast<float>(x + 100 * y);
+      }
+    }
+  }
+}
+
+float value(vtkImageData* image, int x, int y, int z)
+{
+  return *static_cast<float*>(image->GetScalarPointer(x, y, z));
+}
+
+void align(vtkImageData* image, TranslateAlignOperator::Interpolation method)
+{
+  TranslateAlignOperator op(nullptr);
+  QVector<vtkVector2f> offsets;
+  offsets << vtkVector2f(0.0f, 0.0f) << vtkVector2f(2.0f, -1.0f)
+          << vtkVector2f(0.5f, 0.5f);
+  op.setAlignOffsets(offsets);
+  op.setInterpolation(method);
+  ASSERT_EQ(op.transform(image), TransformResult::Complete);
+}
+}
+
+TEST(TranslateAlignOperatorTest, whole_pixel_shift)
+{
+  vtkNew<vtkImageData> image;
+  createRamp(image.Get());
+  align(image.Get(), TranslateAlignOperator::Interpolation::Linear);
+
+  for (int y = 0; y < ny; ++y) {
+    for (int x = 0; x < nx; ++x) {
+      ASSERT_EQ(value(image.Get(), x, y, 0), x + 100 * y);
+      // Pixel (x, y) comes from (x - 2, y + 1), the edges left behind are
+      // filled with zeros.
+      if (x < 2 || y == ny - 1) {
+        ASSERT_EQ(value(image.Get(), x, y, 1), 0.0f);
+      } else {
+        ASSERT_EQ(value(image.Get(), x, y, 1), x - 2 + 100 * (y + 1));
+      }
+    }
+  }
+}
+
+TEST(TranslateAlignOperatorTest, half_pixel_shift)
+{
+  // A ramp resamples to itself moved by half a pixel, wherever the kernel
+  // lies within the image.
+  const TranslateAlignOperator::Interpolation methods[] = {
+    TranslateAlignOperator::Interpolation::Linear,
+    TranslateAlignOperator::Interpolation::Sinc
+  };
+  const int margins[2][2] = { { 1, 0 }, { 3, 2 } };
+  for (int m = 0; m < 2; ++m) {
+    vtkNew<vtkImageData> image;
+    createRamp(image.Get());
+    align(image.Get(), methods[m]);
+    for (int y = margins[m][0]; y < ny - margins[m][1]; ++y) {
+      for (int x = margins[m][0]; x < nx - margins[m][1]; ++x) {
+        ASSERT_NEAR(value(image.Get(), x, y, 2), x - 0.5 + 100 * (y - 0.5),
+                    1e-3);
+      }
+    }
+  }
+}
@@ -0,0 +1,97 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include <gtest/gtest.h>
+
+#include <vtkDataArray.h>
+#include <vtkSmartPointer.h>
+
+#include "VolumeBufferPool.h"
+
+#include <cstdint>
+
+using namespace tomviz;
+
+namespace {
+
+// Enough floats to be pooled.
+const vtkIdType tuples = 1 << 20;
+
+vtkSmartPointer<vtkDataArray> newArray(vtkIdType count = tuples)
+{
+  vtkSmartPointer<vtkDataArray> array;
+  array.TakeReference(VolumeBufferPool::newArray(VTK_FLOAT, 1, count));
+  return array;
+}
+}
+
+TEST(VolumeBufferPoolTest, buffers_are_reused)
+{
+  VolumeBufferPool::setCapacity(qint64(1) << 30);
+  VolumeBufferPool::trim();
+  auto before = VolumeBufferPool::statistics();
+
+  auto array = newArray();
+  ASSERT_EQ(array->GetNumberOfTuples(), tuples);
+  void* buffer = array->GetVoidPointer(0);
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(buffer) % (2 << 20), 0u);
+  auto inUse = VolumeBufferPool::statistics();
+  ASSERT_EQ(inUse.requests, before.requests + 1);
+  ASSERT_EQ(inUse.hits, before.hits);
+  ASSERT_GE(inUse.bytesInUse - before.bytesInUse, tuples * 4);
+
+  array = nullptr;
+  auto released = VolumeBufferPool::statistics();
+  ASSERT_EQ(released.bytesInUse, before.bytesInUse);
+  ASSERT_GE(released.bytesCached, tuples * 4);
+
+  // A slightly smaller array is of the same size class.
+  array = newArray(tuples - 1000);
+  ASSERT_EQ(array->GetVoidPointer(0), buffer);
+  auto reused = VolumeBufferPool::statistics();
+  ASSERT_EQ(reused.hits, before.hits + 1);
+  ASSERT_EQ(reused.bytesCached, before.bytesCached);
+  ASSERT_GE(reused.peakBytesInUse, reused.bytesInUse);
+
+  array = nullptr;
+  VolumeBufferPool::setCapacity(0);
+  ASSERT_EQ(VolumeBufferPool::statistics().bytesCached, 0);
+}
+
+TEST(VolumeBufferPoolTest, copy)
+{
+  auto array = newArray();
+  array->SetName("ImageScalars");
+  for (vtkIdType i = 0; i < tuples; i += 1000) {
+    array->SetTuple1(i, i);
+  }
+  vtkSmartPointer<vtkDataArray> copy;
+  copy.TakeReference(VolumeBufferPool::newCopy(array));
+  ASSERT_NE(copy->GetVoidPointer(0), array->GetVoidPointer(0));
+  ASSERT_STREQ(copy->GetName(), "ImageScalars");
+  ASSERT_EQ(copy->GetNumberOfTuples(), tuples);
+  for (vtkIdType i = 0; i < tuples; i += 1000) {
+    ASSERT_EQ(copy->GetTuple1(i), i);
+  }
+}
+
+TEST(VolumeBufferPoolTest, small_arrays_are_not_pooled)
+{
+  auto before = VolumeBufferPool::statistics();
+  auto array = newArray(16);
+  ASSERT_EQ(array->GetNumberOfTuples(), 16);
+  ASSERT_EQ(VolumeBufferPool::statistics().requests, before.requests);
+}
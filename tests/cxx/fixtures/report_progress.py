@@ -0,0 +1,10 @@
+import tomviz.operators
+
+
+class TestOperator(tomviz.operators.Operator):
+
+    def transform_scalars(self, data):
+        self.progress.maximum = 4
+        for i in range(1, 5):
+            self.progress.value = i
+        self.progress.message = 'Done'
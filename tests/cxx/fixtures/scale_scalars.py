@@ -0,0 +1,15 @@
+from tomviz import utils
+
+
+def transform_scalars(dataset, scale, offset, in_place):
+    # Whole floats must arrive as floats and ints as ints.
+    if not isinstance(scale, float) or isinstance(offset, float):
+        raise TypeError('scale is %r and offset is %r' % (scale, offset))
+
+    scalars = utils.get_scalars(dataset)
+    if in_place:
+        scalars *= scale
+        scalars += offset
+    else:
+        scaled = scalars * scale + offset
+        utils.set_scalars(dataset, scaled.astype('float64'))
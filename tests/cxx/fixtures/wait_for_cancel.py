@@ -0,0 +1,16 @@
+import tomviz.operators
+import time
+
+
+class TestOperator(tomviz.operators.CancelableOperator):
+
+    def transform_scalars(self, data):
+        # Reports progress once, the test cancels when it arrives.
+        self.progress.value = 1
+        i = 0
+        while not self.canceled and i < 300:
+            time.sleep(0.1)
+            i += 1
+
+        if self.canceled:
+            raise Exception('Canceled')
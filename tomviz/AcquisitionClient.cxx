@@ -17,10 +17,143 @@
 #include "AcquisitionClient.h"
 
 #include "JsonRpcClient.h"
+#include <QJsonDocument>
 #include <QNetworkAccessManager>
+#include <QtEndian>
+
+#include <cstring>
+#include <limits>
 
 namespace tomviz {
 
+void AcquisitionFrameReader::append(const QByteArray& bytes)
+{
+  // The frames taken are only dropped here, so they are moved once for each
+  // read rather than for each frame.
+  if (m_offset > 0) {
+    m_buffer.remove(0, m_offset);
+    m_offset = 0;
+  }
+  m_buffer.append(bytes);
+}
+
+bool AcquisitionFrameReader::takeFrame(Frame& frame)
+{
+  if (!m_valid || m_buffer.size() - m_offset < headerSize) {
+    return false;
+  }
+
+  const char* header = m_buffer.constData() + m_offset;
+  if (memcmp(header, "TVZF", 4) != 0) {
+    m_valid = false;
+    return false;
+  }
+  auto field = [header](int i) {
+    return qFromLittleEndian<quint32>(
+      reinterpret_cast<const uchar*>(header) + 4 * i);
+  };
+  quint32 mimeTypeSize = field(2);
+  quint32 payloadSize = field(3);
+  qint64 end = static_cast<qint64>(m_offset) + headerSize + mimeTypeSize +
+               payloadSize;
+  if (end > std::numeric_limits<int>::max()) {
+    m_valid = false;
+    return false;
+  }
+  if (m_buffer.size() < end) {
+    return false;
+  }
+
+  int start = m_offset + headerSize;
+  frame.index = static_cast<int>(field(1));
+  frame.mimeType = QString::fromLatin1(m_buffer.constData() + start,
+                                       static_cast<int>(mimeTypeSize));
+  frame.payload = m_buffer.mid(start + static_cast<int>(mimeTypeSize),
+                               static_cast<int>(payloadSize));
+  m_offset = static_cast<int>(end);
+  return true;
+}
+
+AcquisitionClientStreamRequest::AcquisitionClientStreamRequest(
+  QNetworkReply* reply, QObject* parent)
+  : AcquisitionClientBaseRequest(parent), m_reply(reply)
+{
+  QObject::connect(reply, &QNetworkReply::readyRead, this,
+                   &AcquisitionClientStreamRequest::readFrames);
+  QObject::connect(reply, &QNetworkReply::finished, this,
+                   &AcquisitionClientStreamRequest::onFinished);
+}
+
+void AcquisitionClientStreamRequest::abort()
+{
+  if (m_aborted) {
+    return;
+  }
+  m_aborted = true;
+  if (m_reply) {
+    m_reply->disconnect(this);
+    m_reply->abort();
+    m_reply->deleteLater();
+  }
+}
+
+void AcquisitionClientStreamRequest::readFrames()
+{
+  if (m_aborted) {
+    return;
+  }
+  m_reader.append(m_reply->readAll());
+
+  AcquisitionFrameReader::Frame frame;
+  // Anything connected may abort the stream.
+  while (!m_aborted && m_reader.takeFrame(frame)) {
+    if (frame.mimeType != "application/json") {
+      emit imageReceived(frame.index, frame.mimeType, frame.payload);
+      continue;
+    }
+
+    QJsonParseError errorHandler;
+    auto doc = QJsonDocument::fromJson(frame.payload, &errorHandler);
+    if (errorHandler.error != QJsonParseError::NoError) {
+      emit error(errorHandler.errorString(), QJsonValue(errorHandler.error));
+    } else if (!doc.isObject()) {
+      emit error("Response did not contain a valid JSON object.",
+                 QJsonValue());
+    } else if (doc.object().contains("error")) {
+      QJsonObject errorObject = doc.object()["error"].toObject();
+      emit error(errorObject["message"].toString(), errorObject["data"]);
+    } else {
+      emit resultReceived(frame.index, doc.object()["result"]);
+    }
+  }
+
+  if (!m_aborted && !m_reader.isValid()) {
+    emit error("Stream contains an invalid frame.", QJsonValue());
+    abort();
+  }
+}
+
+void AcquisitionClientStreamRequest::onFinished()
+{
+  readFrames();
+  if (m_aborted) {
+    return;
+  }
+
+  QVariant statusCode =
+    m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  if (m_reply->error() != QNetworkReply::NoError) {
+    QJsonValue data(statusCode.isValid() ? statusCode.toInt()
+                                         : static_cast<int>(m_reply->error()));
+    emit error(m_reply->errorString(), data);
+  } else if (m_reader.hasPartialFrame()) {
+    emit error("Stream ended part way through a frame.", QJsonValue());
+  } else {
+    emit finished();
+  }
+  m_reply->deleteLater();
+}
+
 AcquisitionClient::AcquisitionClient(const QString& url, QObject* parent)
   : QObject(parent), m_jsonRpcClient(new JsonRpcClient(url, this))
 {
@@ -79,6 +212,34 @@ AcquisitionClientRequest* AcquisitionClient::describe(const QString& method)
   return makeRequest("describe", params);
 }
 
+AcquisitionClientStreamRequest* AcquisitionClient::stream(
+  const QJsonArray& calls)
+{
+  QNetworkReply* reply = m_jsonRpcClient->sendStreamRequest(calls);
+
+  return new AcquisitionClientStreamRequest(reply, this);
+}
+
+AcquisitionClientStreamRequest* AcquisitionClient::tilt_series(
+  const QVector<double>& angles)
+{
+  QJsonArray calls;
+  foreach (double angle, angles) {
+    QJsonObject params;
+    params["angle"] = angle;
+    QJsonObject tiltParams;
+    tiltParams["method"] = QLatin1String("tilt_params");
+    tiltParams["params"] = params;
+    calls.append(tiltParams);
+
+    QJsonObject stemAcquire;
+    stemAcquire["method"] = QLatin1String("stem_acquire");
+    calls.append(stemAcquire);
+  }
+
+  return stream(calls);
+}
+
 AcquisitionClientRequest* AcquisitionClient::makeRequest(
   const QString& method, const QJsonObject& params)
 {
@@ -17,9 +17,15 @@
 #ifndef ACQUISITION_CLIENT_H
 #define ACQUISITION_CLIENT_H
 
+#include <QByteArray>
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QObject>
+#include <QPointer>
+#include <QVector>
+
+class QNetworkReply;
 
 namespace tomviz {
 
@@ -67,6 +73,74 @@ signals:
   void finished(const QString mimeType, const QByteArray& result);
 };
 
+/// Splits a stream of acquisition frames into the frames, as its bytes
+/// arrive. Each frame is a header of the magic "TVZF" and three little endian
+/// 32 bit integers, the index of the call it answers, the length of the mime
+/// type and the length of the payload, followed by the mime type and payload.
+class AcquisitionFrameReader
+{
+public:
+  static const int headerSize = 16;
+
+  struct Frame
+  {
+    int index = -1;
+    QString mimeType;
+    QByteArray payload;
+  };
+
+  void append(const QByteArray& bytes);
+
+  /// Takes the next complete frame. Returns false if there is none yet, or
+  /// if the stream isn't valid.
+  bool takeFrame(Frame& frame);
+
+  /// False once bytes that don't start a frame have been read.
+  bool isValid() const { return m_valid; }
+
+  /// True if the bytes of an incomplete frame are left.
+  bool hasPartialFrame() const { return m_buffer.size() > m_offset; }
+
+private:
+  QByteArray m_buffer;
+  int m_offset = 0;
+  bool m_valid = true;
+};
+
+/// The frames answering a stream of calls, emitted as they arrive.
+class AcquisitionClientStreamRequest : public AcquisitionClientBaseRequest
+{
+  Q_OBJECT
+
+public:
+  explicit AcquisitionClientStreamRequest(QNetworkReply* reply,
+                                          QObject* parent = 0);
+
+public slots:
+  /// Stops the stream, nothing more is emitted.
+  void abort();
+
+signals:
+  /// The result of the call at index, for calls that don't return an image.
+  void resultReceived(int index, const QJsonValue& result);
+
+  /// The image the call at index returned.
+  void imageReceived(int index, const QString& mimeType,
+                     const QByteArray& image);
+
+  /// Emitted once every call has been answered.
+  void finished();
+
+private slots:
+  void readFrames();
+  void onFinished();
+
+private:
+  QPointer<QNetworkReply> m_reply;
+  AcquisitionFrameReader m_reader;
+  bool m_aborted = false;
+};
+
 class AcquisitionClient : public QObject
 {
   Q_OBJECT
@@ -94,6 +168,16 @@ public slots:
 
   AcquisitionClientRequest* describe(const QString& method);
 
+  /// Makes each of calls, objects of the method and its params, in turn in a
+  /// single request. The server answers each as soon as it returns, with the
+  /// images themselves rather than their URLs.
+  AcquisitionClientStreamRequest* stream(const QJsonArray& calls);
+
+  /// Streams tilt_params and stem_acquire for each of angles, so the stage
+  /// is moved to the next angle as soon as each image has been sent. Call
+  /// 2 * i returns the angle reached and call 2 * i + 1 the image there.
+  AcquisitionClientStreamRequest* tilt_series(const QVector<double>& angles);
+
 private slots:
 
   AcquisitionClientRequest* makeRequest(const QString& method,
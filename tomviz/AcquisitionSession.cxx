@@ -0,0 +1,344 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "AcquisitionSession.h"
+
+#include "DataSource.h"
+#include "LoadDataReaction.h"
+#include "PipelineCache.h"
+#include "TomographyReconstruction.h"
+#include "Utilities.h"
+#include "VolumeBufferPool.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkTrivialProducer.h>
+#include <vtkTypeInt8Array.h>
+#include <vtksys/SystemInformation.hxx>
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace tomviz {
+
+namespace {
+
+// The live reconstruction is only meant to judge the acquisition by, the
+// projections are binned down to at most this many rays for it.
+const int maximumReconstructionRays = 512;
+
+void releaseStorage(vtkObject*, unsigned long, void* clientData, void*)
+{
+  static_cast<vtkDataArray*>(clientData)->UnRegister(nullptr);
+}
+
+// Returns a new array of the first tuples of storage, without copying them.
+// The view keeps storage alive for as long as it is itself referenced.
+vtkDataArray* newView(vtkDataArray* storage, vtkIdType tuples)
+{
+  vtkDataArray* view = vtkDataArray::CreateDataArray(storage->GetDataType());
+  view->SetName(storage->GetName());
+  view->SetVoidArray(storage->GetVoidPointer(0), tuples, 1);
+  storage->Register(nullptr);
+  vtkNew<vtkCallbackCommand> release;
+  release->SetCallback(releaseStorage);
+  release->SetClientData(storage);
+  view->AddObserver(vtkCommand::DeleteEvent, release.Get());
+  return view;
+}
+
+// Averages bin by bin blocks of the dims[0] by dims[1] values into result,
+// which is dims[0] / bin by dims[1] / bin. Values left over at the ends are
+// dropped.
+template <typename T>
+void binToFloat(const T* values, const int dims[2], int bin, float* result)
+{
+  const int width = dims[0] / bin;
+  const int height = dims[1] / bin;
+  const float scale = 1.0f / (bin * bin);
+  for (int j = 0; j < height; ++j) {
+    float* row = result + static_cast<size_t>(j) * width;
+    std::fill(row, row + width, 0.0f);
+    for (int k = j * bin; k < (j + 1) * bin; ++k) {
+      const T* in = values + static_cast<size_t>(k) * dims[0];
+      for (int i = 0; i < width * bin; ++i) {
+        row[i / bin] += static_cast<float>(in[i]);
+      }
+    }
+    for (int i = 0; i < width; ++i) {
+      row[i] *= scale;
+    }
+  }
+}
+
+// Replaces the original data of dataSource and runs its operators again.
+void replaceData(DataSource* dataSource, vtkImageData* image)
+{
+  vtkSMSourceProxy* proxy = dataSource->originalDataSource();
+  vtkTrivialProducer* tp =
+    vtkTrivialProducer::SafeDownCast(proxy->GetClientSideObject());
+  tp->SetOutput(image);
+  proxy->MarkModified(nullptr);
+  PipelineCache::instance().remove(dataSource->operators());
+  dataSource->executeOperators();
+}
+
+DataSource* addDataSource(vtkImageData* image, const char* label)
+{
+  DataSource* dataSource = LoadDataReaction::createDataSource(image);
+  dataSource->producer()->SetAnnotation(Attributes::LABEL, label);
+  LoadDataReaction::dataSourceAdded(dataSource);
+  return dataSource;
+}
+}
+
+class AcquisitionSession::ReconstructTask : public QRunnable
+{
+public:
+  ReconstructTask(AcquisitionSession* session, std::vector<float>& projection,
+                  double tiltAngle)
+    : m_session(session), m_tiltAngle(tiltAngle)
+  {
+    m_projection.swap(projection);
+  }
+
+  void run() override
+  {
+    auto& backProjection = *m_session->m_backProjection;
+    vtkSmartPointer<vtkDataArray> values;
+    values.TakeReference(VolumeBufferPool::newArray(
+      VTK_FLOAT, 1,
+      static_cast<vtkIdType>(backProjection.reconstructionSize())));
+    values->SetName("ImageScalars");
+
+    // The update is written to a new array, the one before it may be on
+    // display while this runs.
+    const float* previous = nullptr;
+    if (m_session->m_latest) {
+      previous = static_cast<float*>(m_session->m_latest->GetVoidPointer(0));
+    }
+    float* recon = static_cast<float*>(values->GetVoidPointer(0));
+    backProjection.addProjection(m_projection.data(), m_tiltAngle, previous,
+                                 recon);
+    m_session->m_latest = values;
+    {
+      QMutexLocker locker(&m_session->m_mutex);
+      m_session->m_reconstructed.append(
+        { backProjection.numberOfProjections(), values });
+    }
+    // The session waits for its tasks in its destructor, so it is alive.
+    QMetaObject::invokeMethod(m_session, "deliver", Qt::QueuedConnection);
+  }
+
+private:
+  AcquisitionSession* m_session;
+  std::vector<float> m_projection;
+  double m_tiltAngle;
+};
+
+AcquisitionSession::AcquisitionSession(int plannedProjections,
+                                       bool reconstruct, QObject* parentObject)
+  : QObject(parentObject), m_capacity(std::max(plannedProjections, 1)),
+    m_reconstruct(reconstruct)
+{
+  m_pool.setMaxThreadCount(1);
+}
+
+AcquisitionSession::~AcquisitionSession()
+{
+  waitForDone();
+}
+
+bool AcquisitionSession::append(vtkImageData* projection, double tiltAngle,
+                                QString* errorMessage)
+{
+  vtkDataArray* scalars = projection->GetPointData()->GetScalars();
+  int dims[3];
+  projection->GetDimensions(dims);
+  QString error;
+  if (!scalars || scalars->GetNumberOfComponents() != 1 || dims[2] != 1) {
+    error = "Projections must be single component images.";
+  } else if (m_tiltAngles.isEmpty()) {
+    m_dimensions[0] = dims[0];
+    m_dimensions[1] = dims[1];
+    m_scalarType = scalars->GetDataType();
+    double spacing[3];
+    projection->GetSpacing(spacing);
+    m_spacing[0] = spacing[0];
+    m_spacing[1] = spacing[1];
+  } else if (dims[0] != m_dimensions[0] || dims[1] != m_dimensions[1] ||
+             scalars->GetDataType() != m_scalarType) {
+    error = QString("Projection is %1 x %2 %3, the tilt series is %4 x %5 %6.")
+              .arg(dims[0])
+              .arg(dims[1])
+              .arg(scalars->GetDataTypeAsString())
+              .arg(m_dimensions[0])
+              .arg(m_dimensions[1])
+              .arg(vtkImageScalarTypeNameMacro(m_scalarType));
+  }
+  if (!error.isEmpty()) {
+    if (errorMessage) {
+      *errorMessage = error;
+    }
+    return false;
+  }
+
+  const vtkIdType frame = static_cast<vtkIdType>(dims[0]) * dims[1];
+  const size_t frameBytes =
+    static_cast<size_t>(frame) * scalars->GetDataTypeSize();
+  const int count = m_tiltAngles.size();
+  if (!m_storage || count == m_capacity) {
+    // Sized for the planned projections, and doubled if more arrive. The
+    // views of the old storage keep it alive while they are in use.
+    if (m_storage) {
+      m_capacity *= 2;
+    }
+    vtkSmartPointer<vtkDataArray> storage;
+    storage.TakeReference(
+      VolumeBufferPool::newArray(m_scalarType, 1, frame * m_capacity));
+    storage->SetName("ImageScalars");
+    if (m_storage) {
+      memcpy(storage->GetVoidPointer(0), m_storage->GetVoidPointer(0),
+             frameBytes * count);
+    }
+    m_storage = storage;
+  }
+  memcpy(static_cast<char*>(m_storage->GetVoidPointer(0)) + frameBytes * count,
+         scalars->GetVoidPointer(0), frameBytes);
+  m_tiltAngles.append(tiltAngle);
+  updateTiltSeries();
+
+  if (m_reconstruct && !m_backProjection) {
+    startReconstruction();
+  }
+  if (m_reconstruct) {
+    std::vector<float> values(static_cast<size_t>(m_binned[0]) * m_binned[1]);
+    switch (m_scalarType) {
+      vtkTemplateMacro(
+        binToFloat(static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)),
+                   m_dimensions, m_binning, values.data()));
+    }
+    m_pool.start(new ReconstructTask(this, values, tiltAngle));
+  }
+  return true;
+}
+
+void AcquisitionSession::startReconstruction()
+{
+  int largest = std::max(m_dimensions[0], m_dimensions[1]);
+  m_binning = (largest + maximumReconstructionRays - 1) /
+              maximumReconstructionRays;
+  m_binned[0] = std::max(m_dimensions[0] / m_binning, 1);
+  m_binned[1] = std::max(m_dimensions[1] / m_binning, 1);
+
+  // Three reconstructions may be alive at once, the one on display, the
+  // latest and the one being written. Those must fit in a quarter of the
+  // memory, next to the tilt series.
+  double bytes = 3.0 * m_binned[0] * m_binned[1] * m_binned[1] * sizeof(float);
+  vtksys::SystemInformation info;
+  info.RunMemoryCheck();
+  double available = info.GetTotalPhysicalMemory() / 4.0 * 1024 * 1024;
+  if (bytes > available) {
+    m_reconstruct = false;
+    emit reconstructionSkipped(
+      QString("Not reconstructing, a %1 x %2 x %2 reconstruction would not "
+              "fit in memory")
+        .arg(m_binned[0])
+        .arg(m_binned[1]));
+    return;
+  }
+  m_backProjection.reset(new TomographyReconstruction::StreamingBackProjection(
+    m_binned[0], m_binned[1]));
+}
+
+void AcquisitionSession::updateTiltSeries()
+{
+  const int count = m_tiltAngles.size();
+  vtkNew<vtkImageData> image;
+  image->SetExtent(0, m_dimensions[0] - 1, 0, m_dimensions[1] - 1, 0,
+                   count - 1);
+  image->SetSpacing(m_spacing);
+  vtkSmartPointer<vtkDataArray> view;
+  view.TakeReference(newView(
+    m_storage, static_cast<vtkIdType>(m_dimensions[0]) * m_dimensions[1] *
+                 count));
+  image->GetPointData()->SetScalars(view);
+
+  vtkNew<vtkDoubleArray> angles;
+  angles->SetName("tilt_angles");
+  angles->SetNumberOfTuples(count);
+  for (int i = 0; i < count; ++i) {
+    angles->SetValue(i, m_tiltAngles[i]);
+  }
+  image->GetFieldData()->AddArray(angles.Get());
+  vtkNew<vtkTypeInt8Array> type;
+  type->SetName("tomviz_data_source_type");
+  type->SetNumberOfTuples(1);
+  type->SetTuple1(0, DataSource::TiltSeries);
+  image->GetFieldData()->AddArray(type.Get());
+
+  if (count == 1) {
+    m_tiltSeries = addDataSource(image.Get(), "Live tilt series");
+  } else if (m_tiltSeries) {
+    replaceData(m_tiltSeries, image.Get());
+  }
+}
+
+void AcquisitionSession::waitForDone()
+{
+  m_pool.waitForDone();
+}
+
+void AcquisitionSession::deliver()
+{
+  QList<Reconstructed> reconstructed;
+  {
+    QMutexLocker locker(&m_mutex);
+    reconstructed.swap(m_reconstructed);
+  }
+  if (reconstructed.isEmpty()) {
+    return;
+  }
+
+  // Only the latest is shown, the others are skipped when projections arrive
+  // faster than they are back projected.
+  const Reconstructed& latest = reconstructed.last();
+  vtkNew<vtkImageData> image;
+  image->SetExtent(0, m_binned[0] - 1, 0, m_binned[1] - 1, 0,
+                   m_binned[1] - 1);
+  image->SetSpacing(m_spacing[0] * m_binning, m_spacing[1] * m_binning,
+                    m_spacing[1] * m_binning);
+  image->GetPointData()->SetScalars(latest.values);
+
+  if (!m_reconstructionAdded) {
+    m_reconstruction = addDataSource(image.Get(), "Live reconstruction");
+    m_reconstructionAdded = true;
+  } else if (m_reconstruction) {
+    replaceData(m_reconstruction, image.Get());
+  }
+  emit reconstructionUpdated(latest.count);
+}
+}
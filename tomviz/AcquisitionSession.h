@@ -0,0 +1,131 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizAcquisitionSession_h
+#define tomvizAcquisitionSession_h
+
+#include <QObject>
+
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <memory>
+
+class vtkDataArray;
+class vtkImageData;
+
+namespace tomviz {
+
+class DataSource;
+
+namespace TomographyReconstruction {
+class StreamingBackProjection;
+}
+
+/// Assembles the projections of an acquisition into a tilt series data source
+/// as they arrive, and optionally reconstructs it as it grows. The tilt series
+/// is stored in one buffer sized for the planned number of projections, which
+/// is only reallocated if more arrive. Each projection is back projected into
+/// the reconstruction on a background thread, and the reconstruction data
+/// source is updated on the UI thread with the latest result, so it can be
+/// judged while the acquisition is still running. The projections are binned
+/// for it to at most 512 rays, and it is skipped if it would still not fit in
+/// memory.
+class AcquisitionSession : public QObject
+{
+  Q_OBJECT
+
+public:
+  AcquisitionSession(int plannedProjections, bool reconstruct,
+                     QObject* parent = nullptr);
+  ~AcquisitionSession() override;
+
+  /// Appends a projection taken at tiltAngle degrees to the tilt series. The
+  /// first projection sets the size and type the others must have. Returns
+  /// false, and sets errorMessage if given, if the projection doesn't match.
+  bool append(vtkImageData* projection, double tiltAngle,
+              QString* errorMessage = nullptr);
+
+  int numberOfProjections() const { return m_tiltAngles.size(); }
+
+  /// The data sources, created with the first projection and the first
+  /// reconstruction. These are null until then, or if they are deleted.
+  DataSource* tiltSeries() const { return m_tiltSeries; }
+  DataSource* reconstruction() const { return m_reconstruction; }
+
+  /// Waits until every projection appended has been back projected.
+  void waitForDone();
+
+signals:
+  /// The reconstruction data source now shows the reconstruction of the
+  /// first count projections.
+  void reconstructionUpdated(int count);
+
+  /// Emitted with the first projection if the reconstruction was asked for
+  /// but is too large to keep in memory.
+  void reconstructionSkipped(const QString& reason);
+
+private slots:
+  void deliver();
+
+private:
+  class ReconstructTask;
+
+  struct Reconstructed
+  {
+    int count;
+    vtkSmartPointer<vtkDataArray> values;
+  };
+
+  void updateTiltSeries();
+  void startReconstruction();
+
+  int m_capacity;
+  bool m_reconstruct;
+  int m_dimensions[2] = { 0, 0 };
+  double m_spacing[3] = { 1.0, 1.0, 1.0 };
+  int m_scalarType = 0;
+  vtkSmartPointer<vtkDataArray> m_storage;
+  QVector<double> m_tiltAngles;
+  QPointer<DataSource> m_tiltSeries;
+  QPointer<DataSource> m_reconstruction;
+  bool m_reconstructionAdded = false;
+
+  // The projections are binned by m_binning to m_binned for the
+  // reconstruction.
+  int m_binning = 1;
+  int m_binned[2] = { 0, 0 };
+
+  // Only the reconstruct tasks touch these, one at a time.
+  std::unique_ptr<TomographyReconstruction::StreamingBackProjection>
+    m_backProjection;
+  vtkSmartPointer<vtkDataArray> m_latest;
+
+  // One thread, so the projections are back projected in order.
+  QThreadPool m_pool;
+
+  // Reconstructions handed over by the tasks.
+  QMutex m_mutex;
+  QList<Reconstructed> m_reconstructed;
+};
+}
+
+#endif
@@ -19,7 +19,9 @@
 #include "ui_AcquisitionWidget.h"
 
 #include "AcquisitionClient.h"
+#include "AcquisitionSession.h"
 #include "ActiveObjects.h"
+#include "ImageDecoder.h"
 
 #include <pqApplicationCore.h>
 #include <pqSettings.h>
@@ -34,19 +36,32 @@
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
 #include <vtkScalarsToColors.h>
-#include <vtkTIFFReader.h>
 
-#include <QBuffer>
 #include <QCloseEvent>
 #include <QDebug>
 #include <QDir>
-#include <QFile>
+
+#include <cmath>
 
 namespace tomviz {
 
+namespace {
+
+QString imageName(double tiltAngle)
+{
+  QString name = "tomviz_";
+  if (tiltAngle > 0.0) {
+    name.append('+');
+  }
+  name.append(QString::number(tiltAngle, 'g', 2));
+  return name;
+}
+}
+
 AcquisitionWidget::AcquisitionWidget(QWidget* parent)
   : QWidget(parent), m_ui(new Ui::AcquisitionWidget),
-    m_client(new AcquisitionClient("http://localhost:8080/acquisition", this))
+    m_client(new AcquisitionClient("http://localhost:8080/acquisition", this)),
+    m_decoder(new ImageDecoder(this))
 {
   m_ui->setupUi(this);
   this->setWindowFlags(Qt::Dialog);
@@ -55,6 +70,15 @@ AcquisitionWidget::AcquisitionWidget(QWidget* parent)
   connect(m_ui->disconnectButton, SIGNAL(clicked(bool)),
           SLOT(disconnectFromServer()));
   connect(m_ui->previewButton, SIGNAL(clicked(bool)), SLOT(setTiltAngle()));
+  connect(m_ui->acquireButton, SIGNAL(clicked(bool)),
+          SLOT(startAcquisition()));
+  connect(m_ui->stopButton, SIGNAL(clicked(bool)), SLOT(onStopClicked()));
+  connect(m_ui->archiveCheckBox, SIGNAL(toggled(bool)),
+          SLOT(updateArchiveDirectory()));
+  connect(m_decoder.data(), &ImageDecoder::imageReady, this,
+          &AcquisitionWidget::showImage);
+  connect(m_decoder.data(), &ImageDecoder::failed, this,
+          &AcquisitionWidget::onDecodeError);
 
   m_ui->imageWidget->GetRenderWindow()->AddRenderer(m_renderer.Get());
   m_ui->imageWidget->GetInteractor()->SetInteractorStyle(
@@ -65,6 +89,7 @@ AcquisitionWidget::AcquisitionWidget(QWidget* parent)
   m_renderer->SetViewport(0.0, 0.0, 1.0, 1.0);
 
   readSettings();
+  updateArchiveDirectory();
 }
 
 AcquisitionWidget::~AcquisitionWidget() = default;
@@ -87,6 +112,14 @@ void AcquisitionWidget::readSettings()
   m_ui->hostnameEdit->setText(
     settings->value("hostname", "localhost").toString());
   m_ui->portEdit->setText(settings->value("port", "8080").toString());
+  m_ui->archiveCheckBox->setChecked(settings->value("archive", true).toBool());
+  m_ui->startAngleSpinBox->setValue(
+    settings->value("startAngle", -70.0).toDouble());
+  m_ui->endAngleSpinBox->setValue(settings->value("endAngle", 70.0).toDouble());
+  m_ui->angleStepSpinBox->setValue(
+    settings->value("angleStep", 2.0).toDouble());
+  m_ui->reconstructCheckBox->setChecked(
+    settings->value("reconstruct", true).toBool());
   settings->endGroup();
 }
 
@@ -98,6 +131,11 @@ void AcquisitionWidget::writeSettings()
   settings->setValue("splitterSizes", m_ui->splitter->saveState());
   settings->setValue("hostname", m_ui->hostnameEdit->text());
   settings->setValue("port", m_ui->portEdit->text());
+  settings->setValue("archive", m_ui->archiveCheckBox->isChecked());
+  settings->setValue("startAngle", m_ui->startAngleSpinBox->value());
+  settings->setValue("endAngle", m_ui->endAngleSpinBox->value());
+  settings->setValue("angleStep", m_ui->angleStepSpinBox->value());
+  settings->setValue("reconstruct", m_ui->reconstructCheckBox->isChecked());
   settings->endGroup();
 }
 
@@ -198,35 +236,146 @@ void AcquisitionWidget::acquirePreview(const QJsonValue& result)
 
 void AcquisitionWidget::previewReady(QString mimeType, QByteArray result)
 {
-  if (mimeType != "image/tiff") {
-    qDebug() << "image/tiff is the only supported mime type right now.\n"
+  if (!ImageDecoder::canDecode(mimeType)) {
+    qDebug() << "image/tiff and" << ImageDecoder::rawMimeType
+             << "are the only supported mime types right now.\n"
              << mimeType << "\n";
     return;
   }
 
-  QDir dir(QDir::homePath() + "/tomviz-data");
-  if (!dir.exists()) {
-    dir.mkpath(dir.path());
+  // Decoded, and saved if asked to, in the background.
+  m_decoder->submit(mimeType, result, imageName(m_tiltAngle));
+}
+
+void AcquisitionWidget::startAcquisition()
+{
+  double start = m_ui->startAngleSpinBox->value();
+  double end = m_ui->endAngleSpinBox->value();
+  double step = m_ui->angleStepSpinBox->value();
+  int count =
+    static_cast<int>(std::floor(std::abs(end - start) / step + 1e-6));
+  if (end < start) {
+    step = -step;
+  }
+  m_plannedAngles.clear();
+  for (int i = 0; i <= count; ++i) {
+    m_plannedAngles.append(start + i * step);
+  }
+  m_reconstructedCount = 0;
+  m_projectionAngles.clear();
+
+  // The data sources of the session before stay loaded.
+  m_session.reset(new AcquisitionSession(
+    m_plannedAngles.size(), m_ui->reconstructCheckBox->isChecked()));
+  connect(m_session.data(), &AcquisitionSession::reconstructionUpdated, this,
+          &AcquisitionWidget::onReconstructionUpdated);
+  connect(m_session.data(), &AcquisitionSession::reconstructionSkipped,
+          m_ui->statusEdit, &QTextEdit::setText);
+
+  m_acquiring = true;
+  m_ui->previewButton->setEnabled(false);
+  m_ui->acquireButton->setEnabled(false);
+  m_ui->stopButton->setEnabled(true);
+  m_ui->statusEdit->setText("Acquiring a tilt series");
+  updateProgress();
+
+  // The whole tilt series is a single request, the server moves the stage to
+  // the next angle as soon as it has sent the image before.
+  m_stream = m_client->tilt_series(m_plannedAngles);
+  connect(m_stream.data(), &AcquisitionClientStreamRequest::resultReceived,
+          this, &AcquisitionWidget::onProjectionAngle);
+  connect(m_stream.data(), &AcquisitionClientStreamRequest::imageReceived,
+          this, &AcquisitionWidget::projectionReady);
+  connect(m_stream.data(), &AcquisitionClientStreamRequest::finished, this,
+          &AcquisitionWidget::onAcquisitionFinished);
+  connect(m_stream.data(), &AcquisitionClientStreamRequest::error, this,
+          &AcquisitionWidget::onError);
+}
+
+void AcquisitionWidget::onProjectionAngle(int index, const QJsonValue& result)
+{
+  if (!m_acquiring || index % 2 != 0) {
+    return;
+  }
+  // The angle the stage reached, rather than the one asked for.
+  m_tiltAngle = result.toDouble(m_plannedAngles[index / 2]);
+  m_ui->tiltAngle->setText(QString::number(m_tiltAngle, 'g', 2));
+}
+
+void AcquisitionWidget::projectionReady(int, const QString& mimeType,
+                                        const QByteArray& result)
+{
+  if (!m_acquiring) {
+    return;
+  }
+  if (!ImageDecoder::canDecode(mimeType)) {
+    stopAcquisition("Acquisition stopped, unsupported image type " +
+                    mimeType);
+    return;
+  }
+
+  // The stage moves to the next angle while this projection is decoded.
+  int id = m_decoder->submit(mimeType, result, imageName(m_tiltAngle));
+  m_projectionAngles.insert(id, m_tiltAngle);
+}
+
+void AcquisitionWidget::onAcquisitionFinished()
+{
+  if (m_acquiring) {
+    stopAcquisition(
+      QString("Acquired %1 projections").arg(m_plannedAngles.size()));
+  }
+}
+
+void AcquisitionWidget::onReconstructionUpdated(int count)
+{
+  m_reconstructedCount = count;
+  updateProgress();
+}
+
+void AcquisitionWidget::onStopClicked()
+{
+  if (m_acquiring) {
+    stopAcquisition("Acquisition stopped");
+  }
+}
+
+void AcquisitionWidget::stopAcquisition(const QString& status)
+{
+  m_acquiring = false;
+  if (m_stream) {
+    m_stream->abort();
+    m_stream->deleteLater();
   }
+  m_ui->statusEdit->setText(status);
+  m_ui->previewButton->setEnabled(true);
+  m_ui->acquireButton->setEnabled(true);
+  m_ui->stopButton->setEnabled(false);
+}
 
-  QString path = "/tomviz_";
+void AcquisitionWidget::updateProgress()
+{
+  QString progress = QString("%1 of %2")
+                       .arg(m_session->numberOfProjections())
+                       .arg(m_plannedAngles.size());
+  if (m_ui->reconstructCheckBox->isChecked()) {
+    progress += QString(", %1 reconstructed").arg(m_reconstructedCount);
+  }
+  m_ui->progress->setText(progress);
+}
 
-  if (m_tiltAngle > 0.0) {
-    path.append('+');
+void AcquisitionWidget::showImage(int id, vtkSmartPointer<vtkImageData> image)
+{
+  if (m_projectionAngles.contains(id)) {
+    QString errorMessage;
+    if (!m_session->append(image, m_projectionAngles.take(id),
+                           &errorMessage)) {
+      stopAcquisition("Acquisition stopped, " + errorMessage);
+    }
+    updateProgress();
   }
-  path.append(QString::number(m_tiltAngle, 'g', 2));
-  path.append(".tiff");
-
-  QFile file(dir.path() + path);
-  file.open(QIODevice::WriteOnly);
-  file.write(result);
-  qDebug() << "Data file:" << file.fileName();
-  file.close();
-
-  vtkNew<vtkTIFFReader> reader;
-  reader->SetFileName(file.fileName().toLatin1());
-  reader->Update();
-  m_imageData = reader->GetOutput();
+
+  m_imageData = image;
   m_imageSlice->GetProperty()->SetInterpolationTypeToNearest();
   m_imageSliceMapper->SetInputData(m_imageData.Get());
   m_imageSliceMapper->Update();
@@ -245,8 +394,30 @@ void AcquisitionWidget::previewReady(QString mimeType, QByteArray result)
     m_imageSlice->GetProperty()->SetLookupTable(m_lut.Get());
   }
 
-  m_ui->previewButton->setEnabled(true);
-  m_ui->acquireButton->setEnabled(true);
+  if (!m_acquiring) {
+    m_ui->previewButton->setEnabled(true);
+    m_ui->acquireButton->setEnabled(true);
+  }
+}
+
+void AcquisitionWidget::onDecodeError(int id, const QString& errorMessage)
+{
+  // A projection that can't be decoded is left out of the tilt series.
+  m_projectionAngles.remove(id);
+  m_ui->statusEdit->setText("Failed to decode image: " + errorMessage);
+  if (!m_acquiring) {
+    m_ui->previewButton->setEnabled(true);
+    m_ui->acquireButton->setEnabled(true);
+  }
+}
+
+void AcquisitionWidget::updateArchiveDirectory()
+{
+  if (m_ui->archiveCheckBox->isChecked()) {
+    m_decoder->setArchiveDirectory(QDir::homePath() + "/tomviz-data");
+  } else {
+    m_decoder->setArchiveDirectory(QString());
+  }
 }
 
 void AcquisitionWidget::resetCamera()
@@ -280,5 +451,8 @@ void AcquisitionWidget::onError(const QString& errorMessage,
 {
   qDebug() << errorMessage;
   qDebug() << errorData;
+  if (m_acquiring) {
+    stopAcquisition("Acquisition stopped: " + errorMessage);
+  }
 }
 }
@@ -16,7 +16,10 @@
 #ifndef tomvizAcquisitionWidget_h
 #define tomvizAcquisitionWidget_h
 
+#include <QHash>
+#include <QPointer>
 #include <QScopedPointer>
+#include <QVector>
 #include <QWidget>
 
 #include <vtkNew.h>
@@ -37,6 +40,9 @@ class AcquisitionWidget;
 namespace tomviz {
 
 class AcquisitionClient;
+class AcquisitionClientStreamRequest;
+class AcquisitionSession;
+class ImageDecoder;
 
 class AcquisitionWidget : public QWidget
 {
@@ -65,13 +71,29 @@ private slots:
   void setTiltAngle();
   void acquirePreview(const QJsonValue& result);
   void previewReady(QString, QByteArray);
+  void showImage(int id, vtkSmartPointer<vtkImageData> image);
+  void onDecodeError(int id, const QString& errorMessage);
+  void updateArchiveDirectory();
+
+  void startAcquisition();
+  void onProjectionAngle(int index, const QJsonValue& result);
+  void projectionReady(int index, const QString& mimeType,
+                       const QByteArray& result);
+  void onAcquisitionFinished();
+  void onReconstructionUpdated(int count);
+  void onStopClicked();
 
   void resetCamera();
   void onError(const QString& errorMessage, const QJsonValue& errorData);
 
 private:
+  void stopAcquisition(const QString& status);
+  void updateProgress();
+
   QScopedPointer<Ui::AcquisitionWidget> m_ui;
   QScopedPointer<AcquisitionClient> m_client;
+  QScopedPointer<ImageDecoder> m_decoder;
+  QScopedPointer<AcquisitionSession> m_session;
 
   vtkNew<vtkRenderer> m_renderer;
   vtkNew<vtkInteractorStyleRubberBand2D> m_defaultInteractorStyle;
@@ -84,6 +106,14 @@ private:
   QString m_units = "unknown";
   double m_calX = 0.0;
   double m_calY = 0.0;
+
+  // The acquisition in progress, the tilt angle of each projection is kept
+  // by the id of its image until it is decoded.
+  bool m_acquiring = false;
+  QPointer<AcquisitionClientStreamRequest> m_stream;
+  QVector<double> m_plannedAngles;
+  int m_reconstructedCount = 0;
+  QHash<int, double> m_projectionAngles;
 };
 }
 
@@ -26,8 +26,8 @@
 
 namespace tomviz {
 
-AddAlignReaction::AddAlignReaction(QAction* parentObject)
-  : pqReaction(parentObject)
+AddAlignReaction::AddAlignReaction(QAction* parentObject, bool automatic)
+  : pqReaction(parentObject), m_automatic(automatic)
 {
   connect(&ActiveObjects::instance(), SIGNAL(dataSourceChanged(DataSource*)),
           SLOT(updateEnableState()));
@@ -54,7 +54,12 @@ void AddAlignReaction::align(DataSource* source)
     return;
   }
 
-  Operator* Op = new TranslateAlignOperator(source);
+  TranslateAlignOperator* Op = new TranslateAlignOperator(source);
+  if (m_automatic) {
+    Op->setAutomatic(true);
+    source->addOperator(Op);
+    return;
+  }
   EditOperatorDialog* dialog =
     new EditOperatorDialog(Op, source, true, pqCoreUtilities::mainWidget());
 
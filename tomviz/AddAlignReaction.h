@@ -26,7 +26,9 @@ class AddAlignReaction : public pqReaction
   Q_OBJECT
 
 public:
-  AddAlignReaction(QAction* parent);
+  /// Automatic alignment adds a cross-correlation TranslateAlignOperator to
+  /// the pipeline, otherwise the manual alignment dialog is shown.
+  AddAlignReaction(QAction* parent, bool automatic = false);
   ~AddAlignReaction();
 
   void align(DataSource* source = nullptr);
@@ -37,6 +39,8 @@ protected:
 
 private:
   Q_DISABLE_COPY(AddAlignReaction)
+
+  bool m_automatic;
 };
 }
 
@@ -0,0 +1,61 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "AddLabelMapReaction.h"
+
+#include <QAction>
+#include <QMainWindow>
+
+#include "ActiveObjects.h"
+#include "DataSource.h"
+#include "EditOperatorDialog.h"
+
+namespace tomviz {
+
+AddLabelMapReaction::AddLabelMapReaction(
+  QAction* parentObject, LabelMapOperator::Function function,
+  QMainWindow* mw)
+  : pqReaction(parentObject), m_function(function), m_mainWindow(mw)
+{
+  connect(&ActiveObjects::instance(), SIGNAL(dataSourceChanged(DataSource*)),
+          SLOT(updateEnableState()));
+  updateEnableState();
+}
+
+void AddLabelMapReaction::updateEnableState()
+{
+  parentAction()->setEnabled(ActiveObjects::instance().activeDataSource() !=
+                             nullptr);
+}
+
+void AddLabelMapReaction::addOperator()
+{
+  DataSource* source = ActiveObjects::instance().activeDataSource();
+  if (!source) {
+    return;
+  }
+
+  LabelMapOperator* op = new LabelMapOperator(m_function);
+  if (!op->hasCustomUI()) {
+    source->addOperator(op);
+    return;
+  }
+  EditOperatorDialog* dialog =
+    new EditOperatorDialog(op, source, true, m_mainWindow);
+  dialog->setAttribute(Qt::WA_DeleteOnClose);
+  dialog->show();
+  connect(op, SIGNAL(destroyed()), dialog, SLOT(reject()));
+}
+}
@@ -0,0 +1,50 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizAddPointwiseReaction_h
+#define tomvizAddPointwiseReaction_h
+
+#include <pqReaction.h>
+
+#include "PointwiseOperator.h"
+
+class QMainWindow;
+
+namespace tomviz {
+
+/// Adds a PointwiseOperator with the given function to the active data
+/// source, first letting its parameters be edited if it has any.
+class AddPointwiseReaction : public pqReaction
+{
+  Q_OBJECT
+
+public:
+  AddPointwiseReaction(QAction* parent, PointwiseOperator::Function function,
+                       QMainWindow* mw);
+
+  void addOperator();
+
+protected:
+  void updateEnableState() override;
+  void onTriggered() override { addOperator(); }
+
+private:
+  Q_DISABLE_COPY(AddPointwiseReaction)
+  PointwiseOperator::Function m_function;
+  QMainWindow* m_mainWindow;
+};
+}
+
+#endif
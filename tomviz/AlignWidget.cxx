@@ -18,6 +18,8 @@
 
 #include "ActiveObjects.h"
 #include "DataSource.h"
+#include "DataStatistics.h"
+#include "ImageAlignment.h"
 #include "LoadDataReaction.h"
 #include "SpinBox.h"
 #include "TranslateAlignOperator.h"
@@ -29,10 +31,8 @@
 #include <pqCoreUtilities.h>
 #include <pqPresetDialog.h>
 #include <pqView.h>
-#include <vtkPVArrayInformation.h>
 #include <vtkSMPropertyHelper.h>
 #include <vtkSMSessionProxyManager.h>
-#include <vtkSMSourceProxy.h>
 #include <vtkSMTransferFunctionManager.h>
 #include <vtkSMTransferFunctionPresets.h>
 #include <vtkSMTransferFunctionProxy.h>
@@ -55,7 +55,6 @@
 #include <vtkRenderer.h>
 #include <vtkScalarsToColors.h>
 #include <vtkSmartPointer.h>
-#include <vtkTrivialProducer.h>
 #include <vtkVector.h>
 
 #include <QButtonGroup>
@@ -67,6 +66,7 @@
 #include <QKeyEvent>
 #include <QLabel>
 #include <QLineEdit>
+#include <QProgressDialog>
 #include <QPushButton>
 #include <QRadioButton>
 #include <QSlider>
@@ -77,6 +77,9 @@
 #include <QToolButton>
 #include <QVBoxLayout>
 
+#include <algorithm>
+#include <cmath>
+
 namespace tomviz {
 
 namespace {
@@ -88,8 +91,44 @@ void renderViews()
     view->render();
   }
 }
+
+vtkVector2i rounded(const vtkVector2f& offset)
+{
+  return vtkVector2i(static_cast<int>(std::lround(offset[0])),
+                     static_cast<int>(std::lround(offset[1])));
+}
 }
 
+class AlignWidget::AutoAlignTask : public QRunnable
+{
+public:
+  AutoAlignTask(AlignWidget* widget, vtkImageData* series,
+                std::shared_ptr<std::atomic<bool>> canceled)
+    : m_widget(widget), m_series(series), m_canceled(canceled)
+  {
+  }
+
+  void run() override
+  {
+    AlignWidget* widget = m_widget;
+    std::shared_ptr<std::atomic<bool>> canceled = m_canceled;
+    // The widget waits for the task in its destructor, so it is alive.
+    widget->m_alignedShifts = ImageAlignment::alignTiltSeries(
+      m_series, -1, [widget, canceled](int pairs) {
+        QMetaObject::invokeMethod(widget, "autoAlignProgress",
+                                  Qt::QueuedConnection, Q_ARG(int, pairs));
+        return !*canceled;
+      });
+    QMetaObject::invokeMethod(widget, "autoAlignFinished",
+                              Qt::QueuedConnection);
+  }
+
+private:
+  AlignWidget* m_widget;
+  vtkSmartPointer<vtkImageData> m_series;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+};
+
 class ViewMode
 {
 public:
@@ -149,7 +188,10 @@ public:
                                                           adjustedRange);
     }
   }
-  virtual void range(double r[2]) { m_originalData->GetScalarRange(r); }
+  virtual void range(double r[2])
+  {
+    DataStatistics::instance().range(m_originalData, r);
+  }
 
   virtual void timeout() {}
   virtual void timerStopped() {}
@@ -277,20 +319,10 @@ public:
   }
   virtual void range(double r[2]) override
   {
-    vtkSMSessionProxyManager* pxm = ActiveObjects::instance().proxyManager();
-    vtkSmartPointer<vtkSMProxy> source;
-    source.TakeReference(pxm->NewProxy("sources", "TrivialProducer"));
-    vtkTrivialProducer::SafeDownCast(source->GetClientSideObject())
-      ->SetOutput(m_originalData);
-    vtkPVArrayInformation* ainfo = tomviz::scalarArrayInformation(
-      vtkSMSourceProxy::SafeDownCast(source.Get()));
-
-    if (ainfo != nullptr) {
-      double range[2];
-      ainfo->GetComponentRange(0, range);
-      r[0] = std::min(range[0], -range[1]);
-      r[1] = std::max(range[1], -range[0]);
-    }
+    double range[2];
+    DataStatistics::instance().range(m_originalData, range);
+    r[0] = std::min(range[0], -range[1]);
+    r[1] = std::max(range[1], -range[0]);
   }
   double* bounds() const override { return m_imageSliceMapper->GetBounds(); }
   vtkSMProxy* getLUT() override { return m_lut; }
@@ -539,6 +571,19 @@ AlignWidget::AlignWidget(TranslateAlignOperator* op,
   connect(spin, SIGNAL(valueChanged(int)), SLOT(setFrameRate(int)));
   grid->addWidget(spin, gridrow, 1, 1, 1, Qt::AlignLeft);
 
+  ++gridrow;
+  label = new QLabel("Subpixel interpolation:");
+  grid->addWidget(label, gridrow, 0, 1, 1, Qt::AlignRight);
+  m_interpolationSelect = new QComboBox;
+  m_interpolationSelect->addItem("Linear");
+  m_interpolationSelect->addItem("Sinc");
+  m_interpolationSelect->setToolTip("Resampling of images whose offsets are "
+                                    "not whole pixels, as found by Auto "
+                                    "Align");
+  m_interpolationSelect->setCurrentIndex(
+    op->interpolation() == TranslateAlignOperator::Interpolation::Sinc ? 1 : 0);
+  grid->addWidget(m_interpolationSelect, gridrow, 1, 1, 1, Qt::AlignLeft);
+
   // Slice offsets
   ++gridrow;
   m_currentSliceOffset =
@@ -555,6 +600,11 @@ AlignWidget::AlignWidget(TranslateAlignOperator* op,
   m_stopButton = new QPushButton("Stop");
   connect(m_stopButton, SIGNAL(clicked()), SLOT(stopAlign()));
   buttonLayout->addWidget(m_stopButton);
+  m_autoAlignButton = new QPushButton("Auto Align");
+  m_autoAlignButton->setToolTip("Set the offsets of all images by "
+                              "cross-correlation with their neighbors");
+  connect(m_autoAlignButton, SIGNAL(clicked()), SLOT(autoAlign()));
+  buttonLayout->addWidget(m_autoAlignButton);
   buttonLayout->addStretch();
   v->addLayout(buttonLayout);
 
@@ -563,7 +613,7 @@ AlignWidget::AlignWidget(TranslateAlignOperator* op,
   v->addWidget(m_offsetTable, 2);
   m_offsets.fill(vtkVector2i(0, 0), m_maxSliceNum + 1);
 
-  const QVector<vtkVector2i>& oldOffsets = m_operator->getAlignOffsets();
+  m_exactOffsets = m_operator->getAlignOffsets();
 
   m_offsetTable->setRowCount(m_offsets.size());
   m_offsetTable->setColumnCount(4);
@@ -579,8 +629,8 @@ AlignWidget::AlignWidget(TranslateAlignOperator* op,
   item = new QTableWidgetItem();
   item->setText("Tilt angle");
   m_offsetTable->setHorizontalHeaderItem(3, item);
-  for (int i = 0; i < oldOffsets.size(); ++i) {
-    m_offsets[i] = oldOffsets[i];
+  for (int i = 0; i < m_exactOffsets.size() && i < m_offsets.size(); ++i) {
+    m_offsets[i] = rounded(m_exactOffsets[i]);
   }
 
   // show initial current and reference image
@@ -620,6 +670,10 @@ AlignWidget::AlignWidget(TranslateAlignOperator* op,
 
 AlignWidget::~AlignWidget()
 {
+  if (m_alignCanceled) {
+    *m_alignCanceled = true;
+  }
+  m_alignPool.waitForDone();
   qDeleteAll(m_modes);
   m_modes.clear();
 }
@@ -852,6 +906,70 @@ void AlignWidget::stopAlign()
   }
 }
 
+void AlignWidget::autoAlign()
+{
+  if (m_alignPool.activeThreadCount() > 0) {
+    return;
+  }
+
+  int dims[3];
+  m_inputData->GetDimensions(dims);
+  m_alignCanceled = std::make_shared<std::atomic<bool>>(false);
+  m_alignProgress = new QProgressDialog("Aligning images...", "Cancel", 0,
+                                        std::max(dims[2] - 1, 0), this);
+  m_alignProgress->setWindowModality(Qt::WindowModal);
+  m_alignProgress->setMinimumDuration(500);
+  auto canceled = m_alignCanceled;
+  connect(m_alignProgress.data(), &QProgressDialog::canceled,
+          [canceled]() { *canceled = true; });
+  m_autoAlignButton->setEnabled(false);
+
+  m_alignPool.start(new AutoAlignTask(this, m_inputData, m_alignCanceled));
+}
+
+void AlignWidget::autoAlignProgress(int pairs)
+{
+  // Progress from the threads may arrive out of order.
+  if (m_alignProgress && pairs > m_alignProgress->value()) {
+    m_alignProgress->setValue(pairs);
+  }
+}
+
+void AlignWidget::autoAlignFinished()
+{
+  // The task is returning, wait for it so its shifts are complete.
+  m_alignPool.waitForDone();
+  if (m_alignProgress) {
+    m_alignProgress->deleteLater();
+  }
+  m_autoAlignButton->setEnabled(true);
+
+  std::vector<vtkVector2d> shifts;
+  shifts.swap(m_alignedShifts);
+  if (shifts.empty()) {
+    // Canceled, the offsets are left as they were.
+    return;
+  }
+
+  m_exactOffsets.resize(static_cast<int>(shifts.size()));
+  for (int i = 0; i < m_exactOffsets.size(); ++i) {
+    m_exactOffsets[i] = vtkVector2f(static_cast<float>(shifts[i][0]),
+                                    static_cast<float>(shifts[i][1]));
+  }
+
+  m_offsetTable->blockSignals(true);
+  for (int i = 0; i < m_offsets.size() && i < m_exactOffsets.size(); ++i) {
+    m_offsets[i] = rounded(m_exactOffsets[i]);
+    m_offsetTable->item(i, 1)->setData(Qt::DisplayRole,
+                                       QString::number(m_offsets[i][0]));
+    m_offsetTable->item(i, 2)->setData(Qt::DisplayRole,
+                                       QString::number(m_offsets[i][1]));
+  }
+  m_offsetTable->blockSignals(false);
+  applySliceOffset(m_referenceSlice);
+  applySliceOffset();
+}
+
 void AlignWidget::zoomToSelectionStart()
 {
   m_widget->GetRenderWindow()->GetInteractor()->SetInteractorStyle(
@@ -870,9 +988,24 @@ void AlignWidget::zoomToSelectionFinished()
 
 void AlignWidget::applyChangesToOperator()
 {
-  if (m_operator) {
-    m_operator->setAlignOffsets(m_offsets);
+  if (!m_operator) {
+    return;
+  }
+  // Images whose offsets were not edited keep their fractional part.
+  QVector<vtkVector2f> offsets(m_offsets.size());
+  for (int i = 0; i < m_offsets.size(); ++i) {
+    if (i < m_exactOffsets.size() &&
+        rounded(m_exactOffsets[i]) == m_offsets[i]) {
+      offsets[i] = m_exactOffsets[i];
+    } else {
+      offsets[i] = vtkVector2f(m_offsets[i][0], m_offsets[i][1]);
+    }
   }
+  m_operator->setAlignOffsets(offsets);
+  m_operator->setInterpolation(
+    m_interpolationSelect->currentIndex() == 1
+      ? TranslateAlignOperator::Interpolation::Sinc
+      : TranslateAlignOperator::Interpolation::Linear);
 }
 
 void AlignWidget::resetCamera()
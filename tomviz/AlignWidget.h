@@ -23,14 +23,20 @@
 #include <vtkVector.h>
 
 #include <QPointer>
+#include <QThreadPool>
 #include <QVector>
 
+#include <atomic>
+#include <memory>
+#include <vector>
+
 class QLabel;
 class QComboBox;
 class QSpinBox;
 class QTimer;
 class QKeyEvent;
 class QButtonGroup;
+class QProgressDialog;
 class QPushButton;
 class QRadioButton;
 class QTableWidget;
@@ -81,6 +87,9 @@ protected slots:
   void startAlign();
   void stopAlign();
   void onTimeout();
+  void autoAlign();
+  void autoAlignProgress(int pairs);
+  void autoAlignFinished();
 
   void zoomToSelectionStart();
 
@@ -99,6 +108,7 @@ protected:
   QVTKGLWidget* m_widget;
 
   QComboBox* m_modeSelect;
+  QComboBox* m_interpolationSelect;
   QTimer* m_timer;
   SpinBox* m_currentSlice;
   QLabel* m_currentSliceOffset;
@@ -109,6 +119,7 @@ protected:
   QSpinBox* m_refNum;
   QPushButton* m_startButton;
   QPushButton* m_stopButton;
+  QPushButton* m_autoAlignButton;
   QTableWidget* m_offsetTable;
 
   int m_frameRate = 5;
@@ -121,9 +132,22 @@ protected:
   QVector<ViewMode*> m_modes;
   int m_currentMode = 0;
 
+  // The widget moves images by whole pixels, the operator may hold fractional
+  // offsets from automatic alignment.
   QVector<vtkVector2i> m_offsets;
+  QVector<vtkVector2f> m_exactOffsets;
   QPointer<TranslateAlignOperator> m_operator;
   DataSource* m_unalignedData;
+
+private:
+  class AutoAlignTask;
+
+  // Automatic alignment runs on a worker, the shifts are read once it is
+  // done.
+  QThreadPool m_alignPool;
+  std::shared_ptr<std::atomic<bool>> m_alignCanceled;
+  std::vector<vtkVector2d> m_alignedShifts;
+  QPointer<QProgressDialog> m_alignProgress;
 };
 }
 
@@ -0,0 +1,266 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "BrickContour.h"
+
+#include "Parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tomviz {
+
+namespace BrickContour {
+
+namespace {
+
+/// Offset of the first component of point (x, y, z) of wholeExtent.
+size_t offset(const int wholeExtent[6], int components, int x, int y, int z)
+{
+  const size_t rowSize = wholeExtent[1] - wholeExtent[0] + 1;
+  const size_t sliceSize = rowSize * (wholeExtent[3] - wholeExtent[2] + 1);
+  return ((z - wholeExtent[4]) * sliceSize + (y - wholeExtent[2]) * rowSize +
+          (x - wholeExtent[0])) *
+         components;
+}
+
+template <typename T>
+void computeRanges(const T* values, const int wholeExtent[6], int components,
+                   std::vector<Brick>& bricks)
+{
+  Parallel::forRange(
+    0, static_cast<int>(bricks.size()), 1, [&](int begin, int end) {
+      for (int b = begin; b < end; ++b) {
+        const int* extent = bricks[b].extent;
+        // NaNs fail both comparisons and are left out of the range.
+        T low = std::numeric_limits<T>::max();
+        T high = std::numeric_limits<T>::lowest();
+        for (int z = extent[4]; z <= extent[5]; ++z) {
+          for (int y = extent[2]; y <= extent[3]; ++y) {
+            const T* value =
+              values + offset(wholeExtent, components, extent[0], y, z);
+            for (int x = extent[0]; x <= extent[1]; ++x) {
+              if (*value < low) {
+                low = *value;
+              }
+              if (*value > high) {
+                high = *value;
+              }
+              value += components;
+            }
+          }
+        }
+        bricks[b].range[0] = static_cast<double>(low);
+        bricks[b].range[1] = static_cast<double>(high);
+      }
+    });
+}
+
+template <typename T>
+void copyExtent(const T* values, const int wholeExtent[6], int components,
+                const int extent[6], T* output)
+{
+  for (int z = extent[4]; z <= extent[5]; ++z) {
+    for (int y = extent[2]; y <= extent[3]; ++y) {
+      const T* value =
+        values + offset(wholeExtent, components, extent[0], y, z);
+      for (int x = extent[0]; x <= extent[1]; ++x) {
+        *output++ = *value;
+        value += components;
+      }
+    }
+  }
+}
+
+/// Gradient of the first component at point (x, y, z) of wholeExtent, from
+/// central differences, or one-sided ones on the faces of wholeExtent as
+/// flying edges computes it.
+template <typename T>
+void gradient(const T* values, const int wholeExtent[6], int components,
+              const double spacing[3], const int point[3], double g[3])
+{
+  for (int axis = 0; axis < 3; ++axis) {
+    int before[3] = { point[0], point[1], point[2] };
+    int after[3] = { point[0], point[1], point[2] };
+    before[axis] = std::max(point[axis] - 1, wholeExtent[2 * axis]);
+    after[axis] = std::min(point[axis] + 1, wholeExtent[2 * axis + 1]);
+    double difference =
+      static_cast<double>(values[offset(wholeExtent, components, after[0],
+                                        after[1], after[2])]) -
+      static_cast<double>(values[offset(wholeExtent, components, before[0],
+                                        before[1], before[2])]);
+    g[axis] = difference / ((after[axis] - before[axis]) * spacing[axis]);
+  }
+}
+
+/// Normals of the points of surface, from the gradient of the whole volume
+/// interpolated at each point, so points shared by neighboring bricks get
+/// the same normal.
+template <typename T>
+void computeNormals(const T* values, const int wholeExtent[6], int components,
+                    const double origin[3], const double spacing[3],
+                    vtkPolyData* surface)
+{
+  vtkPoints* points = surface->GetPoints();
+  if (!points) {
+    return;
+  }
+  vtkNew<vtkFloatArray> normals;
+  normals->SetName("Normals");
+  normals->SetNumberOfComponents(3);
+  normals->SetNumberOfTuples(points->GetNumberOfPoints());
+  for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i) {
+    double position[3];
+    points->GetPoint(i, position);
+    // The cell holding the point, and the point's place within it.
+    int corner[3];
+    double fraction[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      double index = (position[axis] - origin[axis]) / spacing[axis];
+      corner[axis] = std::max(
+        wholeExtent[2 * axis],
+        std::min(static_cast<int>(std::floor(index)),
+                 wholeExtent[2 * axis + 1] - 1));
+      fraction[axis] =
+        std::max(0.0, std::min(1.0, index - corner[axis]));
+    }
+
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (int c = 0; c < 8; ++c) {
+      double weight = 1.0;
+      int point[3];
+      for (int axis = 0; axis < 3; ++axis) {
+        int step = (c >> axis) & 1;
+        point[axis] = corner[axis] + step;
+        weight *= step ? fraction[axis] : 1.0 - fraction[axis];
+      }
+      // Points lie on cell edges, so most corners have no weight.
+      if (weight == 0.0) {
+        continue;
+      }
+      double g[3];
+      gradient(values, wholeExtent, components, spacing, point, g);
+      for (int axis = 0; axis < 3; ++axis) {
+        sum[axis] += weight * g[axis];
+      }
+    }
+    // Like flying edges, normals point down the gradient.
+    double normal[3] = { -sum[0], -sum[1], -sum[2] };
+    vtkMath::Normalize(normal);
+    normals->SetTuple(i, normal);
+  }
+  surface->GetPointData()->SetNormals(normals.Get());
+}
+}
+
+std::vector<Brick> bricks(vtkImageData* image, int size)
+{
+  std::vector<Brick> result;
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  if (!scalars) {
+    return result;
+  }
+
+  int wholeExtent[6];
+  image->GetExtent(wholeExtent);
+  int counts[3];
+  for (int i = 0; i < 3; ++i) {
+    int cells = wholeExtent[2 * i + 1] - wholeExtent[2 * i];
+    counts[i] = std::max(1, (cells + size - 1) / size);
+  }
+
+  result.reserve(static_cast<size_t>(counts[0]) * counts[1] * counts[2]);
+  for (int k = 0; k < counts[2]; ++k) {
+    for (int j = 0; j < counts[1]; ++j) {
+      for (int i = 0; i < counts[0]; ++i) {
+        Brick brick;
+        const int index[3] = { i, j, k };
+        for (int axis = 0; axis < 3; ++axis) {
+          // The last point of a brick is the first of the next one.
+          int first = wholeExtent[2 * axis] + index[axis] * size;
+          brick.extent[2 * axis] = first;
+          brick.extent[2 * axis + 1] =
+            std::min(first + size, wholeExtent[2 * axis + 1]);
+        }
+        result.push_back(brick);
+      }
+    }
+  }
+
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(computeRanges(
+      static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), wholeExtent,
+      scalars->GetNumberOfComponents(), result));
+  }
+  return result;
+}
+
+vtkSmartPointer<vtkPolyData> contour(vtkImageData* image,
+                                     const int extent[6], double value)
+{
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  if (!scalars || extent[0] == extent[1] || extent[2] == extent[3] ||
+      extent[4] == extent[5]) {
+    // Without cells in every direction there is nothing to contour.
+    return vtkSmartPointer<vtkPolyData>::New();
+  }
+
+  int wholeExtent[6];
+  image->GetExtent(wholeExtent);
+  vtkNew<vtkImageData> brick;
+  brick->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4],
+                   extent[5]);
+  brick->SetOrigin(image->GetOrigin());
+  brick->SetSpacing(image->GetSpacing());
+  brick->AllocateScalars(scalars->GetDataType(), 1);
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(copyExtent(
+      static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), wholeExtent,
+      scalars->GetNumberOfComponents(), extent,
+      static_cast<VTK_TT*>(brick->GetScalarPointer())));
+  }
+
+  vtkNew<vtkFlyingEdges3D> flyingEdges;
+  flyingEdges->SetInputData(brick.Get());
+  flyingEdges->SetValue(0, value);
+  // Flying edges only sees the brick, its normals on the faces of the brick
+  // would come from one-sided differences and show seams between bricks.
+  flyingEdges->ComputeNormalsOff();
+  flyingEdges->ComputeGradientsOff();
+  flyingEdges->ComputeScalarsOff();
+  flyingEdges->Update();
+
+  vtkSmartPointer<vtkPolyData> surface = flyingEdges->GetOutput();
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(computeNormals(
+      static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), wholeExtent,
+      scalars->GetNumberOfComponents(), image->GetOrigin(),
+      image->GetSpacing(), surface.Get()));
+  }
+  return surface;
+}
+}
+}
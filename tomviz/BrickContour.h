@@ -0,0 +1,59 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizBrickContour_h
+#define tomvizBrickContour_h
+
+#include <vtkSmartPointer.h>
+
+#include <vector>
+
+class vtkImageData;
+class vtkPolyData;
+
+namespace tomviz {
+
+/// Contouring of a volume a brick at a time, so the bricks can be contoured
+/// on several threads and shown as they are done. Neighboring bricks share
+/// the plane of points between them, so each cell belongs to exactly one
+/// brick and the surfaces of the bricks join without gaps or overlaps.
+namespace BrickContour {
+
+/// Edge length, in cells, of the bricks.
+const int brickSize = 32;
+
+struct Brick
+{
+  int extent[6];
+  /// Range of the first component of the scalars over the brick's points.
+  double range[2];
+};
+
+/// Splits the extent of image into bricks and computes the range of each,
+/// in parallel. Any isosurface through a brick lies within its range, so the
+/// bricks a contour needs are found without looking at the voxels again.
+std::vector<Brick> bricks(vtkImageData* image, int size = brickSize);
+
+/// Contours the extent of image at value. The cells of the extent are
+/// contoured with flying edges, after copying the first component of the
+/// scalars, so this is safe to call from several threads at once. Normals
+/// come from the gradient of the whole image, so they match across the
+/// faces the extent shares with its neighbors.
+vtkSmartPointer<vtkPolyData> contour(vtkImageData* image,
+                                     const int extent[6], double value);
+}
+}
+
+#endif
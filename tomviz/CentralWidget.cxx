@@ -16,9 +16,7 @@
 #include "CentralWidget.h"
 #include "ui_CentralWidget.h"
 
-#include <vtkFloatArray.h>
 #include <vtkImageData.h>
-#include <vtkIntArray.h>
 #include <vtkObjectFactory.h>
 #include <vtkPNGWriter.h>
 #include <vtkPiecewiseFunction.h>
@@ -36,8 +34,8 @@
 #include <QTimer>
 
 #include "AbstractDataModel.h"
-#include "ComputeHistogram.h"
 #include "DataSource.h"
+#include "DataStatistics.h"
 #include "Module.h"
 #include "ModuleManager.h"
 #include "Utilities.h"
@@ -51,123 +49,6 @@ Q_DECLARE_METATYPE(vtkSmartPointer<vtkTable>)
 
 namespace tomviz {
 
-// This is just here for now - quick and dirty historgram calculations...
-void PopulateHistogram(vtkImageData* input, vtkTable* output)
-{
-  // The output table will have the twice the number of columns, they will be
-  // the x and y for input column. This is the bin centers, and the population.
-  double minmax[2] = { 0.0, 0.0 };
-
-  // This number of bins in the 2D histogram will also be used as the number of
-  // bins in the 2D transfer function for X (scalar value) and Y (gradient mag.)
-  const int numberOfBins = 256;
-
-  // Keep the array we are working on around even if the user shallow copies
-  // over the input image data by incrementing the reference count here.
-  vtkSmartPointer<vtkDataArray> arrayPtr = input->GetPointData()->GetScalars();
-
-  // The bin values are the centers, extending +/- half an inc either side
-  switch (arrayPtr->GetDataType()) {
-    vtkTemplateMacro(tomviz::GetScalarRange(
-      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)),
-      input->GetPointData()->GetScalars()->GetNumberOfTuples(), minmax));
-    default:
-      break;
-  }
-  if (minmax[0] == minmax[1]) {
-    minmax[1] = minmax[0] + 1.0;
-  }
-
-  double inc = (minmax[1] - minmax[0]) / numberOfBins;
-  double halfInc = inc / 2.0;
-  vtkSmartPointer<vtkFloatArray> extents = vtkFloatArray::SafeDownCast(
-    output->GetColumnByName(vtkStdString("image_extents").c_str()));
-  if (!extents) {
-    extents = vtkSmartPointer<vtkFloatArray>::New();
-    extents->SetName(vtkStdString("image_extents").c_str());
-  }
-  extents->SetNumberOfTuples(numberOfBins);
-  double min = minmax[0] + halfInc;
-  for (int j = 0; j < numberOfBins; ++j) {
-    extents->SetValue(j, min + j * inc);
-  }
-  vtkSmartPointer<vtkIntArray> populations = vtkIntArray::SafeDownCast(
-    output->GetColumnByName(vtkStdString("image_pops").c_str()));
-  if (!populations) {
-    populations = vtkSmartPointer<vtkIntArray>::New();
-    populations->SetName(vtkStdString("image_pops").c_str());
-  }
-  populations->SetNumberOfTuples(numberOfBins);
-  auto pops = static_cast<int*>(populations->GetVoidPointer(0));
-  for (int k = 0; k < numberOfBins; ++k) {
-    pops[k] = 0;
-  }
-  int invalid = 0;
-
-  switch (arrayPtr->GetDataType()) {
-    vtkTemplateMacro(tomviz::CalculateHistogram(
-      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)),
-      arrayPtr->GetNumberOfTuples(), minmax[0], pops, inc, numberOfBins,
-      invalid));
-    default:
-      cout << "UpdateFromFile: Unknown data type" << endl;
-  }
-
-#ifndef NDEBUG
-  vtkIdType total = invalid;
-  for (int i = 0; i < numberOfBins; ++i)
-    total += pops[i];
-  assert(total == arrayPtr->GetNumberOfTuples());
-#endif
-  if (invalid) {
-    cout << "Warning: NaN or infinite value in dataset" << endl;
-  }
-
-  output->AddColumn(extents.Get());
-  output->AddColumn(populations.Get());
-}
-
-void Populate2DHistogram(vtkImageData* input, vtkImageData* output)
-{
-  double minmax[2] = { 0.0, 0.0 };
-  const int numberOfBins = 256;
-
-  // Keep the array we are working on around even if the user shallow copies
-  // over the input image data by incrementing the reference count here.
-  vtkSmartPointer<vtkDataArray> arrayPtr = input->GetPointData()->GetScalars();
-
-  // The bin values are the centers, extending +/- half an inc either side
-  switch (arrayPtr->GetDataType()) {
-    vtkTemplateMacro(tomviz::GetScalarRange(
-      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)),
-      input->GetPointData()->GetScalars()->GetNumberOfTuples(), minmax));
-    default:
-      break;
-  }
-  if (minmax[0] == minmax[1]) {
-    minmax[1] = minmax[0] + 1.0;
-  }
-
-  // vtkPlotHistogram2D expects the histogram array to be VTK_DOUBLE
-  output->SetDimensions(numberOfBins, numberOfBins, 1);
-  output->AllocateScalars(VTK_DOUBLE, 1);
-
-  // Get input parameters
-  int dim[3];
-  input->GetDimensions(dim);
-  int numComp = arrayPtr->GetNumberOfComponents();
-  double spacing[3];
-  input->GetSpacing(spacing);
-
-  switch (arrayPtr->GetDataType()) {
-    vtkTemplateMacro(tomviz::Calculate2DHistogram(
-      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)), dim, numComp,
-      minmax, output, spacing));
-    default:
-      cout << "UpdateFromFile: Unknown data type" << endl;
-  }
-}
-
 // This is a QObject that will be owned by the background thread
 // and use signals/slots to create histograms
 class HistogramMaker : public QObject
@@ -180,11 +61,9 @@ public:
   HistogramMaker(QObject* p = nullptr) : QObject(p) {}
 
 public slots:
-  void makeHistogram(vtkSmartPointer<vtkImageData> input,
-                     vtkSmartPointer<vtkTable> output);
+  void makeHistogram(vtkSmartPointer<vtkImageData> input);
 
-  void makeHistogram2D(vtkSmartPointer<vtkImageData> input,
-                       vtkSmartPointer<vtkImageData> output);
+  void makeHistogram2D(vtkSmartPointer<vtkImageData> input);
 
 signals:
   void histogramDone(vtkSmartPointer<vtkImageData> image,
@@ -194,22 +73,22 @@ signals:
                        vtkSmartPointer<vtkImageData> output);
 };
 
-void HistogramMaker::makeHistogram(vtkSmartPointer<vtkImageData> input,
-                                   vtkSmartPointer<vtkTable> output)
+void HistogramMaker::makeHistogram(vtkSmartPointer<vtkImageData> input)
 {
   // make the histogram and notify observers (the main thread) that it
   // is done.
-  if (input && output) {
-    PopulateHistogram(input.Get(), output.Get());
+  vtkSmartPointer<vtkTable> output;
+  if (input) {
+    output = DataStatistics::instance().histogram(input);
   }
   emit histogramDone(input, output);
 }
 
-void HistogramMaker::makeHistogram2D(vtkSmartPointer<vtkImageData> input,
-                                     vtkSmartPointer<vtkImageData> output)
+void HistogramMaker::makeHistogram2D(vtkSmartPointer<vtkImageData> input)
 {
-  if (input && output) {
-    Populate2DHistogram(input.Get(), output.Get());
+  vtkSmartPointer<vtkImageData> output;
+  if (input) {
+    output = DataStatistics::instance().histogram2D(input);
   }
   emit histogram2DDone(input, output);
 }
@@ -431,35 +310,27 @@ void CentralWidget::setColorMapDataSource(DataSource* source)
     m_ui->histogram2DWidget->setTransfer2D(source->transferFunction2D());
   }
 
-  // Check our cache, and use that if appopriate (or update it).
-  if (m_histogramCache.contains(image)) {
-    auto cachedTable = m_histogramCache[image];
-    if (cachedTable->GetMTime() > image->GetMTime()) {
-      setHistogramTable(cachedTable);
-      return;
-    } else {
-      // Need to recalculate, clear the plots, and remove the cached data.
-      m_histogramCache.remove(image);
-    }
-  }
-
-  // Calculate a histogram.
-  auto table = vtkSmartPointer<vtkTable>::New();
-  m_histogramCache[image] = table.Get();
+  // Use the histograms of this version of the data if they have already
+  // been computed, otherwise compute them in the background.
   vtkSmartPointer<vtkImageData> const imageSP = image;
+  auto& statistics = DataStatistics::instance();
+  if (auto table = statistics.histogram(image, false)) {
+    setHistogramTable(table);
+  } else {
+    // This fakes a Qt signal to the background thread (without exposing the
+    // class internals as a signal).  The background thread will then call
+    // makeHistogram on the HistogramMaker object with the parameters we
+    // gave here.
+    QMetaObject::invokeMethod(m_histogramGen, "makeHistogram",
+                              Q_ARG(vtkSmartPointer<vtkImageData>, imageSP));
+  }
 
-  // This fakes a Qt signal to the background thread (without exposing the
-  // class internals as a signal).  The background thread will then call
-  // makeHistogram on the HistogramMaker object with the parameters we
-  // gave here.
-  QMetaObject::invokeMethod(m_histogramGen, "makeHistogram",
-                            Q_ARG(vtkSmartPointer<vtkImageData>, imageSP),
-                            Q_ARG(vtkSmartPointer<vtkTable>, table));
-
-  auto histogram = vtkSmartPointer<vtkImageData>::New();
-  QMetaObject::invokeMethod(m_histogramGen, "makeHistogram2D",
-                            Q_ARG(vtkSmartPointer<vtkImageData>, imageSP),
-                            Q_ARG(vtkSmartPointer<vtkImageData>, histogram));
+  if (auto histogram = statistics.histogram2D(image, false)) {
+    histogram2DReady(imageSP, histogram);
+  } else {
+    QMetaObject::invokeMethod(m_histogramGen, "makeHistogram2D",
+                              Q_ARG(vtkSmartPointer<vtkImageData>, imageSP));
+  }
 }
 
 void CentralWidget::onColorMapUpdated()
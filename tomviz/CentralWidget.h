@@ -16,7 +16,6 @@
 #ifndef tomvizCentralWidget_h
 #define tomvizCentralWidget_h
 
-#include <QMap>
 #include <QPointer>
 #include <QScopedPointer>
 #include <QWidget>
@@ -92,7 +91,6 @@ private:
   QPointer<Module> m_activeModule;
   HistogramMaker* m_histogramGen;
   QThread* m_worker;
-  QMap<vtkImageData*, vtkSmartPointer<vtkTable>> m_histogramCache;
   Transfer2DModel* m_transfer2DModel;
 };
 }
@@ -7,7 +7,14 @@
 #include <dax/cont/ArrayHandleCounting.h>
 #include <dax/cont/DispatcherMapField.h>
 #else
+#include "Parallel.h"
 #include "vtkMath.h"
+
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <type_traits>
+#include <vector>
 #endif
 #include "vtkDoubleArray.h"
 #include "vtkImageData.h"
@@ -156,41 +163,183 @@ void CalculateHistogram(T* values, const unsigned int n, const float min,
 }
 
 #else
+namespace detail {
+
+// Values are scanned in chunks of this many, each chunk by a single thread
+// with its own bins, which are then added to the shared ones.
+const vtkIdType HistogramChunkSize = 1 << 18;
+
+// Only floating point values can be NaN or infinite, for integer types this
+// is a constant and the test compiles away.
 template <typename T>
-void GetScalarRange(T* values, const vtkIdType n, double* minmax)
+inline bool IsFiniteValue(T value)
 {
-  T tempMinMax[2];
-  tempMinMax[0] = values[0];
-  tempMinMax[1] = values[0];
-  for (vtkIdType j = 1; j < n; ++j) {
-    // This code does not handle NaN or Inf values, so check for them
-    if (!vtkMath::IsFinite(values[j]))
-      continue;
-    tempMinMax[0] = std::min(values[j], tempMinMax[0]);
-    tempMinMax[1] = std::max(values[j], tempMinMax[1]);
-  }
+  return !std::is_floating_point<T>::value ||
+         vtkMath::IsFinite(static_cast<double>(value));
+}
+
+// Calls func(first, last) for chunks of [0, n) across threads, giving each
+// thread a few large chunks so that per chunk bins stay cheap.
+template <typename Functor>
+void ForEachChunk(vtkIdType n, Functor&& func)
+{
+  int chunks =
+    static_cast<int>((n + HistogramChunkSize - 1) / HistogramChunkSize);
+  int grain = std::max(1, chunks / (Parallel::threadCount() * 4));
+  Parallel::forRange(0, chunks, grain, [&](int begin, int end) {
+    func(begin * HistogramChunkSize,
+         std::min(n, end * HistogramChunkSize));
+  });
+}
 
-  minmax[0] = static_cast<double>(tempMinMax[0]);
-  minmax[1] = static_cast<double>(tempMinMax[1]);
+template <typename T>
+inline int BinIndex(T value, float min, float inc, int maxBin)
+{
+  return std::max(0, std::min(static_cast<int>((value - min) / inc), maxBin));
+}
+
+// Values of types of up to two bytes are counted exactly, as there are at
+// most 65536 of them, so the range and histogram need a single pass.
+template <typename T>
+struct IsCountable
+  : std::integral_constant<bool, std::is_integral<T>::value &&
+                                   sizeof(T) <= 2>
+{
+};
 }
 
+/// Computes the range of the finite values, in parallel. Returns false, and
+/// leaves minmax untouched, if there are none.
+template <typename T>
+bool GetScalarRange(T* values, const vtkIdType n, double* minmax)
+{
+  std::mutex mutex;
+  T low = std::numeric_limits<T>::max();
+  T high = std::numeric_limits<T>::lowest();
+  detail::ForEachChunk(n, [&](vtkIdType first, vtkIdType last) {
+    T chunkLow = std::numeric_limits<T>::max();
+    T chunkHigh = std::numeric_limits<T>::lowest();
+    for (vtkIdType j = first; j < last; ++j) {
+      const T value = values[j];
+      if (detail::IsFiniteValue(value)) {
+        chunkLow = value < chunkLow ? value : chunkLow;
+        chunkHigh = value > chunkHigh ? value : chunkHigh;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    low = std::min(low, chunkLow);
+    high = std::max(high, chunkHigh);
+  });
+  if (low > high) {
+    return false;
+  }
+  minmax[0] = static_cast<double>(low);
+  minmax[1] = static_cast<double>(high);
+  return true;
+}
+
+/// Adds the values to the numberOfBins populations in pops, the first bin
+/// starting at min and each inc wide, in parallel. Values that are NaN or
+/// infinite are counted in invalid instead.
 template <typename T>
 void CalculateHistogram(T* values, const vtkIdType n, const float min,
                         int* pops, const float inc, const int numberOfBins,
                         int& invalid)
 {
+  std::mutex mutex;
   const int maxBin(numberOfBins - 1);
-  for (vtkIdType j = 0; j < n; ++j) {
-    // This code does not handle NaN or Inf values, so check for them and handle
-    // them specially
-    if (vtkMath::IsFinite(*values)) {
-      int index = std::min(static_cast<int>((*(values++) - min) / inc), maxBin);
-      ++pops[index];
-    } else {
-      ++values;
-      ++invalid;
+  detail::ForEachChunk(n, [&](vtkIdType first, vtkIdType last) {
+    std::vector<int> bins(numberOfBins, 0);
+    int chunkInvalid = 0;
+    for (vtkIdType j = first; j < last; ++j) {
+      const T value = values[j];
+      if (detail::IsFiniteValue(value)) {
+        ++bins[detail::BinIndex(value, min, inc, maxBin)];
+      } else {
+        ++chunkInvalid;
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < numberOfBins; ++i) {
+      pops[i] += bins[i];
+    }
+    invalid += chunkInvalid;
+  });
+}
+
+namespace detail {
+
+template <typename T>
+void CalculateRangeAndHistogram(T* values, const vtkIdType n, double* minmax,
+                                int* pops, const int numberOfBins,
+                                int& invalid, std::false_type)
+{
+  if (!GetScalarRange(values, n, minmax)) {
+    minmax[0] = minmax[1] = 0.0;
+  }
+  if (minmax[0] == minmax[1]) {
+    minmax[1] = minmax[0] + 1.0;
+  }
+  const double inc = (minmax[1] - minmax[0]) / numberOfBins;
+  CalculateHistogram(values, n, minmax[0], pops, inc, numberOfBins, invalid);
+}
+
+template <typename T>
+void CalculateRangeAndHistogram(T* values, const vtkIdType n, double* minmax,
+                                int* pops, const int numberOfBins, int&,
+                                std::true_type)
+{
+  const int lowest = static_cast<int>(std::numeric_limits<T>::lowest());
+  const int numberOfValues =
+    static_cast<int>(std::numeric_limits<T>::max()) - lowest + 1;
+  std::mutex mutex;
+  std::vector<vtkIdType> counts(numberOfValues, 0);
+  ForEachChunk(n, [&](vtkIdType first, vtkIdType last) {
+    std::vector<vtkIdType> chunkCounts(numberOfValues, 0);
+    for (vtkIdType j = first; j < last; ++j) {
+      ++chunkCounts[static_cast<int>(values[j]) - lowest];
     }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < numberOfValues; ++i) {
+      counts[i] += chunkCounts[i];
+    }
+  });
+
+  int first = 0;
+  int last = numberOfValues - 1;
+  while (first < last && counts[first] == 0) {
+    ++first;
+  }
+  while (last > first && counts[last] == 0) {
+    --last;
+  }
+  minmax[0] = first + lowest;
+  minmax[1] = last + lowest;
+  if (minmax[0] == minmax[1]) {
+    minmax[1] = minmax[0] + 1.0;
   }
+
+  // Bin the values exactly as CalculateHistogram would.
+  const float min = minmax[0];
+  const float inc = (minmax[1] - minmax[0]) / numberOfBins;
+  for (int i = first; i <= last; ++i) {
+    const T value = static_cast<T>(i + lowest);
+    pops[BinIndex(value, min, inc, numberOfBins - 1)] +=
+      static_cast<int>(counts[i]);
+  }
+}
+}
+
+/// Computes the range of the values, widened to be at least one, and adds
+/// the values to the numberOfBins populations in pops that evenly divide it.
+/// Values of one and two byte integer types are read once, others twice.
+template <typename T>
+void CalculateRangeAndHistogram(T* values, const vtkIdType n, double* minmax,
+                                int* pops, const int numberOfBins,
+                                int& invalid)
+{
+  detail::CalculateRangeAndHistogram(values, n, minmax, pops, numberOfBins,
+                                     invalid, detail::IsCountable<T>());
 }
 
 template <typename T>
@@ -201,12 +350,11 @@ void Calculate2DHistogram(T* values, const int* dim, const int numComp,
   // Assumes all inputs are valid
   // Expects histogram image to be 1C double
   vtkDataArray* arr = histogram->GetPointData()->GetScalars();
-  using ArrDouble = vtkAOSDataArrayTemplate<double>;
-  ArrDouble* histogramArr = ArrDouble::SafeDownCast(arr);
+  double* histogramValues = static_cast<double*>(arr->GetVoidPointer(0));
 
   int bins[3];
   histogram->GetDimensions(bins);
-  const size_t sizeBins = static_cast<size_t>(bins[0] * bins[1]);
+  const size_t sizeBins = static_cast<size_t>(bins[0]) * bins[1];
 
   // Adjust histogram's spacing so that the axis show the actual range in the
   // chart
@@ -214,15 +362,7 @@ void Calculate2DHistogram(T* values, const int* dim, const int numComp,
                            (range[1] * 0.25) / bins[1], 1.0 };
   histogram->SetSpacing(binSpacing);
 
-  memset(histogramArr->GetVoidPointer(0), 0x0, sizeBins * sizeof(double));
-
-  const size_t sizeSlice = static_cast<size_t>(dim[0] * dim[1] * numComp);
-  std::vector<T> sliceLast(sizeSlice, 0);
-  std::vector<T> sliceCurrent(sizeSlice, 0);
-  std::vector<T> sliceNext(sizeSlice, 0);
-
-  double gradMagMax = std::numeric_limits<double>::min();
-  double gradMagMin = std::numeric_limits<double>::max();
+  std::fill(histogramValues, histogramValues + sizeBins, 0.0);
 
   // Central differences delta (2 * h)
   const double avgSpacing = (spacing[0] + spacing[1] + spacing[2]) / 3.0;
@@ -230,63 +370,59 @@ void Calculate2DHistogram(T* values, const int* dim, const int numComp,
                             spacing[1] * 2 / avgSpacing,
                             spacing[2] * 2 / avgSpacing };
 
-  for (int kIndex = 0; kIndex < dim[2]; kIndex++) {
-    // Index assumes alignment order in  x -> y -> z.
-    // ( z0 * Dx * Dy + y0 * Dx + x0 ) * numComp
-    const size_t strideSlice =
-      static_cast<size_t>(dim[0] * dim[1] * kIndex * numComp);
-    memcpy(&(sliceNext[0]), values + strideSlice, sizeSlice * sizeof(T));
-
-    // Fill up temporary slices during the first two iterations
-    if (kIndex >= 2) {
+  // Normalize to RangeMax/4. This is what the gradient computation in the
+  // GPUMapper's fragment shader expects.
+  const double maxGradMag = range[1] * 0.25;
+
+  // Index assumes alignment order in  x -> y -> z, the first component of
+  // voxel (i, j, k) is at ((k * Dy + j) * Dx + i) * numComp.
+  const size_t strideX = static_cast<size_t>(numComp);
+  const size_t strideY = strideX * dim[0];
+  const size_t strideZ = strideY * dim[1];
+
+  // Each slab of slices is binned by one thread into its own bins.
+  std::mutex mutex;
+  const int interior = std::max(0, dim[2] - 2);
+  const int grain = std::max(1, interior / Parallel::threadCount());
+  Parallel::forRange(1, dim[2] - 1, grain, [&](int begin, int end) {
+    std::vector<int> slabBins(sizeBins, 0);
+    for (int kIndex = begin; kIndex < end; kIndex++) {
       for (int jIndex = 1; jIndex < dim[1] - 1; jIndex++) {
+        const T* row = values + kIndex * strideZ + jIndex * strideY;
         for (int iIndex = 1; iIndex < dim[0] - 1; iIndex++) {
-          const size_t centerIndex = dim[0] * jIndex + iIndex;
-          const size_t deltaXFront = centerIndex + 1;
-          const size_t deltaXBack = centerIndex - 1;
-
-          const double Dx = static_cast<double>(sliceCurrent[deltaXFront] -
-                                                sliceCurrent[deltaXBack]) /
+          const T* center = row + iIndex * strideX;
+          const T value = *center;
+          if (!detail::IsFiniteValue(value)) {
+            continue;
+          }
+          const double Dx = (static_cast<double>(center[strideX]) -
+                             static_cast<double>(*(center - strideX))) /
                             delta[0];
-
-          const size_t deltaYFront = dim[0] * (jIndex + 1) + iIndex;
-          const size_t deltaYBack = dim[0] * (jIndex - 1) + iIndex;
-          const double Dy = static_cast<double>(sliceCurrent[deltaYFront] -
-                                                sliceCurrent[deltaYBack]) /
+          const double Dy = (static_cast<double>(center[strideY]) -
+                             static_cast<double>(*(center - strideY))) /
                             delta[1];
-
-          const double Dz = static_cast<double>(sliceNext[centerIndex] -
-                                                sliceLast[centerIndex]) /
+          const double Dz = (static_cast<double>(center[strideZ]) -
+                             static_cast<double>(*(center - strideZ))) /
                             delta[2];
 
-          double gradMag = sqrt(Dx * Dx + Dy * Dy + Dz * Dz);
-          gradMagMax = vtkMath::Max(gradMag, gradMagMax);
-          gradMagMin = vtkMath::Min(gradMag, gradMagMin);
-
-          // Normalize to RangeMax/4. This is what the gradient computation in
-          // the
-          // GPUMapper's fragment shader expects.
-          const double maxGradMag = range[1] * 0.25;
-          gradMag = floor(gradMag + 0.5);
+          double gradMag = std::sqrt(Dx * Dx + Dy * Dy + Dz * Dz);
+          gradMag = std::floor(gradMag + 0.5);
           gradMag = vtkMath::ClampValue(gradMag, 0.0, maxGradMag);
           const vtkIdType gradIndex =
             static_cast<vtkIdType>(gradMag * (bins[1] - 1) / maxGradMag);
 
-          const T value = values[strideSlice + centerIndex * numComp];
           const vtkIdType valueIndex = static_cast<vtkIdType>(
             (value - range[0]) * (bins[1] - 1) / (range[1] - range[0]));
 
-          // Update histogram array
-          const vtkIdType tupleIndex = gradIndex * bins[0] + valueIndex;
-          double histogramValue = histogramArr->GetValue(tupleIndex);
-          histogramArr->SetValue(tupleIndex, ++histogramValue);
+          ++slabBins[gradIndex * bins[0] + valueIndex];
         }
       }
     }
-
-    std::swap(sliceLast, sliceCurrent);
-    std::swap(sliceCurrent, sliceNext);
-  }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < sizeBins; ++i) {
+      histogramValues[i] += slabBins[i];
+    }
+  });
 }
 
 #endif
@@ -16,19 +16,22 @@
 
 #include "ConvertToFloatOperator.h"
 
-#include <vtkFloatArray.h>
+#include "VolumeBufferPool.h"
+
+#include <vtkDataArray.h>
 #include <vtkImageData.h>
-#include <vtkNew.h>
 #include <vtkPointData.h>
+#include <vtkSmartPointer.h>
 
 namespace {
 
 template <typename T>
-void convertToFloat(vtkFloatArray* fArray, int nComps, int nTuples, void* data)
+void convertToFloat(vtkDataArray* fArray, int nComps, vtkIdType nTuples,
+                    void* data)
 {
   T* d = static_cast<T*>(data);
   float* a = static_cast<float*>(fArray->GetVoidPointer(0));
-  for (int i = 0; i < nComps * nTuples; ++i) {
+  for (vtkIdType i = 0; i < nComps * nTuples; ++i) {
     a[i] = (float)d[i];
   }
 }
@@ -53,9 +56,10 @@ bool ConvertToFloatOperator::applyTransform(vtkDataObject* data)
     return false;
   }
   vtkDataArray* scalars = imageData->GetPointData()->GetScalars();
-  vtkNew<vtkFloatArray> floatArray;
-  floatArray->SetNumberOfComponents(scalars->GetNumberOfComponents());
-  floatArray->SetNumberOfTuples(scalars->GetNumberOfTuples());
+  vtkSmartPointer<vtkDataArray> floatArray;
+  floatArray.TakeReference(VolumeBufferPool::newArray(
+    VTK_FLOAT, scalars->GetNumberOfComponents(),
+    scalars->GetNumberOfTuples()));
   floatArray->SetName(scalars->GetName());
   switch (scalars->GetDataType()) {
     vtkTemplateMacro(convertToFloat<VTK_TT>(
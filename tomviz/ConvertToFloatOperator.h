@@ -30,6 +30,7 @@ public:
   QString label() const override { return "Convert to Float"; }
   QIcon icon() const override;
   Operator* clone() const override;
+  bool writesArraysInPlace() const override { return false; }
   bool serialize(pugi::xml_node& ns) const override;
   bool deserialize(const pugi::xml_node& ns) override;
   bool hasCustomUI() const override { return false; }
@@ -0,0 +1,106 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "CopyOnWrite.h"
+
+#include "VolumeBufferPool.h"
+
+#include <vtkAbstractArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkDataSet.h>
+#include <vtkDataSetAttributes.h>
+#include <vtkFieldData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include <vector>
+
+namespace tomviz {
+
+namespace CopyOnWrite {
+
+namespace {
+
+qint64 detachArrays(vtkDataSetAttributes* attributes)
+{
+  qint64 bytes = 0;
+  int numberOfArrays = attributes->GetNumberOfArrays();
+  std::vector<vtkSmartPointer<vtkAbstractArray>> arrays(numberOfArrays);
+  bool shared = false;
+  for (int i = 0; i < numberOfArrays; ++i) {
+    arrays[i] = attributes->GetAbstractArray(i);
+    // One reference is held by the attributes, one by arrays[i].
+    if (arrays[i] && arrays[i]->GetReferenceCount() > 2) {
+      vtkSmartPointer<vtkAbstractArray> copy;
+      if (auto dataArray = vtkDataArray::SafeDownCast(arrays[i])) {
+        copy.TakeReference(VolumeBufferPool::newCopy(dataArray));
+      } else {
+        copy.TakeReference(arrays[i]->NewInstance());
+        copy->DeepCopy(arrays[i]);
+      }
+      bytes += static_cast<qint64>(copy->GetActualMemorySize()) * 1024;
+      arrays[i] = copy;
+      shared = true;
+    }
+  }
+  if (!shared) {
+    return 0;
+  }
+
+  // Rebuild the attributes in the same order, so the indices of the active
+  // scalars, vectors and so on still refer to the same arrays.
+  int attributeIndices[vtkDataSetAttributes::NUM_ATTRIBUTES];
+  attributes->GetAttributeIndices(attributeIndices);
+  attributes->Initialize();
+  for (auto& array : arrays) {
+    attributes->AddArray(array);
+  }
+  for (int i = 0; i < vtkDataSetAttributes::NUM_ATTRIBUTES; ++i) {
+    if (attributeIndices[i] >= 0) {
+      attributes->SetActiveAttribute(attributeIndices[i], i);
+    }
+  }
+  return bytes;
+}
+}
+
+void share(vtkDataObject* target, vtkDataObject* source)
+{
+  target->ShallowCopy(source);
+  vtkNew<vtkFieldData> fieldData;
+  fieldData->DeepCopy(source->GetFieldData());
+  target->SetFieldData(fieldData.Get());
+}
+
+vtkDataObject* sharedCopy(vtkDataObject* data)
+{
+  vtkDataObject* copy = data->NewInstance();
+  share(copy, data);
+  return copy;
+}
+
+qint64 detach(vtkDataObject* data)
+{
+  vtkDataSet* dataSet = vtkDataSet::SafeDownCast(data);
+  if (!dataSet) {
+    return 0;
+  }
+  return detachArrays(dataSet->GetPointData()) +
+         detachArrays(dataSet->GetCellData());
+}
+}
+}
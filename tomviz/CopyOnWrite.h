@@ -0,0 +1,45 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizCopyOnWrite_h
+#define tomvizCopyOnWrite_h
+
+#include <QtGlobal>
+
+class vtkDataObject;
+
+namespace tomviz {
+
+/// Copy-on-write sharing of data between the data source, the pipeline and
+/// the pipeline cache. A shared copy references the same point and cell
+/// arrays as its source, so handing data to the pipeline costs nothing until
+/// an operator that writes into the arrays runs. Field data, which is small
+/// and routinely edited, is always copied.
+namespace CopyOnWrite {
+
+/// Makes target a shared copy of source.
+void share(vtkDataObject* target, vtkDataObject* source);
+
+/// Returns a new shared copy of data, the caller takes ownership.
+vtkDataObject* sharedCopy(vtkDataObject* data);
+
+/// Replaces each point and cell array of data that is also referenced
+/// elsewhere with a private copy, so it can be modified in place. The copies
+/// are drawn from the VolumeBufferPool. Returns the number of bytes copied.
+qint64 detach(vtkDataObject* data);
+}
+}
+
+#endif
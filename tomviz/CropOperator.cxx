@@ -17,19 +17,66 @@
 #include "CropOperator.h"
 
 #include "EditOperatorWidget.h"
+#include "Parallel.h"
 #include "SelectVolumeWidget.h"
+#include "VolumeBufferPool.h"
+#include "vtkCellData.h"
+#include "vtkDataArray.h"
 #include "vtkDataObject.h"
 #include "vtkExtractVOI.h"
 #include "vtkImageData.h"
 #include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSmartPointer.h"
 
+#include <QDebug>
 #include <QHBoxLayout>
 #include <QPointer>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <vector>
 
 namespace {
 
+// Copies the rows of array within bounds, a sub-extent of extent, into a new
+// array drawn from the buffer pool.
+vtkDataArray* cropArray(vtkDataArray* array, const int extent[6],
+                        const int bounds[6])
+{
+  vtkIdType dims[3], cropped[3];
+  for (int i = 0; i < 3; ++i) {
+    dims[i] = extent[2 * i + 1] - extent[2 * i] + 1;
+    cropped[i] = bounds[2 * i + 1] - bounds[2 * i] + 1;
+  }
+  vtkDataArray* copy = tomviz::VolumeBufferPool::newArray(
+    array->GetDataType(), array->GetNumberOfComponents(),
+    cropped[0] * cropped[1] * cropped[2]);
+  copy->SetName(array->GetName());
+  copy->CopyComponentNames(array);
+
+  vtkIdType tupleSize =
+    array->GetNumberOfComponents() * array->GetDataTypeSize();
+  size_t rowSize = static_cast<size_t>(cropped[0] * tupleSize);
+  auto from = static_cast<const char*>(array->GetVoidPointer(0));
+  auto to = static_cast<char*>(copy->GetVoidPointer(0));
+  tomviz::Parallel::forRange(
+    0, static_cast<int>(cropped[2]), 1, [&](int begin, int end) {
+      for (vtkIdType z = begin; z < end; ++z) {
+        vtkIdType sourceZ = z + bounds[4] - extent[4];
+        for (vtkIdType y = 0; y < cropped[1]; ++y) {
+          vtkIdType sourceY = y + bounds[2] - extent[2];
+          vtkIdType source =
+            (sourceZ * dims[1] + sourceY) * dims[0] + bounds[0] - extent[0];
+          vtkIdType target = (z * cropped[1] + y) * cropped[0];
+          memcpy(to + target * tupleSize, from + source * tupleSize, rowSize);
+        }
+      }
+    });
+  return copy;
+}
+
 class CropWidget : public tomviz::EditOperatorWidget
 {
   Q_OBJECT
@@ -94,6 +141,55 @@ QIcon CropOperator::icon() const
 }
 
 bool CropOperator::applyTransform(vtkDataObject* data)
+{
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  if (!image) {
+    return false;
+  }
+  vtkPointData* pointData = image->GetPointData();
+  bool rowsCopyable = image->GetCellData()->GetNumberOfArrays() == 0;
+  for (int i = 0; i < pointData->GetNumberOfArrays(); ++i) {
+    vtkDataArray* array = pointData->GetArray(i);
+    rowsCopyable = rowsCopyable && array && array->HasStandardMemoryLayout();
+  }
+  if (!rowsCopyable) {
+    return extractVOI(data);
+  }
+
+  int extent[6], bounds[6];
+  image->GetExtent(extent);
+  for (int i = 0; i < 3; ++i) {
+    bounds[2 * i] = std::max(m_bounds[2 * i], extent[2 * i]);
+    bounds[2 * i + 1] = std::min(m_bounds[2 * i + 1], extent[2 * i + 1]);
+    if (bounds[2 * i] > bounds[2 * i + 1]) {
+      qCritical() << "The crop bounds do not overlap the data";
+      return false;
+    }
+  }
+
+  // The cropped arrays replace the originals in the same order, so the
+  // active scalars and so on stay the same.
+  int numberOfArrays = pointData->GetNumberOfArrays();
+  std::vector<vtkSmartPointer<vtkDataArray>> arrays(numberOfArrays);
+  for (int i = 0; i < numberOfArrays; ++i) {
+    arrays[i].TakeReference(cropArray(pointData->GetArray(i), extent, bounds));
+  }
+  int attributeIndices[vtkDataSetAttributes::NUM_ATTRIBUTES];
+  pointData->GetAttributeIndices(attributeIndices);
+  pointData->Initialize();
+  for (auto& array : arrays) {
+    pointData->AddArray(array);
+  }
+  for (int i = 0; i < vtkDataSetAttributes::NUM_ATTRIBUTES; ++i) {
+    if (attributeIndices[i] >= 0) {
+      pointData->SetActiveAttribute(attributeIndices[i], i);
+    }
+  }
+  image->SetExtent(bounds);
+  return true;
+}
+
+bool CropOperator::extractVOI(vtkDataObject* data)
 {
   vtkNew<vtkExtractVOI> extractor;
   extractor->SetVOI(m_bounds);
@@ -33,6 +33,8 @@ public:
 
   Operator* clone() const override;
 
+  bool writesArraysInPlace() const override { return false; }
+
   bool serialize(pugi::xml_node& ns) const override;
   bool deserialize(const pugi::xml_node& ns) override;
 
@@ -47,6 +49,9 @@ protected:
   bool applyTransform(vtkDataObject* data) override;
 
 private:
+  /// Crops with vtkExtractVOI, for data whose rows cannot just be copied.
+  bool extractVOI(vtkDataObject* data);
+
   int m_bounds[6];
   Q_DISABLE_COPY(CropOperator)
 };
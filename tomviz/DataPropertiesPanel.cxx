@@ -146,6 +146,15 @@ QString getDataTypeString(vtkSMSourceProxy* proxy)
     return QString("Type: ?");
   }
 }
+
+QString getBytesCopiedString(qint64 bytes)
+{
+  if (bytes == 0) {
+    return QString("Copied by operators: none");
+  }
+  return QString("Copied by operators: %1 MiB")
+    .arg(bytes / 1048576.0, 0, 'f', 1);
+}
 }
 
 void DataPropertiesPanel::updateData()
@@ -172,6 +181,7 @@ void DataPropertiesPanel::updateData()
   m_ui->TransformedDataRange->setText(
     getDataExtentAndRangeString(dsource->producer()));
   m_ui->TransformedDataType->setText(getDataTypeString(dsource->producer()));
+  m_ui->BytesCopied->setText(getBytesCopiedString(dsource->bytesCopied()));
 
   int extent[6];
   double spacing[3];
@@ -351,6 +361,7 @@ void DataPropertiesPanel::clear()
   m_ui->OriginalDataType->setText("Type:");
   m_ui->TransformedDataRange->setText("");
   m_ui->TransformedDataType->setText("Type:");
+  m_ui->BytesCopied->setText("");
   if (m_colorMapWidget) {
     m_ui->verticalLayout->removeWidget(m_colorMapWidget);
     delete m_colorMapWidget;
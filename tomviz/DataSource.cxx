@@ -15,10 +15,14 @@
 ******************************************************************************/
 #include "DataSource.h"
 
+#include "CopyOnWrite.h"
 #include "ModuleManager.h"
 #include "Operator.h"
 #include "OperatorFactory.h"
+#include "PipelineCache.h"
 #include "PipelineWorker.h"
+#include "ResolutionPyramid.h"
+#include "SpanSpaceIndex.h"
 #include "Utilities.h"
 
 #include <vtkDataObject.h>
@@ -27,6 +31,7 @@
 #include <vtkImageData.h>
 #include <vtkNew.h>
 #include <vtkPiecewiseFunction.h>
+#include <vtkPointData.h>
 #include <vtkSmartPointer.h>
 #include <vtkStringArray.h>
 #include <vtkTrivialProducer.h>
@@ -45,9 +50,15 @@
 
 #include <QDebug>
 #include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
 #include <QTimer>
 
+#include <algorithm>
 #include <sstream>
+#include <utility>
 
 namespace tomviz {
 
@@ -64,9 +75,17 @@ public:
   vtkSmartPointer<vtkDataArray> TiltAngles;
   vtkSmartPointer<vtkStringArray> Units;
   vtkVector3d DisplayPosition;
-  QMap<Operator*, vtkWeakPointer<vtkImageData>> CachedPreOpStates;
   PipelineWorker* Worker;
   PipelineWorker::Future* Future;
+  ResolutionPyramid* Pyramid = nullptr;
+  qint64 BytesCopied = 0;
+  SpanSpaceIndex SpanSpace;
+  int SpanSpaceGeneration = 0;
+  QThreadPool SpanSpacePool;
+  QMutex SpanSpaceMutex;
+  // The last index built in the background, and the data it was built for.
+  SpanSpaceIndex BuiltSpanSpace;
+  int BuiltSpanSpaceGeneration = -1;
   bool PipelinePaused = false;
   bool GradientOpacityVisibility = false;
   PersistenceState PersistState = PersistenceState::Saved;
@@ -95,6 +114,73 @@ public:
       }
     }
   }
+
+  // Returns a checkpoint that stores the output of each operator in the
+  // PipelineCache as the pipeline runs.
+  PipelineWorker::Checkpoint checkpoint()
+  {
+    if (PipelineCache::instance().memoryBudget() <= 0) {
+      return PipelineWorker::Checkpoint();
+    }
+    QMap<Operator*, quint64> keys;
+    QList<quint64> chain = PipelineCache::keys(this->Operators);
+    for (int i = 0; i < chain.size(); ++i) {
+      keys[this->Operators[i]] = chain[i];
+    }
+    return [keys](Operator* op, vtkDataObject* data) {
+      auto key = keys.find(op);
+      if (key != keys.end()) {
+        PipelineCache::instance().insert(op, *key, data);
+      }
+    };
+  }
+
+  // Finds the latest cached output of the operators before index. Returns
+  // the index of the first operator that has to run on it, or zero if the
+  // pipeline has to run from the original data.
+  int resumeIndex(int index, vtkSmartPointer<vtkDataObject>& input)
+  {
+    QList<quint64> keys = PipelineCache::keys(this->Operators.mid(0, index));
+    for (int i = index; i > 0; --i) {
+      input =
+        PipelineCache::instance().find(this->Operators[i - 1], keys[i - 1]);
+      if (input) {
+        return i;
+      }
+    }
+    return 0;
+  }
+};
+
+class DataSource::SpanSpaceBuilder : public QRunnable
+{
+public:
+  SpanSpaceBuilder(DataSource* source, vtkImageData* image, int generation)
+    : m_source(source), m_generation(generation)
+  {
+    m_image.TakeReference(
+      vtkImageData::SafeDownCast(CopyOnWrite::sharedCopy(image)));
+  }
+
+  void run() override
+  {
+    SpanSpaceIndex index;
+    index.build(m_image);
+    {
+      DSInternals* internals = m_source->Internals.data();
+      QMutexLocker locker(&internals->SpanSpaceMutex);
+      std::swap(internals->BuiltSpanSpace, index);
+      internals->BuiltSpanSpaceGeneration = m_generation;
+    }
+    // The data source waits for builders in its destructor, so it is alive.
+    QMetaObject::invokeMethod(m_source, "spanSpaceBuilt",
+                              Qt::QueuedConnection);
+  }
+
+private:
+  DataSource* m_source;
+  vtkSmartPointer<vtkImageData> m_image;
+  int m_generation;
 };
 
 namespace {
@@ -228,6 +314,13 @@ DataSource::DataSource(vtkSMSourceProxy* dataSource, DataSourceType dataType,
   connect(this, &DataSource::dataPropertiesChanged,
           [this]() { this->producer()->MarkModified(nullptr); });
 
+  this->Internals->Pyramid = new ResolutionPyramid(this);
+
+  // The span space index is rebuilt in the background, one at a time since
+  // the ranges of the bricks are computed across threads.
+  this->Internals->SpanSpacePool.setMaxThreadCount(1);
+  connect(this, &DataSource::dataChanged, this, &DataSource::buildSpanSpace);
+
   resetData();
 
   this->Internals->Worker = new PipelineWorker(this);
@@ -235,6 +328,8 @@ DataSource::DataSource(vtkSMSourceProxy* dataSource, DataSourceType dataType,
 
 DataSource::~DataSource()
 {
+  this->Internals->SpanSpacePool.waitForDone();
+  PipelineCache::instance().remove(this->Internals->Operators);
   if (this->Internals->Producer) {
     vtkNew<vtkSMParaViewPipelineController> controller;
     controller->UnRegisterProxy(this->Internals->Producer);
@@ -550,7 +645,12 @@ int DataSource::addOperator(Operator* op)
 bool DataSource::removeOperator(Operator* op)
 {
   if (op) {
-    // TODO Should remove any cache entries?
+    // The snapshots from this operator on no longer match the pipeline.
+    int index = this->Internals->Operators.indexOf(op);
+    if (index >= 0) {
+      PipelineCache::instance().remove(
+        this->Internals->Operators.mid(index));
+    }
 
     // We should emit that the operator was removed...
     this->Internals->Operators.removeAll(op);
@@ -561,11 +661,11 @@ bool DataSource::removeOperator(Operator* op)
       // If we can't safely cancel the execution then trigger the rerun of the
       // pipeline.
       if (!this->Internals->Future->cancel(op)) {
-        operatorTransformModified();
+        executeOperatorsFrom(std::max(index, 0));
       }
     } else {
       // Trigger the pipeline to run
-      this->operatorTransformModified();
+      executeOperatorsFrom(std::max(index, 0));
     }
 
     op->deleteLater();
@@ -586,6 +686,7 @@ bool DataSource::removeAllOperators()
 
   while (this->Internals->Operators.size() > 0) {
     Operator* lastOperator = this->Internals->Operators.takeLast();
+    PipelineCache::instance().remove(lastOperator);
 
     if (lastOperator->hasChildDataSource()) {
       DataSource* childDataSource = lastOperator->childDataSource();
@@ -637,7 +738,8 @@ void DataSource::operate(Operator* op)
   else {
     emit operatorStarted();
     vtkDataObject* copy = copyData();
-    this->Internals->Future = this->Internals->Worker->run(copy, op);
+    this->Internals->Future =
+      this->Internals->Worker->run(copy, op, this->Internals->checkpoint());
     connect(this->Internals->Future, SIGNAL(finished(bool)), this,
             SLOT(pipelineFinished(bool)));
     connect(this->Internals->Future, SIGNAL(canceled()), this,
@@ -651,19 +753,29 @@ DataSource::ImageFuture* DataSource::getCopyOfImagePriorTo(Operator* op)
   ImageFuture* imageFuture;
   if (this->Internals->Operators.contains(op)) {
     if (this->Internals->Operators.size() > 1) {
-      vtkAlgorithm* alg = vtkAlgorithm::SafeDownCast(
-        this->Internals->OriginalDataSource->GetClientSideObject());
-      result->DeepCopy(alg->GetOutputDataObject(0));
-
       auto index = this->Internals->Operators.indexOf(op);
-      // Only run operators if we have some to run
-      if (index > 0) {
+      // Start from the latest cached state before the operator, and only run
+      // operators if we have some to run
+      vtkSmartPointer<vtkDataObject> input;
+      int first = this->Internals->resumeIndex(index, input);
+      if (input) {
+        CopyOnWrite::share(result, input);
+      } else {
+        vtkAlgorithm* alg = vtkAlgorithm::SafeDownCast(
+          this->Internals->OriginalDataSource->GetClientSideObject());
+        CopyOnWrite::share(result, alg->GetOutputDataObject(0));
+      }
+      if (first < index) {
         auto future = this->Internals->Worker->run(
-          result, this->Internals->Operators.mid(0, index));
+          result, this->Internals->Operators.mid(first, index - first),
+          this->Internals->checkpoint());
 
         imageFuture = new ImageFuture(op, result, future);
-        connect(imageFuture, SIGNAL(finished(bool)), this, SLOT(updateCache()));
-
+        return imageFuture;
+      } else if (index > 0) {
+        imageFuture = new ImageFuture(op, result);
+        // Delay emitting signal until next event loop
+        QTimer::singleShot(0, [=] { emit imageFuture->finished(true); });
         return imageFuture;
       }
     } else { // this->Internals->Operators.size() == 1
@@ -676,7 +788,7 @@ DataSource::ImageFuture* DataSource::getCopyOfImagePriorTo(Operator* op)
 
   vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
     this->Internals->Producer->GetClientSideObject());
-  result->DeepCopy(tp->GetOutputDataObject(0));
+  CopyOnWrite::share(result, tp->GetOutputDataObject(0));
   imageFuture = new ImageFuture(op, result);
   // Delay emitting signal until next event loop
   QTimer::singleShot(0, [=] { emit imageFuture->finished(true); });
@@ -684,13 +796,6 @@ DataSource::ImageFuture* DataSource::getCopyOfImagePriorTo(Operator* op)
   return imageFuture;
 }
 
-void DataSource::updateCache()
-{
-  DataSource::ImageFuture* future =
-    qobject_cast<DataSource::ImageFuture*>(sender());
-  this->Internals->CachedPreOpStates[future->op()] = future->result();
-}
-
 void DataSource::dataModified()
 {
   vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
@@ -730,6 +835,9 @@ void DataSource::dataModified()
   filter->UpdatePipeline();
   filter->Delete();
 
+  // Rebuild the coarse levels used to render while interacting.
+  this->Internals->Pyramid->build(vtkImageData::SafeDownCast(dObject));
+
   emit dataChanged();
 }
 
@@ -769,11 +877,7 @@ vtkDataObject* DataSource::copyData()
   vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
     this->Internals->Producer->GetClientSideObject());
   Q_ASSERT(tp);
-  vtkDataObject* data = tp->GetOutputDataObject(0);
-  vtkDataObject* copy = data->NewInstance();
-  copy->DeepCopy(data);
-
-  return copy;
+  return CopyOnWrite::sharedCopy(tp->GetOutputDataObject(0));
 }
 
 vtkDataObject* DataSource::copyOriginalData()
@@ -792,8 +896,7 @@ vtkDataObject* DataSource::copyOriginalData()
 
   // Create a clone and release the reader data.
   vtkDataObject* data = vtkalgorithm->GetOutputDataObject(0);
-  vtkDataObject* dataClone = data->NewInstance();
-  dataClone->DeepCopy(data);
+  vtkDataObject* dataClone = CopyOnWrite::sharedCopy(data);
   // data->ReleaseData();  FIXME: how it this supposed to work? I get errors on
   // attempting to re-execute the reader pipeline in clone().
 
@@ -807,6 +910,7 @@ void DataSource::resetData()
   this->Internals->GradientOpacityMap->RemoveAllPoints();
   this->Internals->m_transfer2D->SetDimensions(1, 1, 1);
   this->Internals->m_transfer2D->AllocateScalars(VTK_FLOAT, 4);
+  this->Internals->Pyramid->build(vtkImageData::SafeDownCast(data));
   emit dataChanged();
 }
 
@@ -851,37 +955,47 @@ void DataSource::operatorTransformModified()
     return;
   }
 
+  // Only the modified operator and those after it need to run again.
   Operator* srcOp = qobject_cast<Operator*>(sender());
+  int index = std::max(this->Internals->Operators.indexOf(srcOp), 0);
+  PipelineCache::instance().remove(this->Internals->Operators.mid(index));
+  executeOperatorsFrom(index);
+}
 
-  vtkSmartPointer<vtkImageData> cachedState;
-  if (srcOp && this->Internals->CachedPreOpStates.contains(srcOp)) {
-    cachedState = this->Internals->CachedPreOpStates[srcOp];
+void DataSource::executeOperatorsFrom(int index)
+{
+  if (this->Internals->PipelinePaused) {
+    return;
   }
+
+  vtkSmartPointer<vtkDataObject> input;
+  int first = this->Internals->resumeIndex(index, input);
+  if (first == 0) {
+    executeOperators();
+    return;
+  }
+
   // Cancel any running operators
   if (this->Internals->Future != nullptr &&
       this->Internals->Future->isRunning()) {
     this->Internals->Future->cancel();
   }
 
-  // Disable caching for now, issue #1133.
-  if (false && cachedState) {
-    vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
-      this->Internals->Producer->GetClientSideObject());
-    // TODO Should we not copy this?
-    tp->SetOutput(cachedState);
-
-    // Use cached result and run the pipeline from the operator which we have
-    // the data before it was applied.
-    this->Internals->Future = this->Internals->Worker->run(
-      cachedState, this->Internals->Operators.mid(
-                     this->Internals->Operators.indexOf(srcOp)));
-    connect(this->Internals->Future, SIGNAL(finished(bool)), this,
-            SLOT(pipelineFinished(bool)));
-    connect(this->Internals->Future, SIGNAL(canceled()), this,
-            SLOT(pipelineCanceled()));
-  } else {
-    executeOperators();
+  // The cached state belongs to the cache, so run on a copy of it.
+  vtkDataObject* data = CopyOnWrite::sharedCopy(input);
+  if (first == this->Internals->Operators.size()) {
+    setData(data);
+    dataModified();
+    return;
   }
+
+  this->Internals->Future = this->Internals->Worker->run(
+    data, this->Internals->Operators.mid(first),
+    this->Internals->checkpoint());
+  connect(this->Internals->Future, SIGNAL(finished(bool)), this,
+          SLOT(pipelineFinished(bool)));
+  connect(this->Internals->Future, SIGNAL(canceled()), this,
+          SLOT(pipelineCanceled()));
 }
 
 void DataSource::pipelineFinished(bool result)
@@ -889,6 +1003,7 @@ void DataSource::pipelineFinished(bool result)
   PipelineWorker::Future* future =
     qobject_cast<PipelineWorker::Future*>(sender());
   if (result) {
+    this->Internals->BytesCopied = future->bytesCopied();
     setData(future->result());
   } else {
     future->result()->Delete();
@@ -918,6 +1033,56 @@ vtkSMProxy* DataSource::colorMap() const
   return this->Internals->ColorMap;
 }
 
+ResolutionPyramid* DataSource::pyramid() const
+{
+  return this->Internals->Pyramid;
+}
+
+qint64 DataSource::bytesCopied() const
+{
+  return this->Internals->BytesCopied;
+}
+
+const SpanSpaceIndex& DataSource::spanSpace() const
+{
+  return this->Internals->SpanSpace;
+}
+
+void DataSource::buildSpanSpace()
+{
+  // The bricks of the data before have nothing to do with the new data.
+  ++this->Internals->SpanSpaceGeneration;
+  this->Internals->SpanSpace.clear();
+
+  vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
+    this->Internals->Producer->GetClientSideObject());
+  Q_ASSERT(tp);
+  auto image = vtkImageData::SafeDownCast(tp->GetOutputDataObject(0));
+  if (!image || !image->GetPointData()->GetScalars()) {
+    emit spanSpaceChanged();
+    return;
+  }
+  this->Internals->SpanSpacePool.start(
+    new SpanSpaceBuilder(this, image, this->Internals->SpanSpaceGeneration));
+}
+
+void DataSource::spanSpaceBuilt()
+{
+  SpanSpaceIndex index;
+  {
+    QMutexLocker locker(&this->Internals->SpanSpaceMutex);
+    // Indices of data replaced since they were started are dropped.
+    if (this->Internals->BuiltSpanSpaceGeneration !=
+        this->Internals->SpanSpaceGeneration) {
+      return;
+    }
+    std::swap(this->Internals->BuiltSpanSpace, index);
+    this->Internals->BuiltSpanSpaceGeneration = -1;
+  }
+  std::swap(this->Internals->SpanSpace, index);
+  emit spanSpaceChanged();
+}
+
 DataSource::DataSourceType DataSource::type() const
 {
   return this->Internals->Type;
@@ -1049,8 +1214,8 @@ void DataSource::executeOperators()
     setData(data);
     dataModified();
   } else {
-    this->Internals->Future =
-      this->Internals->Worker->run(data, this->Internals->Operators);
+    this->Internals->Future = this->Internals->Worker->run(
+      data, this->Internals->Operators, this->Internals->checkpoint());
     connect(this->Internals->Future, SIGNAL(finished(bool)), this,
             SLOT(pipelineFinished(bool)));
     connect(this->Internals->Future, SIGNAL(canceled()), this,
@@ -35,6 +35,8 @@ class vtkPiecewiseFunction;
 
 namespace tomviz {
 class Operator;
+class ResolutionPyramid;
+class SpanSpaceIndex;
 
 /// Encapsulation for a DataSource. This class manages a data source, including
 /// the provenance for any operations performed on the data source.
@@ -109,6 +111,19 @@ public:
   bool isGradientOpacityVisible() const;
   vtkImageData* transferFunction2D() const;
 
+  /// Returns the downsampled levels of the data, kept up to date in the
+  /// background as the data changes.
+  ResolutionPyramid* pyramid() const;
+
+  /// Returns the bytes of array data the last finished pipeline run copied,
+  /// which is zero when every operator left its input arrays alone.
+  qint64 bytesCopied() const;
+
+  /// Returns the range of each brick of the data, to find the bricks a value
+  /// or range touches. The index is built in the background as the data
+  /// changes, and is empty until spanSpaceChanged() is emitted.
+  const SpanSpaceIndex& spanSpace() const;
+
   /// Indicates whether the DataSource has a label map of the voxels.
   bool hasLabelMap();
 
@@ -179,6 +194,10 @@ signals:
   /// new/updated data.
   void dataChanged();
 
+  /// This signal is fired when the index returned by spanSpace() has been
+  /// built for the current data.
+  void spanSpaceChanged();
+
   /// This signal is fired to notify the world that the data's properties may
   /// have changed.
   void dataPropertiesChanged();
@@ -215,10 +234,12 @@ protected:
   /// producer takes over ownership of the data object.
   void setData(vtkDataObject* newData);
 
-  /// Create copy of current data object, caller is responsible for ownership
+  /// Create copy of current data object, caller is responsible for ownership.
+  /// The copy shares its arrays until they are modified, see CopyOnWrite.
   vtkDataObject* copyData();
 
-  /// Create copy of original data object, caller is responsible for ownership
+  /// Create copy of original data object, caller is responsible for ownership.
+  /// The copy shares its arrays until they are modified, see CopyOnWrite.
   vtkDataObject* copyOriginalData();
 
   /// Sets the type of data in the DataSource
@@ -235,9 +256,19 @@ protected slots:
 
   /// The pipeline worker is has been canceled
   void pipelineCanceled();
-  void updateCache();
+
+private slots:
+  /// Starts building the span space index of the current data.
+  void buildSpanSpace();
+  void spanSpaceBuilt();
 
 private:
+  class SpanSpaceBuilder;
+
+  /// Execute the operators from the given index on, starting from the latest
+  /// cached state of the pipeline before it.
+  void executeOperatorsFrom(int index);
+
   Q_DISABLE_COPY(DataSource)
 
   class DSInternals;
@@ -0,0 +1,260 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "DataStatistics.h"
+
+#include "ComputeHistogram.h"
+
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkTable.h>
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+namespace {
+
+// The statistics of at most this many images are kept.
+const int maximumEntries = 32;
+
+// This number of bins in the 2D histogram will also be used as the number of
+// bins in the 2D transfer function for X (scalar value) and Y (gradient mag.)
+const int numberOfBins = 256;
+
+vtkMTimeType version(vtkImageData* image, vtkDataArray* scalars)
+{
+  return std::max(image->GetMTime(), scalars->GetMTime());
+}
+
+void PopulateHistogram(vtkImageData* input, vtkTable* output)
+{
+  // The output table will have the twice the number of columns, they will be
+  // the x and y for input column. This is the bin centers, and the population.
+  double minmax[2] = { 0.0, 0.0 };
+
+  // Keep the array we are working on around even if the user shallow copies
+  // over the input image data by incrementing the reference count here.
+  vtkSmartPointer<vtkDataArray> arrayPtr = input->GetPointData()->GetScalars();
+
+  vtkNew<vtkIntArray> populations;
+  populations->SetName("image_pops");
+  populations->SetNumberOfTuples(numberOfBins);
+  auto pops = static_cast<int*>(populations->GetVoidPointer(0));
+  for (int k = 0; k < numberOfBins; ++k) {
+    pops[k] = 0;
+  }
+  int invalid = 0;
+
+  switch (arrayPtr->GetDataType()) {
+    vtkTemplateMacro(tomviz::CalculateRangeAndHistogram(
+      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)),
+      arrayPtr->GetNumberOfTuples(), minmax, pops, numberOfBins, invalid));
+    default:
+      std::cout << "UpdateFromFile: Unknown data type" << std::endl;
+  }
+
+  // The bin values are the centers, extending +/- half an inc either side
+  double inc = (minmax[1] - minmax[0]) / numberOfBins;
+  double halfInc = inc / 2.0;
+  vtkNew<vtkFloatArray> extents;
+  extents->SetName("image_extents");
+  extents->SetNumberOfTuples(numberOfBins);
+  double min = minmax[0] + halfInc;
+  for (int j = 0; j < numberOfBins; ++j) {
+    extents->SetValue(j, min + j * inc);
+  }
+
+#ifndef NDEBUG
+  vtkIdType total = invalid;
+  for (int i = 0; i < numberOfBins; ++i)
+    total += pops[i];
+  assert(total == arrayPtr->GetNumberOfTuples());
+#endif
+  if (invalid) {
+    std::cout << "Warning: NaN or infinite value in dataset" << std::endl;
+  }
+
+  output->AddColumn(extents.Get());
+  output->AddColumn(populations.Get());
+}
+
+void Populate2DHistogram(vtkImageData* input, vtkImageData* output)
+{
+  double minmax[2] = { 0.0, 0.0 };
+
+  // Keep the array we are working on around even if the user shallow copies
+  // over the input image data by incrementing the reference count here.
+  vtkSmartPointer<vtkDataArray> arrayPtr = input->GetPointData()->GetScalars();
+
+  // The bin values are the centers, extending +/- half an inc either side
+  switch (arrayPtr->GetDataType()) {
+    vtkTemplateMacro(tomviz::GetScalarRange(
+      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)),
+      input->GetPointData()->GetScalars()->GetNumberOfTuples(), minmax));
+    default:
+      break;
+  }
+  if (minmax[0] == minmax[1]) {
+    minmax[1] = minmax[0] + 1.0;
+  }
+
+  // vtkPlotHistogram2D expects the histogram array to be VTK_DOUBLE
+  output->SetDimensions(numberOfBins, numberOfBins, 1);
+  output->AllocateScalars(VTK_DOUBLE, 1);
+
+  // Get input parameters
+  int dim[3];
+  input->GetDimensions(dim);
+  int numComp = arrayPtr->GetNumberOfComponents();
+  double spacing[3];
+  input->GetSpacing(spacing);
+
+  switch (arrayPtr->GetDataType()) {
+    vtkTemplateMacro(tomviz::Calculate2DHistogram(
+      reinterpret_cast<VTK_TT*>(arrayPtr->GetVoidPointer(0)), dim, numComp,
+      minmax, output, spacing));
+    default:
+      std::cout << "UpdateFromFile: Unknown data type" << std::endl;
+  }
+}
+}
+
+namespace tomviz {
+
+DataStatistics& DataStatistics::instance()
+{
+  static DataStatistics theInstance;
+  return theInstance;
+}
+
+DataStatistics::Entry& DataStatistics::entry(vtkImageData* image)
+{
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  vtkMTimeType time = version(image, scalars);
+  if (!m_entries.contains(image) && m_entries.size() >= maximumEntries) {
+    auto oldest = m_entries.begin();
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+      if (it->lastUsed < oldest->lastUsed) {
+        oldest = it;
+      }
+    }
+    m_entries.erase(oldest);
+  }
+  Entry& e = m_entries[image];
+  if (e.scalars != scalars || e.time != time) {
+    e = Entry();
+    e.scalars = scalars;
+    e.time = time;
+  }
+  e.lastUsed = ++m_lastUsed;
+  return e;
+}
+
+void DataStatistics::range(vtkImageData* image, double range[2])
+{
+  range[0] = 0.0;
+  range[1] = 1.0;
+  vtkSmartPointer<vtkDataArray> scalars =
+    image ? image->GetPointData()->GetScalars() : nullptr;
+  if (!scalars) {
+    return;
+  }
+  vtkMTimeType time;
+  {
+    QMutexLocker locker(&m_mutex);
+    Entry& e = entry(image);
+    if (e.hasRange) {
+      std::copy(e.range, e.range + 2, range);
+      return;
+    }
+    time = e.time;
+  }
+
+  vtkIdType n = scalars->GetNumberOfTuples() * scalars->GetNumberOfComponents();
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(
+      GetScalarRange(static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), n,
+                     range));
+  }
+
+  QMutexLocker locker(&m_mutex);
+  Entry& e = entry(image);
+  if (e.time == time) {
+    e.hasRange = true;
+    std::copy(range, range + 2, e.range);
+  }
+}
+
+vtkSmartPointer<vtkTable> DataStatistics::histogram(vtkImageData* image,
+                                                    bool compute)
+{
+  if (!image || !image->GetPointData()->GetScalars()) {
+    return nullptr;
+  }
+  vtkMTimeType time;
+  {
+    QMutexLocker locker(&m_mutex);
+    Entry& e = entry(image);
+    if (e.histogram || !compute) {
+      return e.histogram;
+    }
+    time = e.time;
+  }
+
+  auto table = vtkSmartPointer<vtkTable>::New();
+  PopulateHistogram(image, table);
+
+  QMutexLocker locker(&m_mutex);
+  Entry& e = entry(image);
+  if (e.time == time) {
+    e.histogram = table;
+  }
+  return table;
+}
+
+vtkSmartPointer<vtkImageData> DataStatistics::histogram2D(vtkImageData* image,
+                                                          bool compute)
+{
+  if (!image || !image->GetPointData()->GetScalars()) {
+    return nullptr;
+  }
+  vtkMTimeType time;
+  {
+    QMutexLocker locker(&m_mutex);
+    Entry& e = entry(image);
+    if (e.histogram2D || !compute) {
+      return e.histogram2D;
+    }
+    time = e.time;
+  }
+
+  auto histogram = vtkSmartPointer<vtkImageData>::New();
+  Populate2DHistogram(image, histogram);
+
+  QMutexLocker locker(&m_mutex);
+  Entry& e = entry(image);
+  if (e.time == time) {
+    e.histogram2D = histogram;
+  }
+  return histogram;
+}
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizDataStatistics_h
+#define tomvizDataStatistics_h
+
+#include <QMap>
+#include <QMutex>
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkDataArray;
+class vtkImageData;
+class vtkTable;
+
+namespace tomviz {
+
+/// Caches statistics of the scalars of images, so they are computed once for
+/// each version of the data however many views and panels ask for them. The
+/// statistics of an image are kept until its scalars are replaced or either
+/// is modified, as told by their MTime. All the methods are thread safe,
+/// statistics are computed without holding the cache locked.
+class DataStatistics
+{
+public:
+  static DataStatistics& instance();
+
+  /// Gets the range of the finite values of the scalars.
+  void range(vtkImageData* image, double range[2]);
+
+  /// Returns the histogram of the scalars as a table with the bin centers in
+  /// the "image_extents" column and populations in "image_pops". Returns
+  /// nullptr if compute is false and it has not been computed yet. The table
+  /// is shared with the cache and must not be modified.
+  vtkSmartPointer<vtkTable> histogram(vtkImageData* image,
+                                      bool compute = true);
+
+  /// Returns the 2D histogram of the scalars against their gradient
+  /// magnitude, with the same sharing as histogram().
+  vtkSmartPointer<vtkImageData> histogram2D(vtkImageData* image,
+                                            bool compute = true);
+
+private:
+  DataStatistics() = default;
+
+  struct Entry
+  {
+    vtkDataArray* scalars = nullptr;
+    vtkMTimeType time = 0;
+    quint64 lastUsed = 0;
+    bool hasRange = false;
+    double range[2];
+    vtkSmartPointer<vtkTable> histogram;
+    vtkSmartPointer<vtkImageData> histogram2D;
+  };
+
+  // Returns the entry of the image, emptied if its data has changed. The
+  // cache must be locked.
+  Entry& entry(vtkImageData* image);
+
+  QMutex m_mutex;
+  QMap<vtkImageData*, Entry> m_entries;
+  quint64 m_lastUsed = 0;
+};
+}
+
+#endif
@@ -20,6 +20,8 @@
 #include <QMenu>
 
 #include "AddExpressionReaction.h"
+#include "AddLabelMapReaction.h"
+#include "AddPointwiseReaction.h"
 #include "AddPythonTransformReaction.h"
 #include "CloneDataReaction.h"
 #include "ConvertToFloatReaction.h"
@@ -109,16 +111,17 @@ void DataTransformMenu::buildTransforms()
                                  readInJSONDescription("Rotate3D"));
   new AddPythonTransformReaction(clearAction, "Clear Volume",
                                  readInPythonScript("ClearVolume"));
-  new AddPythonTransformReaction(setNegativeVoxelsToZeroAction,
-                                 "Set Negative Voxels to Zero",
-                                 readInPythonScript("SetNegativeVoxelsToZero"));
-  new AddPythonTransformReaction(addConstantAction, "Add a Constant",
-                                 readInPythonScript("AddConstant"), false,
-                                 false, readInJSONDescription("AddConstant"));
-  new AddPythonTransformReaction(invertDataAction, "Invert Data",
-                                 readInPythonScript("InvertData"));
-  new AddPythonTransformReaction(squareRootAction, "Square Root Data",
-                                 readInPythonScript("Square_Root_Data"));
+  new AddPointwiseReaction(setNegativeVoxelsToZeroAction,
+                           PointwiseOperator::Function::ClampNegative,
+                           mainWindow);
+  new AddPointwiseReaction(addConstantAction,
+                           PointwiseOperator::Function::AddConstant,
+                           mainWindow);
+  new AddPointwiseReaction(invertDataAction,
+                           PointwiseOperator::Function::Invert, mainWindow);
+  new AddPointwiseReaction(squareRootAction,
+                           PointwiseOperator::Function::SquareRoot,
+                           mainWindow);
   new AddPythonTransformReaction(cropEdgesAction, "Clip Edges",
                                  readInPythonScript("ClipEdges"), false, true,
                                  readInJSONDescription("ClipEdges"));
@@ -157,6 +160,7 @@ void DataTransformMenu::buildTransforms()
 
 void DataTransformMenu::buildSegmentation()
 {
+  QMainWindow* mainWindow = m_mainWindow;
   QMenu* menu = m_segmentationMenu;
   menu->clear();
 
@@ -191,35 +195,27 @@ void DataTransformMenu::buildSegmentation()
     otsuMultipleThresholdAction, "Otsu Multiple Threshold",
     readInPythonScript("OtsuMultipleThreshold"), false, false,
     readInJSONDescription("OtsuMultipleThreshold"));
-  new AddPythonTransformReaction(
-    connectedComponentsAction, "Connected Components",
-    readInPythonScript("ConnectedComponents"), false, false,
-    readInJSONDescription("ConnectedComponents"));
-  new AddPythonTransformReaction(binaryDilateAction, "Binary Dilate",
-                                 readInPythonScript("BinaryDilate"), false,
-                                 false, readInJSONDescription("BinaryDilate"));
-  new AddPythonTransformReaction(binaryErodeAction, "Binary Erode",
-                                 readInPythonScript("BinaryErode"), false,
-                                 false, readInJSONDescription("BinaryErode"));
-  new AddPythonTransformReaction(binaryOpenAction, "Binary Open",
-                                 readInPythonScript("BinaryOpen"), false, false,
-                                 readInJSONDescription("BinaryOpen"));
-  new AddPythonTransformReaction(binaryCloseAction, "Binary Close",
-                                 readInPythonScript("BinaryClose"), false,
-                                 false, readInJSONDescription("BinaryClose"));
+  new AddLabelMapReaction(connectedComponentsAction,
+                          LabelMapOperator::Function::ConnectedComponents,
+                          mainWindow);
+  new AddLabelMapReaction(binaryDilateAction,
+                          LabelMapOperator::Function::Dilate, mainWindow);
+  new AddLabelMapReaction(binaryErodeAction, LabelMapOperator::Function::Erode,
+                          mainWindow);
+  new AddLabelMapReaction(binaryOpenAction, LabelMapOperator::Function::Open,
+                          mainWindow);
+  new AddLabelMapReaction(binaryCloseAction, LabelMapOperator::Function::Close,
+                          mainWindow);
   new AddPythonTransformReaction(
     binaryMinMaxCurvatureFlowAction, "Binary MinMax Curvature Flow",
     readInPythonScript("BinaryMinMaxCurvatureFlow"), false, false,
     readInJSONDescription("BinaryMinMaxCurvatureFlow"));
 
-  new AddPythonTransformReaction(
-    labelObjectAttributesAction, "Label Object Attributes",
-    readInPythonScript("LabelObjectAttributes"), false, false,
-    readInJSONDescription("LabelObjectAttributes"));
-  new AddPythonTransformReaction(
-    labelObjectPrincipalAxesAction, "Label Object Principal Axes",
-    readInPythonScript("LabelObjectPrincipalAxes"), false, false,
-    readInJSONDescription("LabelObjectPrincipalAxes"));
+  new AddLabelMapReaction(labelObjectAttributesAction,
+                          LabelMapOperator::Function::Attributes, mainWindow);
+  new AddLabelMapReaction(labelObjectPrincipalAxesAction,
+                          LabelMapOperator::Function::PrincipalAxes,
+                          mainWindow);
   new AddPythonTransformReaction(
     distanceFromAxisAction, "Label Object Distance From Principal Axis",
     readInPythonScript("LabelObjectDistanceFromPrincipalAxis"), false, false,
@@ -16,6 +16,8 @@
 #include "EmdFormat.h"
 
 #include "DataSource.h"
+#include "MappedVolume.h"
+#include "Parallel.h"
 
 #include <vtkDataArray.h>
 #include <vtkImageData.h>
@@ -25,8 +27,14 @@
 #include <vtkSMSourceProxy.h>
 
 #include "vtk_hdf5.h"
+#include "vtk_zlib.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -34,33 +42,279 @@
 
 namespace tomviz {
 
-/**
- * Write the data into the supplied group. This is really just mapping the C++
- * vtkImageData types to the HDF5 API/types.
- *
- * dataTypeId refers to the type that will be stored in the HDF5 file
- * memTypeId refers to the memory type that will be copied from vtkImageData
- */
-template <typename T>
-bool writeVolume(T* buffer, hid_t groupId, const char* name, hid_t dataspaceId,
-                 hid_t dataTypeId, hid_t memTypeId)
+namespace {
+
+/// Filter id registered with the HDF Group for the LZ4 plugin.
+const H5Z_filter_t lz4Filter = 32004;
+
+/// Pick the chunk shape in HDF5 order (z, y, x). Requested sizes are given in
+/// x, y, z order, and zeros are replaced by a cubic brick of about a megabyte
+/// so that sub-extents in any direction touch few chunks.
+void chunkShape(const hsize_t dims[3], const int requested[3],
+                size_t typeSize, hsize_t chunk[3])
 {
-  bool success = true;
-  hid_t dataId = H5Dcreate(groupId, name, dataTypeId, dataspaceId, H5P_DEFAULT,
-                           H5P_DEFAULT, H5P_DEFAULT);
-  if (dataId < 0) { // Failed to create object.
-    return false;
+  const double target = static_cast<double>(1 << 20) / typeSize;
+  const hsize_t side = std::max<hsize_t>(16, std::cbrt(target));
+  for (int i = 0; i < 3; ++i) {
+    hsize_t size = requested[2 - i] > 0 ? requested[2 - i] : side;
+    chunk[i] = std::max<hsize_t>(1, std::min(size, dims[i]));
   }
-  hid_t status =
-    H5Dwrite(dataId, memTypeId, H5S_ALL, H5S_ALL, H5P_DEFAULT, buffer);
-  if (status < 0) {
-    success = false;
+}
+
+/// Computes the offset of chunk index in a grid of chunks covering dims.
+void chunkOffset(hsize_t index, const hsize_t dims[3], const hsize_t chunk[3],
+                 hsize_t offset[3])
+{
+  hsize_t grid[3];
+  for (int i = 0; i < 3; ++i) {
+    grid[i] = (dims[i] + chunk[i] - 1) / chunk[i];
   }
-  status = H5Dclose(dataId);
-  if (status < 0) {
-    success = false;
+  offset[2] = (index % grid[2]) * chunk[2];
+  offset[1] = ((index / grid[2]) % grid[1]) * chunk[1];
+  offset[0] = (index / (grid[2] * grid[1])) * chunk[0];
+}
+
+/// Copies the voxels shared by a chunk and a box of the volume between the
+/// chunk buffer and a buffer holding just that box, in the direction given by
+/// toChunk. Offsets, starts and sizes are all in HDF5 order (z, y, x).
+void copyChunk(unsigned char* chunk, const hsize_t offset[3],
+               const hsize_t chunkDims[3], unsigned char* box,
+               const hsize_t start[3], const hsize_t count[3],
+               size_t typeSize, bool toChunk)
+{
+  hsize_t lo[3], hi[3];
+  for (int i = 0; i < 3; ++i) {
+    lo[i] = std::max(offset[i], start[i]);
+    hi[i] = std::min(offset[i] + chunkDims[i], start[i] + count[i]);
+    if (lo[i] >= hi[i]) {
+      return;
+    }
   }
-  return success;
+  const size_t rowBytes = (hi[2] - lo[2]) * typeSize;
+  for (hsize_t z = lo[0]; z < hi[0]; ++z) {
+    for (hsize_t y = lo[1]; y < hi[1]; ++y) {
+      size_t c = ((z - offset[0]) * chunkDims[1] + (y - offset[1])) *
+                   chunkDims[2] + (lo[2] - offset[2]);
+      size_t b = ((z - start[0]) * count[1] + (y - start[1])) * count[2] +
+                 (lo[2] - start[2]);
+      if (toChunk) {
+        std::memcpy(chunk + c * typeSize, box + b * typeSize, rowBytes);
+      } else {
+        std::memcpy(box + b * typeSize, chunk + c * typeSize, rowBytes);
+      }
+    }
+  }
+}
+
+/// The byte transposition done by the HDF5 shuffle filter, and its inverse.
+void shuffleBytes(const unsigned char* in, unsigned char* out, size_t count,
+                  size_t typeSize)
+{
+  for (size_t b = 0; b < typeSize; ++b) {
+    for (size_t i = 0; i < count; ++i) {
+      out[b * count + i] = in[i * typeSize + b];
+    }
+  }
+}
+
+void unshuffleBytes(const unsigned char* in, unsigned char* out, size_t count,
+                    size_t typeSize)
+{
+  for (size_t b = 0; b < typeSize; ++b) {
+    for (size_t i = 0; i < count; ++i) {
+      out[i * typeSize + b] = in[b * count + i];
+    }
+  }
+}
+
+#if H5_VERSION_GE(1, 10, 3)
+
+/// Compresses the chunks of the volume across threads, and writes the results
+/// straight into the dataset. The dataset must have been created with the
+/// same chunk shape, an optional shuffle filter followed by deflate.
+bool writeChunks(hid_t datasetId, unsigned char* volume, const hsize_t dims[3],
+                 const hsize_t chunk[3], size_t typeSize, bool shuffle,
+                 int level)
+{
+  const hsize_t start[3] = { 0, 0, 0 };
+  const size_t chunkSize = chunk[0] * chunk[1] * chunk[2];
+  const size_t chunkBytes = chunkSize * typeSize;
+  hsize_t total = 1;
+  for (int i = 0; i < 3; ++i) {
+    total *= (dims[i] + chunk[i] - 1) / chunk[i];
+  }
+
+  // HDF5 is not thread safe, so compress a few chunks per thread at a time
+  // and write them out serially. This also bounds the memory used.
+  const int batch = Parallel::threadCount() * 4;
+  std::vector<std::vector<unsigned char>> compressed(batch);
+  for (hsize_t first = 0; first < total; first += batch) {
+    int count = static_cast<int>(std::min<hsize_t>(batch, total - first));
+    std::atomic<bool> failed{ false };
+    Parallel::forRange(0, count, 1, [&](int begin, int end) {
+      std::vector<unsigned char> raw(chunkBytes);
+      std::vector<unsigned char> shuffled(shuffle ? chunkBytes : 0);
+      for (int i = begin; i < end; ++i) {
+        hsize_t offset[3];
+        chunkOffset(first + i, dims, chunk, offset);
+        // Chunks on the far edges are padded with zeros.
+        std::fill(raw.begin(), raw.end(), 0);
+        copyChunk(raw.data(), offset, chunk, volume, start, dims, typeSize,
+                  true);
+        const unsigned char* source = raw.data();
+        if (shuffle) {
+          shuffleBytes(raw.data(), shuffled.data(), chunkSize, typeSize);
+          source = shuffled.data();
+        }
+        auto& bytes = compressed[i];
+        uLongf size = compressBound(static_cast<uLong>(chunkBytes));
+        bytes.resize(size);
+        if (compress2(bytes.data(), &size, source,
+                      static_cast<uLong>(chunkBytes), level) != Z_OK) {
+          failed = true;
+        }
+        bytes.resize(size);
+      }
+    });
+    if (failed) {
+      return false;
+    }
+    for (int i = 0; i < count; ++i) {
+      hsize_t offset[3];
+      chunkOffset(first + i, dims, chunk, offset);
+      if (H5Dwrite_chunk(datasetId, H5P_DEFAULT, 0, offset,
+                         compressed[i].size(), compressed[i].data()) < 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/// Returns true if the chunks of the dataset can be decompressed by
+/// readChunks, that is when it is chunked, filtered by an optional shuffle
+/// followed by deflate, and unwritten chunks read as zero. The chunk shape
+/// and the pipeline position of each filter (-1 if absent) are returned.
+bool rawChunkLayout(hid_t datasetId, hsize_t chunk[3], int& shuffleFilter,
+                    int& deflateFilter)
+{
+  shuffleFilter = -1;
+  deflateFilter = -1;
+  hid_t propertiesId = H5Dget_create_plist(datasetId);
+  H5D_fill_value_t fill = H5D_FILL_VALUE_ERROR;
+  bool usable = H5Pget_layout(propertiesId) == H5D_CHUNKED &&
+                H5Pget_chunk(propertiesId, 3, chunk) == 3 &&
+                H5Pfill_value_defined(propertiesId, &fill) >= 0 &&
+                fill == H5D_FILL_VALUE_DEFAULT;
+  int filterCount = usable ? H5Pget_nfilters(propertiesId) : 0;
+  for (int i = 0; i < filterCount && usable; ++i) {
+    unsigned int flags = 0;
+    size_t valueCount = 0;
+    H5Z_filter_t filter = H5Pget_filter2(propertiesId, i, &flags, &valueCount,
+                                         nullptr, 0, nullptr, nullptr);
+    if (filter == H5Z_FILTER_SHUFFLE && shuffleFilter < 0 &&
+        deflateFilter < 0) {
+      shuffleFilter = i;
+    } else if (filter == H5Z_FILTER_DEFLATE && deflateFilter < 0) {
+      deflateFilter = i;
+    } else {
+      usable = false;
+    }
+  }
+  H5Pclose(propertiesId);
+  return usable && deflateFilter >= 0;
+}
+
+/// Reads the chunks overlapping the box at start of size count, decompressing
+/// them across threads into box, which is laid out in HDF5 order.
+bool readChunks(hid_t datasetId, unsigned char* box, const hsize_t start[3],
+                const hsize_t count[3], const hsize_t chunk[3],
+                size_t typeSize, int shuffleFilter, int deflateFilter)
+{
+  const size_t chunkSize = chunk[0] * chunk[1] * chunk[2];
+  const size_t chunkBytes = chunkSize * typeSize;
+  std::vector<hsize_t> offsets;
+  for (hsize_t z = start[0] / chunk[0] * chunk[0]; z < start[0] + count[0];
+       z += chunk[0]) {
+    for (hsize_t y = start[1] / chunk[1] * chunk[1];
+         y < start[1] + count[1]; y += chunk[1]) {
+      for (hsize_t x = start[2] / chunk[2] * chunk[2];
+           x < start[2] + count[2]; x += chunk[2]) {
+        offsets.push_back(z);
+        offsets.push_back(y);
+        offsets.push_back(x);
+      }
+    }
+  }
+  const int total = static_cast<int>(offsets.size() / 3);
+
+  // As for writing, only the decompression happens across threads.
+  const int batch = Parallel::threadCount() * 4;
+  std::vector<std::vector<unsigned char>> stored(batch);
+  std::vector<uint32_t> masks(batch, 0);
+  for (int first = 0; first < total; first += batch) {
+    int last = std::min(total, first + batch);
+    for (int c = first; c < last; ++c) {
+      auto& bytes = stored[c - first];
+      hsize_t size = 0;
+      herr_t found = -1;
+      bytes.clear();
+      // Fails for chunks that were never written.
+      H5E_BEGIN_TRY
+      {
+        found = H5Dget_chunk_storage_size(datasetId, &offsets[3 * c], &size);
+      }
+      H5E_END_TRY;
+      if (found >= 0 && size > 0) {
+        bytes.resize(size);
+        if (H5Dread_chunk(datasetId, H5P_DEFAULT, &offsets[3 * c],
+                          &masks[c - first], bytes.data()) < 0) {
+          return false;
+        }
+      }
+    }
+    std::atomic<bool> failed{ false };
+    Parallel::forRange(first, last, 1, [&](int begin, int end) {
+      std::vector<unsigned char> raw(chunkBytes);
+      std::vector<unsigned char> shuffled(chunkBytes);
+      for (int c = begin; c < end; ++c) {
+        const auto& bytes = stored[c - first];
+        // A bit set in the mask means the filter was skipped for the chunk.
+        uint32_t mask = masks[c - first];
+        if (bytes.empty()) {
+          // Chunks that were never written hold the fill value.
+          std::fill(raw.begin(), raw.end(), 0);
+        } else if (!(mask & (1u << deflateFilter))) {
+          uLongf size = static_cast<uLongf>(chunkBytes);
+          if (uncompress(raw.data(), &size, bytes.data(),
+                         static_cast<uLong>(bytes.size())) != Z_OK ||
+              size != chunkBytes) {
+            failed = true;
+            continue;
+          }
+        } else if (bytes.size() == chunkBytes) {
+          std::copy(bytes.begin(), bytes.end(), raw.begin());
+        } else {
+          failed = true;
+          continue;
+        }
+        if (!bytes.empty() && shuffleFilter >= 0 &&
+            !(mask & (1u << shuffleFilter))) {
+          unshuffleBytes(raw.data(), shuffled.data(), chunkSize, typeSize);
+          raw.swap(shuffled);
+        }
+        copyChunk(raw.data(), &offsets[3 * c], chunk, box, start, count,
+                  typeSize, false);
+      }
+    });
+    if (failed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
 }
 
 class EmdFormat::Private
@@ -92,14 +346,19 @@ public:
       // The type of the attribute does not match the requested type.
       cout << "Type determined does not match that requested." << endl;
       cout << type << " -> " << typeId << " : " << H5T_STD_U32LE << endl;
+      H5Tclose(type);
       H5Aclose(attr);
       return false;
     } else if (H5Tequal(type, typeId) < 0) {
       cout << "Something went really wrong....\n\n";
+      H5Tclose(type);
       H5Aclose(attr);
       return false;
     }
     hid_t status = H5Aread(attr, H5T_NATIVE_INT, value);
+    // An attribute left open keeps the file open after it is closed.
+    H5Tclose(type);
+    H5Aclose(attr);
     return status >= 0;
   }
 
@@ -223,7 +482,7 @@ public:
   }
 
   bool writeData(const std::string& group, const std::string& name,
-                 vtkImageData* data)
+                 vtkImageData* data, const EmdFormat::WriteOptions& options)
   {
     bool success = true;
     hsize_t h5dim[3];
@@ -233,9 +492,6 @@ public:
     h5dim[1] = dim[1];
     h5dim[2] = dim[0];
 
-    auto arrayPtr = data->GetPointData()->GetScalars();
-    auto dataPtr = static_cast<float*>(arrayPtr->GetVoidPointer(0));
-
     // Map the VTK types to the HDF5 types for storage and memory. We should
     // probably add more, but I got the important ones for testing in first.
     hid_t dataTypeId = 0;
@@ -258,21 +514,70 @@ public:
         memTypeId = H5T_NATIVE_UCHAR;
         break;
       default:
-        success = false;
+        return false;
     }
 
-    hid_t groupId = H5Gopen(fileId, group.c_str(), H5P_DEFAULT);
-    hid_t dataspaceId =
-      H5Screate_simple(3, &h5dim[0], NULL);
+    // Unless asked for a contiguous block that can be mapped, store the
+    // volume in chunks so that sub-extents can be read back without touching
+    // the rest of the file.
+    typedef EmdFormat::WriteOptions Options;
+    const size_t typeSize = data->GetScalarSize();
+    const bool compress =
+      !options.contiguous && options.compression != Options::None;
+    hsize_t chunk[3];
+    chunkShape(h5dim, options.chunkShape, typeSize, chunk);
+    hid_t propertiesId = H5Pcreate(H5P_DATASET_CREATE);
+    if (!options.contiguous) {
+      H5Pset_chunk(propertiesId, 3, chunk);
+    }
 
-    switch (data->GetScalarType()) {
-      vtkTemplateMacro(success =
-                         writeVolume((VTK_TT*)(dataPtr), groupId, name.c_str(),
-                                     dataspaceId, dataTypeId, memTypeId));
-      default:
+    bool lz4 = compress && options.compression == Options::Fast &&
+               H5Zfilter_avail(lz4Filter) > 0;
+    bool deflate = compress && !lz4;
+    int level = options.compression == Options::Fast
+                  ? 1
+                  : std::max(1, std::min(options.level, 9));
+    bool shuffle = options.shuffle && typeSize > 1;
+    if (compress) {
+      if (shuffle) {
+        H5Pset_shuffle(propertiesId);
+      }
+      if (lz4) {
+        H5Pset_filter(propertiesId, lz4Filter, H5Z_FLAG_OPTIONAL, 0, nullptr);
+      } else {
+        H5Pset_deflate(propertiesId, level);
+      }
+    }
+
+    hid_t groupId = H5Gopen(fileId, group.c_str(), H5P_DEFAULT);
+    hid_t dataspaceId = H5Screate_simple(3, &h5dim[0], NULL);
+    hid_t dataId = H5Dcreate(groupId, name.c_str(), dataTypeId, dataspaceId,
+                             H5P_DEFAULT, propertiesId, H5P_DEFAULT);
+    if (dataId < 0) { // Failed to create object.
+      success = false;
+    } else {
+      auto buffer = static_cast<unsigned char*>(data->GetScalarPointer());
+      bool written = false;
+#if H5_VERSION_GE(1, 10, 3)
+      // The deflate filter runs on a single thread inside HDF5, so compress
+      // the chunks ourselves. They are stored as given, so the memory layout
+      // must already match the file.
+      if (deflate && H5Tequal(dataTypeId, memTypeId) > 0) {
+        success = writeChunks(dataId, buffer, h5dim, chunk, typeSize, shuffle,
+                              level);
+        written = true;
+      }
+#endif
+      if (!written) {
+        success = H5Dwrite(dataId, memTypeId, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                           buffer) >= 0;
+      }
+      if (H5Dclose(dataId) < 0) {
         success = false;
+      }
     }
 
+    H5Pclose(propertiesId);
     hid_t status = H5Sclose(dataspaceId);
     if (status < 0) {
       success = false;
@@ -284,7 +589,107 @@ public:
     return success;
   }
 
-  bool readData(const std::string& path, vtkImageData* data)
+  /// Map the HDF5 types to the VTK types for storage and memory. We should
+  /// probably add more, but I got the important ones for testing in first.
+  bool scalarType(hid_t dataTypeId, int& vtkDataType, hid_t& memTypeId)
+  {
+    if (H5Tequal(dataTypeId, H5T_IEEE_F32LE)) {
+      memTypeId = H5T_NATIVE_FLOAT;
+      vtkDataType = VTK_FLOAT;
+    } else if (H5Tequal(dataTypeId, H5T_STD_I32LE)) {
+      memTypeId = H5T_NATIVE_INT;
+      vtkDataType = VTK_INT;
+    } else if (H5Tequal(dataTypeId, H5T_STD_U32LE)) {
+      memTypeId = H5T_NATIVE_UINT;
+      vtkDataType = VTK_UNSIGNED_INT;
+    } else if (H5Tequal(dataTypeId, H5T_STD_I16LE)) {
+      memTypeId = H5T_NATIVE_SHORT;
+      vtkDataType = VTK_SHORT;
+    } else if (H5Tequal(dataTypeId, H5T_STD_U16LE)) {
+      memTypeId = H5T_NATIVE_USHORT;
+      vtkDataType = VTK_UNSIGNED_SHORT;
+    } else if (H5Tequal(dataTypeId, H5T_STD_I8LE)) {
+      memTypeId = H5T_NATIVE_CHAR;
+      vtkDataType = VTK_SIGNED_CHAR;
+    } else if (H5Tequal(dataTypeId, H5T_STD_U8LE)) {
+      memTypeId = H5T_NATIVE_UCHAR;
+      vtkDataType = VTK_UNSIGNED_CHAR;
+    } else {
+      // Not accounted for, fail for now, should probably improve this soon.
+      std::cout << "Unknown type encountered!" << dataTypeId << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /// Maps the contiguous, unfiltered dataset at path instead of reading it.
+  bool mapData(const std::string& fileName, const std::string& path,
+               vtkImageData* data)
+  {
+    hid_t datasetId = H5Dopen(fileId, path.c_str(), H5P_DEFAULT);
+    if (datasetId < 0) {
+      return false;
+    }
+    hid_t dataspaceId = H5Dget_space(datasetId);
+    hid_t dataTypeId = H5Dget_type(datasetId);
+    hid_t propertiesId = H5Dget_create_plist(datasetId);
+    hsize_t h5dims[3] = { 0, 0, 0 };
+    int vtkDataType = VTK_FLOAT;
+    hid_t memTypeId = 0;
+    haddr_t offset = H5Dget_offset(datasetId);
+    // The offset is undefined unless the dataset is stored in one block.
+    bool mappable = H5Sget_simple_extent_ndims(dataspaceId) == 3 &&
+                    H5Sget_simple_extent_dims(dataspaceId, h5dims, nullptr) ==
+                      3 &&
+                    H5Pget_layout(propertiesId) == H5D_CONTIGUOUS &&
+                    offset != HADDR_UNDEF &&
+                    scalarType(dataTypeId, vtkDataType, memTypeId) &&
+                    H5Tequal(dataTypeId, memTypeId) > 0;
+    H5Pclose(propertiesId);
+    H5Tclose(dataTypeId);
+    H5Sclose(dataspaceId);
+    H5Dclose(datasetId);
+    if (!mappable) {
+      return false;
+    }
+
+    int extent[6] = { 0, static_cast<int>(h5dims[2]) - 1,
+                      0, static_cast<int>(h5dims[1]) - 1,
+                      0, static_cast<int>(h5dims[0]) - 1 };
+    return MappedVolume::map(QString::fromStdString(fileName),
+                             static_cast<qint64>(offset), vtkDataType, 1,
+                             extent, data);
+  }
+
+  bool dataDimensions(const std::string& path, int dims[3], int& valueSize)
+  {
+    hid_t datasetId = H5Dopen(fileId, path.c_str(), H5P_DEFAULT);
+    if (datasetId < 0) {
+      return false;
+    }
+    hid_t dataspaceId = H5Dget_space(datasetId);
+    hid_t dataTypeId = H5Dget_type(datasetId);
+    hsize_t h5dims[3] = { 0, 0, 0 };
+    int vtkDataType = VTK_FLOAT;
+    hid_t memTypeId = 0;
+    bool success = H5Sget_simple_extent_ndims(dataspaceId) == 3 &&
+                   H5Sget_simple_extent_dims(dataspaceId, h5dims, nullptr) ==
+                     3 &&
+                   scalarType(dataTypeId, vtkDataType, memTypeId);
+    if (success) {
+      for (int i = 0; i < 3; ++i) {
+        dims[i] = static_cast<int>(h5dims[2 - i]);
+      }
+      valueSize = static_cast<int>(H5Tget_size(memTypeId));
+    }
+    H5Tclose(dataTypeId);
+    H5Sclose(dataspaceId);
+    H5Dclose(datasetId);
+    return success;
+  }
+
+  bool readData(const std::string& path, vtkImageData* data,
+                const int extent[6])
   {
     std::vector<int> dims;
     hid_t datasetId = H5Dopen(fileId, path.c_str(), H5P_DEFAULT);
@@ -293,11 +698,11 @@ public:
     }
     hid_t dataspaceId = H5Dget_space(datasetId);
     if (dataspaceId < 0) {
-      H5Dclose(dataspaceId);
+      H5Dclose(datasetId);
       return false;
     }
     int dimCount = H5Sget_simple_extent_ndims(dataspaceId);
-    if (dimCount < 1) {
+    if (dimCount < 1 || (extent && dimCount != 3)) {
       H5Sclose(dataspaceId);
       H5Dclose(datasetId);
       return false;
@@ -315,56 +720,83 @@ public:
     }
     delete[] h5dims;
 
-    // Map the HDF5 types to the VTK types for storage and memory. We should
-    // probably add more, but I got the important ones for testing in first.
+    // The box to read in HDF5 order (z, y, x), clamped to the dataset.
+    hsize_t start[3] = { 0, 0, 0 };
+    hsize_t count[3] = { 0, 0, 0 };
+    if (dimCount == 3) {
+      for (int i = 0; i < 3; ++i) {
+        int first = extent ? std::max(extent[2 * i], 0) : 0;
+        int last =
+          extent ? std::min(extent[2 * i + 1], dims[i] - 1) : dims[i] - 1;
+        if (last < first) {
+          H5Sclose(dataspaceId);
+          H5Dclose(datasetId);
+          return false;
+        }
+        start[2 - i] = first;
+        count[2 - i] = last - first + 1;
+      }
+    }
+
     int vtkDataType = VTK_FLOAT;
     hid_t dataTypeId = H5Dget_type(datasetId);
     hid_t memTypeId = 0;
-
-    if (H5Tequal(dataTypeId, H5T_IEEE_F32LE)) {
-      memTypeId = H5T_NATIVE_FLOAT;
-      vtkDataType = VTK_FLOAT;
-    } else if (H5Tequal(dataTypeId, H5T_STD_I32LE)) {
-      memTypeId = H5T_NATIVE_INT;
-      vtkDataType = VTK_INT;
-    } else if (H5Tequal(dataTypeId, H5T_STD_U32LE)) {
-      memTypeId = H5T_NATIVE_UINT;
-      vtkDataType = VTK_UNSIGNED_INT;
-    } else if (H5Tequal(dataTypeId, H5T_STD_I16LE)) {
-      memTypeId = H5T_NATIVE_SHORT;
-      vtkDataType = VTK_SHORT;
-    } else if (H5Tequal(dataTypeId, H5T_STD_U16LE)) {
-      memTypeId = H5T_NATIVE_USHORT;
-      vtkDataType = VTK_UNSIGNED_SHORT;
-    } else if (H5Tequal(dataTypeId, H5T_STD_I8LE)) {
-        memTypeId = H5T_NATIVE_CHAR;
-        vtkDataType = VTK_SIGNED_CHAR;
-    } else if (H5Tequal(dataTypeId, H5T_STD_U8LE)) {
-      memTypeId = H5T_NATIVE_UCHAR;
-      vtkDataType = VTK_UNSIGNED_CHAR;
-    } else {
-      // Not accounted for, fail for now, should probably improve this soon.
-      std::cout << "Unknown type encountered!" << dataTypeId << std::endl;
+    if (!scalarType(dataTypeId, vtkDataType, memTypeId)) {
       H5Tclose(dataTypeId);
       H5Sclose(dataspaceId);
       H5Dclose(datasetId);
       return false;
     }
+    bool nativeLayout = H5Tequal(dataTypeId, memTypeId) > 0;
     H5Tclose(dataTypeId);
 
-    data->SetDimensions(&dims[0]);
+    if (dimCount == 3) {
+      data->SetExtent(start[2], start[2] + count[2] - 1, start[1],
+                      start[1] + count[1] - 1, start[0],
+                      start[0] + count[0] - 1);
+    } else {
+      data->SetDimensions(&dims[0]);
+    }
     data->AllocateScalars(vtkDataType, 1);
-
-    H5Dread(datasetId, memTypeId, H5S_ALL, dataspaceId, H5P_DEFAULT,
-            data->GetScalarPointer());
+    auto buffer = static_cast<unsigned char*>(data->GetScalarPointer());
+
+    bool success = false;
+    bool done = false;
+#if H5_VERSION_GE(1, 10, 3)
+    // Deflated chunks can be decompressed across threads, rather than one at
+    // a time in the HDF5 filter pipeline.
+    hsize_t chunk[3];
+    int shuffleFilter = -1;
+    int deflateFilter = -1;
+    if (dimCount == 3 && nativeLayout &&
+        rawChunkLayout(datasetId, chunk, shuffleFilter, deflateFilter)) {
+      success = readChunks(datasetId, buffer, start, count, chunk,
+                           data->GetScalarSize(), shuffleFilter,
+                           deflateFilter);
+      done = true;
+    }
+#else
+    (void)nativeLayout;
+#endif
+    if (!done && dimCount == 3) {
+      // Let HDF5 read just the chunks overlapping the selection.
+      hid_t memspaceId = H5Screate_simple(3, count, nullptr);
+      H5Sselect_hyperslab(dataspaceId, H5S_SELECT_SET, start, nullptr, count,
+                          nullptr);
+      success = H5Dread(datasetId, memTypeId, memspaceId, dataspaceId,
+                        H5P_DEFAULT, buffer) >= 0;
+      H5Sclose(memspaceId);
+    } else if (!done) {
+      success = H5Dread(datasetId, memTypeId, H5S_ALL, dataspaceId,
+                        H5P_DEFAULT, buffer) >= 0;
+    }
     data->Modified();
 
     H5Sclose(dataspaceId);
     H5Dclose(datasetId);
 
-    return true;
+    return success;
   }
-
   std::vector<std::string> children(const std::string path)
   {
     std::vector<std::string> result;
@@ -406,63 +838,105 @@ public:
     }
     return "";
   }
+  /// Opens the file and returns the path of its EMD data set, or an empty
+  /// string if there is none.
+  std::string open(const std::string& fileName)
+  {
+    fileId = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (fileId < 0) {
+      fileId = H5I_INVALID_HID;
+      return "";
+    }
+
+    int version[2];
+    if (!attribute("/", "version_major", version[0])) {
+      cout << "Failed to find version_major" << endl;
+    }
+    if (!attribute("/", "version_minor", version[1])) {
+      cout << "Failed to find version_minor" << endl;
+    }
+
+    std::string emdNode = firstEmdNode();
+    std::string emdDataNode = emdNode + "/data";
+
+    // Verify that the path exists in the HDF5 file, and that it is a dataset.
+    H5O_info_t info;
+    if (emdNode.length() != 0 &&
+        H5Oget_info_by_name(fileId, emdDataNode.c_str(), &info,
+                            H5P_DEFAULT) >= 0 &&
+        info.type == H5O_TYPE_DATASET) {
+      return emdDataNode;
+    }
+    return "";
+  }
+
+  void close()
+  {
+    // Close up the file now we are done.
+    if (fileId != H5I_INVALID_HID) {
+      H5Fclose(fileId);
+      fileId = H5I_INVALID_HID;
+    }
+  }
 };
 
 EmdFormat::EmdFormat() : d(new Private)
 {
 }
 
-bool EmdFormat::read(const std::string& fileName, vtkImageData* image)
+EmdFormat::WriteOptions::WriteOptions()
+  : chunkShape{ 0, 0, 0 }, compression(None), level(4), shuffle(true),
+    contiguous(false)
 {
-  d->fileId = H5Fopen(fileName.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
-
-  int version[2];
-  if (!d->attribute("/", "version_major", version[0])) {
-    cout << "Failed to find version_major" << endl;
-  }
-  if (!d->attribute("/", "version_minor", version[1])) {
-    cout << "Failed to find version_minor" << endl;
-  }
-
-  std::string emdNode = d->firstEmdNode();
-  std::string emdDataNode = emdNode + "/data";
+}
 
-  if (emdNode.length() == 0) {
-    // We couldn't find a valid EMD node, exit early.
-    return false;
-  }
+bool EmdFormat::read(const std::string& fileName, vtkImageData* image)
+{
+  return read(fileName, image, nullptr);
+}
 
-  // Verify that the path exists in the HDF5 file.
-  bool dataLinkExists = false;
-  if (H5Oexists_by_name(d->fileId, emdNode.c_str(), H5P_DEFAULT) == 1) {
-    dataLinkExists = true;
-  }
+bool EmdFormat::read(const std::string& fileName, vtkImageData* image,
+                     const int extent[6])
+{
+  std::string path = d->open(fileName);
+  bool success = !path.empty() && d->readData(path, image, extent);
+  d->close();
+  return success;
+}
 
-  H5O_info_t info;
-  if (H5Oget_info_by_name(d->fileId, emdDataNode.c_str(), &info,
-                          H5P_DEFAULT < 0)) {
-    dataLinkExists = false;
-  } else {
-    dataLinkExists = true;
-  }
+bool EmdFormat::dimensions(const std::string& fileName, int dims[3],
+                           int& valueSize)
+{
+  std::string path = d->open(fileName);
+  bool success = !path.empty() && d->dataDimensions(path, dims, valueSize);
+  d->close();
+  return success;
+}
 
-  if (dataLinkExists && info.type == H5O_TYPE_DATASET) {
-    d->readData(emdDataNode, image);
-    return true;
-  } else {
-    return false;
-  }
+bool EmdFormat::map(const std::string& fileName, vtkImageData* image)
+{
+  std::string path = d->open(fileName);
+  bool success = !path.empty() && d->mapData(fileName, path, image);
+  d->close();
+  return success;
+}
 
-  // Close up the file now we are done.
-  if (d->fileId != H5I_INVALID_HID) {
-    H5Fclose(d->fileId);
-    d->fileId = H5I_INVALID_HID;
-  }
+bool EmdFormat::write(const std::string& fileName, DataSource* source)
+{
+  return write(fileName, source, WriteOptions());
+}
 
-  return true;
+bool EmdFormat::write(const std::string& fileName, DataSource* source,
+                      const WriteOptions& options)
+{
+  auto t =
+    vtkTrivialProducer::SafeDownCast(source->producer()->GetClientSideObject());
+  auto image = vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
+  return write(fileName, image, options);
 }
 
-bool EmdFormat::write(const std::string& fileName, DataSource* source)
+bool EmdFormat::write(const std::string& fileName, vtkImageData* image,
+                      const WriteOptions& options)
 {
   d->fileId =
     H5Fcreate(fileName.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
@@ -484,10 +958,6 @@ bool EmdFormat::write(const std::string& fileName, DataSource* source)
   hid_t status;
 
   // Now create the tomography data store!
-  auto t =
-    vtkTrivialProducer::SafeDownCast(source->producer()->GetClientSideObject());
-  auto image = vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
-
   std::vector<float> imageDimDataX(2);
   std::vector<float> imageDimDataY(2);
   std::vector<float> imageDimDataZ(2);
@@ -497,7 +967,7 @@ bool EmdFormat::write(const std::string& fileName, DataSource* source)
     imageDimDataZ[i] = i;
   }
 
-  d->writeData("/data/tomography", "data", image);
+  bool success = d->writeData("/data/tomography", "data", image, options);
 
   // Create the 3 dim sets too...
   std::vector<int> side;
@@ -524,7 +994,7 @@ bool EmdFormat::write(const std::string& fileName, DataSource* source)
     status = H5Fclose(d->fileId);
     d->fileId = H5I_INVALID_HID;
   }
-  return status >= 0;
+  return success && status >= 0;
 }
 
 EmdFormat::~EmdFormat()
@@ -27,11 +27,60 @@ class DataSource;
 class EmdFormat
 {
 public:
+  /// Controls how the volume is laid out and compressed when writing.
+  struct WriteOptions
+  {
+    enum Compression
+    {
+      None,
+      Deflate,
+      /// LZ4 when the HDF5 filter plugin is available, otherwise a fast
+      /// deflate level.
+      Fast
+    };
+
+    WriteOptions();
+
+    /// Chunk shape in voxels along x, y and z. Zeros pick a cubic brick of
+    /// about a megabyte.
+    int chunkShape[3];
+    Compression compression;
+    /// Deflate level from 1 (fastest) to 9 (smallest).
+    int level;
+    /// Shuffle the bytes of the values before compression, this usually
+    /// compresses numeric data much better.
+    bool shuffle;
+    /// Store the volume uncompressed in one contiguous block, so that it can
+    /// be memory-mapped when loaded. The chunk shape and compression are
+    /// then ignored.
+    bool contiguous;
+  };
+
   EmdFormat();
   ~EmdFormat();
 
   bool read(const std::string& fileName, vtkImageData* data);
+
+  /// Read only the voxels in extent, given as { x0, x1, y0, y1, z0, z1 } in
+  /// voxel indices. Only the chunks overlapping the extent are read from the
+  /// file, so a region of interest can be opened without loading the volume.
+  bool read(const std::string& fileName, vtkImageData* data,
+            const int extent[6]);
+
+  /// Reads the dimensions of the volume and the size of its values in bytes,
+  /// without reading the volume.
+  bool dimensions(const std::string& fileName, int dims[3], int& valueSize);
+
+  /// Map the volume into memory rather than reading it, see MappedVolume.
+  /// This only works for uncompressed, contiguous data sets stored in the
+  /// native byte order, false is returned for anything else.
+  bool map(const std::string& fileName, vtkImageData* data);
+
   bool write(const std::string& fileName, DataSource* source);
+  bool write(const std::string& fileName, DataSource* source,
+             const WriteOptions& options);
+  bool write(const std::string& fileName, vtkImageData* image,
+             const WriteOptions& options = WriteOptions());
 
 private:
   class Private;
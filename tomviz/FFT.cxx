@@ -0,0 +1,100 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "FFT.h"
+
+#include <vtkMath.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace tomviz {
+
+FFT::FFT(int size) : m_size(size)
+{
+  assert(size > 0 && (size & (size - 1)) == 0);
+  m_twiddles.resize(size / 2);
+  for (int k = 0; k < size / 2; ++k) {
+    m_twiddles[k] = std::polar(1.0, -2.0 * vtkMath::Pi() * k / size);
+  }
+  m_bitReverse.resize(size);
+  int bits = 0;
+  while ((1 << bits) < size) {
+    ++bits;
+  }
+  for (int i = 0; i < size; ++i) {
+    int reversed = 0;
+    for (int b = 0; b < bits; ++b) {
+      reversed |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+    m_bitReverse[i] = reversed;
+  }
+}
+
+template <typename T>
+void FFT::apply(std::complex<T>* data, bool inverse) const
+{
+  const int n = m_size;
+  for (int i = 0; i < n; ++i) {
+    if (i < m_bitReverse[i]) {
+      std::swap(data[i], data[m_bitReverse[i]]);
+    }
+  }
+  for (int length = 2; length <= n; length *= 2) {
+    int half = length / 2;
+    int step = n / length;
+    for (int start = 0; start < n; start += length) {
+      for (int k = 0; k < half; ++k) {
+        std::complex<T> w(m_twiddles[k * step]);
+        if (inverse) {
+          w = std::conj(w);
+        }
+        std::complex<T> odd = w * data[start + k + half];
+        data[start + k + half] = data[start + k] - odd;
+        data[start + k] += odd;
+      }
+    }
+  }
+}
+
+void FFT::transform(std::complex<double>* data, bool inverse) const
+{
+  apply(data, inverse);
+}
+
+void FFT::transform(std::complex<float>* data, bool inverse) const
+{
+  apply(data, inverse);
+}
+
+void FFT::transform2D(std::complex<float>* data, int nx, int ny, bool inverse)
+{
+  FFT rows(nx);
+  for (int y = 0; y < ny; ++y) {
+    rows.transform(data + static_cast<size_t>(y) * nx, inverse);
+  }
+  FFT columns(ny);
+  std::vector<std::complex<float>> column(ny);
+  for (int x = 0; x < nx; ++x) {
+    for (int y = 0; y < ny; ++y) {
+      column[y] = data[static_cast<size_t>(y) * nx + x];
+    }
+    columns.transform(column.data(), inverse);
+    for (int y = 0; y < ny; ++y) {
+      data[static_cast<size_t>(y) * nx + x] = column[y];
+    }
+  }
+}
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizFFT_h
+#define tomvizFFT_h
+
+#include <complex>
+#include <vector>
+
+namespace tomviz {
+
+/// In place radix-2 FFT of a fixed power of two size. The twiddle factors
+/// and bit reversal permutation are computed once, so one FFT can transform
+/// every row of an image and be used from several threads at once. Neither
+/// direction is scaled, the inverse of a forward transform multiplies the
+/// values by size().
+class FFT
+{
+public:
+  FFT() = default;
+  explicit FFT(int size);
+
+  int size() const { return m_size; }
+
+  /// Transforms size() values in place.
+  void transform(std::complex<double>* data, bool inverse) const;
+  void transform(std::complex<float>* data, bool inverse) const;
+
+  /// Transforms the nx by ny values of an image, stored row by row, in
+  /// place. nx and ny must be powers of two.
+  static void transform2D(std::complex<float>* data, int nx, int ny,
+                          bool inverse);
+
+private:
+  template <typename T>
+  void apply(std::complex<T>* data, bool inverse) const;
+
+  int m_size = 0;
+  std::vector<std::complex<double>> m_twiddles;
+  std::vector<int> m_bitReverse;
+};
+}
+
+#endif
@@ -0,0 +1,430 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ImageAlignment.h"
+
+#include "FFT.h"
+#include "Parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+#include <vtkVectorOperators.h>
+#include <vtksys/SystemInformation.hxx>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace tomviz {
+
+namespace ImageAlignment {
+
+namespace {
+
+typedef std::complex<float> Complex;
+
+// The band-pass filter cutoff of the Python operator, in pixels.
+const double filterCutoff = 4.0;
+
+struct Plane
+{
+  int nx = 0;
+  int ny = 0;
+  std::vector<float> values;
+};
+
+// Subtracts the mean and tapers the edges to zero with a sin^2 window, so the
+// edges of the images do not dominate the correlation.
+void taper(Plane& plane)
+{
+  double sum = 0.0;
+  for (float value : plane.values) {
+    sum += value;
+  }
+  float mean = static_cast<float>(sum / plane.values.size());
+
+  std::vector<float> wx(plane.nx), wy(plane.ny);
+  for (int x = 0; x < plane.nx; ++x) {
+    double s = std::sin(vtkMath::Pi() * (x + 1) / plane.nx);
+    wx[x] = static_cast<float>(s * s);
+  }
+  for (int y = 0; y < plane.ny; ++y) {
+    double s = std::sin(vtkMath::Pi() * (y + 1) / plane.ny);
+    wy[y] = static_cast<float>(s * s);
+  }
+  float* value = plane.values.data();
+  for (int y = 0; y < plane.ny; ++y) {
+    for (int x = 0; x < plane.nx; ++x, ++value) {
+      *value = (*value - mean) * wx[x] * wy[y];
+    }
+  }
+}
+
+template <typename T>
+void extractSlice(const T* scalars, int components, int nx, int ny, int slice,
+                  Plane& plane)
+{
+  plane.nx = nx;
+  plane.ny = ny;
+  plane.values.resize(static_cast<size_t>(nx) * ny);
+  const T* in = scalars + static_cast<size_t>(slice) * nx * ny * components;
+  for (size_t i = 0; i < plane.values.size(); ++i) {
+    plane.values[i] = static_cast<float>(in[i * components]);
+  }
+}
+
+// Averages 2x2 blocks, the last row or column is dropped for odd sizes.
+Plane half(const Plane& plane)
+{
+  Plane result;
+  result.nx = std::max(plane.nx / 2, 1);
+  result.ny = std::max(plane.ny / 2, 1);
+  result.values.resize(static_cast<size_t>(result.nx) * result.ny);
+  for (int y = 0; y < result.ny; ++y) {
+    int y0 = std::min(2 * y, plane.ny - 1);
+    int y1 = std::min(2 * y + 1, plane.ny - 1);
+    for (int x = 0; x < result.nx; ++x) {
+      int x0 = std::min(2 * x, plane.nx - 1);
+      int x1 = std::min(2 * x + 1, plane.nx - 1);
+      result.values[y * result.nx + x] =
+        0.25f * (plane.values[y0 * plane.nx + x0] +
+                 plane.values[y0 * plane.nx + x1] +
+                 plane.values[y1 * plane.nx + x0] +
+                 plane.values[y1 * plane.nx + x1]);
+    }
+  }
+  return result;
+}
+
+int powerOfTwo(int n)
+{
+  int p = 1;
+  while (p < n) {
+    p <<= 1;
+  }
+  return p;
+}
+
+// The shift of image onto reference at the position of the largest value of
+// their cross-correlation. The images are zero padded to a power of two, so
+// the correlation does not wrap around.
+vtkVector2d fftShift(const Plane& image, const Plane& reference)
+{
+  int px = powerOfTwo(image.nx);
+  int py = powerOfTwo(image.ny);
+  std::vector<Complex> a(static_cast<size_t>(px) * py);
+  std::vector<Complex> b(a.size());
+  for (int y = 0; y < image.ny; ++y) {
+    for (int x = 0; x < image.nx; ++x) {
+      a[static_cast<size_t>(y) * px + x] = image.values[y * image.nx + x];
+      b[static_cast<size_t>(y) * px + x] =
+        reference.values[y * reference.nx + x];
+    }
+  }
+  FFT::transform2D(a.data(), px, py, false);
+  FFT::transform2D(b.data(), px, py, false);
+
+  for (int y = 0; y < py; ++y) {
+    double ky = (y < py / 2 ? y : y - py) / static_cast<double>(py);
+    for (int x = 0; x < px; ++x) {
+      double kx = (x < px / 2 ? x : x - px) / static_cast<double>(px);
+      double k = std::sqrt(kx * kx + ky * ky);
+      double filter = 0.0;
+      if (k <= 0.5 / filterCutoff) {
+        double s = std::sin(2.0 * filterCutoff * vtkMath::Pi() * k);
+        filter = s * s;
+      }
+      size_t i = static_cast<size_t>(y) * px + x;
+      a[i] = std::conj(a[i]) * b[i] * static_cast<float>(filter);
+    }
+  }
+  // The inverse is not scaled, only the position of the peak matters.
+  FFT::transform2D(a.data(), px, py, true);
+
+  size_t peak = 0;
+  for (size_t i = 1; i < a.size(); ++i) {
+    if (a[i].real() > a[peak].real()) {
+      peak = i;
+    }
+  }
+  int mx = static_cast<int>(peak % px);
+  int my = static_cast<int>(peak / px);
+  auto at = [&](int x, int y) {
+    x = (x + px) % px;
+    y = (y + py) % py;
+    return static_cast<double>(a[static_cast<size_t>(y) * px + x].real());
+  };
+  double peakValue = at(mx, my);
+  double sx = (mx < px / 2 ? mx : mx - px) +
+              apex(at(mx - 1, my), peakValue, at(mx + 1, my));
+  double sy = (my < py / 2 ? my : my - py) +
+              apex(at(mx, my - 1), peakValue, at(mx, my + 1));
+  return vtkVector2d(sx, sy);
+}
+
+// The correlation of reference with image shifted by (sx, sy), over the
+// region where they overlap.
+double overlapScore(const Plane& image, const Plane& reference, int sx, int sy)
+{
+  int x0 = std::max(0, sx);
+  int x1 = std::min(image.nx, image.nx + sx);
+  int y0 = std::max(0, sy);
+  int y1 = std::min(image.ny, image.ny + sy);
+  double sum = 0.0;
+  for (int y = y0; y < y1; ++y) {
+    const float* r = &reference.values[static_cast<size_t>(y) * image.nx];
+    const float* i =
+      &image.values[static_cast<size_t>(y - sy) * image.nx] - sx;
+    double row = 0.0;
+    for (int x = x0; x < x1; ++x) {
+      row += r[x] * i[x];
+    }
+    sum += row;
+  }
+  return sum;
+}
+
+// Climbs the correlation from start to its local maximum. The shift from the
+// coarser level is within a pixel or two, so this takes a few steps.
+vtkVector2d refineShift(const Plane& image, const Plane& reference,
+                        vtkVector2i start)
+{
+  std::map<std::pair<int, int>, double> scores;
+  auto at = [&](int x, int y) {
+    auto key = std::make_pair(x, y);
+    auto it = scores.find(key);
+    if (it != scores.end()) {
+      return it->second;
+    }
+    double score = overlapScore(image, reference, x, y);
+    scores[key] = score;
+    return score;
+  };
+
+  const int steps[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+  vtkVector2i best = start;
+  for (int iteration = 0; iteration < 32; ++iteration) {
+    vtkVector2i next = best;
+    double value = at(best[0], best[1]);
+    for (int i = 0; i < 4; ++i) {
+      int x = best[0] + steps[i][0];
+      int y = best[1] + steps[i][1];
+      if (at(x, y) > value) {
+        value = at(x, y);
+        next = vtkVector2i(x, y);
+      }
+    }
+    if (next == best) {
+      break;
+    }
+    best = next;
+  }
+
+  int x = best[0];
+  int y = best[1];
+  double peak = at(x, y);
+  return vtkVector2d(x + apex(at(x - 1, y), peak, at(x + 1, y)),
+                     y + apex(at(x, y - 1), peak, at(x, y + 1)));
+}
+
+// The shift of image onto reference, both already tapered.
+vtkVector2d taperedShift(const Plane& image, const Plane& reference)
+{
+  std::vector<Plane> images, references;
+  const Plane* coarseImage = &image;
+  const Plane* coarseReference = &reference;
+  while (std::max(coarseImage->nx, coarseImage->ny) > coarsestSize) {
+    images.push_back(half(*coarseImage));
+    references.push_back(half(*coarseReference));
+    coarseImage = &images.back();
+    coarseReference = &references.back();
+  }
+
+  vtkVector2d result = fftShift(*coarseImage, *coarseReference);
+  for (int level = static_cast<int>(images.size()) - 1; level >= 0; --level) {
+    const Plane& finerImage = level > 0 ? images[level - 1] : image;
+    const Plane& finerReference = level > 0 ? references[level - 1] : reference;
+    vtkVector2i start(static_cast<int>(std::lround(2.0 * result[0])),
+                      static_cast<int>(std::lround(2.0 * result[1])));
+    result = refineShift(finerImage, finerReference, start);
+  }
+  return result;
+}
+
+// Moves the plane by (sx, sy) with bilinear interpolation, values beyond its
+// edges repeat the edges.
+void translate(const Plane& plane, const vtkVector2d& shift, Plane& result)
+{
+  result.nx = plane.nx;
+  result.ny = plane.ny;
+  result.values.resize(plane.values.size());
+  int ix = static_cast<int>(std::floor(shift[0]));
+  int iy = static_cast<int>(std::floor(shift[1]));
+  float fx = static_cast<float>(shift[0] - ix);
+  float fy = static_cast<float>(shift[1] - iy);
+  auto clamp = [](int i, int n) { return std::max(0, std::min(i, n - 1)); };
+  std::vector<int> x0(plane.nx), x1(plane.nx);
+  for (int x = 0; x < plane.nx; ++x) {
+    x0[x] = clamp(x - ix - 1, plane.nx);
+    x1[x] = clamp(x - ix, plane.nx);
+  }
+  for (int y = 0; y < plane.ny; ++y) {
+    size_t y0 = clamp(y - iy - 1, plane.ny);
+    size_t y1 = clamp(y - iy, plane.ny);
+    const float* row0 = &plane.values[y0 * plane.nx];
+    const float* row1 = &plane.values[y1 * plane.nx];
+    float* out = &result.values[static_cast<size_t>(y) * plane.nx];
+    for (int x = 0; x < plane.nx; ++x) {
+      float top = fx * row0[x0[x]] + (1.0f - fx) * row0[x1[x]];
+      float bottom = fx * row1[x0[x]] + (1.0f - fx) * row1[x1[x]];
+      out[x] = fy * top + (1.0f - fy) * bottom;
+    }
+  }
+}
+
+// The shift of image onto reference. The taper is fixed to the frame, so it
+// pulls the correlation peak towards no shift by several percent of the
+// shift. Moving the image by the shift found and measuring what is left of
+// it removes most of that, the rest goes with a couple more rounds.
+vtkVector2d shift(const Plane& image, const Plane& reference)
+{
+  Plane tapered = image;
+  Plane taperedReference = reference;
+  taper(tapered);
+  taper(taperedReference);
+  vtkVector2d result = taperedShift(tapered, taperedReference);
+  for (int round = 0; round < 3; ++round) {
+    translate(image, result, tapered);
+    taper(tapered);
+    vtkVector2d rest =
+      refineShift(tapered, taperedReference, vtkVector2i(0, 0));
+    result = result + rest;
+    if (std::abs(rest[0]) < 0.01 && std::abs(rest[1]) < 0.01) {
+      break;
+    }
+  }
+  return result;
+}
+}
+
+double apex(double before, double at, double after)
+{
+  double curvature = before - 2.0 * at + after;
+  if (curvature >= 0.0) {
+    return 0.0;
+  }
+  return std::max(-0.5, std::min(0.5, 0.5 * (before - after) / curvature));
+}
+
+vtkVector2d crossCorrelationShift(const float* image, const float* reference,
+                                  int nx, int ny)
+{
+  Plane a, b;
+  extractSlice(image, 1, nx, ny, 0, a);
+  extractSlice(reference, 1, nx, ny, 0, b);
+  return shift(a, b);
+}
+
+int referenceSlice(vtkImageData* series)
+{
+  int dims[3];
+  series->GetDimensions(dims);
+  vtkDataArray* angles = series->GetFieldData()->GetArray("tilt_angles");
+  if (!angles || angles->GetNumberOfTuples() != dims[2]) {
+    return dims[2] / 2;
+  }
+  int reference = 0;
+  for (int i = 1; i < dims[2]; ++i) {
+    if (std::abs(angles->GetTuple1(i)) <
+        std::abs(angles->GetTuple1(reference))) {
+      reference = i;
+    }
+  }
+  return reference;
+}
+
+std::vector<vtkVector2d> alignTiltSeries(vtkImageData* series, int reference,
+                                         const Progress& progress)
+{
+  int dims[3];
+  series->GetDimensions(dims);
+  std::vector<vtkVector2d> shifts(dims[2], vtkVector2d(0.0, 0.0));
+  vtkDataArray* scalars = series->GetPointData()->GetScalars();
+  if (!scalars || dims[2] < 2) {
+    return shifts;
+  }
+  if (reference < 0 || reference >= dims[2]) {
+    reference = referenceSlice(series);
+  }
+
+  // Each thread holds two slices, and their tapered copies and pyramids,
+  // keep that within a quarter of the memory.
+  vtksys::SystemInformation info;
+  info.RunMemoryCheck();
+  double perThread = (2.0 + 2.0 * 1.4) * dims[0] * dims[1] * sizeof(float);
+  double available = info.GetTotalPhysicalMemory() / 4.0 * 1024 * 1024;
+  int threads = std::max(
+    1, std::min(Parallel::threadCount(),
+                static_cast<int>(available / std::max(perThread, 1.0))));
+
+  // The shift of each slice onto the previous one. These are independent of
+  // one another, so they are all computed at once, and accumulated below.
+  std::vector<vtkVector2d> steps(dims[2] - 1);
+  std::atomic<bool> stopped{ false };
+  std::mutex mutex;
+  int done = 0;
+  int components = scalars->GetNumberOfComponents();
+  void* pointer = scalars->GetVoidPointer(0);
+  auto correlate = [&](int begin, int end) {
+    Plane previous, current;
+    for (int i = begin; i < end && !stopped; ++i) {
+      switch (scalars->GetDataType()) {
+        vtkTemplateMacro(extractSlice(static_cast<VTK_TT*>(pointer),
+                                      components, dims[0], dims[1], i,
+                                      previous);
+                         extractSlice(static_cast<VTK_TT*>(pointer),
+                                      components, dims[0], dims[1], i + 1,
+                                      current));
+      }
+      steps[i] = shift(current, previous);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (progress && !progress(++done)) {
+        stopped = true;
+      }
+    }
+  };
+  Parallel::forRange(0, dims[2] - 1, 1, correlate, threads);
+  if (stopped) {
+    return std::vector<vtkVector2d>();
+  }
+
+  for (int i = reference; i + 1 < dims[2]; ++i) {
+    shifts[i + 1] = shifts[i] + steps[i];
+  }
+  for (int i = reference; i > 0; --i) {
+    shifts[i - 1] = shifts[i] - steps[i - 1];
+  }
+  return shifts;
+}
+}
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizImageAlignment_h
+#define tomvizImageAlignment_h
+
+#include <vtkVector.h>
+
+#include <functional>
+#include <vector>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// Cross-correlation alignment of the images of a tilt series, shared by the
+/// automatic alignment and the manual alignment widget. Images are tapered
+/// to zero at their edges and band-pass filtered as in the Python operator
+/// this replaces. Large images are correlated on a pyramid: the FFT finds
+/// the shift on an image of at most coarsestSize pixels across, and each
+/// finer level refines it by a local search. Shifts have subpixel precision
+/// from a parabola fitted through the correlation peak, and are measured
+/// again on the image moved by them to undo the pull of the taper.
+namespace ImageAlignment {
+
+/// The largest image size the FFT correlation runs on.
+const int coarsestSize = 512;
+
+/// Returns the shift that moves image onto reference, both images are nx by
+/// ny pixels, stored row by row. Applying the shift as a TranslateAlign
+/// offset makes the image match the reference.
+vtkVector2d crossCorrelationShift(const float* image, const float* reference,
+                                  int nx, int ny);
+
+/// Called from worker threads with the number of image pairs correlated so
+/// far, out of the number of slices less one. Returning false stops the
+/// alignment.
+typedef std::function<bool(int)> Progress;
+
+/// Returns the shift of each slice of the tilt series that aligns it to its
+/// neighbor towards the reference slice, accumulated so all slices line up
+/// with the reference. The correlations of all neighboring pairs run in
+/// parallel. A negative reference picks the slice closest to zero tilt, or
+/// the middle one. Returns an empty vector when stopped by progress.
+std::vector<vtkVector2d> alignTiltSeries(vtkImageData* series,
+                                         int reference = -1,
+                                         const Progress& progress = Progress());
+
+/// Fits a parabola through three equally spaced samples around a peak and
+/// returns the offset of its apex from the middle one, in samples, within
+/// half a sample. Returns zero when the samples don't curve downwards.
+double apex(double before, double at, double after);
+
+/// Returns the slice with the tilt angle closest to zero, or the middle
+/// slice when the data has no tilt angles.
+int referenceSlice(vtkImageData* series);
+}
+}
+
+#endif
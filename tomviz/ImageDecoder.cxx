@@ -0,0 +1,492 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ImageDecoder.h"
+
+#include "VolumeBufferPool.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSysInfo>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+extern "C" {
+#include "vtk_tiff.h"
+}
+
+namespace tomviz {
+
+const char* ImageDecoder::tiffMimeType = "image/tiff";
+const char* ImageDecoder::rawMimeType = "application/x-tomviz-raw";
+
+namespace {
+
+const char rawMagic[] = "TVZR";
+
+vtkSmartPointer<vtkImageData> fail(QString* errorMessage,
+                                   const QString& message)
+{
+  if (errorMessage) {
+    *errorMessage = message;
+  }
+  return nullptr;
+}
+
+vtkSmartPointer<vtkImageData> newImage(int width, int height, int scalarType,
+                                       int components)
+{
+  vtkSmartPointer<vtkDataArray> scalars;
+  scalars.TakeReference(VolumeBufferPool::newArray(
+    scalarType, components, static_cast<vtkIdType>(width) * height));
+  scalars->SetName("ImageScalars");
+  auto image = vtkSmartPointer<vtkImageData>::New();
+  image->SetExtent(0, width - 1, 0, height - 1, 0, 0);
+  image->GetPointData()->SetScalars(scalars);
+  return image;
+}
+
+// Converts values between little endian and the byte order of the host.
+template <typename T>
+void swapLittleEndian(void* data, vtkIdType count)
+{
+  if (QSysInfo::ByteOrder == QSysInfo::LittleEndian) {
+    return;
+  }
+  auto values = static_cast<uchar*>(data);
+  for (vtkIdType i = 0; i < count; ++i) {
+    T value = qFromLittleEndian<T>(values + i * sizeof(T));
+    memcpy(values + i * sizeof(T), &value, sizeof(T));
+  }
+}
+
+// The bytes of a TIFF file, for libtiff to read from memory as it would
+// from disk.
+struct MemoryFile
+{
+  const char* data;
+  toff_t size;
+  toff_t offset;
+};
+
+tsize_t readMemory(thandle_t handle, tdata_t buffer, tsize_t size)
+{
+  auto file = static_cast<MemoryFile*>(handle);
+  toff_t offset = std::min(file->offset, file->size);
+  toff_t count = std::min(static_cast<toff_t>(size), file->size - offset);
+  memcpy(buffer, file->data + offset, static_cast<size_t>(count));
+  file->offset = offset + count;
+  return static_cast<tsize_t>(count);
+}
+
+tsize_t writeMemory(thandle_t, tdata_t, tsize_t)
+{
+  return -1;
+}
+
+toff_t seekMemory(thandle_t handle, toff_t offset, int whence)
+{
+  auto file = static_cast<MemoryFile*>(handle);
+  switch (whence) {
+    case SEEK_SET:
+      file->offset = offset;
+      break;
+    case SEEK_CUR:
+      file->offset += offset;
+      break;
+    case SEEK_END:
+      file->offset = file->size + offset;
+      break;
+  }
+  return file->offset;
+}
+
+int closeMemory(thandle_t)
+{
+  return 0;
+}
+
+toff_t sizeMemory(thandle_t handle)
+{
+  return static_cast<MemoryFile*>(handle)->size;
+}
+
+// The bytes are mapped as they are, so strips are decoded straight from
+// them.
+int mapMemory(thandle_t handle, tdata_t* base, toff_t* size)
+{
+  auto file = static_cast<MemoryFile*>(handle);
+  *base = const_cast<char*>(file->data);
+  *size = file->size;
+  return 1;
+}
+
+void unmapMemory(thandle_t, tdata_t, toff_t)
+{
+}
+
+// Reads single sample images as they are, and anything else as 8 bit RGBA.
+vtkSmartPointer<vtkImageData> readTiff(TIFF* tiff, QString* errorMessage)
+{
+  uint32 width = 0;
+  uint32 height = 0;
+  if (!TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width) ||
+      !TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height) || width == 0 ||
+      height == 0) {
+    return fail(errorMessage, "The TIFF image has no size.");
+  }
+  uint16 samples = 1;
+  uint16 bits = 8;
+  uint16 format = SAMPLEFORMAT_UINT;
+  uint16 photometric = PHOTOMETRIC_MINISBLACK;
+  uint16 orientation = ORIENTATION_TOPLEFT;
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samples);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bits);
+  TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &format);
+  TIFFGetField(tiff, TIFFTAG_PHOTOMETRIC, &photometric);
+  TIFFGetField(tiff, TIFFTAG_ORIENTATION, &orientation);
+
+  int scalarType = -1;
+  if (samples == 1 && photometric == PHOTOMETRIC_MINISBLACK) {
+    bool isSigned = format == SAMPLEFORMAT_INT;
+    if (bits == 8 && format != SAMPLEFORMAT_IEEEFP) {
+      scalarType = isSigned ? VTK_SIGNED_CHAR : VTK_UNSIGNED_CHAR;
+    } else if (bits == 16 && format != SAMPLEFORMAT_IEEEFP) {
+      scalarType = isSigned ? VTK_SHORT : VTK_UNSIGNED_SHORT;
+    } else if (bits == 32) {
+      scalarType = format == SAMPLEFORMAT_IEEEFP
+                     ? VTK_FLOAT
+                     : (isSigned ? VTK_INT : VTK_UNSIGNED_INT);
+    }
+  }
+
+  if (scalarType < 0) {
+    std::vector<uint32> raster(static_cast<size_t>(width) * height);
+    if (!TIFFReadRGBAImageOriented(tiff, width, height, &raster[0],
+                                   ORIENTATION_BOTLEFT, 0)) {
+      return fail(errorMessage, "The TIFF image cannot be decoded.");
+    }
+    auto image = newImage(width, height, VTK_UNSIGNED_CHAR, 4);
+    auto rgba = static_cast<unsigned char*>(image->GetScalarPointer());
+    for (size_t i = 0; i < raster.size(); ++i) {
+      rgba[4 * i] = TIFFGetR(raster[i]);
+      rgba[4 * i + 1] = TIFFGetG(raster[i]);
+      rgba[4 * i + 2] = TIFFGetB(raster[i]);
+      rgba[4 * i + 3] = TIFFGetA(raster[i]);
+    }
+    return image;
+  }
+
+  // The first row of the file is at the top unless it says otherwise, and
+  // y goes up in the image.
+  const bool flip = orientation != ORIENTATION_BOTLEFT;
+  const size_t rowBytes = static_cast<size_t>(width) * bits / 8;
+  auto image = newImage(width, height, scalarType, 1);
+  auto out = static_cast<char*>(image->GetScalarPointer());
+  auto copyRow = [&](uint32 fileRow, uint32 x, const char* from,
+                     size_t bytes) {
+    uint32 row = flip ? height - fileRow - 1 : fileRow;
+    memcpy(out + row * rowBytes + x * bits / 8, from, bytes);
+  };
+
+  std::vector<char> block;
+  if (TIFFIsTiled(tiff)) {
+    uint32 tileWidth = 0;
+    uint32 tileHeight = 0;
+    TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &tileWidth);
+    TIFFGetField(tiff, TIFFTAG_TILELENGTH, &tileHeight);
+    if (tileWidth == 0 || tileHeight == 0) {
+      return fail(errorMessage, "The TIFF image has empty tiles.");
+    }
+    block.resize(TIFFTileSize(tiff));
+    const size_t tileRowBytes = static_cast<size_t>(tileWidth) * bits / 8;
+    for (uint32 y = 0; y < height; y += tileHeight) {
+      for (uint32 x = 0; x < width; x += tileWidth) {
+        if (TIFFReadEncodedTile(tiff, TIFFComputeTile(tiff, x, y, 0, 0),
+                                &block[0], block.size()) < 0) {
+          return fail(errorMessage, "A tile of the TIFF image is corrupt.");
+        }
+        // Tiles at the edges are padded.
+        size_t bytes = static_cast<size_t>(std::min(tileWidth, width - x)) *
+                       bits / 8;
+        for (uint32 i = 0; i < tileHeight && y + i < height; ++i) {
+          copyRow(y + i, x, &block[i * tileRowBytes], bytes);
+        }
+      }
+    }
+  } else {
+    uint32 rowsPerStrip = height;
+    TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+    rowsPerStrip = std::max<uint32>(std::min(rowsPerStrip, height), 1);
+    block.resize(TIFFStripSize(tiff));
+    for (uint32 y = 0; y < height; y += rowsPerStrip) {
+      if (TIFFReadEncodedStrip(tiff, TIFFComputeStrip(tiff, y, 0), &block[0],
+                               block.size()) < 0) {
+        return fail(errorMessage, "A strip of the TIFF image is corrupt.");
+      }
+      for (uint32 i = 0; i < rowsPerStrip && y + i < height; ++i) {
+        copyRow(y + i, 0, &block[i * rowBytes], rowBytes);
+      }
+    }
+  }
+  return image;
+}
+}
+
+class ImageDecoder::DecodeTask : public QRunnable
+{
+public:
+  DecodeTask(ImageDecoder* decoder, int id, const QString& mimeType,
+             const QByteArray& bytes)
+    : m_decoder(decoder), m_id(id), m_mimeType(mimeType), m_bytes(bytes)
+  {
+  }
+
+  void run() override
+  {
+    Decoded decoded;
+    decoded.id = m_id;
+    decoded.image = decode(m_mimeType, m_bytes, &decoded.errorMessage);
+    {
+      QMutexLocker locker(&m_decoder->m_mutex);
+      m_decoder->m_decoded.append(decoded);
+    }
+    // The decoder waits for its tasks in its destructor, so it is alive.
+    QMetaObject::invokeMethod(m_decoder, "deliver", Qt::QueuedConnection);
+  }
+
+private:
+  ImageDecoder* m_decoder;
+  int m_id;
+  QString m_mimeType;
+  QByteArray m_bytes;
+};
+
+class ImageDecoder::ArchiveTask : public QRunnable
+{
+public:
+  ArchiveTask(const QString& directory, const QString& fileName,
+              const QByteArray& bytes)
+    : m_directory(directory), m_fileName(fileName), m_bytes(bytes)
+  {
+  }
+
+  void run() override
+  {
+    QDir dir(m_directory);
+    if (!dir.exists()) {
+      dir.mkpath(dir.path());
+    }
+    QFile file(dir.filePath(m_fileName));
+    if (!file.open(QIODevice::WriteOnly) ||
+        file.write(m_bytes) != m_bytes.size()) {
+      qWarning() << "Failed to archive" << file.fileName() << ":"
+                 << file.errorString();
+    }
+  }
+
+private:
+  QString m_directory;
+  QString m_fileName;
+  QByteArray m_bytes;
+};
+
+ImageDecoder::ImageDecoder(QObject* parentObject) : QObject(parentObject)
+{
+  m_decodePool.setMaxThreadCount(1);
+  m_archivePool.setMaxThreadCount(1);
+}
+
+ImageDecoder::~ImageDecoder()
+{
+  waitForDone();
+}
+
+bool ImageDecoder::canDecode(const QString& mimeType)
+{
+  return mimeType == tiffMimeType || mimeType == rawMimeType;
+}
+
+QString ImageDecoder::fileExtension(const QString& mimeType)
+{
+  if (mimeType == tiffMimeType) {
+    return ".tiff";
+  } else if (mimeType == rawMimeType) {
+    return ".raw";
+  }
+  return QString();
+}
+
+vtkSmartPointer<vtkImageData> ImageDecoder::decode(const QString& mimeType,
+                                                   const QByteArray& bytes,
+                                                   QString* errorMessage)
+{
+  if (mimeType == tiffMimeType) {
+    return decodeTiff(bytes, errorMessage);
+  } else if (mimeType == rawMimeType) {
+    return decodeRaw(bytes, errorMessage);
+  }
+  return fail(errorMessage, "Unsupported image type: " + mimeType);
+}
+
+vtkSmartPointer<vtkImageData> ImageDecoder::decodeTiff(const QByteArray& bytes,
+                                                       QString* errorMessage)
+{
+  MemoryFile file = { bytes.constData(), static_cast<toff_t>(bytes.size()),
+                      0 };
+  TIFF* tiff = TIFFClientOpen("memory", "r", &file, readMemory, writeMemory,
+                              seekMemory, closeMemory, sizeMemory, mapMemory,
+                              unmapMemory);
+  if (!tiff) {
+    return fail(errorMessage, "Not a TIFF image.");
+  }
+  auto image = readTiff(tiff, errorMessage);
+  TIFFClose(tiff);
+  return image;
+}
+
+vtkSmartPointer<vtkImageData> ImageDecoder::decodeRaw(const QByteArray& bytes,
+                                                      QString* errorMessage)
+{
+  if (bytes.size() < rawHeaderSize || !bytes.startsWith(rawMagic)) {
+    return fail(errorMessage, "Not a raw image.");
+  }
+  auto header = reinterpret_cast<const uchar*>(bytes.constData());
+  quint32 width = qFromLittleEndian<quint32>(header + 4);
+  quint32 height = qFromLittleEndian<quint32>(header + 8);
+  quint32 type = qFromLittleEndian<quint32>(header + 12);
+
+  int scalarType;
+  int valueSize;
+  switch (static_cast<RawType>(type)) {
+    case RawType::UInt16:
+      scalarType = VTK_UNSIGNED_SHORT;
+      valueSize = 2;
+      break;
+    case RawType::Float32:
+      scalarType = VTK_FLOAT;
+      valueSize = 4;
+      break;
+    default:
+      return fail(errorMessage,
+                  QString("Unknown raw value type %1.").arg(type));
+  }
+  qint64 count = static_cast<qint64>(width) * height;
+  if (width == 0 || height == 0 || width > VTK_INT_MAX ||
+      height > VTK_INT_MAX ||
+      (bytes.size() - rawHeaderSize) / valueSize < count) {
+    return fail(errorMessage, "The raw image is truncated.");
+  }
+
+  auto image = newImage(width, height, scalarType, 1);
+  void* values = image->GetScalarPointer();
+  memcpy(values, header + rawHeaderSize,
+         static_cast<size_t>(count * valueSize));
+  if (scalarType == VTK_FLOAT) {
+    swapLittleEndian<quint32>(values, count);
+  } else {
+    swapLittleEndian<quint16>(values, count);
+  }
+  return image;
+}
+
+QByteArray ImageDecoder::encodeRaw(vtkImageData* image)
+{
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  if (!scalars || scalars->GetNumberOfComponents() != 1) {
+    return QByteArray();
+  }
+  RawType type;
+  switch (scalars->GetDataType()) {
+    case VTK_UNSIGNED_SHORT:
+      type = RawType::UInt16;
+      break;
+    case VTK_FLOAT:
+      type = RawType::Float32;
+      break;
+    default:
+      return QByteArray();
+  }
+
+  int dims[3];
+  image->GetDimensions(dims);
+  qint64 count = static_cast<qint64>(dims[0]) * dims[1];
+  qint64 bytes = count * scalars->GetDataTypeSize();
+  QByteArray raw(static_cast<int>(rawHeaderSize + bytes), Qt::Uninitialized);
+  auto header = reinterpret_cast<uchar*>(raw.data());
+  memcpy(header, rawMagic, 4);
+  qToLittleEndian<quint32>(dims[0], header + 4);
+  qToLittleEndian<quint32>(dims[1], header + 8);
+  qToLittleEndian<quint32>(static_cast<quint32>(type), header + 12);
+  uchar* values = header + rawHeaderSize;
+  memcpy(values, scalars->GetVoidPointer(0), static_cast<size_t>(bytes));
+  if (type == RawType::Float32) {
+    swapLittleEndian<quint32>(values, count);
+  } else {
+    swapLittleEndian<quint16>(values, count);
+  }
+  return raw;
+}
+
+void ImageDecoder::setArchiveDirectory(const QString& directory)
+{
+  m_archiveDirectory = directory;
+}
+
+int ImageDecoder::submit(const QString& mimeType, const QByteArray& bytes,
+                         const QString& name)
+{
+  int id = m_nextId++;
+  m_decodePool.start(new DecodeTask(this, id, mimeType, bytes));
+  if (!m_archiveDirectory.isEmpty()) {
+    QString fileName = name.isEmpty() ? QString("image_%1").arg(id) : name;
+    m_archivePool.start(new ArchiveTask(
+      m_archiveDirectory, fileName + fileExtension(mimeType), bytes));
+  }
+  return id;
+}
+
+void ImageDecoder::waitForDone()
+{
+  m_decodePool.waitForDone();
+  m_archivePool.waitForDone();
+}
+
+void ImageDecoder::deliver()
+{
+  QList<Decoded> decoded;
+  {
+    QMutexLocker locker(&m_mutex);
+    decoded.swap(m_decoded);
+  }
+  foreach (const Decoded& result, decoded) {
+    if (result.image) {
+      emit imageReady(result.id, result.image);
+    } else {
+      emit failed(result.id, result.errorMessage);
+    }
+  }
+}
+}
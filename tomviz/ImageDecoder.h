@@ -0,0 +1,126 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizImageDecoder_h
+#define tomvizImageDecoder_h
+
+#include <QObject>
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// Decodes the images sent by an acquisition server from the bytes received,
+/// without writing them to disk. Images are decoded on a background thread
+/// and handed back on the UI thread in the order they were submitted. The
+/// bytes can also be archived to disk on a thread of their own, which the
+/// display never waits for.
+///
+/// Besides TIFF, a raw format is understood: a 16 byte header of the magic
+/// "TVZR", the width, the height and the type of the values as little endian
+/// 32 bit integers, followed by the values, little endian, x fastest and
+/// starting from y = 0.
+class ImageDecoder : public QObject
+{
+  Q_OBJECT
+
+public:
+  /// The types of the values of raw images.
+  enum class RawType
+  {
+    UInt16 = 1,
+    Float32 = 2
+  };
+
+  static const char* tiffMimeType;
+  static const char* rawMimeType;
+  static const int rawHeaderSize = 16;
+
+  ImageDecoder(QObject* parent = nullptr);
+  ~ImageDecoder() override;
+
+  /// Whether images of mimeType can be decoded.
+  static bool canDecode(const QString& mimeType);
+
+  /// The extension archived files of mimeType are given, with the dot.
+  static QString fileExtension(const QString& mimeType);
+
+  /// Decodes an image of mimeType from bytes. Returns nullptr and sets
+  /// errorMessage, when given, if it cannot be decoded.
+  static vtkSmartPointer<vtkImageData> decode(const QString& mimeType,
+                                              const QByteArray& bytes,
+                                              QString* errorMessage = nullptr);
+  static vtkSmartPointer<vtkImageData> decodeTiff(
+    const QByteArray& bytes, QString* errorMessage = nullptr);
+  static vtkSmartPointer<vtkImageData> decodeRaw(
+    const QByteArray& bytes, QString* errorMessage = nullptr);
+
+  /// Encodes the first slice of a float or unsigned short image in the raw
+  /// format, or returns an empty array for other types.
+  static QByteArray encodeRaw(vtkImageData* image);
+
+  /// Files are archived into directory, or not at all if it is empty, the
+  /// default.
+  void setArchiveDirectory(const QString& directory);
+  QString archiveDirectory() const { return m_archiveDirectory; }
+
+  /// Decodes bytes in the background, imageReady() or failed() is emitted
+  /// with the number returned. When archiving, the bytes are also written to
+  /// name, with the extension of mimeType, in the archive directory.
+  int submit(const QString& mimeType, const QByteArray& bytes,
+             const QString& name = QString());
+
+  /// Waits until everything submitted has been decoded and archived.
+  void waitForDone();
+
+signals:
+  void imageReady(int id, vtkSmartPointer<vtkImageData> image);
+  void failed(int id, const QString& errorMessage);
+
+private slots:
+  void deliver();
+
+private:
+  class DecodeTask;
+  class ArchiveTask;
+
+  struct Decoded
+  {
+    int id;
+    vtkSmartPointer<vtkImageData> image;
+    QString errorMessage;
+  };
+
+  int m_nextId = 0;
+  QString m_archiveDirectory;
+  // One thread each, so images are decoded, and files written, in order.
+  QThreadPool m_decodePool;
+  QThreadPool m_archivePool;
+
+  // Images handed over by the decode tasks.
+  QMutex m_mutex;
+  QList<Decoded> m_decoded;
+};
+}
+
+#endif
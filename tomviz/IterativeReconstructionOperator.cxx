@@ -0,0 +1,334 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+
+#include "IterativeReconstructionOperator.h"
+
+#include "DataSource.h"
+#include "EditOperatorWidget.h"
+#include "Parallel.h"
+#include "TomographyTiltSeries.h"
+
+#include "pqSMProxy.h"
+#include "vtkDataArray.h"
+#include "vtkImageData.h"
+#include "vtkNew.h"
+#include "vtkPointData.h"
+#include "vtkSMProxyManager.h"
+#include "vtkSMSessionProxyManager.h"
+#include "vtkSMSourceProxy.h"
+#include "vtkTrivialProducer.h"
+
+#include <QComboBox>
+#include <QDebug>
+#include <QDoubleSpinBox>
+#include <QFormLayout>
+#include <QPointer>
+#include <QSpinBox>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using tomviz::TomographyReconstruction::IterativeMethod;
+using tomviz::TomographyReconstruction::IterativeOptions;
+
+// Serialized names and display labels of the methods, in enum order.
+const char* methodNames[] = { "art", "landweber", "cimmino",
+                              "component-averaging" };
+const char* methodLabels[] = { "ART (Kaczmarz)", "SIRT (Landweber)",
+                               "SIRT (Cimmino)", "SIRT (Component Averaging)" };
+const int numberOfMethods = sizeof(methodNames) / sizeof(methodNames[0]);
+
+class IterativeReconstructionWidget : public tomviz::EditOperatorWidget
+{
+  Q_OBJECT
+
+public:
+  IterativeReconstructionWidget(tomviz::IterativeReconstructionOperator* op,
+                                QWidget* p)
+    : tomviz::EditOperatorWidget(p), m_operator(op)
+  {
+    const IterativeOptions& options = op->options();
+    m_method = new QComboBox(this);
+    for (int i = 0; i < numberOfMethods; ++i) {
+      m_method->addItem(methodLabels[i]);
+    }
+    m_method->setCurrentIndex(static_cast<int>(options.method));
+
+    m_iterations = new QSpinBox(this);
+    m_iterations->setRange(1, 10000);
+    m_iterations->setValue(options.iterations);
+
+    m_relaxation = new QDoubleSpinBox(this);
+    m_relaxation->setRange(0.001, 2.0);
+    m_relaxation->setDecimals(3);
+    m_relaxation->setSingleStep(0.05);
+    m_relaxation->setValue(options.relaxation);
+
+    m_tvSteps = new QSpinBox(this);
+    m_tvSteps->setRange(0, 1000);
+    m_tvSteps->setSpecialValueText("Off");
+    m_tvSteps->setValue(options.tvSteps);
+
+    m_tvWeight = new QDoubleSpinBox(this);
+    m_tvWeight->setRange(0.0, 10.0);
+    m_tvWeight->setDecimals(3);
+    m_tvWeight->setSingleStep(0.05);
+    m_tvWeight->setValue(options.tvWeight);
+
+    QFormLayout* layout = new QFormLayout;
+    layout->addRow("Method", m_method);
+    layout->addRow("Iterations", m_iterations);
+    layout->addRow("Relaxation", m_relaxation);
+    layout->addRow("TV minimization steps", m_tvSteps);
+    layout->addRow("TV step weight", m_tvWeight);
+    setLayout(layout);
+  }
+
+  void applyChangesToOperator() override
+  {
+    if (m_operator) {
+      IterativeOptions options = m_operator->options();
+      options.method = static_cast<IterativeMethod>(m_method->currentIndex());
+      options.iterations = m_iterations->value();
+      options.relaxation = m_relaxation->value();
+      options.tvSteps = m_tvSteps->value();
+      options.tvWeight = m_tvWeight->value();
+      m_operator->setOptions(options);
+    }
+  }
+
+private:
+  QPointer<tomviz::IterativeReconstructionOperator> m_operator;
+  QComboBox* m_method;
+  QSpinBox* m_iterations;
+  QDoubleSpinBox* m_relaxation;
+  QSpinBox* m_tvSteps;
+  QDoubleSpinBox* m_tvWeight;
+};
+}
+
+#include "IterativeReconstructionOperator.moc"
+
+namespace tomviz {
+IterativeReconstructionOperator::IterativeReconstructionOperator(
+  DataSource* source, QObject* p)
+  : Operator(p), m_dataSource(source)
+{
+  setSupportsCancel(true);
+  setTotalProgressSteps(m_options.iterations);
+  setNumberOfResults(1);
+  setHasChildDataSource(true);
+  connect(this, &IterativeReconstructionOperator::newChildDataSource, this,
+          &IterativeReconstructionOperator::createNewChildDataSource);
+  connect(this, &IterativeReconstructionOperator::newOperatorResult, this,
+          &IterativeReconstructionOperator::setOperatorResult);
+}
+
+QIcon IterativeReconstructionOperator::icon() const
+{
+  return QIcon(":/pqWidgets/Icons/pqExtractGrid24.png");
+}
+
+Operator* IterativeReconstructionOperator::clone() const
+{
+  auto other = new IterativeReconstructionOperator(m_dataSource);
+  other->setOptions(m_options);
+  return other;
+}
+
+bool IterativeReconstructionOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("method").set_value(
+    methodNames[static_cast<int>(m_options.method)]);
+  ns.append_attribute("iterations").set_value(m_options.iterations);
+  ns.append_attribute("relaxation").set_value(m_options.relaxation);
+  ns.append_attribute("tv_steps").set_value(m_options.tvSteps);
+  ns.append_attribute("tv_weight").set_value(m_options.tvWeight);
+  return true;
+}
+
+bool IterativeReconstructionOperator::deserialize(const pugi::xml_node& ns)
+{
+  IterativeOptions options;
+  const char* name = ns.attribute("method").value();
+  for (int i = 0; i < numberOfMethods; ++i) {
+    if (strcmp(name, methodNames[i]) == 0) {
+      options.method = static_cast<IterativeMethod>(i);
+    }
+  }
+  options.iterations = ns.attribute("iterations").as_int(options.iterations);
+  options.relaxation =
+    ns.attribute("relaxation").as_double(options.relaxation);
+  options.tvSteps = ns.attribute("tv_steps").as_int(options.tvSteps);
+  options.tvWeight = ns.attribute("tv_weight").as_double(options.tvWeight);
+  setOptions(options);
+  return true;
+}
+
+EditOperatorWidget* IterativeReconstructionOperator::getEditorContents(
+  QWidget* p)
+{
+  return new IterativeReconstructionWidget(this, p);
+}
+
+void IterativeReconstructionOperator::setOptions(
+  const TomographyReconstruction::IterativeOptions& options)
+{
+  m_options = options;
+  m_options.iterations = std::max(m_options.iterations, 1);
+  setTotalProgressSteps(m_options.iterations);
+  emit transformModified();
+}
+
+bool IterativeReconstructionOperator::applyTransform(vtkDataObject* dataObject)
+{
+  vtkImageData* imageData = vtkImageData::SafeDownCast(dataObject);
+  if (!imageData) {
+    return false;
+  }
+  int dataExtent[6];
+  imageData->GetExtent(dataExtent);
+  int numXSlices = dataExtent[1] - dataExtent[0] + 1;
+  int numYSlices = dataExtent[3] - dataExtent[2] + 1;
+  int numZSlices = dataExtent[5] - dataExtent[4] + 1;
+  QVector<double> tiltAngles = m_dataSource->getTiltAngles();
+  if (tiltAngles.size() < numZSlices) {
+    qCritical() << "Not enough tilt angles for the tilt series";
+    return false;
+  }
+
+  // Copy the options so edits made while running apply to the next run.
+  const TomographyReconstruction::IterativeOptions options = m_options;
+  setTotalProgressSteps(options.iterations);
+  setProgressStep(0);
+
+  TomographyTiltSeries::SinogramProvider sinograms(
+    imageData, TomographyTiltSeries::SinogramProvider::SliceMajor);
+  TomographyReconstruction::RayProjector projector(tiltAngles.data(),
+                                                   numZSlices, numYSlices);
+
+  // The slices being iterated on, each stored contiguously.
+  const size_t sliceSize = static_cast<size_t>(numYSlices) * numYSlices;
+  std::vector<float> slices(sliceSize * numXSlices, 0.0f);
+
+  const size_t sinogramSize = static_cast<size_t>(numYSlices) * numZSlices;
+  double sinogramNorm = 0.0;
+  for (int i = 0; i < numXSlices; ++i) {
+    const float* sinogram = sinograms.sinogram(i).data;
+    for (size_t j = 0; j < sinogramSize; ++j) {
+      sinogramNorm += sinogram[j] * sinogram[j];
+    }
+  }
+  sinogramNorm = std::sqrt(sinogramNorm);
+
+  // Every slice takes the same iteration before the next begins, so the
+  // residual reported is that of the whole volume.
+  for (int iteration = 0; iteration < options.iterations; ++iteration) {
+    std::mutex residualMutex;
+    double residual = 0.0;
+    Parallel::forRange(0, numXSlices, 1, [&](int begin, int end) {
+      TomographyReconstruction::IterativeSolver solver(projector, options);
+      double sum = 0.0;
+      for (int i = begin; i < end && !isCanceled(); ++i) {
+        sum += solver.iterate(sinograms.sinogram(i).data,
+                              &slices[sliceSize * i], iteration);
+      }
+      std::lock_guard<std::mutex> lock(residualMutex);
+      residual += sum;
+    });
+    if (isCanceled()) {
+      return false;
+    }
+    double relativeResidual =
+      sinogramNorm > 0.0 ? std::sqrt(residual) / sinogramNorm : 0.0;
+    setProgressMessage(QString("Iteration %1 of %2, relative residual %3")
+                         .arg(iteration + 1)
+                         .arg(options.iterations)
+                         .arg(relativeResidual, 0, 'g', 4));
+    setProgressStep(iteration + 1);
+  }
+
+  vtkNew<vtkImageData> reconstructionImage;
+  int extent2[6] = { dataExtent[0], dataExtent[1], dataExtent[2],
+                     dataExtent[3], dataExtent[2], dataExtent[3] };
+  reconstructionImage->SetExtent(extent2);
+  reconstructionImage->AllocateScalars(VTK_FLOAT, 1);
+  vtkDataArray* darray = reconstructionImage->GetPointData()->GetScalars();
+  darray->SetName("scalars");
+  float* reconstruction = static_cast<float*>(darray->GetVoidPointer(0));
+
+  // Same orientation as the back projection reconstruction.
+  Parallel::forRange(0, numYSlices, 1, [&](int begin, int end) {
+    for (int j = begin; j < end; ++j) {
+      for (int k = 0; k < numYSlices; ++k) {
+        float* row = reconstruction +
+                     static_cast<size_t>(j) * numYSlices * numXSlices +
+                     static_cast<size_t>(k) * numXSlices;
+        for (int i = 0; i < numXSlices; ++i) {
+          row[i] = slices[sliceSize * i + k * numYSlices + j];
+        }
+      }
+    }
+  });
+
+  emit newOperatorResult(reconstructionImage.Get());
+  emit newChildDataSource("Reconstruction", reconstructionImage.Get());
+  return true;
+}
+
+void IterativeReconstructionOperator::createNewChildDataSource(
+  const QString& label, vtkSmartPointer<vtkDataObject> childData)
+{
+  vtkSMProxyManager* proxyManager = vtkSMProxyManager::GetProxyManager();
+  vtkSMSessionProxyManager* sessionProxyManager =
+    proxyManager->GetActiveSessionProxyManager();
+
+  pqSMProxy producerProxy;
+  producerProxy.TakeReference(
+    sessionProxyManager->NewProxy("sources", "TrivialProducer"));
+  producerProxy->UpdateVTKObjects();
+
+  vtkTrivialProducer* producer =
+    vtkTrivialProducer::SafeDownCast(producerProxy->GetClientSideObject());
+  if (!producer) {
+    qWarning() << "Could not get TrivialProducer from proxy";
+    return;
+  }
+
+  producer->SetOutput(childData);
+
+  DataSource* childDS = new DataSource(
+    vtkSMSourceProxy::SafeDownCast(producerProxy), DataSource::Volume, this,
+    DataSource::PersistenceState::Transient);
+
+  childDS->setFilename(label.toLatin1().data());
+  setChildDataSource(childDS);
+}
+
+void IterativeReconstructionOperator::setOperatorResult(
+  vtkSmartPointer<vtkDataObject> result)
+{
+  bool resultWasSet = setResult(0, result);
+  if (!resultWasSet) {
+    qCritical() << "Could not set result 0";
+  }
+}
+}
@@ -0,0 +1,80 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizIterativeReconstructionOperator_h
+#define tomvizIterativeReconstructionOperator_h
+
+#include "Operator.h"
+
+#include "TomographyReconstruction.h"
+
+namespace tomviz {
+class DataSource;
+
+/// Reconstructs a tilt series with ART or one of the SIRT update rules,
+/// optionally with total variation minimization. Each iteration runs over
+/// every slice in parallel, and the residual of the iteration is reported in
+/// the progress message.
+class IterativeReconstructionOperator : public Operator
+{
+  Q_OBJECT
+
+public:
+  IterativeReconstructionOperator(DataSource* source,
+                                  QObject* parent = nullptr);
+
+  QString label() const override { return "Iterative Reconstruction"; }
+
+  QIcon icon() const override;
+
+  Operator* clone() const override;
+
+  bool writesArraysInPlace() const override { return false; }
+
+  bool serialize(pugi::xml_node& ns) const override;
+  bool deserialize(const pugi::xml_node& ns) override;
+
+  EditOperatorWidget* getEditorContents(QWidget* parent) override;
+  bool hasCustomUI() const override { return true; }
+
+  void setOptions(const TomographyReconstruction::IterativeOptions& options);
+  const TomographyReconstruction::IterativeOptions& options() const
+  {
+    return m_options;
+  }
+
+protected:
+  bool applyTransform(vtkDataObject* data) override;
+
+signals:
+  // Signal used to request the creation of a new data source. Needed to
+  // ensure the initialization of the new DataSource is performed on UI thread
+  void newChildDataSource(const QString&, vtkSmartPointer<vtkDataObject>);
+  void newOperatorResult(vtkSmartPointer<vtkDataObject>);
+
+private slots:
+  // Create a new child datasource and set it on this operator
+  void createNewChildDataSource(const QString& label,
+                                vtkSmartPointer<vtkDataObject>);
+  void setOperatorResult(vtkSmartPointer<vtkDataObject> result);
+
+private:
+  DataSource* m_dataSource;
+  TomographyReconstruction::IterativeOptions m_options;
+  Q_DISABLE_COPY(IterativeReconstructionOperator)
+};
+}
+
+#endif
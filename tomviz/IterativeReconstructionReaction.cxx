@@ -0,0 +1,60 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "IterativeReconstructionReaction.h"
+
+#include <QAction>
+#include <QMainWindow>
+
+#include "ActiveObjects.h"
+#include "DataSource.h"
+#include "EditOperatorDialog.h"
+#include "IterativeReconstructionOperator.h"
+
+namespace tomviz {
+
+IterativeReconstructionReaction::IterativeReconstructionReaction(
+  QAction* parentObject, QMainWindow* mw)
+  : pqReaction(parentObject), m_mainWindow(mw)
+{
+  connect(&ActiveObjects::instance(), SIGNAL(dataSourceChanged(DataSource*)),
+          SLOT(updateEnableState()));
+  updateEnableState();
+}
+
+void IterativeReconstructionReaction::updateEnableState()
+{
+  parentAction()->setEnabled(
+    ActiveObjects::instance().activeDataSource() != nullptr &&
+    ActiveObjects::instance().activeDataSource()->type() ==
+      DataSource::TiltSeries);
+}
+
+void IterativeReconstructionReaction::recon(DataSource* input)
+{
+  input = input ? input : ActiveObjects::instance().activeDataSource();
+  if (!input) {
+    return;
+  }
+
+  // Let the method and iterations be chosen before the operator is added.
+  Operator* op = new IterativeReconstructionOperator(input);
+  EditOperatorDialog* dialog =
+    new EditOperatorDialog(op, input, true, m_mainWindow);
+  dialog->setAttribute(Qt::WA_DeleteOnClose);
+  dialog->show();
+  connect(op, SIGNAL(destroyed()), dialog, SLOT(reject()));
+}
+}
@@ -104,4 +104,28 @@ JsonRpcReply* JsonRpcClient::sendRequest(const QJsonObject& requestBody)
   return rpcReply;
 }
 
+QNetworkReply* JsonRpcClient::sendStreamRequest(const QJsonArray& requests)
+{
+  QJsonArray batch;
+  foreach (const QJsonValue& value, requests) {
+    QJsonObject request = value.toObject();
+    request["jsonrpc"] = QLatin1String("2.0");
+    request["id"] = static_cast<int>(m_requestCounter++);
+    batch.append(request);
+  }
+
+  QString url = m_url;
+  while (url.endsWith('/')) {
+    url.chop(1);
+  }
+  QNetworkRequest networkRequest(QUrl(url + "/stream"));
+  QByteArray rpcRequest = QJsonDocument(batch).toJson(QJsonDocument::Compact);
+
+  networkRequest.setRawHeader("Content-Type", "application/json");
+  networkRequest.setRawHeader("Content-Length",
+                              QByteArray::number(rpcRequest.size()));
+
+  return m_networkAccessManager->post(networkRequest, rpcRequest);
+}
+
 }
@@ -17,6 +17,7 @@
 #ifndef TOMVIZ_JSONRPCCLIENT_H
 #define TOMVIZ_JSONRPCCLIENT_H
 
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonParseError>
 #include <QNetworkReply>
@@ -66,6 +67,11 @@ public slots:
   ///Send the Json request to the RPC server.
   JsonRpcReply* sendRequest(const QJsonObject& request);
 
+  /// Send a batch of Json requests to the stream endpoint of the server,
+  /// which answers each with a frame as it is made. The reply is returned
+  /// as is, to be read as the frames arrive.
+  QNetworkReply* sendStreamRequest(const QJsonArray& requests);
+
 signals:
   /// Emitted when a notification is received.
   void notificationReceived(QJsonObject message);
@@ -0,0 +1,725 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "LabelMap.h"
+
+#include "Parallel.h"
+#include "VolumeBufferPool.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+using tomviz::LabelMap::Canceled;
+using tomviz::LabelMap::Element;
+using tomviz::LabelMap::Object;
+
+// Voxels of the planes along z are handed to the threads in chunks of this
+// many.
+const int planeChunk = 4096;
+
+bool isCanceled(const Canceled& canceled)
+{
+  return canceled && canceled();
+}
+
+// Dilates length voxels along an axis by width voxels to either side, for
+// batch lines at once that are contiguous in memory, step apart along the
+// axis. Each voxel is set if the nearest set voxel before or after it is
+// close enough, so the cost does not depend on the width.
+void dilateLines(const unsigned char* in, unsigned char* out, int length,
+                 vtkIdType step, int batch, int width, std::vector<int>& last)
+{
+  last.assign(batch, -width - 1);
+  for (int i = 0; i < length; ++i) {
+    const unsigned char* a = in + i * step;
+    unsigned char* b = out + i * step;
+    for (int j = 0; j < batch; ++j) {
+      if (a[j]) {
+        last[j] = i;
+      }
+      b[j] = i - last[j] <= width;
+    }
+  }
+  last.assign(batch, length + width + 1);
+  for (int i = length - 1; i >= 0; --i) {
+    const unsigned char* a = in + i * step;
+    unsigned char* b = out + i * step;
+    for (int j = 0; j < batch; ++j) {
+      if (a[j]) {
+        last[j] = i;
+      }
+      b[j] |= last[j] - i <= width;
+    }
+  }
+}
+
+// Dilates in along one axis into out. Lines along y and z are dilated a
+// row or a chunk of a plane at a time, so memory is read contiguously.
+void dilateAxis(const unsigned char* in, unsigned char* out, const int dims[3],
+                int axis, int width)
+{
+  const vtkIdType nx = dims[0];
+  const vtkIdType plane = nx * dims[1];
+  if (axis == 0) {
+    tomviz::Parallel::forRange(0, dims[1] * dims[2], 64, [&](int begin,
+                                                             int end) {
+      std::vector<int> last;
+      for (int row = begin; row < end; ++row) {
+        dilateLines(in + row * nx, out + row * nx, dims[0], 1, 1, width,
+                    last);
+      }
+    });
+  } else if (axis == 1) {
+    tomviz::Parallel::forRange(0, dims[2], 1, [&](int begin, int end) {
+      std::vector<int> last;
+      for (int z = begin; z < end; ++z) {
+        dilateLines(in + z * plane, out + z * plane, dims[1], nx, dims[0],
+                    width, last);
+      }
+    });
+  } else {
+    int chunks = static_cast<int>((plane + planeChunk - 1) / planeChunk);
+    tomviz::Parallel::forRange(0, chunks, 1, [&](int begin, int end) {
+      std::vector<int> last;
+      for (int c = begin; c < end; ++c) {
+        vtkIdType first = static_cast<vtkIdType>(c) * planeChunk;
+        int batch = static_cast<int>(std::min<vtkIdType>(planeChunk,
+                                                         plane - first));
+        dilateLines(in + first, out + first, dims[2], plane, batch, width,
+                    last);
+      }
+    });
+  }
+}
+
+// The ball is the union of runs along x, one for each offset along y and z
+// within it. Runs of the same half width share one dilation along x, which
+// the offsets then shift and combine row by row.
+void dilateBall(std::vector<unsigned char>& mask, const int dims[3],
+                int radius)
+{
+  const int limit = radius * radius + radius;
+  std::vector<std::vector<std::pair<int, int>>> offsets(radius + 1);
+  for (int dz = -radius; dz <= radius; ++dz) {
+    for (int dy = -radius; dy <= radius; ++dy) {
+      int remaining = limit - dy * dy - dz * dz;
+      if (remaining < 0) {
+        continue;
+      }
+      int width = static_cast<int>(std::sqrt(static_cast<double>(remaining)));
+      while ((width + 1) * (width + 1) <= remaining) {
+        ++width;
+      }
+      while (width * width > remaining) {
+        --width;
+      }
+      offsets[width].push_back(std::make_pair(dy, dz));
+    }
+  }
+
+  const vtkIdType nx = dims[0];
+  std::vector<unsigned char> runs(mask.size());
+  std::vector<unsigned char> result(mask.size(), 0);
+  for (int width = 0; width <= radius; ++width) {
+    if (offsets[width].empty()) {
+      continue;
+    }
+    dilateAxis(mask.data(), runs.data(), dims, 0, width);
+    tomviz::Parallel::forRange(0, dims[1] * dims[2], 16, [&](int begin,
+                                                             int end) {
+      for (int row = begin; row < end; ++row) {
+        int y = row % dims[1];
+        int z = row / dims[1];
+        unsigned char* out = result.data() + row * nx;
+        for (const auto& offset : offsets[width]) {
+          int ys = y + offset.first;
+          int zs = z + offset.second;
+          if (ys < 0 || ys >= dims[1] || zs < 0 || zs >= dims[2]) {
+            continue;
+          }
+          const unsigned char* in =
+            runs.data() + (static_cast<vtkIdType>(zs) * dims[1] + ys) * nx;
+          for (vtkIdType x = 0; x < nx; ++x) {
+            out[x] |= in[x];
+          }
+        }
+      }
+    });
+  }
+  mask.swap(result);
+}
+
+void invert(std::vector<unsigned char>& mask)
+{
+  for (auto& value : mask) {
+    value ^= 1;
+  }
+}
+
+template <typename T>
+bool applyMorphology(T* values, const int dims[3],
+                     tomviz::LabelMap::Morphology morphology, Element element,
+                     int radius, T object, T background,
+                     const Canceled& canceled)
+{
+  using tomviz::LabelMap::Morphology;
+  vtkIdType count = static_cast<vtkIdType>(dims[0]) * dims[1] * dims[2];
+  std::vector<unsigned char> mask(count);
+  for (vtkIdType i = 0; i < count; ++i) {
+    mask[i] = values[i] == object;
+  }
+
+  // Open and close take two passes, and can be canceled between them.
+  std::vector<unsigned char> result(mask);
+  switch (morphology) {
+    case Morphology::Dilate:
+      tomviz::LabelMap::dilate(result, dims, element, radius);
+      break;
+    case Morphology::Erode:
+      tomviz::LabelMap::erode(result, dims, element, radius);
+      break;
+    case Morphology::Open:
+      tomviz::LabelMap::erode(result, dims, element, radius);
+      if (isCanceled(canceled)) {
+        return false;
+      }
+      tomviz::LabelMap::dilate(result, dims, element, radius);
+      break;
+    case Morphology::Close:
+      tomviz::LabelMap::dilate(result, dims, element, radius);
+      if (isCanceled(canceled)) {
+        return false;
+      }
+      tomviz::LabelMap::erode(result, dims, element, radius);
+      break;
+  }
+  if (isCanceled(canceled)) {
+    return false;
+  }
+
+  for (vtkIdType i = 0; i < count; ++i) {
+    if (result[i] != mask[i]) {
+      values[i] = result[i] ? object : background;
+    }
+  }
+  return true;
+}
+
+unsigned int findRoot(std::vector<unsigned int>& parent, unsigned int label)
+{
+  while (parent[label] != label) {
+    parent[label] = parent[parent[label]];
+    label = parent[label];
+  }
+  return label;
+}
+
+// Merges the sets of a and b, the smaller label becomes the root so every
+// component is represented by the label of its first voxel.
+void unite(std::vector<unsigned int>& parent, unsigned int a, unsigned int b)
+{
+  a = findRoot(parent, a);
+  b = findRoot(parent, b);
+  if (a < b) {
+    parent[b] = a;
+  } else if (b < a) {
+    parent[a] = b;
+  }
+}
+
+// The provisional labels of a slab of planes along z, local to the slab.
+struct Slab
+{
+  int first;
+  int last;
+  std::vector<unsigned int> parent;
+  std::vector<vtkIdType> voxels;
+  unsigned int base = 0;
+};
+
+template <typename T>
+void labelSlab(const T* values, const int dims[3], T background, Slab& slab,
+               unsigned int* labels)
+{
+  const vtkIdType nx = dims[0];
+  const vtkIdType plane = nx * dims[1];
+  slab.parent.assign(1, 0);
+  slab.voxels.assign(1, 0);
+  for (int z = slab.first; z < slab.last; ++z) {
+    for (int y = 0; y < dims[1]; ++y) {
+      vtkIdType i = z * plane + y * nx;
+      for (int x = 0; x < dims[0]; ++x, ++i) {
+        if (values[i] == background) {
+          labels[i] = 0;
+          continue;
+        }
+        unsigned int label = x > 0 ? labels[i - 1] : 0;
+        unsigned int neighbors[2] = { y > 0 ? labels[i - nx] : 0,
+                                      z > slab.first ? labels[i - plane]
+                                                     : 0 };
+        for (unsigned int neighbor : neighbors) {
+          if (neighbor == 0) {
+            continue;
+          }
+          if (label == 0) {
+            label = neighbor;
+          } else if (neighbor != label) {
+            unite(slab.parent, label, neighbor);
+          }
+        }
+        if (label == 0) {
+          label = static_cast<unsigned int>(slab.parent.size());
+          slab.parent.push_back(label);
+          slab.voxels.push_back(0);
+        }
+        labels[i] = label;
+        ++slab.voxels[label];
+      }
+    }
+  }
+}
+
+template <typename T>
+int labelComponents(const T* values, const int dims[3], T background,
+                    vtkImageData* image, const Canceled& canceled)
+{
+  const vtkIdType plane = static_cast<vtkIdType>(dims[0]) * dims[1];
+  const vtkIdType count = plane * dims[2];
+  vtkSmartPointer<vtkDataArray> labelArray;
+  labelArray.TakeReference(
+    tomviz::VolumeBufferPool::newArray(VTK_UNSIGNED_INT, 1, count));
+  auto labels = static_cast<unsigned int*>(labelArray->GetVoidPointer(0));
+
+  // First pass, each slab on its own.
+  int slabCount = std::min(dims[2], 4 * tomviz::Parallel::threadCount());
+  std::vector<Slab> slabs(slabCount);
+  for (int s = 0; s < slabCount; ++s) {
+    slabs[s].first = static_cast<int>(
+      static_cast<vtkIdType>(dims[2]) * s / slabCount);
+    slabs[s].last = static_cast<int>(
+      static_cast<vtkIdType>(dims[2]) * (s + 1) / slabCount);
+  }
+  tomviz::Parallel::forRange(0, slabCount, 1, [&](int begin, int end) {
+    for (int s = begin; s < end && !isCanceled(canceled); ++s) {
+      labelSlab(values, dims, background, slabs[s], labels);
+    }
+  });
+  if (isCanceled(canceled)) {
+    return -1;
+  }
+
+  // Gather the provisional labels of all slabs, then join the components
+  // that continue across the planes between slabs.
+  vtkIdType total = 0;
+  for (auto& slab : slabs) {
+    slab.base = static_cast<unsigned int>(total);
+    total += slab.parent.size() - 1;
+  }
+  if (total >= std::numeric_limits<unsigned int>::max()) {
+    return -1;
+  }
+  std::vector<unsigned int> parent(total + 1, 0);
+  std::vector<vtkIdType> voxels(total + 1, 0);
+  for (auto& slab : slabs) {
+    for (size_t l = 1; l < slab.parent.size(); ++l) {
+      unsigned int label = static_cast<unsigned int>(l);
+      parent[slab.base + l] = slab.base + findRoot(slab.parent, label);
+      voxels[slab.base + l] = slab.voxels[l];
+    }
+  }
+  for (int s = 1; s < slabCount; ++s) {
+    const unsigned int* above = labels + slabs[s].first * plane;
+    const unsigned int* below = above - plane;
+    for (vtkIdType i = 0; i < plane; ++i) {
+      if (above[i] && below[i]) {
+        unite(parent, slabs[s].base + above[i], slabs[s - 1].base + below[i]);
+      }
+    }
+  }
+
+  // Roots are the smallest label of their component, so they come before
+  // the labels they hold.
+  std::vector<unsigned int> roots;
+  for (vtkIdType l = 1; l <= total; ++l) {
+    unsigned int root = findRoot(parent, static_cast<unsigned int>(l));
+    if (root == l) {
+      roots.push_back(root);
+    } else {
+      voxels[root] += voxels[l];
+    }
+  }
+
+  // Number the components by size, ties in reverse order of their first
+  // voxel as the ITK relabeling this replaces did.
+  std::sort(roots.begin(), roots.end(), [&](unsigned int a, unsigned int b) {
+    return voxels[a] != voxels[b] ? voxels[a] < voxels[b] : a > b;
+  });
+  std::vector<unsigned int> ordered(total + 1, 0);
+  for (size_t i = 0; i < roots.size(); ++i) {
+    ordered[roots[i]] = static_cast<unsigned int>(i + 1);
+  }
+  for (vtkIdType l = 1; l <= total; ++l) {
+    ordered[l] = ordered[parent[l]];
+  }
+
+  vtkSmartPointer<vtkDataArray> output = labelArray;
+  unsigned short* shortLabels = nullptr;
+  if (roots.size() <= std::numeric_limits<unsigned short>::max()) {
+    output.TakeReference(
+      tomviz::VolumeBufferPool::newArray(VTK_UNSIGNED_SHORT, 1, count));
+    shortLabels = static_cast<unsigned short*>(output->GetVoidPointer(0));
+  }
+  tomviz::Parallel::forRange(0, slabCount, 1, [&](int begin, int end) {
+    for (int s = begin; s < end; ++s) {
+      vtkIdType first = slabs[s].first * plane;
+      vtkIdType last = slabs[s].last * plane;
+      unsigned int base = slabs[s].base;
+      for (vtkIdType i = first; i < last; ++i) {
+        unsigned int label = labels[i] ? ordered[base + labels[i]] : 0;
+        if (shortLabels) {
+          shortLabels[i] = static_cast<unsigned short>(label);
+        } else {
+          labels[i] = label;
+        }
+      }
+    }
+  });
+
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  output->SetName(scalars->GetName());
+  image->GetPointData()->RemoveArray(scalars->GetName());
+  image->GetPointData()->SetScalars(output);
+  return static_cast<int>(roots.size());
+}
+
+// The directions of the lines the surface area is estimated along, the axes,
+// the face diagonals and the body diagonals of the voxels.
+const int lineCount = 13;
+const int lines[lineCount][3] = { { 1, 0, 0 },  { 0, 1, 0 },  { 0, 0, 1 },
+                                  { 1, 1, 0 },  { 1, -1, 0 }, { 1, 0, 1 },
+                                  { 1, 0, -1 }, { 0, 1, 1 },  { 0, 1, -1 },
+                                  { 1, 1, 1 },  { 1, 1, -1 }, { 1, -1, 1 },
+                                  { 1, -1, -1 } };
+
+// The share of the directions nearest to each line, the areas of the Voronoi
+// regions of the lines on the unit sphere, as in ITK's shape label maps.
+const double lineWeights[lineCount] = {
+  0.0915557824095, 0.0915557824095, 0.0915557824095, 0.0739612557522,
+  0.0739612557522, 0.0739612557522, 0.0739612557522, 0.0739612557522,
+  0.0739612557522, 0.0703912795646, 0.0703912795646, 0.0703912795646,
+  0.0703912795646
+};
+
+// Sums over the voxels of one object, in voxel indices.
+struct Sums
+{
+  vtkIdType voxels = 0;
+  // The boundary crossings of the object along each of the lines.
+  vtkIdType crossings[lineCount] = {};
+  double first[3] = { 0.0, 0.0, 0.0 };
+  double second[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+  void add(const Sums& other)
+  {
+    voxels += other.voxels;
+    for (int i = 0; i < lineCount; ++i) {
+      crossings[i] += other.crossings[i];
+    }
+    for (int i = 0; i < 3; ++i) {
+      first[i] += other.first[i];
+    }
+    for (int i = 0; i < 6; ++i) {
+      second[i] += other.second[i];
+    }
+  }
+};
+
+// Crofton's formula, the surface area is twice the volume sampled times the
+// crossings per length of line, averaged over the directions.
+double croftonArea(const Sums& s, const double spacing[3])
+{
+  double perLength = 0.0;
+  for (int k = 0; k < lineCount; ++k) {
+    double length = 0.0;
+    for (int i = 0; i < 3; ++i) {
+      length += lines[k][i] * lines[k][i] * spacing[i] * spacing[i];
+    }
+    perLength += lineWeights[k] * s.crossings[k] / std::sqrt(length);
+  }
+  return 2.0 * spacing[0] * spacing[1] * spacing[2] * perLength;
+}
+
+typedef std::unordered_map<vtkTypeInt64, Sums> SumsMap;
+
+template <typename T>
+void sumPlanes(const T* values, const int dims[3], T background, int first,
+               int last, SumsMap& sums)
+{
+  const vtkIdType nx = dims[0];
+  const vtkIdType plane = nx * dims[1];
+  vtkIdType steps[lineCount];
+  for (int k = 0; k < lineCount; ++k) {
+    steps[k] = lines[k][0] + lines[k][1] * nx + lines[k][2] * plane;
+  }
+  // Neighboring voxels mostly share labels, so the last lookup is kept.
+  Sums* current = nullptr;
+  T currentLabel = background;
+  for (int z = first; z < last; ++z) {
+    for (int y = 0; y < dims[1]; ++y) {
+      vtkIdType i = z * plane + y * nx;
+      for (int x = 0; x < dims[0]; ++x, ++i) {
+        T value = values[i];
+        if (value == background) {
+          continue;
+        }
+        if (!current || value != currentLabel) {
+          current = &sums[static_cast<vtkTypeInt64>(value)];
+          currentLabel = value;
+        }
+        Sums& s = *current;
+        ++s.voxels;
+        // A line leaves the object both ways where the neighbor along it has
+        // another label or is outside of the volume.
+        for (int k = 0; k < lineCount; ++k) {
+          const int* line = lines[k];
+          for (int sign = -1; sign <= 1; sign += 2) {
+            int a = x + sign * line[0];
+            int b = y + sign * line[1];
+            int c = z + sign * line[2];
+            bool inside = a >= 0 && a < dims[0] && b >= 0 && b < dims[1] &&
+                          c >= 0 && c < dims[2];
+            s.crossings[k] += !inside || values[i + sign * steps[k]] != value;
+          }
+        }
+        double p[3] = { static_cast<double>(x), static_cast<double>(y),
+                        static_cast<double>(z) };
+        for (int k = 0; k < 3; ++k) {
+          s.first[k] += p[k];
+          s.second[k] += p[k] * p[k];
+        }
+        s.second[3] += p[0] * p[1];
+        s.second[4] += p[0] * p[2];
+        s.second[5] += p[1] * p[2];
+      }
+    }
+  }
+}
+
+template <typename T>
+bool measure(const T* values, const int dims[3], T background,
+             SumsMap& total, const Canceled& canceled)
+{
+  std::mutex mutex;
+  int grain = std::max(1, dims[2] / (4 * tomviz::Parallel::threadCount()));
+  tomviz::Parallel::forRange(0, dims[2], grain, [&](int begin, int end) {
+    if (isCanceled(canceled)) {
+      return;
+    }
+    SumsMap sums;
+    sumPlanes(values, dims, background, begin, end, sums);
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& entry : sums) {
+      total[entry.first].add(entry.second);
+    }
+  });
+  return !isCanceled(canceled);
+}
+
+bool isIntegerLabelMap(vtkImageData* image)
+{
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : nullptr;
+  if (!scalars || scalars->GetNumberOfComponents() != 1) {
+    return false;
+  }
+  int type = scalars->GetDataType();
+  return type != VTK_FLOAT && type != VTK_DOUBLE;
+}
+}
+
+namespace tomviz {
+namespace LabelMap {
+
+void dilate(std::vector<unsigned char>& mask, const int dims[3],
+            Element element, int radius)
+{
+  if (radius <= 0) {
+    return;
+  }
+  std::vector<unsigned char> other(mask.size());
+  switch (element) {
+    case Element::Box:
+      dilateAxis(mask.data(), other.data(), dims, 0, radius);
+      dilateAxis(other.data(), mask.data(), dims, 1, radius);
+      dilateAxis(mask.data(), other.data(), dims, 2, radius);
+      mask.swap(other);
+      break;
+    case Element::Ball:
+      dilateBall(mask, dims, radius);
+      break;
+    case Element::Cross: {
+      std::vector<unsigned char> arm(mask.size());
+      dilateAxis(mask.data(), other.data(), dims, 0, radius);
+      for (int axis = 1; axis < 3; ++axis) {
+        dilateAxis(mask.data(), arm.data(), dims, axis, radius);
+        for (size_t i = 0; i < arm.size(); ++i) {
+          other[i] |= arm[i];
+        }
+      }
+      mask.swap(other);
+      break;
+    }
+  }
+}
+
+void erode(std::vector<unsigned char>& mask, const int dims[3],
+           Element element, int radius)
+{
+  // The structuring elements are symmetric, so eroding the objects dilates
+  // the background.
+  invert(mask);
+  dilate(mask, dims, element, radius);
+  invert(mask);
+}
+
+bool apply(vtkImageData* image, Morphology morphology, Element element,
+           int radius, double objectLabel, double backgroundLabel,
+           const Canceled& canceled)
+{
+  vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : nullptr;
+  if (!scalars || scalars->GetNumberOfComponents() != 1) {
+    return false;
+  }
+  int dims[3];
+  image->GetDimensions(dims);
+  bool result = false;
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(result = applyMorphology(
+                       static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), dims,
+                       morphology, element, radius,
+                       static_cast<VTK_TT>(objectLabel),
+                       static_cast<VTK_TT>(backgroundLabel), canceled));
+  }
+  if (result) {
+    scalars->Modified();
+  }
+  return result;
+}
+
+int connectedComponents(vtkImageData* image, double background,
+                        const Canceled& canceled)
+{
+  if (!isIntegerLabelMap(image)) {
+    return -1;
+  }
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  int dims[3];
+  image->GetDimensions(dims);
+  int components = -1;
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(components = labelComponents(
+                       static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)),
+                       dims, static_cast<VTK_TT>(background), image,
+                       canceled));
+  }
+  return components;
+}
+
+void Object::principalAxes(double axes[3][3]) const
+{
+  double matrix[3][3] = { { covariance[0], covariance[3], covariance[4] },
+                          { covariance[3], covariance[1], covariance[5] },
+                          { covariance[4], covariance[5], covariance[2] } };
+  double* rows[3] = { matrix[0], matrix[1], matrix[2] };
+  double vectors[3][3];
+  double* vectorRows[3] = { vectors[0], vectors[1], vectors[2] };
+  double lengths[3];
+  // The eigenvalues come sorted in decreasing order, with the eigenvectors
+  // in the columns.
+  vtkMath::Jacobi(rows, lengths, vectorRows);
+  for (int i = 0; i < 3; ++i) {
+    for (int k = 0; k < 3; ++k) {
+      axes[i][k] = vectors[k][i];
+    }
+  }
+}
+
+bool measureObjects(vtkImageData* image, std::vector<Object>& objects,
+                    double background, const Canceled& canceled)
+{
+  if (!isIntegerLabelMap(image)) {
+    return false;
+  }
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  int dims[3];
+  image->GetDimensions(dims);
+  SumsMap sums;
+  bool measured = false;
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(measured = measure(
+                       static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)),
+                       dims, static_cast<VTK_TT>(background), sums,
+                       canceled));
+  }
+  if (!measured) {
+    return false;
+  }
+
+  double origin[3], spacing[3];
+  int extent[6];
+  image->GetOrigin(origin);
+  image->GetSpacing(spacing);
+  image->GetExtent(extent);
+  objects.clear();
+  objects.reserve(sums.size());
+  for (const auto& entry : sums) {
+    const Sums& s = entry.second;
+    Object object;
+    object.label = entry.first;
+    object.voxels = s.voxels;
+    object.volume = s.voxels * spacing[0] * spacing[1] * spacing[2];
+    object.surfaceArea = croftonArea(s, spacing);
+    double mean[3];
+    for (int k = 0; k < 3; ++k) {
+      mean[k] = s.first[k] / s.voxels;
+      object.centroid[k] = origin[k] + (extent[2 * k] + mean[k]) * spacing[k];
+    }
+    // Covariances in voxel indices, scaled to physical units.
+    const int pairs[6][2] = { { 0, 0 }, { 1, 1 }, { 2, 2 },
+                              { 0, 1 }, { 0, 2 }, { 1, 2 } };
+    for (int p = 0; p < 6; ++p) {
+      int a = pairs[p][0], b = pairs[p][1];
+      object.covariance[p] = (s.second[p] / s.voxels - mean[a] * mean[b]) *
+                             spacing[a] * spacing[b];
+    }
+    objects.push_back(object);
+  }
+  std::sort(objects.begin(), objects.end(),
+            [](const Object& a, const Object& b) { return a.label < b.label; });
+  return true;
+}
+}
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizLabelMap_h
+#define tomvizLabelMap_h
+
+#include <vtkType.h>
+
+#include <functional>
+#include <vector>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// Binary morphology, connected components and object measures on label
+/// maps, the segmented volumes whose voxel values are object labels. These
+/// replace the ITK filters the segmentation operators ran from Python, and
+/// work on the scalars of the image directly, each pass split across
+/// threads.
+namespace LabelMap {
+
+/// The shape of the structuring element of the morphology. A box of radius r
+/// spans 2r + 1 voxels along each axis, a cross only reaches r voxels along
+/// the axes, and a ball holds the voxels less than r + 1/2 from its center.
+enum class Element
+{
+  Box,
+  Ball,
+  Cross
+};
+
+enum class Morphology
+{
+  Dilate,
+  Erode,
+  Open,
+  Close
+};
+
+/// Called from worker threads, returning true stops the computation.
+typedef std::function<bool()> Canceled;
+
+/// Dilates mask, a dims[0] by dims[1] by dims[2] volume of zeros and ones,
+/// x varying fastest. Voxels outside of the volume are zeros. A box is
+/// dilated one axis at a time, and a ball as a union of runs along x, so the
+/// cost grows with the radius at most as the area of a disk.
+void dilate(std::vector<unsigned char>& mask, const int dims[3],
+            Element element, int radius);
+
+/// Erodes mask like dilate() dilates it. Voxels outside of the volume are
+/// ones, so objects touching the border are not eroded from it.
+void erode(std::vector<unsigned char>& mask, const int dims[3],
+           Element element, int radius);
+
+/// Applies the morphology to the voxels of image equal to objectLabel.
+/// Voxels added to the objects are set to objectLabel, and voxels removed
+/// from them to backgroundLabel. Returns false if image has no single
+/// component scalars or if canceled.
+bool apply(vtkImageData* image, Morphology morphology, Element element,
+           int radius, double objectLabel, double backgroundLabel,
+           const Canceled& canceled = Canceled());
+
+/// Replaces the scalars of image with a label map of the connected
+/// components of its voxels that differ from background, with face
+/// connectivity. Components are labeled from 1 in order of increasing size,
+/// so the largest has the highest label, and background voxels become 0.
+/// Labels are unsigned short unless there are more components than that
+/// holds. Slabs of the volume are labeled in parallel, their provisional
+/// labels merged by union-find. Returns the number of components, or -1 if
+/// image is not an integer label map or if canceled.
+int connectedComponents(vtkImageData* image, double background,
+                        const Canceled& canceled = Canceled());
+
+/// Measures of one object of a label map, in physical units.
+struct Object
+{
+  vtkTypeInt64 label = 0;
+  vtkIdType voxels = 0;
+  double volume = 0.0;
+  /// The area of the surface of the object, estimated from the crossings of
+  /// its boundary along lines in 13 directions with Crofton's formula like
+  /// ITK's perimeter. Unlike the area of its voxel faces, this does not
+  /// overestimate curved surfaces, which the faces do by half for a sphere.
+  double surfaceArea = 0.0;
+  double centroid[3] = { 0.0, 0.0, 0.0 };
+  /// The covariance of the positions of the voxels of the object, xx, yy,
+  /// zz, xy, xz and yz.
+  double covariance[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+  /// Returns the principal axes of the object in axes[0] to axes[2], unit
+  /// vectors from longest to shortest.
+  void principalAxes(double axes[3][3]) const;
+};
+
+/// Measures every object of an integer label map in a single pass over it,
+/// all labels other than background. The objects are returned in order of
+/// increasing label. Returns false if image is not an integer label map or
+/// if canceled.
+bool measureObjects(vtkImageData* image, std::vector<Object>& objects,
+                    double background = 0.0,
+                    const Canceled& canceled = Canceled());
+}
+}
+
+#endif
@@ -0,0 +1,392 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "LabelMapOperator.h"
+
+#include "EditOperatorWidget.h"
+#include "OperatorResult.h"
+
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkFloatArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkTable.h>
+
+#include <QComboBox>
+#include <QDebug>
+#include <QFormLayout>
+#include <QPointer>
+#include <QSpinBox>
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+using tomviz::LabelMapOperator;
+
+// Serialized names and labels of the functions and elements, in enum order.
+const char* functionNames[] = { "binary-dilate",
+                                "binary-erode",
+                                "binary-open",
+                                "binary-close",
+                                "connected-components",
+                                "label-object-attributes",
+                                "label-object-principal-axes" };
+const char* functionLabels[] = { "Binary Dilate",
+                                 "Binary Erode",
+                                 "Binary Open",
+                                 "Binary Close",
+                                 "Connected Components",
+                                 "Label Object Attributes",
+                                 "Label Object Principal Axes" };
+const int numberOfFunctions =
+  sizeof(functionNames) / sizeof(functionNames[0]);
+
+const char* elementNames[] = { "box", "ball", "cross" };
+const char* elementLabels[] = { "Box", "Ball", "Cross" };
+const int numberOfElements = sizeof(elementNames) / sizeof(elementNames[0]);
+
+QSpinBox* labelSpinBox(int value, QWidget* parent)
+{
+  QSpinBox* spinBox = new QSpinBox(parent);
+  spinBox->setRange(std::numeric_limits<int>::min(),
+                    std::numeric_limits<int>::max());
+  spinBox->setValue(value);
+  return spinBox;
+}
+
+class LabelMapWidget : public tomviz::EditOperatorWidget
+{
+  Q_OBJECT
+
+public:
+  LabelMapWidget(LabelMapOperator* op, QWidget* p)
+    : tomviz::EditOperatorWidget(p), m_operator(op)
+  {
+    QFormLayout* layout = new QFormLayout;
+    if (op->isMorphology()) {
+      m_element = new QComboBox(this);
+      for (int i = 0; i < numberOfElements; ++i) {
+        m_element->addItem(elementLabels[i]);
+      }
+      m_element->setCurrentIndex(static_cast<int>(op->element()));
+      m_radius = new QSpinBox(this);
+      m_radius->setRange(1, 100);
+      m_radius->setValue(op->radius());
+      m_objectLabel = labelSpinBox(op->objectLabel(), this);
+      m_backgroundLabel = labelSpinBox(op->backgroundLabel(), this);
+      layout->addRow("Structuring Element", m_element);
+      layout->addRow("Radius", m_radius);
+      layout->addRow("Object Label", m_objectLabel);
+      layout->addRow("Background Label", m_backgroundLabel);
+    } else if (op->function() == LabelMapOperator::Function::PrincipalAxes) {
+      m_objectLabel = labelSpinBox(op->objectLabel(), this);
+      layout->addRow("Label Value", m_objectLabel);
+    } else {
+      m_backgroundLabel = labelSpinBox(op->backgroundLabel(), this);
+      layout->addRow("Background Value", m_backgroundLabel);
+    }
+    setLayout(layout);
+  }
+
+  void applyChangesToOperator() override
+  {
+    if (!m_operator) {
+      return;
+    }
+    if (m_element) {
+      m_operator->setElement(
+        static_cast<tomviz::LabelMap::Element>(m_element->currentIndex()));
+      m_operator->setRadius(m_radius->value());
+    }
+    if (m_objectLabel) {
+      m_operator->setObjectLabel(m_objectLabel->value());
+    }
+    if (m_backgroundLabel) {
+      m_operator->setBackgroundLabel(m_backgroundLabel->value());
+    }
+  }
+
+private:
+  QPointer<LabelMapOperator> m_operator;
+  QComboBox* m_element = nullptr;
+  QSpinBox* m_radius = nullptr;
+  QSpinBox* m_objectLabel = nullptr;
+  QSpinBox* m_backgroundLabel = nullptr;
+};
+
+vtkSmartPointer<vtkFloatArray> newColumn(const char* name, vtkIdType rows)
+{
+  auto column = vtkSmartPointer<vtkFloatArray>::New();
+  column->SetName(name);
+  column->SetNumberOfTuples(rows);
+  return column;
+}
+}
+
+#include "LabelMapOperator.moc"
+
+namespace tomviz {
+
+LabelMapOperator::LabelMapOperator(Function function, QObject* p)
+  : Operator(p), m_function(function)
+{
+  setSupportsCancel(true);
+  setupResults();
+  connect(this, &LabelMapOperator::newOperatorResult, this,
+          &LabelMapOperator::setOperatorResult);
+}
+
+QString LabelMapOperator::label() const
+{
+  return functionLabels[static_cast<int>(m_function)];
+}
+
+QIcon LabelMapOperator::icon() const
+{
+  return QIcon();
+}
+
+Operator* LabelMapOperator::clone() const
+{
+  auto other = new LabelMapOperator(m_function);
+  other->setElement(m_element);
+  other->setRadius(m_radius);
+  other->setObjectLabel(m_objectLabel);
+  other->setBackgroundLabel(m_backgroundLabel);
+  return other;
+}
+
+bool LabelMapOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("function").set_value(
+    functionNames[static_cast<int>(m_function)]);
+  if (isMorphology()) {
+    ns.append_attribute("element").set_value(
+      elementNames[static_cast<int>(m_element)]);
+    ns.append_attribute("radius").set_value(m_radius);
+  }
+  ns.append_attribute("object_label").set_value(m_objectLabel);
+  ns.append_attribute("background_label").set_value(m_backgroundLabel);
+  return true;
+}
+
+bool LabelMapOperator::deserialize(const pugi::xml_node& ns)
+{
+  const char* name = ns.attribute("function").value();
+  for (int i = 0; i < numberOfFunctions; ++i) {
+    if (strcmp(name, functionNames[i]) == 0) {
+      m_function = static_cast<Function>(i);
+    }
+  }
+  setupResults();
+  const char* element = ns.attribute("element").value();
+  for (int i = 0; i < numberOfElements; ++i) {
+    if (strcmp(element, elementNames[i]) == 0) {
+      setElement(static_cast<LabelMap::Element>(i));
+    }
+  }
+  setRadius(ns.attribute("radius").as_int(1));
+  setObjectLabel(ns.attribute("object_label").as_int(1));
+  setBackgroundLabel(ns.attribute("background_label").as_int(0));
+  return true;
+}
+
+EditOperatorWidget* LabelMapOperator::getEditorContents(QWidget* p)
+{
+  if (!hasCustomUI()) {
+    return nullptr;
+  }
+  return new LabelMapWidget(this, p);
+}
+
+void LabelMapOperator::setupResults()
+{
+  if (m_function != Function::Attributes) {
+    setNumberOfResults(0);
+    return;
+  }
+  setNumberOfResults(1);
+  resultAt(0)->setName("component_statistics");
+  resultAt(0)->setLabel("Component Statistics");
+}
+
+bool LabelMapOperator::isMorphology() const
+{
+  return m_function == Function::Dilate || m_function == Function::Erode ||
+         m_function == Function::Open || m_function == Function::Close;
+}
+
+void LabelMapOperator::setElement(LabelMap::Element element)
+{
+  m_element = element;
+  emit transformModified();
+}
+
+void LabelMapOperator::setRadius(int radius)
+{
+  m_radius = radius;
+  emit transformModified();
+}
+
+void LabelMapOperator::setObjectLabel(int label)
+{
+  m_objectLabel = label;
+  emit transformModified();
+}
+
+void LabelMapOperator::setBackgroundLabel(int label)
+{
+  m_backgroundLabel = label;
+  emit transformModified();
+}
+
+bool LabelMapOperator::applyTransform(vtkDataObject* data)
+{
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  if (!image || !image->GetPointData()->GetScalars()) {
+    qCritical() << "No scalars found!";
+    return false;
+  }
+
+  auto canceled = [this]() { return isCanceled(); };
+  switch (m_function) {
+    case Function::Dilate:
+    case Function::Erode:
+    case Function::Open:
+    case Function::Close:
+      // These come first, in the order of LabelMap::Morphology.
+      return LabelMap::apply(
+        image, static_cast<LabelMap::Morphology>(m_function), m_element,
+        m_radius, m_objectLabel, m_backgroundLabel, canceled);
+    case Function::ConnectedComponents:
+      if (LabelMap::connectedComponents(image, m_backgroundLabel, canceled) <
+          0) {
+        if (!isCanceled()) {
+          qCritical() << "Connected Components works only on images with"
+                      << "integral types.";
+        }
+        return false;
+      }
+      return true;
+    case Function::Attributes:
+      return addAttributes(image);
+    case Function::PrincipalAxes:
+      return addPrincipalAxes(image);
+  }
+  return false;
+}
+
+bool LabelMapOperator::addAttributes(vtkImageData* image)
+{
+  std::vector<LabelMap::Object> objects;
+  if (!LabelMap::measureObjects(image, objects, 0.0,
+                                [this]() { return isCanceled(); })) {
+    if (!isCanceled()) {
+      qCritical() << "Label Object Attributes works only on images with"
+                  << "integral types.";
+    }
+    return false;
+  }
+
+  // The columns of the table the ITK version made come first.
+  vtkIdType rows = static_cast<vtkIdType>(objects.size());
+  auto surfaceArea = newColumn("SurfaceArea", rows);
+  auto volume = newColumn("Volume", rows);
+  auto ratio = newColumn("SurfaceAreaToVolumeRatio", rows);
+  auto label = newColumn("Label", rows);
+  vtkSmartPointer<vtkFloatArray> centroid[3] = {
+    newColumn("CentroidX", rows), newColumn("CentroidY", rows),
+    newColumn("CentroidZ", rows)
+  };
+  for (vtkIdType i = 0; i < rows; ++i) {
+    const LabelMap::Object& object = objects[i];
+    surfaceArea->SetValue(i, object.surfaceArea);
+    volume->SetValue(i, object.volume);
+    ratio->SetValue(i, object.surfaceArea / object.volume);
+    label->SetValue(i, object.label);
+    for (int k = 0; k < 3; ++k) {
+      centroid[k]->SetValue(i, object.centroid[k]);
+    }
+  }
+
+  vtkNew<vtkTable> table;
+  table->AddColumn(surfaceArea);
+  table->AddColumn(volume);
+  table->AddColumn(ratio);
+  table->AddColumn(label);
+  for (int k = 0; k < 3; ++k) {
+    table->AddColumn(centroid[k]);
+  }
+  emit newOperatorResult(table.Get());
+  return true;
+}
+
+bool LabelMapOperator::addPrincipalAxes(vtkImageData* image)
+{
+  std::vector<LabelMap::Object> objects;
+  if (!LabelMap::measureObjects(image, objects, 0.0,
+                                [this]() { return isCanceled(); })) {
+    if (!isCanceled()) {
+      qCritical() << "Label Object Principal Axes works only on images with"
+                  << "integral types.";
+    }
+    return false;
+  }
+  const LabelMap::Object* object = nullptr;
+  for (const auto& candidate : objects) {
+    if (candidate.label == m_objectLabel) {
+      object = &candidate;
+    }
+  }
+  if (!object) {
+    qCritical() << "No voxels with label" << m_objectLabel << "in label map";
+    return false;
+  }
+
+  double axes[3][3];
+  object->principalAxes(axes);
+  vtkNew<vtkFloatArray> axisArray;
+  axisArray->SetName("PrincipalAxes");
+  axisArray->SetNumberOfComponents(3);
+  axisArray->SetNumberOfTuples(3);
+  for (int i = 0; i < 3; ++i) {
+    axisArray->SetTuple(i, axes[i]);
+  }
+  vtkNew<vtkFloatArray> centerArray;
+  centerArray->SetName("Center");
+  centerArray->SetNumberOfComponents(3);
+  centerArray->SetNumberOfTuples(1);
+  centerArray->SetTuple(0, object->centroid);
+
+  vtkFieldData* fieldData = image->GetFieldData();
+  fieldData->RemoveArray("PrincipalAxes");
+  fieldData->AddArray(axisArray.Get());
+  fieldData->RemoveArray("Center");
+  fieldData->AddArray(centerArray.Get());
+  return true;
+}
+
+void LabelMapOperator::setOperatorResult(
+  vtkSmartPointer<vtkDataObject> result)
+{
+  if (!setResult(0, result)) {
+    qCritical() << "Could not set result 0";
+  }
+}
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizLabelMapOperator_h
+#define tomvizLabelMapOperator_h
+
+#include "Operator.h"
+
+#include "LabelMap.h"
+
+#include <vtkSmartPointer.h>
+
+namespace tomviz {
+
+/// The segmentation operators that work on label maps: binary morphology of
+/// the objects of one label, labeling of connected components, and measures
+/// of the labeled objects. Attributes adds a table of the measures of every
+/// object as a result, principal axes adds the axes and center of one object
+/// to the field data.
+class LabelMapOperator : public Operator
+{
+  Q_OBJECT
+
+public:
+  enum class Function
+  {
+    Dilate,
+    Erode,
+    Open,
+    Close,
+    ConnectedComponents,
+    Attributes,
+    PrincipalAxes
+  };
+
+  LabelMapOperator(Function function = Function::Dilate,
+                   QObject* parent = nullptr);
+
+  QString label() const override;
+  QIcon icon() const override;
+  Operator* clone() const override;
+  bool writesArraysInPlace() const override { return isMorphology(); }
+  bool serialize(pugi::xml_node& ns) const override;
+  bool deserialize(const pugi::xml_node& ns) override;
+  EditOperatorWidget* getEditorContents(QWidget* parent) override;
+  bool hasCustomUI() const override
+  {
+    return m_function != Function::Attributes;
+  }
+
+  Function function() const { return m_function; }
+  bool isMorphology() const;
+
+  /// The structuring element and its radius, for the morphology.
+  void setElement(LabelMap::Element element);
+  LabelMap::Element element() const { return m_element; }
+  void setRadius(int radius);
+  int radius() const { return m_radius; }
+
+  /// The label of the objects the morphology changes, or the object whose
+  /// principal axes are computed.
+  void setObjectLabel(int label);
+  int objectLabel() const { return m_objectLabel; }
+
+  /// The label removed voxels are set to by the morphology, or the value of
+  /// the voxels that are not part of any component.
+  void setBackgroundLabel(int label);
+  int backgroundLabel() const { return m_backgroundLabel; }
+
+protected:
+  bool applyTransform(vtkDataObject* data) override;
+
+signals:
+  // Results can only be set on the UI thread.
+  void newOperatorResult(vtkSmartPointer<vtkDataObject>);
+
+private slots:
+  void setOperatorResult(vtkSmartPointer<vtkDataObject> result);
+
+private:
+  Q_DISABLE_COPY(LabelMapOperator)
+
+  void setupResults();
+  bool addAttributes(vtkImageData* image);
+  bool addPrincipalAxes(vtkImageData* image);
+
+  Function m_function;
+  LabelMap::Element m_element = LabelMap::Element::Box;
+  int m_radius = 1;
+  int m_objectLabel = 1;
+  int m_backgroundLabel = 0;
+};
+}
+
+#endif
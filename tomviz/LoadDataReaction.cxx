@@ -18,11 +18,13 @@
 #include "ActiveObjects.h"
 #include "DataSource.h"
 #include "EmdFormat.h"
+#include "MappedVolume.h"
 #include "ModuleManager.h"
 #include "RecentFilesMenu.h"
 #include "Utilities.h"
 
 #include "pqActiveObjects.h"
+#include "pqCoreUtilities.h"
 #include "pqLoadDataReaction.h"
 #include "pqPipelineSource.h"
 #include "pqProxyWidgetDialog.h"
@@ -31,6 +33,7 @@
 #include "pqView.h"
 #include "vtkDataArray.h"
 #include "vtkImageData.h"
+#include "vtkImageReader2.h"
 #include "vtkNew.h"
 #include "vtkPointData.h"
 #include "vtkSMCoreUtilities.h"
@@ -43,9 +46,20 @@
 #include "vtkSmartPointer.h"
 #include "vtkTrivialProducer.h"
 
+#include <vtksys/SystemInformation.hxx>
+
 #include <QDebug>
+#include <QDialog>
+#include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QGridLayout>
+#include <QLabel>
+#include <QSpinBox>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <string>
 
 namespace tomviz {
 
@@ -158,6 +172,58 @@ DataSource* LoadDataReaction::loadData(const QStringList& fileNames,
   return dataSource;
 }
 
+namespace {
+/// Asks for the region of a volume of dims to open, initially the whole
+/// volume. Returns false if canceled.
+bool chooseRegion(const QString& fileName, const int dims[3], int extent[6])
+{
+  QDialog dialog(pqCoreUtilities::mainWidget());
+  dialog.setWindowTitle("Open Region");
+  QLabel* label =
+    new QLabel(QString("%1 is %2 x %3 x %4 voxels, too large to load whole. "
+                       "Choose the region of it to open.")
+                 .arg(fileName)
+                 .arg(dims[0])
+                 .arg(dims[1])
+                 .arg(dims[2]));
+  label->setWordWrap(true);
+  QGridLayout* grid = new QGridLayout;
+  grid->addWidget(new QLabel("From"), 0, 1);
+  grid->addWidget(new QLabel("To"), 0, 2);
+  const char* axes[3] = { "X", "Y", "Z" };
+  QSpinBox* spinBoxes[6];
+  for (int i = 0; i < 3; ++i) {
+    grid->addWidget(new QLabel(axes[i]), i + 1, 0);
+    for (int j = 0; j < 2; ++j) {
+      QSpinBox* spinBox = new QSpinBox;
+      spinBox->setRange(0, dims[i] - 1);
+      spinBox->setValue(extent[2 * i + j]);
+      grid->addWidget(spinBox, i + 1, j + 1);
+      spinBoxes[2 * i + j] = spinBox;
+    }
+  }
+  QDialogButtonBox* buttons =
+    new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  QObject::connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  QObject::connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  QVBoxLayout* layout = new QVBoxLayout;
+  layout->addWidget(label);
+  layout->addLayout(grid);
+  layout->addWidget(buttons);
+  dialog.setLayout(layout);
+  if (dialog.exec() != QDialog::Accepted) {
+    return false;
+  }
+  for (int i = 0; i < 3; ++i) {
+    extent[2 * i] = std::min(spinBoxes[2 * i]->value(),
+                             spinBoxes[2 * i + 1]->value());
+    extent[2 * i + 1] = std::max(spinBoxes[2 * i]->value(),
+                                 spinBoxes[2 * i + 1]->value());
+  }
+  return true;
+}
+}
+
 DataSource* LoadDataReaction::createDataSourceLocal(const QString& fileName,
                                                     bool defaultModules,
                                                     bool child)
@@ -166,8 +232,30 @@ DataSource* LoadDataReaction::createDataSourceLocal(const QString& fileName,
   if (info.suffix().toLower() == "emd") {
     // Load the file using our simple EMD class.
     EmdFormat emdFile;
+    std::string name = fileName.toLatin1().data();
     vtkNew<vtkImageData> imageData;
-    if (emdFile.read(fileName.toLatin1().data(), imageData.Get())) {
+    // The size of the volume in memory, compressed files are smaller.
+    int dims[3] = { 0, 0, 0 };
+    int valueSize = 0;
+    qint64 bytes = info.size();
+    bool known = emdFile.dimensions(name, dims, valueSize);
+    if (known) {
+      bytes = static_cast<qint64>(dims[0]) * dims[1] * dims[2] * valueSize;
+    }
+    // Volumes too large for memory are mapped when the file allows it, and
+    // only a region of them is read otherwise.
+    bool mapped = MappedVolume::preferred(bytes) &&
+                  emdFile.map(name, imageData.Get());
+    int extent[6] = { 0, dims[0] - 1, 0, dims[1] - 1, 0, dims[2] - 1 };
+    vtksys::SystemInformation system;
+    system.RunMemoryCheck();
+    qint64 quarter = system.GetTotalPhysicalMemory() / 4 * 1024 * 1024;
+    if (!mapped && known && bytes > quarter &&
+        !chooseRegion(info.fileName(), dims, extent)) {
+      return nullptr;
+    }
+    if (mapped ||
+        emdFile.read(name, imageData.Get(), known ? extent : nullptr)) {
       DataSource* dataSource = createDataSource(imageData.Get());
       dataSource->originalDataSource()->SetAnnotation(
         Attributes::FILENAME, fileName.toLatin1().data());
@@ -217,6 +305,59 @@ bool hasData(vtkSMProxy* reader)
   }
   return true;
 }
+
+/// Maps the volume configured on a raw image reader, rather than letting the
+/// reader load it, if it is better kept out of core. Returns false if the
+/// volume should be read, or the layout of the file cannot be mapped.
+bool mapRawData(vtkSMProxy* reader, vtkImageData* image, QString& fileName)
+{
+  // The rows are mapped in the order they are in the file, which is the
+  // order the reader keeps when the first row of the file is the lower left.
+  if (QString(reader->GetXMLName()) != "TVRawImageReader" ||
+      vtkSMPropertyHelper(reader, "FileDimensionality").GetAsInt() != 3 ||
+      vtkSMPropertyHelper(reader, "FileLowerLeft").GetAsInt() == 0) {
+    return false;
+  }
+#ifdef VTK_WORDS_BIGENDIAN
+  const int nativeOrder = VTK_FILE_BYTE_ORDER_BIG_ENDIAN;
+#else
+  const int nativeOrder = VTK_FILE_BYTE_ORDER_LITTLE_ENDIAN;
+#endif
+  // With the default pattern the prefix is the name of the single file.
+  QString pattern = vtkSMPropertyHelper(reader, "FilePattern").GetAsString();
+  if (pattern != "%s" ||
+      vtkSMPropertyHelper(reader, "DataByteOrder").GetAsInt() != nativeOrder) {
+    return false;
+  }
+
+  fileName = vtkSMPropertyHelper(reader, "FilePrefix").GetAsString();
+  int scalarType = vtkSMPropertyHelper(reader, "DataScalarType").GetAsInt();
+  int components =
+    vtkSMPropertyHelper(reader, "NumberOfScalarComponents").GetAsInt();
+  int extent[6];
+  vtkSMPropertyHelper(reader, "DataExtent").Get(extent, 6);
+  qint64 bytes = components * vtkDataArray::GetDataTypeSize(scalarType);
+  for (int i = 0; i < 3; ++i) {
+    bytes *= extent[2 * i + 1] - extent[2 * i] + 1;
+  }
+  // Like the reader, assume anything ahead of the voxels is a header.
+  qint64 header = QFileInfo(fileName).size() - bytes;
+  if (bytes <= 0 || header < 0 || !MappedVolume::preferred(bytes) ||
+      !MappedVolume::map(fileName, header, scalarType, components, extent,
+                         image)) {
+    return false;
+  }
+
+  double spacing[3];
+  double origin[3];
+  vtkSMPropertyHelper(reader, "DataSpacing").Get(spacing, 3);
+  vtkSMPropertyHelper(reader, "DataOrigin").Get(origin, 3);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->GetPointData()->GetScalars()->SetName(
+    vtkSMPropertyHelper(reader, "ScalarArrayName").GetAsString());
+  return true;
+}
 }
 
 DataSource* LoadDataReaction::createDataSource(vtkSMProxy* reader,
@@ -232,13 +373,11 @@ DataSource* LoadDataReaction::createDataSource(vtkSMProxy* reader,
     DataSource* previousActiveDataSource =
       ActiveObjects::instance().activeDataSource();
 
-    if (!hasData(reader)) {
+    DataSource* dataSource = createDataSourceFromReader(reader);
+    if (!dataSource) {
       qCritical() << "Error: failed to load file!";
       return nullptr;
     }
-
-    DataSource* dataSource =
-      new DataSource(vtkSMSourceProxy::SafeDownCast(reader));
     // do whatever we need to do with a new data source.
     LoadDataReaction::dataSourceAdded(dataSource, defaultModules, child);
     if (!previousActiveDataSource) {
@@ -254,6 +393,21 @@ DataSource* LoadDataReaction::createDataSource(vtkSMProxy* reader,
   return nullptr;
 }
 
+DataSource* LoadDataReaction::createDataSourceFromReader(vtkSMProxy* reader)
+{
+  vtkNew<vtkImageData> mapped;
+  QString fileName;
+  if (mapRawData(reader, mapped.Get(), fileName)) {
+    DataSource* dataSource = createDataSource(mapped.Get());
+    dataSource->originalDataSource()->SetAnnotation(
+      Attributes::FILENAME, fileName.toLatin1().data());
+    return dataSource;
+  } else if (hasData(reader)) {
+    return new DataSource(vtkSMSourceProxy::SafeDownCast(reader));
+  }
+  return nullptr;
+}
+
 DataSource* LoadDataReaction::createDataSource(vtkImageData* imageData)
 {
   auto pxm = tomviz::ActiveObjects::instance().proxyManager();
@@ -43,6 +43,11 @@ public:
                                       bool defaultModules = true,
                                       bool child = false);
 
+  /// Create a data source from a reader that is already configured. Raw
+  /// volumes that are better kept out of core are mapped instead of read.
+  /// Returns nullptr if the reader produces no data.
+  static DataSource* createDataSourceFromReader(vtkSMProxy* reader);
+
   /// Create a data source that can be populated with data.
   static DataSource* createDataSource(vtkImageData* imageData);
 
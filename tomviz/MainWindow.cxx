@@ -38,6 +38,7 @@
 #include "Behaviors.h"
 #include "DataPropertiesPanel.h"
 #include "DataTransformMenu.h"
+#include "IterativeReconstructionReaction.h"
 #include "LoadDataReaction.h"
 #include "LoadPaletteReaction.h"
 #include "ModuleManager.h"
@@ -257,6 +258,8 @@ MainWindow::MainWindow(QWidget* parent, Qt::WindowFlags flags)
     m_ui->menuTomography->addAction("Weighted Back Projection");
   QAction* reconWBP_CAction =
     m_ui->menuTomography->addAction("Simple Back Projection (C++)");
+  QAction* reconIterativeAction =
+    m_ui->menuTomography->addAction("Iterative Reconstruction (C++)");
   QAction* reconARTAction =
     m_ui->menuTomography->addAction("Algebraic Reconstruction Technique (ART)");
   QAction* reconSIRTAction = m_ui->menuTomography->addAction(
@@ -318,9 +321,7 @@ MainWindow::MainWindow(QWidget* parent, Qt::WindowFlags flags)
     autoRotateAlignShiftAction, "Auto Tilt Axis Shift Align",
     readInPythonScript("AutoTiltAxisShiftAlignment"), true);
 
-  new AddPythonTransformReaction(
-    autoAlignCCAction, "Auto Tilt Image Align (XCORR)",
-    readInPythonScript("AutoCrossCorrelationTiltImageAlignment"), true);
+  new AddAlignReaction(autoAlignCCAction, true);
   new AddPythonTransformReaction(
     autoAlignCOMAction, "Auto Tilt Image Align (CoM)",
     readInPythonScript("AutoCenterOfMassTiltImageAlignment"), true);
@@ -346,6 +347,7 @@ MainWindow::MainWindow(QWidget* parent, Qt::WindowFlags flags)
     readInJSONDescription("Recon_TV_minimization"));
 
   new ReconstructionReaction(reconWBP_CAction);
+  new IterativeReconstructionReaction(reconIterativeAction, this);
 
   new AddPythonTransformReaction(
     randomShiftsAction, "Shift Tilt Series Randomly",
@@ -0,0 +1,160 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "MappedVolume.h"
+
+#include <pqApplicationCore.h>
+#include <pqSettings.h>
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/SystemInformation.hxx>
+
+#include <QDebug>
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace tomviz {
+
+namespace MappedVolume {
+
+namespace {
+
+/// Unmaps and closes the file once the array using the mapping is deleted.
+void release(vtkObject*, unsigned long, void* clientData, void*)
+{
+  delete static_cast<QFile*>(clientData);
+}
+
+/// Like release(), and removes the file as well, it is only scratch space.
+void releaseShared(vtkObject*, unsigned long, void* clientData, void*)
+{
+  auto file = static_cast<QFile*>(clientData);
+  QString fileName = file->fileName();
+  delete file;
+  QFile::remove(fileName);
+}
+}
+
+bool map(const QString& fileName, qint64 offset, int scalarType,
+         int components, const int extent[6], vtkImageData* image)
+{
+  vtkSmartPointer<vtkDataArray> scalars;
+  scalars.TakeReference(vtkDataArray::CreateDataArray(scalarType));
+  if (!scalars || components < 1) {
+    return false;
+  }
+  qint64 values = static_cast<qint64>(components);
+  for (int i = 0; i < 3; ++i) {
+    values *= extent[2 * i + 1] - extent[2 * i] + 1;
+  }
+  qint64 bytes = values * scalars->GetDataTypeSize();
+
+  auto file = new QFile(fileName);
+  if (!file->open(QIODevice::ReadOnly) || offset + bytes > file->size()) {
+    qCritical() << "Unable to map" << bytes << "bytes of" << fileName;
+    delete file;
+    return false;
+  }
+  // QFile owns the mapping, so it is kept until the scalars are deleted.
+  uchar* memory = file->map(offset, bytes, QFileDevice::MapPrivateOption);
+  if (!memory) {
+    qCritical() << "Unable to map" << fileName << file->errorString();
+    delete file;
+    return false;
+  }
+
+  // Save is set so VTK never tries to free the mapped memory itself.
+  scalars->SetNumberOfComponents(components);
+  scalars->SetVoidArray(memory, values, 1);
+  scalars->SetName("ImageScalars");
+  vtkNew<vtkCallbackCommand> unmap;
+  unmap->SetCallback(release);
+  unmap->SetClientData(file);
+  scalars->AddObserver(vtkCommand::DeleteEvent, unmap.Get());
+
+  image->Initialize();
+  image->SetExtent(const_cast<int*>(extent));
+  image->GetPointData()->SetScalars(scalars);
+  return true;
+}
+
+bool preferred(qint64 bytes)
+{
+  QString mode = "auto";
+  if (auto core = pqApplicationCore::instance()) {
+    mode = core->settings()->value("OutOfCoreLoading", mode).toString();
+  }
+  if (mode == "always") {
+    return true;
+  } else if (mode == "never") {
+    return false;
+  }
+  vtksys::SystemInformation info;
+  info.RunMemoryCheck();
+  qint64 megabytes = info.GetTotalPhysicalMemory() / 4;
+  return bytes > megabytes * 1024 * 1024;
+}
+
+vtkSmartPointer<vtkDataArray> share(const QString& fileName, int scalarType,
+                                    int components, vtkIdType tuples)
+{
+  vtkSmartPointer<vtkDataArray> array;
+  array.TakeReference(vtkDataArray::CreateDataArray(scalarType));
+  if (!array || components < 1 || tuples < 1) {
+    QFile::remove(fileName);
+    return nullptr;
+  }
+  qint64 values = static_cast<qint64>(tuples) * components;
+  qint64 bytes = values * array->GetDataTypeSize();
+
+  auto file = new QFile(fileName);
+  bool sized = file->open(QIODevice::ReadWrite);
+  if (sized && file->size() < bytes) {
+#ifdef Q_OS_LINUX
+    // Reserve the pages up front, in a full tmpfs the first write to a
+    // sparse file would fault instead of this failing.
+    sized = posix_fallocate(file->handle(), 0, bytes) == 0;
+#else
+    sized = file->resize(bytes);
+#endif
+  }
+  // Opened for writing, the mapping is shared rather than private.
+  uchar* memory = sized ? file->map(0, bytes) : nullptr;
+  if (!memory) {
+    qCritical() << "Unable to share" << bytes << "bytes in" << fileName
+                << file->errorString();
+    delete file;
+    QFile::remove(fileName);
+    return nullptr;
+  }
+
+  array->SetNumberOfComponents(components);
+  array->SetVoidArray(memory, values, 1);
+  vtkNew<vtkCallbackCommand> unmap;
+  unmap->SetCallback(releaseShared);
+  unmap->SetClientData(file);
+  array->AddObserver(vtkCommand::DeleteEvent, unmap.Get());
+  return array;
+}
+}
+}
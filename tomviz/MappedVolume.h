@@ -0,0 +1,59 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizMappedVolume_h
+#define tomvizMappedVolume_h
+
+#include <QString>
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+class vtkDataArray;
+class vtkImageData;
+
+namespace tomviz {
+
+/// Out-of-core storage for volumes. The scalars of a mapped image point
+/// straight into a memory-mapped file, so the operating system only brings
+/// in the pages that are touched and can drop them again under memory
+/// pressure. Volumes loaded with map() are mapped privately: writes made by
+/// operators stay in memory and never reach the file.
+namespace MappedVolume {
+
+/// Maps the voxels of extent, stored in x-fastest order with components
+/// interleaved at byte offset in fileName, as the scalars of image. The data
+/// must be stored in the native byte order. The mapping is released when
+/// the scalars are deleted.
+bool map(const QString& fileName, qint64 offset, int scalarType,
+         int components, const int extent[6], vtkImageData* image);
+
+/// Returns true if a volume of the given size should be mapped rather than
+/// read into memory. This is governed by the "OutOfCoreLoading" setting,
+/// which is "always", "never" or "auto". In automatic mode, the default,
+/// volumes larger than a quarter of the physical memory are mapped.
+bool preferred(qint64 bytes);
+
+/// Maps fileName as an array of tuples of the given type and components,
+/// shared with any other process mapping the file, such as the Python
+/// workers. The file is created or grown to the size needed, and removed
+/// once the array is deleted or if it can't be mapped, in which case nullptr
+/// is returned.
+vtkSmartPointer<vtkDataArray> share(const QString& fileName, int scalarType,
+                                    int components, vtkIdType tuples);
+}
+}
+
+#endif
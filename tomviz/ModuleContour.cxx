@@ -20,6 +20,7 @@
 #include "DataSource.h"
 #include "DoubleSliderWidget.h"
 #include "Operator.h"
+#include "SpanSpaceIndex.h"
 #include "Utilities.h"
 
 #include "pqColorChooserButton.h"
@@ -41,6 +42,7 @@
 #include "vtkSmartPointer.h"
 
 #include <algorithm>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -59,8 +61,26 @@ public:
   bool UseSolidColor = false;
   pqPropertyLinks Links;
   QPointer<DataSource> ColorByDataSource = nullptr;
+  // Whether the user shows the module, and whether the surface is skipped
+  // because the isovalues touch no brick of the data.
+  bool Visible = true;
+  bool NoSurface = false;
 };
 
+namespace {
+
+// Sets the Visibility saved in the state of a representation.
+void setSavedVisibility(pugi::xml_node node, bool visible)
+{
+  for (pugi::xml_node property = node.first_child().child("Property");
+       property; property = property.next_sibling("Property")) {
+    if (strcmp(property.attribute("name").value(), "Visibility") == 0) {
+      property.child("Element").attribute("value").set_value(visible ? 1 : 0);
+    }
+  }
+}
+}
+
 ModuleContour::ModuleContour(QObject* parentObject) : Module(parentObject)
 {
   d = new Private;
@@ -152,6 +172,9 @@ bool ModuleContour::initialize(DataSource* data, vtkSMViewProxy* vtkView)
   // Color by the data source by default
   d->ColorByDataSource = dataSource();
 
+  connect(data, &DataSource::spanSpaceChanged, this,
+          &ModuleContour::onSpanSpaceChanged);
+
   // Give the proxy a friendly name for the GUI/Python world.
   if (auto p = convert<pqProxy*>(contourProxy)) {
     p->rename(label());
@@ -169,7 +192,7 @@ void ModuleContour::updateColorMap()
   updateScalarColoring();
 
   vtkSMPropertyHelper(m_activeRepresentation, "Visibility")
-    .Set(visibility() ? 1 : 0);
+    .Set(d->Visible && !d->NoSurface ? 1 : 0);
   m_activeRepresentation->UpdateVTKObjects();
 }
 
@@ -197,8 +220,11 @@ bool ModuleContour::finalize()
 bool ModuleContour::setVisibility(bool val)
 {
   Q_ASSERT(m_activeRepresentation);
+  d->Visible = val;
+  // ParaView only updates the pipeline of visible representations, so hiding
+  // an empty surface skips the contour and the probe.
   vtkSMPropertyHelper(m_activeRepresentation, "Visibility")
-    .Set(val ? 1 : 0);
+    .Set(d->Visible && !d->NoSurface ? 1 : 0);
   m_activeRepresentation->UpdateVTKObjects();
 
   return true;
@@ -206,11 +232,35 @@ bool ModuleContour::setVisibility(bool val)
 
 bool ModuleContour::visibility() const
 {
-  if (m_activeRepresentation) {
-    return vtkSMPropertyHelper(m_activeRepresentation, "Visibility")
-             .GetAsInt() != 0;
-  } else {
-    return false;
+  return m_activeRepresentation && d->Visible;
+}
+
+bool ModuleContour::surfaceExpected() const
+{
+  const SpanSpaceIndex& index = dataSource()->spanSpace();
+  double range[2];
+  if (!m_contourFilter || !index.range(range)) {
+    // Nothing is known of the data until its index is built.
+    return true;
+  }
+  vtkSMPropertyHelper values(m_contourFilter, "ContourValues");
+  for (unsigned int i = 0; i < values.GetNumberOfElements(); ++i) {
+    double value = values.GetAsDouble(i);
+    if (value >= range[0] && value <= range[1] &&
+        !index.bricksContaining(value).empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ModuleContour::onSpanSpaceChanged()
+{
+  bool noSurface = !surfaceExpected();
+  if (noSurface != d->NoSurface && m_activeRepresentation) {
+    d->NoSurface = noSurface;
+    setVisibility(d->Visible);
+    emit renderNeeded();
   }
 }
 
@@ -224,6 +274,8 @@ void ModuleContour::setIsoValues(const QList<double>& values)
     .Set(&vectorValues[0], values.size());
   m_contourFilter->UpdateVTKObjects();
 
+  d->NoSurface = !surfaceExpected();
+  setVisibility(d->Visible);
   updateScalarColoring();
 }
 
@@ -324,6 +376,7 @@ void ModuleContour::createCategoricalColoringPipeline()
 void ModuleContour::onPropertyChanged()
 {
   d->Links.accept();
+  d->NoSurface = !surfaceExpected();
 
   int colorByIndex = m_controllers->getColorByComboBox()->currentIndex();
   if (colorByIndex > 0) {
@@ -394,6 +447,10 @@ bool ModuleContour::serialize(pugi::xml_node& ns) const
       ns.remove_child(node);
       return false;
     }
+    // An empty surface is hidden, but is saved as the user left it.
+    if (m_activeRepresentation == m_resampleRepresentation) {
+      setSavedVisibility(node, d->Visible);
+    }
   }
 
   if (m_pointDataToCellDataRepresentation) {
@@ -416,6 +473,9 @@ bool ModuleContour::serialize(pugi::xml_node& ns) const
       ns.remove_child(node);
       return false;
     }
+    if (m_activeRepresentation == m_pointDataToCellDataRepresentation) {
+      setSavedVisibility(node, d->Visible);
+    }
   }
 
   return Module::serialize(ns);
@@ -434,10 +494,16 @@ bool ModuleContour::deserialize(const pugi::xml_node& ns)
     }
   }
 
-  return tomviz::deserialize(m_contourFilter, ns.child("ContourFilter")) &&
-         tomviz::deserialize(m_resampleRepresentation,
-                             ns.child("ResampleRepresentation")) &&
-         Module::deserialize(ns);
+  if (!tomviz::deserialize(m_contourFilter, ns.child("ContourFilter")) ||
+      !tomviz::deserialize(m_resampleRepresentation,
+                           ns.child("ResampleRepresentation"))) {
+    return false;
+  }
+  // Hide the surface again if the loaded isovalues touch no brick.
+  d->NoSurface = !surfaceExpected();
+  setVisibility(vtkSMPropertyHelper(m_activeRepresentation, "Visibility")
+                  .GetAsInt() != 0);
+  return Module::deserialize(ns);
 }
 
 void ModuleContour::dataSourceMoved(double newX, double newY, double newZ)
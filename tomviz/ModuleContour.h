@@ -68,6 +68,10 @@ protected:
   void updateScalarColoring();
   void createCategoricalColoringPipeline();
 
+  /// Returns false when the span space index of the data shows that none of
+  /// the isovalues passes through any brick, so the surface is empty.
+  bool surfaceExpected() const;
+
   vtkWeakPointer<vtkSMSourceProxy> m_contourFilter;
   vtkWeakPointer<vtkSMSourceProxy> m_resampleFilter;
   vtkWeakPointer<vtkSMProxy> m_resampleRepresentation;
@@ -91,6 +95,9 @@ private slots:
   /// Reset the UI for widgets not connected to a proxy property
   void updateGUI();
 
+  /// Shows or skips the surface for the new index of the data.
+  void onSpanSpaceChanged();
+
 private:
   Q_DISABLE_COPY(ModuleContour)
 };
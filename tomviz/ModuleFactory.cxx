@@ -23,6 +23,7 @@
 #include "ModuleContour.h"
 #include "ModuleOrthogonalSlice.h"
 #include "ModuleOutline.h"
+#include "ModuleParallelContour.h"
 #include "ModuleRuler.h"
 #include "ModuleScaleCube.h"
 #include "ModuleSegment.h"
@@ -56,6 +57,7 @@ QList<QString> ModuleFactory::moduleTypes(DataSource* dataSource,
     reply << "Outline"
           << "Volume"
           << "Contour"
+          << "Parallel Contour"
           << "Threshold"
           << "Slice"
           << "Ruler"
@@ -79,6 +81,8 @@ Module* ModuleFactory::createModule(const QString& type, DataSource* dataSource,
 #else
     module = new ModuleContour();
 #endif
+  } else if (type == "Parallel Contour") {
+    module = new ModuleParallelContour();
   } else if (type == "Volume") {
     module = new ModuleVolume();
   } else if (type == "Slice") {
@@ -148,6 +152,9 @@ const char* ModuleFactory::moduleType(Module* module)
   {
     return "Contour";
   }
+  if (qobject_cast<ModuleParallelContour*>(module)) {
+    return "Parallel Contour";
+  }
   if (qobject_cast<ModuleVolume*>(module)) {
     return "Volume";
   }
@@ -0,0 +1,392 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ModuleParallelContour.h"
+
+#include "CopyOnWrite.h"
+#include "DataSource.h"
+#include "DoubleSliderWidget.h"
+#include "Parallel.h"
+#include "SpanSpaceIndex.h"
+
+#include <vtkActor.h>
+#include <vtkCompositePolyDataMapper2.h>
+#include <vtkImageData.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkPolyData.h>
+#include <vtkProperty.h>
+#include <vtkTrivialProducer.h>
+
+#include <pqColorChooserButton.h>
+#include <vtkPVRenderView.h>
+#include <vtkSMSourceProxy.h>
+#include <vtkSMViewProxy.h>
+
+#include <QColor>
+#include <QFormLayout>
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include <algorithm>
+
+namespace tomviz {
+
+using pugi::xml_attribute;
+using pugi::xml_node;
+
+class ModuleParallelContour::ContourTask : public QRunnable
+{
+public:
+  ContourTask(ModuleParallelContour* module, int brick, double value,
+              std::shared_ptr<std::atomic<bool>> canceled)
+    : m_module(module), m_image(module->m_image), m_brick(brick),
+      m_value(value), m_generation(module->m_generation), m_canceled(canceled)
+  {
+    std::copy(module->m_bricks[brick].extent,
+              module->m_bricks[brick].extent + 6, m_extent);
+  }
+
+  void run() override
+  {
+    if (*m_canceled) {
+      return;
+    }
+    auto surface = BrickContour::contour(m_image, m_extent, m_value);
+    if (*m_canceled) {
+      return;
+    }
+
+    bool queue;
+    {
+      QMutexLocker locker(&m_module->m_mutex);
+      m_module->m_contoured.append({ m_generation, m_brick, surface });
+      queue = !m_module->m_deliveryQueued;
+      m_module->m_deliveryQueued = true;
+    }
+    // One delivery takes every surface done by then. The module waits for
+    // its tasks in its destructor, so it is alive.
+    if (queue) {
+      QMetaObject::invokeMethod(m_module, "deliver", Qt::QueuedConnection);
+    }
+  }
+
+private:
+  ModuleParallelContour* m_module;
+  vtkSmartPointer<vtkImageData> m_image;
+  int m_brick;
+  int m_extent[6];
+  double m_value;
+  int m_generation;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+};
+
+ModuleParallelContour::ModuleParallelContour(QObject* parentObject)
+  : Module(parentObject)
+{
+  m_pool.setMaxThreadCount(Parallel::threadCount());
+}
+
+ModuleParallelContour::~ModuleParallelContour()
+{
+  finalize();
+  cancel();
+  m_pool.waitForDone();
+}
+
+QIcon ModuleParallelContour::icon() const
+{
+  return QIcon(":/icons/pqIsosurface.png");
+}
+
+bool ModuleParallelContour::initialize(DataSource* data,
+                                       vtkSMViewProxy* vtkView)
+{
+  if (!Module::initialize(data, vtkView)) {
+    return false;
+  }
+
+  m_mapper->SetInputDataObject(m_surfaces.Get());
+  m_mapper->ScalarVisibilityOff();
+  m_actor->SetMapper(m_mapper.Get());
+  m_actor->SetPosition(const_cast<double*>(data->displayPosition()));
+
+  m_view = vtkPVRenderView::SafeDownCast(vtkView->GetClientSideView());
+  m_view->AddPropToRenderer(m_actor.Get());
+
+  // The bricks come from the index of the data source, which is built in the
+  // background after the data changes.
+  connect(data, &DataSource::spanSpaceChanged, this,
+          &ModuleParallelContour::onDataChanged);
+  onDataChanged();
+
+  return true;
+}
+
+bool ModuleParallelContour::finalize()
+{
+  if (m_view) {
+    m_view->RemovePropFromRenderer(m_actor.Get());
+    m_view = nullptr;
+  }
+
+  return true;
+}
+
+bool ModuleParallelContour::setVisibility(bool val)
+{
+  m_actor->SetVisibility(val ? 1 : 0);
+  return true;
+}
+
+bool ModuleParallelContour::visibility() const
+{
+  return m_actor->GetVisibility() != 0;
+}
+
+bool ModuleParallelContour::serialize(pugi::xml_node& ns) const
+{
+  xml_node rootNode = ns.append_child("properties");
+
+  xml_node visibilityNode = rootNode.append_child("visibility");
+  visibilityNode.append_attribute("enabled") = visibility();
+
+  xml_node contourNode = rootNode.append_child("contour");
+  contourNode.append_attribute("value") = m_isoValue;
+
+  xml_node color = rootNode.append_child("color");
+  double rgb[3];
+  m_actor->GetProperty()->GetDiffuseColor(rgb);
+  color.append_attribute("r") = rgb[0];
+  color.append_attribute("g") = rgb[1];
+  color.append_attribute("b") = rgb[2];
+
+  xml_node opacityNode = rootNode.append_child("opacity");
+  opacityNode.append_attribute("value") = m_actor->GetProperty()->GetOpacity();
+
+  return Module::serialize(ns);
+}
+
+bool ModuleParallelContour::deserialize(const pugi::xml_node& ns)
+{
+  xml_node rootNode = ns.child("properties");
+  if (!rootNode) {
+    return false;
+  }
+
+  xml_node node = rootNode.child("visibility");
+  if (node) {
+    xml_attribute att = node.attribute("enabled");
+    if (att) {
+      setVisibility(att.as_bool());
+    }
+  }
+  node = rootNode.child("contour");
+  if (node) {
+    xml_attribute att = node.attribute("value");
+    if (att) {
+      setIsoValue(att.as_double());
+    }
+  }
+  node = rootNode.child("color");
+  if (node) {
+    QColor color;
+    color.setRgbF(node.attribute("r").as_double(1.0),
+                  node.attribute("g").as_double(1.0),
+                  node.attribute("b").as_double(1.0));
+    setColor(color);
+  }
+  node = rootNode.child("opacity");
+  if (node) {
+    xml_attribute att = node.attribute("value");
+    if (att) {
+      setOpacity(att.as_double());
+    }
+  }
+
+  return Module::deserialize(ns);
+}
+
+void ModuleParallelContour::addToPanel(QWidget* panel)
+{
+  if (panel->layout()) {
+    delete panel->layout();
+  }
+
+  QFormLayout* layout = new QFormLayout;
+
+  m_isoValueSlider = new DoubleSliderWidget(true);
+  m_isoValueSlider->setLineEditWidth(50);
+  m_isoValueSlider->setMinimum(m_range[0]);
+  m_isoValueSlider->setMaximum(m_range[1]);
+  m_isoValueSlider->setValue(m_isoValue);
+  layout->addRow("Value", m_isoValueSlider);
+
+  pqColorChooserButton* colorSelector = new pqColorChooserButton(panel);
+  colorSelector->setShowAlphaChannel(false);
+  double rgb[3];
+  m_actor->GetProperty()->GetDiffuseColor(rgb);
+  colorSelector->setChosenColor(QColor::fromRgbF(rgb[0], rgb[1], rgb[2]));
+  layout->addRow("Color", colorSelector);
+
+  DoubleSliderWidget* opacitySlider = new DoubleSliderWidget(true);
+  opacitySlider->setLineEditWidth(50);
+  opacitySlider->setValue(m_actor->GetProperty()->GetOpacity());
+  layout->addRow("Opacity", opacitySlider);
+
+  panel->setLayout(layout);
+
+  connect(m_isoValueSlider.data(), &DoubleSliderWidget::valueEdited, this,
+          &ModuleParallelContour::setIsoValue);
+  connect(colorSelector, &pqColorChooserButton::chosenColorChanged, this,
+          &ModuleParallelContour::setColor);
+  connect(opacitySlider, &DoubleSliderWidget::valueEdited, this,
+          &ModuleParallelContour::setOpacity);
+}
+
+void ModuleParallelContour::dataSourceMoved(double newX, double newY,
+                                            double newZ)
+{
+  m_actor->SetPosition(newX, newY, newZ);
+}
+
+bool ModuleParallelContour::isProxyPartOfModule(vtkSMProxy*)
+{
+  return false;
+}
+
+std::string ModuleParallelContour::getStringForProxy(vtkSMProxy*)
+{
+  qWarning("Unknown proxy passed to parallel contour in save animation");
+  return "";
+}
+
+vtkSMProxy* ModuleParallelContour::getProxyForString(const std::string&)
+{
+  return nullptr;
+}
+
+void ModuleParallelContour::setIsoValue(double value)
+{
+  m_isoValue = value;
+  m_isoValueSet = true;
+  if (m_isoValueSlider) {
+    m_isoValueSlider->setValue(value);
+  }
+  contourBricks();
+}
+
+void ModuleParallelContour::setColor(const QColor& color)
+{
+  m_actor->GetProperty()->SetDiffuseColor(color.redF(), color.greenF(),
+                                          color.blueF());
+  emit renderNeeded();
+}
+
+void ModuleParallelContour::setOpacity(double value)
+{
+  m_actor->GetProperty()->SetOpacity(value);
+  emit renderNeeded();
+}
+
+void ModuleParallelContour::onDataChanged()
+{
+  cancel();
+
+  vtkTrivialProducer* tp = vtkTrivialProducer::SafeDownCast(
+    dataSource()->producer()->GetClientSideObject());
+  auto image = vtkImageData::SafeDownCast(tp->GetOutputDataObject(0));
+  m_image = nullptr;
+  m_bricks.clear();
+  if (image) {
+    // The tasks read a copy, so the data can change while they run.
+    m_image.TakeReference(
+      vtkImageData::SafeDownCast(CopyOnWrite::sharedCopy(image)));
+    const SpanSpaceIndex& index = dataSource()->spanSpace();
+    m_bricks = index.bricks();
+    index.range(m_range);
+  }
+  if (!m_isoValueSet) {
+    m_isoValue = 0.5 * (m_range[0] + m_range[1]);
+  }
+  if (m_isoValueSlider) {
+    m_isoValueSlider->setMinimum(m_range[0]);
+    m_isoValueSlider->setMaximum(m_range[1]);
+    m_isoValueSlider->setValue(m_isoValue);
+  }
+
+  // The bricks of the data before have nothing to do with the new ones.
+  m_surfaces->SetNumberOfBlocks(0);
+  m_surfaces->SetNumberOfBlocks(static_cast<unsigned int>(m_bricks.size()));
+  contourBricks();
+}
+
+void ModuleParallelContour::cancel()
+{
+  if (m_canceled) {
+    *m_canceled = true;
+  }
+  m_pool.clear();
+  ++m_generation;
+}
+
+void ModuleParallelContour::contourBricks()
+{
+  cancel();
+  m_canceled = std::make_shared<std::atomic<bool>>(false);
+
+  // The bricks the surface passes through keep the surface they have until
+  // their task replaces it, the others are cleared now.
+  std::vector<int> contoured;
+  if (m_image) {
+    contoured = dataSource()->spanSpace().bricksContaining(m_isoValue);
+  }
+  size_t next = 0;
+  for (size_t i = 0; i < m_bricks.size(); ++i) {
+    if (next < contoured.size() && contoured[next] == static_cast<int>(i)) {
+      m_pool.start(new ContourTask(this, static_cast<int>(i), m_isoValue,
+                                   m_canceled));
+      ++next;
+    } else {
+      m_surfaces->SetBlock(static_cast<unsigned int>(i), nullptr);
+    }
+  }
+  m_surfaces->Modified();
+  emit renderNeeded();
+}
+
+void ModuleParallelContour::deliver()
+{
+  QList<Contoured> contoured;
+  {
+    QMutexLocker locker(&m_mutex);
+    contoured.swap(m_contoured);
+    m_deliveryQueued = false;
+  }
+
+  bool changed = false;
+  for (const auto& entry : contoured) {
+    // Surfaces of a value or data replaced since are dropped.
+    if (entry.generation == m_generation) {
+      m_surfaces->SetBlock(static_cast<unsigned int>(entry.brick),
+                           entry.surface);
+      changed = true;
+    }
+  }
+  if (changed) {
+    m_surfaces->Modified();
+    emit renderNeeded();
+  }
+}
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizModuleParallelContour_h
+#define tomvizModuleParallelContour_h
+
+#include "Module.h"
+
+#include "BrickContour.h"
+
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QThreadPool>
+
+#include <vtkNew.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class QColor;
+
+class vtkActor;
+class vtkCompositePolyDataMapper2;
+class vtkImageData;
+class vtkMultiBlockDataSet;
+class vtkPolyData;
+class vtkPVRenderView;
+
+namespace tomviz {
+
+class DoubleSliderWidget;
+
+/// Isosurface of the data source computed a brick at a time on a thread pool.
+/// The data source's span space index gives the bricks the isosurface passes
+/// through, so only those are contoured when the value changes, and the
+/// surface of each brick is shown as soon as it is done. Until then a brick
+/// keeps the surface of the value before, so the surface is refined in place
+/// rather than disappearing while the value is dragged.
+class ModuleParallelContour : public Module
+{
+  Q_OBJECT
+
+public:
+  ModuleParallelContour(QObject* parent = nullptr);
+  ~ModuleParallelContour() override;
+
+  QString label() const override { return "Parallel Contour"; }
+  QIcon icon() const override;
+  bool initialize(DataSource* dataSource, vtkSMViewProxy* view) override;
+  bool finalize() override;
+  bool setVisibility(bool val) override;
+  bool visibility() const override;
+  bool serialize(pugi::xml_node& ns) const override;
+  bool deserialize(const pugi::xml_node& ns) override;
+  void addToPanel(QWidget* panel) override;
+
+  void dataSourceMoved(double newX, double newY, double newZ) override;
+
+  bool isProxyPartOfModule(vtkSMProxy* proxy) override;
+
+  double isoValue() const { return m_isoValue; }
+
+public slots:
+  void setIsoValue(double value);
+
+protected:
+  std::string getStringForProxy(vtkSMProxy* proxy) override;
+  vtkSMProxy* getProxyForString(const std::string& str) override;
+
+private slots:
+  void onDataChanged();
+  void deliver();
+  void setColor(const QColor& color);
+  void setOpacity(double value);
+
+private:
+  Q_DISABLE_COPY(ModuleParallelContour)
+
+  class ContourTask;
+
+  struct Contoured
+  {
+    int generation;
+    int brick;
+    vtkSmartPointer<vtkPolyData> surface;
+  };
+
+  void contourBricks();
+  void cancel();
+
+  vtkWeakPointer<vtkPVRenderView> m_view;
+  vtkNew<vtkActor> m_actor;
+  vtkNew<vtkCompositePolyDataMapper2> m_mapper;
+  /// The surface of each brick, null for the bricks it doesn't pass through.
+  vtkNew<vtkMultiBlockDataSet> m_surfaces;
+
+  /// A copy-on-write copy of the data the tasks read.
+  vtkSmartPointer<vtkImageData> m_image;
+  /// The bricks of the data source's span space index when m_image was taken.
+  std::vector<BrickContour::Brick> m_bricks;
+  double m_range[2] = { 0.0, 1.0 };
+  double m_isoValue = 0.0;
+  bool m_isoValueSet = false;
+
+  int m_generation = 0;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+  QThreadPool m_pool;
+
+  // Surfaces handed over by the tasks, and whether deliver() is queued.
+  QMutex m_mutex;
+  QList<Contoured> m_contoured;
+  bool m_deliveryQueued = false;
+
+  QPointer<DoubleSliderWidget> m_isoValueSlider;
+};
+}
+
+#endif
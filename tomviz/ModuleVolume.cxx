@@ -17,6 +17,7 @@
 #include "ModuleVolumeWidget.h"
 
 #include "DataSource.h"
+#include "ResolutionPyramid.h"
 #include "Utilities.h"
 
 #include <vtkColorTransferFunction.h>
@@ -24,6 +25,7 @@
 #include <vtkImageData.h>
 #include <vtkNew.h>
 #include <vtkPiecewiseFunction.h>
+#include <vtkRenderWindowInteractor.h>
 #include <vtkSmartPointer.h>
 #include <vtkTrivialProducer.h>
 #include <vtkVector.h>
@@ -31,6 +33,7 @@
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
 
+#include <pqCoreUtilities.h>
 #include <pqProxiesWidget.h>
 #include <vtkPVRenderView.h>
 #include <vtkSMPVRepresentationProxy.h>
@@ -41,15 +44,27 @@
 #include <vtkSMViewProxy.h>
 
 #include <QCheckBox>
+#include <QTimer>
 #include <QVBoxLayout>
 
 namespace tomviz {
 
+namespace {
+
+/// The most voxels drawn while the camera is moving.
+const qint64 interactiveVoxels = 256 * 256 * 256;
+}
+
 using pugi::xml_attribute;
 using pugi::xml_node;
 
 ModuleVolume::ModuleVolume(QObject* parentObject) : Module(parentObject)
 {
+  // Give each level a moment on screen before moving to a finer one.
+  m_refineTimer = new QTimer(this);
+  m_refineTimer->setSingleShot(true);
+  m_refineTimer->setInterval(150);
+  connect(m_refineTimer, &QTimer::timeout, this, &ModuleVolume::refine);
 }
 
 ModuleVolume::~ModuleVolume()
@@ -88,6 +103,39 @@ bool ModuleVolume::initialize(DataSource* data, vtkSMViewProxy* vtkView)
   m_view->AddPropToRenderer(m_volume.Get());
   m_view->Update();
 
+  auto pyramid = data->pyramid();
+  m_levelMappers.resize(ResolutionPyramid::levelCount + 1);
+  connect(pyramid, &ResolutionPyramid::levelReady, this,
+          &ModuleVolume::onLevelReady);
+  connect(pyramid, &ResolutionPyramid::cleared, this,
+          &ModuleVolume::onLevelsCleared);
+  for (int i = 1; i <= ResolutionPyramid::levelCount; ++i) {
+    if (pyramid->level(i)) {
+      onLevelReady(i);
+    }
+  }
+
+  // Any button held down in the view moves the camera or a widget, and the
+  // wheel zooms.
+  if (auto interactor = m_view->GetInteractor()) {
+    const unsigned long presses[] = { vtkCommand::LeftButtonPressEvent,
+                                      vtkCommand::MiddleButtonPressEvent,
+                                      vtkCommand::RightButtonPressEvent };
+    const unsigned long releases[] = { vtkCommand::LeftButtonReleaseEvent,
+                                       vtkCommand::MiddleButtonReleaseEvent,
+                                       vtkCommand::RightButtonReleaseEvent };
+    for (int i = 0; i < 3; ++i) {
+      pqCoreUtilities::connect(interactor, presses[i], this,
+                               SLOT(onInteractionStarted()));
+      pqCoreUtilities::connect(interactor, releases[i], this,
+                               SLOT(onInteractionEnded()));
+    }
+    pqCoreUtilities::connect(interactor, vtkCommand::MouseWheelForwardEvent,
+                             this, SLOT(onMouseWheel()));
+    pqCoreUtilities::connect(interactor, vtkCommand::MouseWheelBackwardEvent,
+                             this, SLOT(onMouseWheel()));
+  }
+
   return true;
 }
 
@@ -362,4 +410,78 @@ void ModuleVolume::setJittering(const bool val)
   emit renderNeeded();
 }
 
+void ModuleVolume::showLevel(int level)
+{
+  vtkGPUVolumeRayCastMapper* mapper = m_volumeMapper.Get();
+  if (level > 0 && m_levelMappers[level]) {
+    // The settings live on the full resolution mapper.
+    mapper = m_levelMappers[level];
+    mapper->SetBlendMode(m_volumeMapper->GetBlendMode());
+    mapper->SetUseJittering(m_volumeMapper->GetUseJittering());
+  } else {
+    level = 0;
+  }
+  m_level = level;
+  m_volume->SetMapper(mapper);
+}
+
+void ModuleVolume::onLevelReady(int level)
+{
+  auto image = dataSource()->pyramid()->level(level);
+  if (level < 1 || !image) {
+    return;
+  }
+  if (!m_levelMappers[level]) {
+    m_levelMappers[level] = vtkSmartPointer<vtkGPUVolumeRayCastMapper>::New();
+  }
+  m_levelMappers[level]->SetInputData(image);
+}
+
+void ModuleVolume::onLevelsCleared()
+{
+  for (auto& mapper : m_levelMappers) {
+    mapper = nullptr;
+  }
+  if (m_level != 0) {
+    showLevel(0);
+    emit renderNeeded();
+  }
+}
+
+void ModuleVolume::onInteractionStarted()
+{
+  m_refineTimer->stop();
+  int level = dataSource()->pyramid()->levelForBudget(interactiveVoxels);
+  if (level != m_level) {
+    showLevel(level);
+  }
+}
+
+void ModuleVolume::onInteractionEnded()
+{
+  if (m_level != 0) {
+    m_refineTimer->start();
+  }
+}
+
+void ModuleVolume::onMouseWheel()
+{
+  // Wheel events come one notch at a time, refine once they stop coming.
+  onInteractionStarted();
+  onInteractionEnded();
+}
+
+void ModuleVolume::refine()
+{
+  int level = m_level - 1;
+  while (level > 0 && !m_levelMappers[level]) {
+    --level;
+  }
+  showLevel(level);
+  emit renderNeeded();
+  if (m_level != 0) {
+    m_refineTimer->start();
+  }
+}
+
 } // end of namespace tomviz
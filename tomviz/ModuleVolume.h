@@ -19,8 +19,13 @@
 #include "Module.h"
 
 #include <vtkNew.h>
+#include <vtkSmartPointer.h>
 #include <vtkWeakPointer.h>
 
+#include <vector>
+
+class QTimer;
+
 class vtkSMProxy;
 class vtkSMSourceProxy;
 
@@ -74,6 +79,15 @@ private:
   ModuleVolumeWidget* m_controllers = nullptr;
   bool m_gradientOpacityEnabled = false;
 
+  /// Mappers for the coarse levels of the data source's pyramid, indexed by
+  /// level. While the camera moves the volume is drawn with a coarse level,
+  /// then refined a level at a time once it stops.
+  std::vector<vtkSmartPointer<vtkGPUVolumeRayCastMapper>> m_levelMappers;
+  int m_level = 0;
+  QTimer* m_refineTimer = nullptr;
+
+  void showLevel(int level);
+
 private slots:
   /**
    * Actuator methods for m_volumeMapper.  These slots should be connected to
@@ -88,6 +102,13 @@ private slots:
   void onSpecularChanged(const double value);
   void onSpecularPowerChanged(const double value);
   void onGradientOpacityChanged(const bool enable);
+
+  void onLevelReady(int level);
+  void onLevelsCleared();
+  void onInteractionStarted();
+  void onInteractionEnded();
+  void onMouseWheel();
+  void refine();
 };
 }
 
@@ -71,6 +71,12 @@ public:
 
   TransformResult transform(vtkDataObject* data);
 
+  /// Should return false if applyTransform never writes into the point or
+  /// cell arrays of the data it is given, because it only reads them or
+  /// replaces them with new arrays. The pipeline shares arrays between data
+  /// objects, and gives operators that return true private copies first.
+  virtual bool writesArraysInPlace() const { return true; }
+
   /// Return a new clone.
   virtual Operator* clone() const = 0;
 
@@ -18,7 +18,10 @@
 #include "ConvertToFloatOperator.h"
 #include "CropOperator.h"
 #include "DataSource.h"
+#include "IterativeReconstructionOperator.h"
+#include "LabelMapOperator.h"
 #include "OperatorPython.h"
+#include "PointwiseOperator.h"
 #include "ReconstructionOperator.h"
 #include "SetTiltAnglesOperator.h"
 #include "SnapshotOperator.h"
@@ -45,6 +48,7 @@ public:
   bool deserialize(const pugi::xml_node&) override { return true; }
   bool hasCustomUI() const override { return false; }
   Operator* clone() const override { return new ConvertToVolumeOperator; }
+  bool writesArraysInPlace() const override { return false; }
 
 protected:
   bool applyTransform(vtkDataObject* data) override
@@ -91,6 +95,9 @@ QList<QString> OperatorFactory::operatorTypes()
         << "ConvertToVolume"
         << "Crop"
         << "CxxReconstruction"
+        << "CxxIterativeReconstruction"
+        << "LabelMap"
+        << "Pointwise"
         << "SetTiltAngles"
         << "TranslateAlign"
         << "Snapshot";
@@ -117,6 +124,12 @@ Operator* OperatorFactory::createOperator(const QString& type, DataSource* ds)
     op = new CropOperator();
   } else if (type == "CxxReconstruction") {
     op = new ReconstructionOperator(ds);
+  } else if (type == "CxxIterativeReconstruction") {
+    op = new IterativeReconstructionOperator(ds);
+  } else if (type == "LabelMap") {
+    op = new LabelMapOperator();
+  } else if (type == "Pointwise") {
+    op = new PointwiseOperator();
   } else if (type == "SetTiltAngles") {
     op = new SetTiltAnglesOperator();
   } else if (type == "TranslateAlign") {
@@ -144,6 +157,15 @@ const char* OperatorFactory::operatorType(Operator* op)
   if (qobject_cast<ReconstructionOperator*>(op)) {
     return "CxxReconstruction";
   }
+  if (qobject_cast<IterativeReconstructionOperator*>(op)) {
+    return "CxxIterativeReconstruction";
+  }
+  if (qobject_cast<LabelMapOperator*>(op)) {
+    return "LabelMap";
+  }
+  if (qobject_cast<PointwiseOperator*>(op)) {
+    return "Pointwise";
+  }
   if (qobject_cast<SetTiltAnglesOperator*>(op)) {
     return "SetTiltAngles";
   }
@@ -20,26 +20,38 @@
 #include <QJsonObject>
 #include <QJsonValue>
 #include <QPointer>
+#include <QTemporaryDir>
 #include <QtDebug>
 
 #include "DataSource.h"
 #include "EditOperatorWidget.h"
+#include "MappedVolume.h"
 #include "OperatorResult.h"
+#include "PythonService.h"
 #include "PythonUtilities.h"
 #include "Utilities.h"
 #include "pqPythonSyntaxHighlighter.h"
 
+#include "vtkDataArray.h"
 #include "vtkDataObject.h"
+#include "vtkFieldData.h"
+#include "vtkGenericDataObjectReader.h"
+#include "vtkImageData.h"
 #include "vtkNew.h"
+#include "vtkPointData.h"
 #include "vtkSMParaViewPipelineController.h"
 #include "vtkSMProxy.h"
 #include "vtkSMProxyManager.h"
 #include "vtkSMSessionProxyManager.h"
 #include "vtkSMSourceProxy.h"
 #include "vtkTrivialProducer.h"
+#include "vtkXMLImageDataReader.h"
+#include "vtkXMLImageDataWriter.h"
 
 #include "ui_EditPythonOperatorWidget.h"
 
+#include <cstring>
+
 namespace {
 
 class EditPythonOperatorWidget : public tomviz::EditOperatorWidget
@@ -70,6 +82,52 @@ private:
   QPointer<tomviz::OperatorPython> Op;
   Ui::EditPythonOperatorWidget Ui;
 };
+
+// JSON has a single number type, and QJsonDocument writes whole doubles such
+// as 3.0 as 3, which Python then reads as an int. The types are sent along
+// so the worker can restore them, lists get a type for each element.
+QJsonValue argumentType(const QVariant& value)
+{
+  if (value.type() == QVariant::List) {
+    QJsonArray types;
+    foreach (const QVariant& element, value.toList()) {
+      types.append(argumentType(element));
+    }
+    return types;
+  } else if (value.type() == QVariant::Double ||
+             value.userType() == QMetaType::Float) {
+    return QString("float");
+  } else if (value.type() == QVariant::Int ||
+             value.type() == QVariant::LongLong) {
+    return QString("int");
+  }
+  return QJsonValue();
+}
+
+QJsonObject argumentTypes(const QVariantMap& arguments)
+{
+  QJsonObject types;
+  for (auto it = arguments.begin(); it != arguments.end(); ++it) {
+    types[it.key()] = argumentType(it.value());
+  }
+  return types;
+}
+
+// Describes scalars held in a file shared with the worker.
+QJsonObject sharedScalars(const QString& fileName, vtkDataArray* scalars)
+{
+  QJsonObject description;
+  description["path"] = fileName;
+  description["type"] = scalars->GetDataType();
+  // Counts go as integers, a double of a million is written as 1e+06, which
+  // Python reads as a float.
+  description["components"] =
+    QJsonValue(static_cast<qint64>(scalars->GetNumberOfComponents()));
+  description["tuples"] =
+    QJsonValue(static_cast<qint64>(scalars->GetNumberOfTuples()));
+  description["name"] = QString(scalars->GetName() ? scalars->GetName() : "");
+  return description;
+}
 }
 
 namespace tomviz {
@@ -91,6 +149,8 @@ OperatorPython::OperatorPython(QObject* parentObject)
     Label("Python Operator")
 {
   Python::initialize();
+  // Touch the service here so it is set up on the UI thread.
+  PythonService::instance();
 
   {
     Python python;
@@ -302,12 +362,17 @@ bool OperatorPython::applyTransform(vtkDataObject* data)
 
   Q_ASSERT(data);
 
-  Python::Object pydata = Python::VTK::GetObjectFromPointer(data);
+  bool handled = false;
+  bool success = this->applyTransformInWorker(data, handled);
+  if (handled) {
+    return success;
+  }
 
   Python::Object result;
   {
     Python python;
 
+    Python::Object pydata = Python::VTK::GetObjectFromPointer(data);
     Python::Tuple args(1);
     args.set(0, pydata);
 
@@ -393,6 +458,186 @@ bool OperatorPython::applyTransform(vtkDataObject* data)
   return !errorEncountered;
 }
 
+bool OperatorPython::applyTransformInWorker(vtkDataObject* data,
+                                            bool& handled)
+{
+  PythonService& service = PythonService::instance();
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  vtkDataArray* scalars =
+    image ? image->GetPointData()->GetScalars() : nullptr;
+  if (!service.isAvailable() || !scalars) {
+    return false;
+  }
+
+  QTemporaryDir directory(service.scratchPath() + "/tomviz-XXXXXX");
+  if (!directory.isValid()) {
+    return false;
+  }
+
+  // The scalars are copied once, into a file both processes map, and the
+  // worker transforms them there. Only their description goes through the
+  // pipe.
+  QString sharedInput = directory.filePath("input.raw");
+  vtkSmartPointer<vtkDataArray> shared = MappedVolume::share(
+    sharedInput, scalars->GetDataType(), scalars->GetNumberOfComponents(),
+    scalars->GetNumberOfTuples());
+  if (!shared) {
+    return false;
+  }
+  std::memcpy(shared->GetVoidPointer(0), scalars->GetVoidPointer(0),
+              scalars->GetDataSize() * scalars->GetDataTypeSize());
+
+  // The rest of the image, its structure, field data such as the tilt angles
+  // and any other point arrays, goes through a file.
+  vtkNew<vtkImageData> structure;
+  structure->CopyStructure(image);
+  structure->GetFieldData()->ShallowCopy(image->GetFieldData());
+  vtkPointData* pointData = image->GetPointData();
+  for (int i = 0; i < pointData->GetNumberOfArrays(); ++i) {
+    if (pointData->GetAbstractArray(i) != scalars) {
+      structure->GetPointData()->AddArray(pointData->GetAbstractArray(i));
+    }
+  }
+  QString input = directory.filePath("input.vti");
+  vtkNew<vtkXMLImageDataWriter> writer;
+  writer->SetFileName(input.toLocal8Bit().data());
+  writer->SetInputData(structure.Get());
+  writer->SetDataModeToAppended();
+  writer->EncodeAppendedDataOff();
+  writer->SetCompressorTypeToNone();
+  if (!writer->Write()) {
+    return false;
+  }
+
+  QJsonObject request;
+  request["label"] = this->label();
+  request["script"] = this->Script;
+  request["arguments"] = QJsonObject::fromVariantMap(m_arguments);
+  request["argument_types"] = argumentTypes(m_arguments);
+  request["directory"] = directory.path();
+  request["input"] = input;
+  request["output"] = directory.filePath("output.vti");
+  request["scalars"] = sharedScalars(sharedInput, scalars);
+  request["output_scalars"] = directory.filePath("output.raw");
+  QJsonArray results;
+  foreach (const QString& name, m_resultNames) {
+    results.append(name);
+  }
+  request["results"] = results;
+  QJsonArray children;
+  for (int i = 0; i < m_childDataSourceNamesAndLabels.size(); ++i) {
+    children.append(m_childDataSourceNamesAndLabels[i].first);
+  }
+  request["children"] = children;
+
+  QJsonObject reply = service.run(
+    request,
+    [this](const QJsonObject& progress) {
+      if (progress.contains("maximum")) {
+        this->setTotalProgressSteps(progress["maximum"].toInt());
+      }
+      if (progress.contains("value")) {
+        this->setProgressStep(progress["value"].toInt());
+      }
+      if (progress.contains("message")) {
+        this->setProgressMessage(progress["message"].toString());
+      }
+    },
+    [this]() { return this->isCanceled(); });
+
+  if (reply["unavailable"].toBool()) {
+    return false;
+  }
+  handled = true;
+  if (!reply["ok"].toBool()) {
+    if (!reply["canceled"].toBool()) {
+      qCritical().noquote() << reply["error"].toString();
+      qCritical("Failed to execute the script.");
+    }
+    return false;
+  }
+
+  vtkNew<vtkXMLImageDataReader> reader;
+  reader->SetFileName(request["output"].toString().toLocal8Bit().data());
+  reader->Update();
+  vtkImageData* output = reader->GetOutput();
+
+  // Scalars transformed in place are already in the shared input, new ones
+  // were written by the worker to a file of their own, and are used where
+  // they are rather than copied.
+  vtkSmartPointer<vtkDataArray> outputScalars;
+  QJsonObject description = reply["scalars"].toObject();
+  if (description["path"].toString() == sharedInput) {
+    outputScalars = shared;
+  } else if (!description.isEmpty()) {
+    outputScalars = MappedVolume::share(
+      description["path"].toString(), description["type"].toInt(),
+      description["components"].toInt(),
+      static_cast<vtkIdType>(description["tuples"].toVariant().toLongLong()));
+  }
+  if (!description.isEmpty() &&
+      (!outputScalars ||
+       outputScalars->GetNumberOfTuples() != output->GetNumberOfPoints())) {
+    qCritical("Failed to read the scalars transformed by the script.");
+    return false;
+  }
+  image->ShallowCopy(output);
+  if (outputScalars) {
+    QString name = description["name"].toString();
+    outputScalars->SetName(name.isEmpty() ? nullptr : name.toUtf8().data());
+    image->GetPointData()->SetScalars(outputScalars);
+  }
+
+  // Like in the interpreter, results are only looked for when the script
+  // returned a dictionary.
+  if (!reply["results"].isObject()) {
+    return true;
+  }
+
+  bool errorEncountered = false;
+  QJsonObject files = reply["results"].toObject();
+  for (int i = 0; i < m_resultNames.size(); ++i) {
+    vtkSmartPointer<vtkDataObject> result =
+      readResult(files[m_resultNames[i]].toString());
+    if (result) {
+      emit newOperatorResult(m_resultNames[i], result);
+    } else {
+      errorEncountered = true;
+      qCritical() << "No result named" << m_resultNames[i]
+                  << "defined in output dictionary.\n";
+    }
+  }
+  for (int i = 0; i < m_childDataSourceNamesAndLabels.size(); ++i) {
+    QPair<QString, QString> nameLabelPair =
+      m_childDataSourceNamesAndLabels[i];
+    vtkSmartPointer<vtkDataObject> child =
+      readResult(files[nameLabelPair.first].toString());
+    if (child) {
+      emit newChildDataSource(nameLabelPair.second, child);
+    } else {
+      errorEncountered = true;
+      qCritical() << "No child data source named '" << nameLabelPair.first
+                  << "' defined in output dictionary.\n";
+    }
+  }
+
+  return !errorEncountered;
+}
+
+vtkSmartPointer<vtkDataObject> OperatorPython::readResult(
+  const QString& fileName)
+{
+  vtkSmartPointer<vtkDataObject> result;
+  if (fileName.isEmpty()) {
+    return result;
+  }
+  vtkNew<vtkGenericDataObjectReader> reader;
+  reader->SetFileName(fileName.toLocal8Bit().data());
+  reader->Update();
+  result = reader->GetOutput();
+  return result;
+}
+
 Operator* OperatorPython::clone() const
 {
   OperatorPython* newClone = new OperatorPython();
@@ -69,6 +69,13 @@ signals:
 protected:
   bool applyTransform(vtkDataObject* data) override;
 
+private:
+  // Runs the transform in a worker process of the PythonService. Sets handled
+  // to false when no worker is available, the transform should then run in
+  // the embedded interpreter.
+  bool applyTransformInWorker(vtkDataObject* data, bool& handled);
+  static vtkSmartPointer<vtkDataObject> readResult(const QString& fileName);
+
 private slots:
   // Create a new child datasource and set it on this operator
   void createNewChildDataSource(const QString& label,
@@ -0,0 +1,29 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "Parallel.h"
+
+namespace tomviz {
+
+namespace Parallel {
+
+int threadCount()
+{
+  static const int count =
+    std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  return count;
+}
+}
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizParallel_h
+#define tomvizParallel_h
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace tomviz {
+
+namespace Parallel {
+
+/// Returns the number of threads data parallel loops should use. This is
+/// the number of cores on the machine, and is always at least one.
+int threadCount();
+
+/// Calls func(begin, end) for consecutive chunks of [first, last) of at most
+/// grain items. Chunks are claimed dynamically, so threads that finish early
+/// pick up the remaining work. The calling thread takes part in the work and
+/// the function returns once every chunk has been processed. The functor
+/// must be safe to call concurrently on disjoint ranges.
+template <typename Functor>
+void forRange(int first, int last, int grain, Functor&& func,
+              int threads = threadCount())
+{
+  if (last <= first) {
+    return;
+  }
+  grain = std::max(grain, 1);
+  int chunks = (last - first + grain - 1) / grain;
+  threads = std::max(1, std::min(threads, chunks));
+
+  std::atomic<int> next{ first };
+  auto worker = [&]() {
+    for (;;) {
+      int begin = next.fetch_add(grain);
+      if (begin >= last) {
+        break;
+      }
+      func(begin, std::min(begin + grain, last));
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (int i = 1; i < threads; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+}
+}
+
+#endif
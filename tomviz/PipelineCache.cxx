@@ -0,0 +1,167 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "PipelineCache.h"
+
+#include "CopyOnWrite.h"
+#include "Operator.h"
+#include "OperatorFactory.h"
+
+#include <pqApplicationCore.h>
+#include <pqSettings.h>
+#include <vtkDataObject.h>
+#include <vtk_pugixml.h>
+#include <vtksys/SystemInformation.hxx>
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+#include <functional>
+#include <sstream>
+#include <string>
+
+namespace tomviz {
+
+PipelineCache::PipelineCache()
+{
+  vtksys::SystemInformation info;
+  info.RunMemoryCheck();
+  qint64 megabytes = info.GetTotalPhysicalMemory() / 4;
+  if (auto core = pqApplicationCore::instance()) {
+    megabytes = core->settings()
+                  ->value("PipelineCacheMemoryBudget", megabytes)
+                  .toLongLong();
+  }
+  m_budget = megabytes * 1024 * 1024;
+}
+
+PipelineCache& PipelineCache::instance()
+{
+  static PipelineCache theInstance;
+  return theInstance;
+}
+
+QList<quint64> PipelineCache::keys(const QList<Operator*>& operators)
+{
+  QList<quint64> reply;
+  quint64 key = 0;
+  foreach (Operator* op, operators) {
+    pugi::xml_document document;
+    pugi::xml_node node = document.append_child("Operator");
+    const char* type = OperatorFactory::operatorType(op);
+    node.append_attribute("operator_type").set_value(type ? type : "");
+    op->serialize(node);
+    std::ostringstream stream;
+    document.save(stream);
+
+    // Chain the hashes so the key also changes when an earlier operator does.
+    quint64 hash = std::hash<std::string>()(stream.str());
+    key ^= hash + 0x9e3779b97f4a7c15ULL + (key << 6) + (key >> 2);
+    reply << key;
+  }
+  return reply;
+}
+
+void PipelineCache::insert(Operator* op, quint64 key, vtkDataObject* data)
+{
+  // GetActualMemorySize is in kibibytes.
+  qint64 bytes = static_cast<qint64>(data->GetActualMemorySize()) * 1024;
+  if (bytes > memoryBudget()) {
+    remove(op);
+    return;
+  }
+
+  // The snapshot shares arrays with the data, which will be copied before
+  // the next operator modifies them.
+  vtkSmartPointer<vtkDataObject> copy;
+  copy.TakeReference(CopyOnWrite::sharedCopy(data));
+
+  QMutexLocker lock(&m_mutex);
+  auto existing = m_entries.find(op);
+  if (existing != m_entries.end()) {
+    m_used -= existing->bytes;
+    m_entries.erase(existing);
+  }
+  makeRoom(bytes);
+  if (m_used + bytes > m_budget) {
+    return;
+  }
+  Entry entry = { key, copy, bytes, ++m_clock };
+  m_entries.insert(op, entry);
+  m_used += bytes;
+}
+
+vtkSmartPointer<vtkDataObject> PipelineCache::find(Operator* op, quint64 key)
+{
+  QMutexLocker lock(&m_mutex);
+  auto entry = m_entries.find(op);
+  if (entry == m_entries.end() || entry->key != key) {
+    return nullptr;
+  }
+  entry->lastUsed = ++m_clock;
+  return entry->data;
+}
+
+void PipelineCache::remove(Operator* op)
+{
+  QMutexLocker lock(&m_mutex);
+  auto entry = m_entries.find(op);
+  if (entry != m_entries.end()) {
+    m_used -= entry->bytes;
+    m_entries.erase(entry);
+  }
+}
+
+void PipelineCache::remove(const QList<Operator*>& operators)
+{
+  foreach (Operator* op, operators) {
+    remove(op);
+  }
+}
+
+void PipelineCache::setMemoryBudget(qint64 bytes)
+{
+  QMutexLocker lock(&m_mutex);
+  m_budget = std::max(bytes, qint64(0));
+  makeRoom(0);
+}
+
+qint64 PipelineCache::memoryBudget() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_budget;
+}
+
+qint64 PipelineCache::memoryUsed() const
+{
+  QMutexLocker lock(&m_mutex);
+  return m_used;
+}
+
+void PipelineCache::makeRoom(qint64 bytes)
+{
+  while (!m_entries.isEmpty() && m_used + bytes > m_budget) {
+    auto oldest = m_entries.begin();
+    for (auto entry = m_entries.begin(); entry != m_entries.end(); ++entry) {
+      if (entry->lastUsed < oldest->lastUsed) {
+        oldest = entry;
+      }
+    }
+    m_used -= oldest->bytes;
+    m_entries.erase(oldest);
+  }
+}
+}
@@ -0,0 +1,94 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizPipelineCache_h
+#define tomvizPipelineCache_h
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+
+#include <vtkSmartPointer.h>
+
+class vtkDataObject;
+
+namespace tomviz {
+
+class Operator;
+
+/// Keeps a snapshot of the data each operator of a pipeline produced, so that
+/// editing an operator only re-executes it and the operators after it. Each
+/// snapshot is stored with a key covering the parameters of its operator and
+/// every operator before it, so a snapshot is only found while nothing that
+/// produced it has changed. The snapshots of all data sources share one
+/// memory budget, and the least recently used ones are evicted to stay
+/// within it.
+class PipelineCache
+{
+public:
+  static PipelineCache& instance();
+
+  /// Returns the key of the state of the pipeline after each operator, which
+  /// depends on the type and parameters of the operator and those before it.
+  static QList<quint64> keys(const QList<Operator*>& operators);
+
+  /// Stores a copy of data as the output of op. This is called from the
+  /// pipeline worker threads. Data larger than the budget is not stored.
+  void insert(Operator* op, quint64 key, vtkDataObject* data);
+
+  /// Returns the output of op stored with the given key, or nullptr. The
+  /// snapshot is shared with the cache and must not be modified.
+  vtkSmartPointer<vtkDataObject> find(Operator* op, quint64 key);
+
+  /// Drops the snapshots of the given operators, use when they are edited or
+  /// removed.
+  void remove(Operator* op);
+  void remove(const QList<Operator*>& operators);
+
+  /// The memory available for snapshots in bytes, zero disables the cache.
+  /// Defaults to the "PipelineCacheMemoryBudget" setting in megabytes, or a
+  /// quarter of the physical memory.
+  void setMemoryBudget(qint64 bytes);
+  qint64 memoryBudget() const;
+
+  /// The memory used by the snapshots in bytes.
+  qint64 memoryUsed() const;
+
+private:
+  PipelineCache();
+
+  struct Entry
+  {
+    quint64 key;
+    vtkSmartPointer<vtkDataObject> data;
+    qint64 bytes;
+    quint64 lastUsed;
+  };
+
+  // Evicts least recently used entries until bytes more fit in the budget.
+  // Must be called with the mutex held.
+  void makeRoom(qint64 bytes);
+
+  mutable QMutex m_mutex;
+  QMap<Operator*, Entry> m_entries;
+  qint64 m_budget = 0;
+  qint64 m_used = 0;
+  quint64 m_clock = 0;
+
+  Q_DISABLE_COPY(PipelineCache)
+};
+}
+
+#endif
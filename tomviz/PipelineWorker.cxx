@@ -14,16 +14,42 @@
 
 ******************************************************************************/
 #include "PipelineWorker.h"
+#include "CopyOnWrite.h"
 #include "Operator.h"
+#include "Parallel.h"
+#include "PointwiseOperator.h"
 
 #include <QObject>
 #include <QQueue>
 #include <QRunnable>
+#include <QThread>
 #include <QThreadPool>
 #include <QTimer>
 
 #include <vtkDataObject.h>
 
+#include <atomic>
+
+namespace {
+
+// Operators being run by all the pipeline workers, the cores available to
+// data parallel operators are shared between them.
+std::atomic<int> runningOperators{ 0 };
+
+// Pipelines run on their own pool rather than the global one, with a thread
+// for each core so that pipelines of independent data sources run
+// concurrently.
+QThreadPool* pipelineThreadPool()
+{
+  static QThreadPool* pool = nullptr;
+  if (!pool) {
+    pool = new QThreadPool;
+    pool->setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+  }
+  return pool;
+}
+}
+
 namespace tomviz {
 
 class PipelineWorker::RunnableOperator : public QObject, public QRunnable
@@ -32,11 +58,18 @@ class PipelineWorker::RunnableOperator : public QObject, public QRunnable
 
 public:
   RunnableOperator(Operator* op, vtkDataObject* input,
-                   QObject* parent = nullptr);
+                   const Checkpoint& checkpoint, QObject* parent = nullptr);
 
   /// Returns the data the operator operates on
   vtkDataObject* data() { return m_data; };
-  Operator* op() { return m_operator; };
+  Operator* op() { return m_operators.first(); };
+  /// Returns the operators run, more than one when they have been fused
+  const QList<Operator*>& operators() { return m_operators; }
+  /// Appends the operator of next to the ones run if they can all be run in
+  /// a single pass over the data, returns false otherwise.
+  bool fuse(RunnableOperator* next);
+  /// Returns the number of bytes copied to give the operator private arrays
+  qint64 bytesCopied() { return m_bytesCopied; }
   void run() override;
   void cancel();
   bool isCanceled();
@@ -45,8 +78,10 @@ signals:
   void complete(TransformResult result);
 
 private:
-  Operator* m_operator;
+  QList<Operator*> m_operators;
   vtkDataObject* m_data;
+  Checkpoint m_checkpoint;
+  qint64 m_bytesCopied = 0;
   Q_DISABLE_COPY(RunnableOperator)
 };
 
@@ -63,7 +98,8 @@ class PipelineWorker::Run : public QObject
   };
 
 public:
-  Run(vtkDataObject* data, QList<Operator*> operators);
+  Run(vtkDataObject* data, QList<Operator*> operators,
+      const Checkpoint& checkpoint);
 
   /// Clear all Operators from the queue and attempts to cancel the
   /// running Operator.
@@ -82,6 +118,9 @@ public:
   /// Returns the data object being used for this run.
   vtkDataObject* data() { return m_data; };
 
+  /// Returns the number of bytes copied by the operators that have run.
+  qint64 bytesCopied() { return m_bytesCopied; }
+
   /// Start the pipeline execution
   Future* start();
 
@@ -98,55 +137,89 @@ signals:
 private:
   RunnableOperator* m_running = nullptr;
   vtkDataObject* m_data;
+  Checkpoint m_checkpoint;
   QQueue<RunnableOperator*> m_runnableOperators;
   QList<RunnableOperator*> m_complete;
   State m_state = State::CREATED;
+  qint64 m_bytesCopied = 0;
 };
 
 #include "PipelineWorker.moc"
 
 PipelineWorker::RunnableOperator::RunnableOperator(Operator* op,
                                                    vtkDataObject* data,
+                                                   const Checkpoint& checkpoint,
                                                    QObject* parent)
-  : QObject(parent), m_operator(op), m_data(data)
+  : QObject(parent), m_data(data), m_checkpoint(checkpoint)
 {
+  m_operators << op;
   this->setAutoDelete(false);
 }
 
-void PipelineWorker::RunnableOperator::run()
+bool PipelineWorker::RunnableOperator::fuse(RunnableOperator* next)
 {
+  foreach (Operator* op, m_operators + next->operators()) {
+    if (!qobject_cast<PointwiseOperator*>(op)) {
+      return false;
+    }
+  }
+  m_operators << next->op();
+  return true;
+}
 
-  TransformResult result = m_operator->transform(m_data);
+void PipelineWorker::RunnableOperator::run()
+{
+  ++runningOperators;
+  // The data may share arrays with the data source or the pipeline cache,
+  // copy them before they are modified.
+  foreach (Operator* op, m_operators) {
+    if (op->writesArraysInPlace()) {
+      m_bytesCopied = CopyOnWrite::detach(m_data);
+      break;
+    }
+  }
+  TransformResult result;
+  if (qobject_cast<PointwiseOperator*>(op())) {
+    QList<PointwiseOperator*> ops;
+    foreach (Operator* op, m_operators) {
+      ops << qobject_cast<PointwiseOperator*>(op);
+    }
+    int threads = std::max(1, Parallel::threadCount() / runningOperators);
+    result = PointwiseOperator::transformFused(ops, m_data, threads);
+  } else {
+    result = op()->transform(m_data);
+  }
+  if (result == TransformResult::Complete && m_checkpoint) {
+    m_checkpoint(m_operators.last(), m_data);
+  }
+  --runningOperators;
   emit complete(result);
 }
 
 void PipelineWorker::RunnableOperator::cancel()
 {
-  m_operator->cancelTransform();
+  foreach (Operator* op, m_operators) {
+    op->cancelTransform();
+  }
 }
 
 bool PipelineWorker::RunnableOperator::isCanceled()
 {
-  return m_operator->isCanceled();
-}
-
-PipelineWorker::ConfigureThreadPool::ConfigureThreadPool()
-{
-  auto threads = QThread::idealThreadCount();
-  if (threads < 1) {
-    threads = 1;
-  } else {
-    // Use half the threads we have available.
-    threads = threads / 2;
+  foreach (Operator* op, m_operators) {
+    if (op->isCanceled()) {
+      return true;
+    }
   }
-  QThreadPool::globalInstance()->setMaxThreadCount(threads);
+  return false;
 }
 
-PipelineWorker::Run::Run(vtkDataObject* data, QList<Operator*> operators)
-  : m_data(data)
+PipelineWorker::Run::Run(vtkDataObject* data, QList<Operator*> operators,
+                         const Checkpoint& checkpoint)
+  : m_data(data), m_checkpoint(checkpoint)
 {
   foreach (auto op, operators) {
-    m_runnableOperators.enqueue(new RunnableOperator(op, m_data, this));
+    m_runnableOperators.enqueue(
+      new RunnableOperator(op, m_data, m_checkpoint, this));
   }
 }
 
@@ -168,9 +241,14 @@ void PipelineWorker::Run::startNextOperator()
 
   if (!m_runnableOperators.isEmpty()) {
     m_running = m_runnableOperators.dequeue();
+    // Consecutive point-wise operators are run in a single pass.
+    while (!m_runnableOperators.isEmpty() &&
+           m_running->fuse(m_runnableOperators.head())) {
+      m_runnableOperators.dequeue()->deleteLater();
+    }
     connect(m_running, &RunnableOperator::complete, this,
             &PipelineWorker::Run::operatorComplete);
-    QThreadPool::globalInstance()->start(m_running);
+    pipelineThreadPool()->start(m_running);
   }
 }
 
@@ -179,6 +257,7 @@ void PipelineWorker::Run::operatorComplete(TransformResult transformResult)
   auto runnableOperator = qobject_cast<RunnableOperator*>(this->sender());
 
   m_complete.append(runnableOperator);
+  m_bytesCopied += runnableOperator->bytesCopied();
 
   bool result = transformResult == TransformResult::Complete;
   // Canceled
@@ -206,7 +285,7 @@ void PipelineWorker::Run::cancel()
 {
   // Try to cancel the currently running operator
   if (m_running != nullptr) {
-    QThreadPool::globalInstance()->cancel(m_running);
+    pipelineThreadPool()->cancel(m_running);
     m_running->cancel();
     m_running = nullptr;
   }
@@ -219,7 +298,7 @@ bool PipelineWorker::Run::cancel(Operator* op)
 
   // If the operator is currently running we just have to cancel the execution
   // of the whole pipeline.
-  if (m_running->op() == op) {
+  if (m_running && m_running->operators().contains(op)) {
     this->cancel();
     return false;
   }
@@ -245,28 +324,31 @@ bool PipelineWorker::Run::addOperator(Operator* op)
     return false;
   }
 
-  m_runnableOperators.enqueue(new RunnableOperator(op, m_data, this));
+  m_runnableOperators.enqueue(
+    new RunnableOperator(op, m_data, m_checkpoint, this));
 
   return true;
 }
 
-PipelineWorker::Future* PipelineWorker::run(vtkDataObject* data, Operator* op)
+PipelineWorker::Future* PipelineWorker::run(vtkDataObject* data, Operator* op,
+                                            Checkpoint checkpoint)
 {
   QList<Operator*> ops;
   ops << op;
 
-  return this->run(data, ops);
+  return this->run(data, ops, checkpoint);
 }
 
 PipelineWorker::Future* PipelineWorker::run(vtkDataObject* data,
-                                            QList<Operator*> operators)
+                                            QList<Operator*> operators,
+                                            Checkpoint checkpoint)
 {
   // Set all the operators in the queued state
   foreach (Operator* op, operators) {
     op->resetState();
   }
 
-  Run* run = new Run(data, operators);
+  Run* run = new Run(data, operators, checkpoint);
 
   return run->start();
 }
@@ -301,6 +383,11 @@ vtkDataObject* PipelineWorker::Future::result()
   return m_run->data();
 }
 
+qint64 PipelineWorker::Future::bytesCopied()
+{
+  return m_run->bytesCopied();
+}
+
 bool PipelineWorker::Future::addOperator(Operator* op)
 {
   return m_run->addOperator(op);
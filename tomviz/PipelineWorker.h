@@ -20,34 +20,39 @@
 #include <QObject>
 #include <QRunnable>
 
+#include <functional>
+
 class vtkDataObject;
 
 namespace tomviz {
 
 class Operator;
 
-/// Responsible for running Operator in a separate thread. Backed by the
-/// QThreadPool. Operators are run in sequence, one at a time.
+/// Responsible for running Operator in a separate thread. Backed by a
+/// QThreadPool shared by all the workers, so the pipelines of different data
+/// sources run concurrently. Operators are run in sequence, one at a time,
+/// except that consecutive PointwiseOperators are run together in a single
+/// pass over the data.
 class PipelineWorker : public QObject
 {
   Q_OBJECT
 
 public:
   class Future;
+
+  /// Called on the worker thread with each operator that completes and the
+  /// data it produced, before the next operator runs.
+  typedef std::function<void(Operator*, vtkDataObject*)> Checkpoint;
+
   PipelineWorker(QObject* parent = nullptr);
-  Future* run(vtkDataObject* data, Operator* op);
-  Future* run(vtkDataObject* data, QList<Operator*> ops);
+  Future* run(vtkDataObject* data, Operator* op,
+              Checkpoint checkpoint = Checkpoint());
+  Future* run(vtkDataObject* data, QList<Operator*> ops,
+              Checkpoint checkpoint = Checkpoint());
 
 private:
   class RunnableOperator;
   class Run;
-  class ConfigureThreadPool
-  {
-  public:
-    ConfigureThreadPool();
-  };
-
-  ConfigureThreadPool configure;
 };
 
 class PipelineWorker::Future : public QObject
@@ -69,6 +74,10 @@ public:
 
   vtkDataObject* result();
 
+  /// Returns the number of bytes of array data the operators that have run
+  /// copied before modifying it in place.
+  qint64 bytesCopied();
+
   /// If the execution of the pipeline is still in progress then add this
   /// operator to it. Return true is
   bool addOperator(Operator* op);
@@ -0,0 +1,372 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "PointwiseOperator.h"
+
+#include "EditOperatorWidget.h"
+#include "Parallel.h"
+#include "VolumeBufferPool.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+
+#include <QDebug>
+#include <QDoubleSpinBox>
+#include <QFormLayout>
+#include <QPointer>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Serialized names and labels of the functions, in enum order.
+const char* functionNames[] = { "add-constant", "invert", "square-root",
+                                "clamp-negative" };
+const char* functionLabels[] = { "Add a Constant", "Invert Data",
+                                 "Square Root Data",
+                                 "Set Negative Voxels to Zero" };
+const int numberOfFunctions =
+  sizeof(functionNames) / sizeof(functionNames[0]);
+
+// Values are mapped a block at a time, so that every operator in a fused
+// pass works on data that is still in cache.
+const int blockSize = 4096;
+
+class AddConstantWidget : public tomviz::EditOperatorWidget
+{
+  Q_OBJECT
+
+public:
+  AddConstantWidget(tomviz::PointwiseOperator* op, QWidget* p)
+    : tomviz::EditOperatorWidget(p), m_operator(op)
+  {
+    m_constant = new QDoubleSpinBox(this);
+    m_constant->setRange(-1e9, 1e9);
+    m_constant->setDecimals(3);
+    m_constant->setValue(op->constant());
+
+    QFormLayout* layout = new QFormLayout;
+    layout->addRow("Constant", m_constant);
+    setLayout(layout);
+  }
+
+  void applyChangesToOperator() override
+  {
+    if (m_operator) {
+      m_operator->setConstant(m_constant->value());
+    }
+  }
+
+private:
+  QPointer<tomviz::PointwiseOperator> m_operator;
+  QDoubleSpinBox* m_constant;
+};
+
+template <typename In, typename Out, typename Chain, typename Canceled>
+void mapBlocks(const In* in, Out* out, vtkIdType count, const Chain& chain,
+               const Canceled& canceled, int threads)
+{
+  int blocks = static_cast<int>((count + blockSize - 1) / blockSize);
+  auto mapRange = [&](int begin, int end) {
+    double values[blockSize];
+    for (int b = begin; b < end && !canceled(); ++b) {
+      vtkIdType first = static_cast<vtkIdType>(b) * blockSize;
+      int n = static_cast<int>(std::min<vtkIdType>(blockSize, count - first));
+      for (int i = 0; i < n; ++i) {
+        values[i] = in[first + i];
+      }
+      chain(values, n);
+      for (int i = 0; i < n; ++i) {
+        out[first + i] = static_cast<Out>(values[i]);
+      }
+    }
+  };
+  tomviz::Parallel::forRange(0, blocks, 16, mapRange, threads);
+}
+
+template <typename In, typename Chain, typename Canceled>
+void mapScalars(const In* in, vtkDataArray* output, vtkIdType count,
+                const Chain& chain, const Canceled& canceled, int threads)
+{
+  void* out = output->GetVoidPointer(0);
+  switch (output->GetDataType()) {
+    case VTK_FLOAT:
+      mapBlocks(in, static_cast<float*>(out), count, chain, canceled,
+                threads);
+      break;
+    case VTK_DOUBLE:
+      mapBlocks(in, static_cast<double*>(out), count, chain, canceled,
+                threads);
+      break;
+    default:
+      // In place, the output is the input array.
+      mapBlocks(in, static_cast<In*>(out), count, chain, canceled, threads);
+      break;
+  }
+}
+}
+
+#include "PointwiseOperator.moc"
+
+namespace tomviz {
+
+PointwiseOperator::PointwiseOperator(Function function, QObject* p)
+  : Operator(p), m_function(function)
+{
+  setSupportsCancel(true);
+}
+
+QString PointwiseOperator::label() const
+{
+  return functionLabels[static_cast<int>(m_function)];
+}
+
+QIcon PointwiseOperator::icon() const
+{
+  // The same icon as the Python operators these functions used to be.
+  return QIcon(":/pqWidgets/Icons/pqProgrammableFilter24.png");
+}
+
+Operator* PointwiseOperator::clone() const
+{
+  auto other = new PointwiseOperator(m_function);
+  other->setConstant(m_constant);
+  return other;
+}
+
+bool PointwiseOperator::serialize(pugi::xml_node& ns) const
+{
+  ns.append_attribute("function").set_value(
+    functionNames[static_cast<int>(m_function)]);
+  if (m_function == Function::AddConstant) {
+    ns.append_attribute("constant").set_value(m_constant);
+  }
+  return true;
+}
+
+bool PointwiseOperator::deserialize(const pugi::xml_node& ns)
+{
+  const char* name = ns.attribute("function").value();
+  for (int i = 0; i < numberOfFunctions; ++i) {
+    if (strcmp(name, functionNames[i]) == 0) {
+      m_function = static_cast<Function>(i);
+    }
+  }
+  setConstant(ns.attribute("constant").as_double(0.0));
+  return true;
+}
+
+EditOperatorWidget* PointwiseOperator::getEditorContents(QWidget* p)
+{
+  if (m_function != Function::AddConstant) {
+    return nullptr;
+  }
+  return new AddConstantWidget(this, p);
+}
+
+void PointwiseOperator::setConstant(double constant)
+{
+  m_constant = constant;
+  emit transformModified();
+}
+
+void PointwiseOperator::mapRange(double range[2]) const
+{
+  switch (m_function) {
+    case Function::AddConstant:
+      range[0] += m_constant;
+      range[1] += m_constant;
+      break;
+    case Function::Invert:
+      range[1] = range[1] - range[0];
+      range[0] = 0.0;
+      break;
+    case Function::SquareRoot:
+      // Square roots of negative values would be NaN, leave them be.
+      if (range[0] >= 0.0) {
+        range[0] = std::sqrt(range[0]);
+        range[1] = std::sqrt(range[1]);
+      }
+      break;
+    case Function::ClampNegative:
+      range[0] = std::max(range[0], 0.0);
+      range[1] = std::max(range[1], 0.0);
+      break;
+  }
+}
+
+bool PointwiseOperator::producesIntegers(const double range[2]) const
+{
+  switch (m_function) {
+    case Function::AddConstant:
+      return std::floor(m_constant) == m_constant;
+    case Function::SquareRoot:
+      return range[0] < 0.0;
+    case Function::ClampNegative:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void PointwiseOperator::map(double* values, int count,
+                            const double range[2]) const
+{
+  switch (m_function) {
+    case Function::AddConstant:
+      for (int i = 0; i < count; ++i) {
+        values[i] += m_constant;
+      }
+      break;
+    case Function::Invert:
+      for (int i = 0; i < count; ++i) {
+        values[i] = range[1] - values[i];
+      }
+      break;
+    case Function::SquareRoot:
+      if (range[0] >= 0.0) {
+        for (int i = 0; i < count; ++i) {
+          values[i] = std::sqrt(values[i]);
+        }
+      }
+      break;
+    case Function::ClampNegative:
+      for (int i = 0; i < count; ++i) {
+        values[i] = std::max(values[i], 0.0);
+      }
+      break;
+  }
+}
+
+TransformResult PointwiseOperator::transformFused(
+  const QList<PointwiseOperator*>& ops, vtkDataObject* data, int threads)
+{
+  if (ops.isEmpty()) {
+    return TransformResult::Complete;
+  }
+
+  // The first operator maps the values for all of them, the others then
+  // only go through their states.
+  PointwiseOperator* first = ops.first();
+  first->m_fused = ops;
+  first->m_threads = threads;
+  TransformResult result = first->transform(data);
+  first->m_fused.clear();
+  for (int i = 1; i < ops.size() && result == TransformResult::Complete;
+       ++i) {
+    ops[i]->m_appliedByFusion = true;
+    result = ops[i]->transform(data);
+    ops[i]->m_appliedByFusion = false;
+  }
+  return result;
+}
+
+bool PointwiseOperator::applyTransform(vtkDataObject* data)
+{
+  if (m_appliedByFusion) {
+    return true;
+  }
+  QList<PointwiseOperator*> ops = m_fused;
+  int threads = m_threads;
+  if (ops.isEmpty()) {
+    ops << this;
+    threads = Parallel::threadCount();
+  }
+
+  vtkImageData* imageData = vtkImageData::SafeDownCast(data);
+  if (!imageData) {
+    return false;
+  }
+  vtkDataArray* scalars = imageData->GetPointData()->GetScalars();
+  if (!scalars) {
+    qCritical() << "No scalars found!";
+    return false;
+  }
+
+  // Each operator is given the range of its input, which the ones before it
+  // determine. They are all monotonic, so the ranges are exact.
+  int components = scalars->GetNumberOfComponents();
+  double range[2];
+  scalars->GetRange(range, 0);
+  for (int c = 1; c < components; ++c) {
+    double componentRange[2];
+    scalars->GetRange(componentRange, c);
+    range[0] = std::min(range[0], componentRange[0]);
+    range[1] = std::max(range[1], componentRange[1]);
+  }
+  int dataType = scalars->GetDataType();
+  bool inPlace = dataType != VTK_FLOAT && dataType != VTK_DOUBLE;
+  std::vector<std::array<double, 2>> ranges;
+  foreach (PointwiseOperator* op, ops) {
+    if (op->m_function == Function::SquareRoot && range[0] < 0.0) {
+      qWarning() << "Square root of negative values results in NaN, the"
+                 << "data was left unchanged";
+    }
+    inPlace = inPlace && op->producesIntegers(range);
+    ranges.push_back({ { range[0], range[1] } });
+    op->mapRange(range);
+  }
+  if (dataType == VTK_FLOAT || dataType == VTK_DOUBLE) {
+    inPlace = true;
+  } else {
+    inPlace = inPlace && range[0] >= scalars->GetDataTypeMin() &&
+              range[1] <= scalars->GetDataTypeMax();
+  }
+
+  vtkSmartPointer<vtkDataArray> output = scalars;
+  if (!inPlace) {
+    output.TakeReference(VolumeBufferPool::newArray(
+      VTK_FLOAT, components, scalars->GetNumberOfTuples()));
+    output->SetName(scalars->GetName());
+  }
+
+  auto chain = [&](double* values, int count) {
+    for (int i = 0; i < ops.size(); ++i) {
+      ops[i]->map(values, count, ranges[i].data());
+    }
+  };
+  auto canceled = [&]() {
+    foreach (PointwiseOperator* op, ops) {
+      if (op->isCanceled()) {
+        return true;
+      }
+    }
+    return false;
+  };
+  vtkIdType count = scalars->GetNumberOfTuples() * components;
+  switch (dataType) {
+    vtkTemplateMacro(mapScalars(
+      static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), output, count,
+      chain, canceled, threads));
+  }
+  if (canceled()) {
+    return false;
+  }
+
+  if (inPlace) {
+    scalars->Modified();
+  } else {
+    imageData->GetPointData()->RemoveArray(scalars->GetName());
+    imageData->GetPointData()->SetScalars(output);
+  }
+  return true;
+}
+}
@@ -0,0 +1,88 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizPointwiseOperator_h
+#define tomvizPointwiseOperator_h
+
+#include "Operator.h"
+
+namespace tomviz {
+
+/// Operator that maps every voxel value independently of the others. The
+/// pipeline worker fuses consecutive point-wise operators into a single pass
+/// over the data, split into chunks across threads.
+class PointwiseOperator : public Operator
+{
+  Q_OBJECT
+
+public:
+  enum class Function
+  {
+    AddConstant,
+    Invert,
+    SquareRoot,
+    ClampNegative
+  };
+
+  PointwiseOperator(Function function = Function::AddConstant,
+                    QObject* parent = nullptr);
+
+  QString label() const override;
+  QIcon icon() const override;
+  Operator* clone() const override;
+  bool serialize(pugi::xml_node& ns) const override;
+  bool deserialize(const pugi::xml_node& ns) override;
+  EditOperatorWidget* getEditorContents(QWidget* parent) override;
+  bool hasCustomUI() const override
+  {
+    return m_function == Function::AddConstant;
+  }
+
+  Function function() const { return m_function; }
+
+  void setConstant(double constant);
+  double constant() const { return m_constant; }
+
+  /// Runs the operators, in order, on the scalars of data in a single pass
+  /// using the given number of threads. Each operator goes through the
+  /// usual transform states, and the first failure or cancellation stops
+  /// the ones after it. Returns the result of the last operator run.
+  static TransformResult transformFused(const QList<PointwiseOperator*>& ops,
+                                        vtkDataObject* data, int threads);
+
+protected:
+  bool applyTransform(vtkDataObject* data) override;
+
+private:
+  Q_DISABLE_COPY(PointwiseOperator)
+
+  /// Replaces range, the range of the values given to map(), with the range
+  /// of the values it produces.
+  void mapRange(double range[2]) const;
+  /// Returns true if the values produced for an input in range are integers
+  /// whenever the input values are.
+  bool producesIntegers(const double range[2]) const;
+  /// Maps count values in place, range is the range of the input values.
+  void map(double* values, int count, const double range[2]) const;
+
+  Function m_function;
+  double m_constant = 0.0;
+  QList<PointwiseOperator*> m_fused;
+  int m_threads = 1;
+  bool m_appliedByFusion = false;
+};
+}
+
+#endif
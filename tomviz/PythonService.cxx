@@ -0,0 +1,367 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "PythonService.h"
+
+#include "Parallel.h"
+#include "PythonUtilities.h"
+
+#include <pqApplicationCore.h>
+#include <pqSettings.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QThread>
+#include <QWaitCondition>
+#include <QtDebug>
+
+#include <algorithm>
+
+namespace tomviz {
+
+struct PythonService::Call
+{
+  QJsonObject request;
+  Progress progress;
+
+  QMutex mutex;
+  QWaitCondition finished;
+  bool done = false;
+  QJsonObject reply;
+};
+
+struct PythonService::Worker
+{
+  QProcess* process = nullptr;
+  QByteArray buffer;
+  std::shared_ptr<Call> call;
+  bool ready = false;
+};
+
+namespace {
+
+QByteArray line(const QJsonObject& message)
+{
+  return QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n';
+}
+
+QJsonObject failure(const char* key, const QString& error)
+{
+  QJsonObject reply;
+  reply["ok"] = false;
+  reply[key] = true;
+  reply["error"] = error;
+  return reply;
+}
+}
+
+PythonService::PythonService()
+{
+  int workers = std::min(4, std::max(1, Parallel::threadCount() / 2));
+  QString program;
+  if (auto core = pqApplicationCore::instance()) {
+    workers =
+      core->settings()->value("PythonWorkerProcesses", workers).toInt();
+    program = core->settings()->value("PythonWorkerExecutable").toString();
+  }
+  m_maxWorkers = std::max(workers, 0);
+  if (m_maxWorkers == 0) {
+    return;
+  }
+
+  // The embedded interpreter knows which Python installation VTK, NumPy and
+  // the operator modules belong to.
+  QString command;
+  Python::initialize();
+  {
+    Python python;
+    Python::Module module = python.import("tomviz._worker");
+    if (module.isValid()) {
+      Python::Function function = module.findFunction("worker_command");
+      if (function.isValid()) {
+        Python::Tuple args(0);
+        command = function.call(args).toString();
+      }
+    }
+  }
+
+  QJsonObject description =
+    QJsonDocument::fromJson(command.toUtf8()).object();
+  m_program = program.isEmpty() ? description["program"].toString() : program;
+  foreach (const QJsonValue& argument, description["arguments"].toArray()) {
+    m_arguments << argument.toString();
+  }
+  m_pythonPath = description["pythonpath"].toString();
+  if (m_program.isEmpty()) {
+    qWarning() << "No Python executable found to run operators in, they will "
+                  "run in the application.";
+    return;
+  }
+
+  m_thread = new QThread;
+  m_thread->setObjectName("PythonService");
+  moveToThread(m_thread);
+  m_thread->start();
+  m_available = true;
+
+  if (auto application = QCoreApplication::instance()) {
+    connect(application, &QCoreApplication::aboutToQuit, this,
+            &PythonService::shutdown, Qt::BlockingQueuedConnection);
+  }
+}
+
+PythonService::~PythonService() = default;
+
+PythonService& PythonService::instance()
+{
+  // Like the pipeline thread pool, the service lives as long as the process.
+  static PythonService* theInstance = new PythonService;
+  return *theInstance;
+}
+
+QJsonObject PythonService::run(QJsonObject request, Progress progress,
+                               Canceled canceled)
+{
+  if (!m_available) {
+    return failure("unavailable", "No Python worker is available.");
+  }
+
+  int id = ++m_nextId;
+  request["id"] = id;
+  auto call = std::make_shared<Call>();
+  call->request = request;
+  call->progress = progress;
+  {
+    QMutexLocker locker(&m_mutex);
+    m_pending.append(call);
+  }
+  QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
+
+  bool cancelSent = false;
+  QMutexLocker locker(&call->mutex);
+  while (!call->done) {
+    call->finished.wait(&call->mutex, 100);
+    if (!call->done && !cancelSent && canceled && canceled()) {
+      cancelSent = true;
+      QMetaObject::invokeMethod(this, "cancel", Qt::QueuedConnection,
+                                Q_ARG(int, id));
+    }
+  }
+  return call->reply;
+}
+
+QString PythonService::scratchPath() const
+{
+#ifdef Q_OS_LINUX
+  // Files in a tmpfs never touch the disk, the workers read and write the
+  // volumes in shared memory.
+  QFileInfo shm("/dev/shm");
+  if (shm.isDir() && shm.isWritable()) {
+    return shm.absoluteFilePath();
+  }
+#endif
+  return QDir::tempPath();
+}
+
+void PythonService::dispatch()
+{
+  int starting = 0;
+  foreach (Worker* worker, m_workers) {
+    if (!worker->ready) {
+      ++starting;
+      continue;
+    }
+    if (worker->call) {
+      continue;
+    }
+    QMutexLocker locker(&m_mutex);
+    if (m_pending.isEmpty()) {
+      return;
+    }
+    worker->call = m_pending.takeFirst();
+    locker.unlock();
+    worker->process->write(line(worker->call->request));
+  }
+
+  // Requests left over are sent as the workers started for them are ready.
+  int waiting = 0;
+  {
+    QMutexLocker locker(&m_mutex);
+    waiting = m_pending.size();
+  }
+  while (m_available && waiting > starting &&
+         m_workers.size() < m_maxWorkers) {
+    startWorker();
+    ++starting;
+  }
+}
+
+void PythonService::cancel(int id)
+{
+  {
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < m_pending.size(); ++i) {
+      if (m_pending[i]->request["id"].toInt() == id) {
+        auto call = m_pending.takeAt(i);
+        locker.unlock();
+        complete(call, failure("canceled", "The request was canceled."));
+        return;
+      }
+    }
+  }
+
+  foreach (Worker* worker, m_workers) {
+    if (worker->call && worker->call->request["id"].toInt() == id) {
+      QJsonObject message;
+      message["cancel"] = id;
+      worker->process->write(line(message));
+    }
+  }
+}
+
+void PythonService::shutdown()
+{
+  m_available = false;
+  foreach (Worker* worker, m_workers) {
+    worker->process->disconnect(this);
+    // The workers exit when their input is closed.
+    worker->process->closeWriteChannel();
+    if (!worker->process->waitForFinished(1000)) {
+      worker->process->kill();
+      worker->process->waitForFinished();
+    }
+    if (worker->call) {
+      complete(worker->call, failure("canceled", "The application quit."));
+    }
+    delete worker->process;
+    delete worker;
+  }
+  m_workers.clear();
+  m_thread->quit();
+}
+
+void PythonService::startWorker()
+{
+  auto worker = new Worker;
+  worker->process = new QProcess(this);
+  m_workers.append(worker);
+
+  QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+  environment.insert("PYTHONPATH", m_pythonPath);
+  worker->process->setProcessEnvironment(environment);
+
+  connect(worker->process, &QProcess::readyReadStandardOutput, this,
+          [this, worker]() { readReplies(worker); });
+  connect(worker->process, &QProcess::readyReadStandardError, this,
+          [worker]() {
+            // Whatever the operators print ends up here.
+            qDebug().noquote()
+              << worker->process->readAllStandardError().trimmed();
+          });
+  connect(worker->process, &QProcess::errorOccurred, this,
+          [this, worker](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart ||
+                error == QProcess::Crashed) {
+              workerExited(worker);
+            }
+          });
+  connect(worker->process,
+          static_cast<void (QProcess::*)(int, QProcess::ExitStatus)>(
+            &QProcess::finished),
+          this, [this, worker]() { workerExited(worker); });
+
+  worker->process->start(m_program, m_arguments);
+}
+
+void PythonService::readReplies(Worker* worker)
+{
+  worker->buffer += worker->process->readAllStandardOutput();
+  int end;
+  while ((end = worker->buffer.indexOf('\n')) >= 0) {
+    QJsonObject message =
+      QJsonDocument::fromJson(worker->buffer.left(end)).object();
+    worker->buffer.remove(0, end + 1);
+
+    if (message.contains("ready")) {
+      worker->ready = true;
+      dispatch();
+    } else if (!worker->call) {
+      continue;
+    } else if (message.contains("progress")) {
+      if (worker->call->progress) {
+        worker->call->progress(message["progress"].toObject());
+      }
+    } else if (message.contains("ok")) {
+      finish(worker, message);
+      dispatch();
+    }
+  }
+}
+
+void PythonService::workerExited(Worker* worker)
+{
+  if (!m_workers.removeOne(worker)) {
+    return;
+  }
+  worker->process->deleteLater();
+
+  if (worker->call) {
+    complete(worker->call, failure("exited", "The Python worker exited."));
+  }
+
+  if (!worker->ready) {
+    // A worker that never came up means the others will not either, hand
+    // the waiting requests back to run in the embedded interpreter.
+    qWarning().noquote() << "Unable to start a Python worker with"
+                         << m_program << "- Python operators will run in "
+                                         "the application.";
+    m_available = false;
+    QList<std::shared_ptr<Call>> pending;
+    {
+      QMutexLocker locker(&m_mutex);
+      pending.swap(m_pending);
+    }
+    foreach (const std::shared_ptr<Call>& call, pending) {
+      complete(call, failure("unavailable", "No Python worker started."));
+    }
+  }
+  delete worker;
+
+  if (m_available) {
+    dispatch();
+  }
+}
+
+void PythonService::finish(Worker* worker, const QJsonObject& reply)
+{
+  auto call = worker->call;
+  worker->call.reset();
+  complete(call, reply);
+}
+
+void PythonService::complete(const std::shared_ptr<Call>& call,
+                             const QJsonObject& reply)
+{
+  QMutexLocker locker(&call->mutex);
+  call->reply = reply;
+  call->done = true;
+  call->finished.wakeAll();
+}
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizPythonService_h
+#define tomvizPythonService_h
+
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class QProcess;
+class QThread;
+
+namespace tomviz {
+
+/// Runs Python operators in persistent worker processes, see
+/// python/tomviz/_worker.py, instead of the interpreter embedded in the
+/// application. A transform holds the GIL of the interpreter running it for
+/// as long as it runs, so in the embedded interpreter the operators of
+/// different data sources run one at a time and the Python shell waits for
+/// them. Each worker runs one operator at a time, and the number of workers
+/// comes from the "PythonWorkerProcesses" setting (zero disables them).
+///
+/// The processes are owned by a thread of the service, requests may be made
+/// from any other thread. The service must first be used from the UI thread,
+/// where it reads the settings and asks the embedded interpreter how to start
+/// a worker.
+class PythonService : public QObject
+{
+  Q_OBJECT
+
+public:
+  static PythonService& instance();
+
+  /// Called on the service thread with each progress update of a request.
+  typedef std::function<void(const QJsonObject&)> Progress;
+  /// Polled on the requesting thread, a request is canceled once it is true.
+  typedef std::function<bool()> Canceled;
+
+  /// Returns false when workers are disabled or could not be started, the
+  /// operators should then run in the embedded interpreter.
+  bool isAvailable() const { return m_available; }
+
+  /// Sends the request to the next idle worker and waits for the reply. The
+  /// "id" of the request is assigned here. When no worker could be started
+  /// the reply has "unavailable" set.
+  QJsonObject run(QJsonObject request, Progress progress = Progress(),
+                  Canceled canceled = Canceled());
+
+  /// A directory to exchange data with the workers in, in memory when the
+  /// system provides one.
+  QString scratchPath() const;
+
+private slots:
+  void dispatch();
+  void cancel(int id);
+  void shutdown();
+
+private:
+  PythonService();
+  ~PythonService();
+  Q_DISABLE_COPY(PythonService)
+
+  struct Call;
+  struct Worker;
+
+  void startWorker();
+  void readReplies(Worker* worker);
+  void workerExited(Worker* worker);
+  void finish(Worker* worker, const QJsonObject& reply);
+  static void complete(const std::shared_ptr<Call>& call,
+                       const QJsonObject& reply);
+
+  QThread* m_thread = nullptr;
+  std::atomic<bool> m_available{ false };
+  std::atomic<int> m_nextId{ 0 };
+  int m_maxWorkers = 0;
+  QString m_program;
+  QStringList m_arguments;
+  QString m_pythonPath;
+
+  // Requests waiting for a worker, shared with the requesting threads.
+  QMutex m_mutex;
+  QList<std::shared_ptr<Call>> m_pending;
+
+  // Only used on the service thread.
+  QList<Worker*> m_workers;
+};
+}
+
+#endif
@@ -17,6 +17,8 @@
 #include "ReconstructionOperator.h"
 
 #include "DataSource.h"
+#include "EditOperatorWidget.h"
+#include "Parallel.h"
 #include "ReconstructionWidget.h"
 #include "TomographyReconstruction.h"
 #include "TomographyTiltSeries.h"
@@ -31,8 +33,65 @@
 #include "vtkSMSourceProxy.h"
 #include "vtkTrivialProducer.h"
 
-#include <QCoreApplication>
+#include <QComboBox>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QPointer>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using FilterType = tomviz::TomographyReconstruction::FilterType;
+
+// Serialized names and display labels of the filters, in enum order.
+const char* filterNames[] = { "none",    "ramp",    "shepp-logan",
+                              "cosine", "hamming", "hann" };
+const char* filterLabels[] = { "None (unfiltered)", "Ramp (Ram-Lak)",
+                               "Shepp-Logan",       "Cosine",
+                               "Hamming",           "Hann" };
+const int numberOfFilters = sizeof(filterNames) / sizeof(filterNames[0]);
+
+class ReconstructionFilterWidget : public tomviz::EditOperatorWidget
+{
+  Q_OBJECT
+
+public:
+  ReconstructionFilterWidget(tomviz::ReconstructionOperator* op, QWidget* p)
+    : tomviz::EditOperatorWidget(p), m_operator(op)
+  {
+    m_filters = new QComboBox(this);
+    for (int i = 0; i < numberOfFilters; ++i) {
+      m_filters->addItem(filterLabels[i]);
+    }
+    m_filters->setCurrentIndex(static_cast<int>(op->filter()));
+    QHBoxLayout* layout = new QHBoxLayout;
+    layout->addWidget(new QLabel("Filter"));
+    layout->addWidget(m_filters);
+    setLayout(layout);
+  }
+
+  void applyChangesToOperator() override
+  {
+    if (m_operator) {
+      m_operator->setFilter(
+        static_cast<FilterType>(m_filters->currentIndex()));
+    }
+  }
+
+private:
+  QPointer<tomviz::ReconstructionOperator> m_operator;
+  QComboBox* m_filters;
+};
+}
+
+#include "ReconstructionOperator.moc"
 
 namespace tomviz {
 ReconstructionOperator::ReconstructionOperator(DataSource* source, QObject* p)
@@ -65,21 +124,45 @@ QIcon ReconstructionOperator::icon() const
 
 Operator* ReconstructionOperator::clone() const
 {
-  return new ReconstructionOperator(m_dataSource);
+  auto other = new ReconstructionOperator(m_dataSource);
+  other->setFilter(m_filter);
+  return other;
 }
 
-bool ReconstructionOperator::serialize(pugi::xml_node&) const
+bool ReconstructionOperator::serialize(pugi::xml_node& ns) const
 {
-  // No state to serialize yet
+  ns.append_attribute("filter").set_value(
+    filterNames[static_cast<int>(m_filter)]);
   return true;
 }
 
-bool ReconstructionOperator::deserialize(const pugi::xml_node&)
+bool ReconstructionOperator::deserialize(const pugi::xml_node& ns)
 {
-  // No state to serialize yet
+  // State saved before filtering was supported had no filter, keep loading
+  // it unfiltered so it reproduces the same result.
+  m_filter = FilterType::None;
+  const char* name = ns.attribute("filter").value();
+  for (int i = 0; i < numberOfFilters; ++i) {
+    if (strcmp(name, filterNames[i]) == 0) {
+      m_filter = static_cast<FilterType>(i);
+    }
+  }
   return true;
 }
 
+EditOperatorWidget* ReconstructionOperator::getEditorContents(QWidget* p)
+{
+  return new ReconstructionFilterWidget(this, p);
+}
+
+void ReconstructionOperator::setFilter(FilterType filter)
+{
+  if (m_filter != filter) {
+    m_filter = filter;
+    emit transformModified();
+  }
+}
+
 QWidget* ReconstructionOperator::getCustomProgressWidget(QWidget* p) const
 {
   ReconstructionWidget* widget = new ReconstructionWidget(m_dataSource, p);
@@ -110,9 +193,11 @@ bool ReconstructionOperator::applyTransform(vtkDataObject* dataObject)
   int numXSlices = dataExtent[1] - dataExtent[0] + 1;
   int numYSlices = dataExtent[3] - dataExtent[2] + 1;
   int numZSlices = dataExtent[5] - dataExtent[4] + 1;
-  std::vector<float> sinogramPtr(numYSlices * numZSlices);
-  std::vector<float> reconstructionPtr(numYSlices * numYSlices);
   QVector<double> tiltAngles = m_dataSource->getTiltAngles();
+  if (tiltAngles.size() < numZSlices) {
+    qCritical() << "Not enough tilt angles for the tilt series";
+    return false;
+  }
 
   vtkNew<vtkImageData> reconstructionImage;
   int extent2[6] = { dataExtent[0], m_extent[1],   dataExtent[2],
@@ -124,24 +209,74 @@ bool ReconstructionOperator::applyTransform(vtkDataObject* dataObject)
 
   // TODO: talk to Dave Lonie about how to do this in new data array API
   float* reconstruction = (float*)darray->GetVoidPointer(0);
-  for (int i = 0; i < numXSlices && !isCanceled(); ++i) {
-    QCoreApplication::processEvents();
-    TomographyTiltSeries::getSinogram(imageData, i, &sinogramPtr[0]);
-    TomographyReconstruction::unweightedBackProjection2(
-      &sinogramPtr[0], tiltAngles.data(), &reconstructionPtr[0], numZSlices,
-      numYSlices);
-    for (int j = 0; j < numYSlices; ++j) {
-      for (int k = 0; k < numYSlices; ++k) {
-        reconstruction[j * (numYSlices * numXSlices) + k * numXSlices + i] =
-          reconstructionPtr[k * numYSlices + j];
+
+  // Convert the tilt series once, storing each sinogram contiguously.
+  TomographyTiltSeries::SinogramProvider sinograms(
+    imageData, TomographyTiltSeries::SinogramProvider::SliceMajor);
+
+  // The trig and ray geometry, and the filter response, are the same for
+  // every slice.
+  TomographyReconstruction::BackProjectionGeometry geometry(
+    tiltAngles.data(), numZSlices, numYSlices);
+  TomographyReconstruction::SinogramFilter sinogramFilter(m_filter,
+                                                          numYSlices);
+
+  // Slices are independent, so they are reconstructed concurrently. Only the
+  // thread that called applyTransform emits the intermediate results and
+  // progress, throttled so the UI isn't flooded from the compute threads.
+  std::atomic<int> slicesDone{ 0 };
+  std::mutex latestMutex;
+  std::vector<float> latestSlice;
+  const auto emitterThread = std::this_thread::get_id();
+  QElapsedTimer sinceLastEmit;
+  sinceLastEmit.start();
+  auto emitProgress = [&]() {
+    std::vector<float> slice;
+    {
+      std::lock_guard<std::mutex> lock(latestMutex);
+      slice.swap(latestSlice);
+    }
+    if (!slice.empty()) {
+      emit intermediateResults(slice);
+    }
+    setProgressStep(slicesDone - 1);
+    sinceLastEmit.restart();
+  };
+
+  Parallel::forRange(0, numXSlices, 1, [&](int begin, int end) {
+    std::vector<float> sinogram(static_cast<size_t>(numYSlices) * numZSlices);
+    std::vector<float> slice(static_cast<size_t>(numYSlices) * numYSlices);
+    for (int i = begin; i < end && !isCanceled(); ++i) {
+      const float* projections = sinograms.sinogram(i).data;
+      if (m_filter != FilterType::None) {
+        sinograms.copySinogram(i, sinogram.data());
+        sinogramFilter.apply(sinogram.data(), numZSlices);
+        projections = sinogram.data();
+      }
+      TomographyReconstruction::unweightedBackProjection2(
+        projections, geometry, slice.data());
+      for (int j = 0; j < numYSlices; ++j) {
+        for (int k = 0; k < numYSlices; ++k) {
+          reconstruction[static_cast<size_t>(j) * numYSlices * numXSlices +
+                         static_cast<size_t>(k) * numXSlices + i] =
+            slice[k * numYSlices + j];
+        }
+      }
+      ++slicesDone;
+      {
+        std::lock_guard<std::mutex> lock(latestMutex);
+        latestSlice = slice;
+      }
+      if (std::this_thread::get_id() == emitterThread &&
+          sinceLastEmit.elapsed() > 100) {
+        emitProgress();
       }
     }
-    emit intermediateResults(reconstructionPtr);
-    setProgressStep(i);
-  }
+  });
   if (isCanceled()) {
     return false;
   }
+  emitProgress();
   emit newOperatorResult(reconstructionImage.Get());
   emit newChildDataSource("Reconstruction", reconstructionImage.Get());
   return true;
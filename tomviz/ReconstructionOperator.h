@@ -18,6 +18,8 @@
 
 #include "Operator.h"
 
+#include "TomographyReconstruction.h"
+
 namespace tomviz {
 class DataSource;
 
@@ -34,13 +36,20 @@ public:
 
   Operator* clone() const override;
 
+  bool writesArraysInPlace() const override { return false; }
+
   bool serialize(pugi::xml_node& ns) const override;
   bool deserialize(const pugi::xml_node& ns) override;
 
-  bool hasCustomUI() const override { return false; }
+  EditOperatorWidget* getEditorContents(QWidget* parent) override;
+  bool hasCustomUI() const override { return true; }
 
   QWidget* getCustomProgressWidget(QWidget*) const override;
 
+  /// The filter applied to each sinogram before it is back projected.
+  void setFilter(TomographyReconstruction::FilterType filter);
+  TomographyReconstruction::FilterType filter() const { return m_filter; }
+
 protected:
   bool applyTransform(vtkDataObject* data) override;
 
@@ -63,6 +72,8 @@ private slots:
 private:
   DataSource* m_dataSource;
   int m_extent[6];
+  TomographyReconstruction::FilterType m_filter =
+    TomographyReconstruction::FilterType::Ramp;
   Q_DISABLE_COPY(ReconstructionOperator)
 };
 }
@@ -0,0 +1,250 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "ResolutionPyramid.h"
+
+#include "CopyOnWrite.h"
+#include "Parallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include <algorithm>
+
+namespace tomviz {
+
+namespace {
+
+/// Edge length of the bricks of output voxels handed to each thread.
+const int brickSize = 32;
+
+template <typename T>
+void downsampleBricks(const T* input, const int inDims[3], T* output,
+                      const int outDims[3], int components,
+                      const std::atomic<bool>* canceled)
+{
+  int bricks[3];
+  for (int i = 0; i < 3; ++i) {
+    bricks[i] = (outDims[i] + brickSize - 1) / brickSize;
+  }
+  const size_t inRow = static_cast<size_t>(inDims[0]) * components;
+  const size_t inSlice = inRow * inDims[1];
+  Parallel::forRange(
+    0, bricks[0] * bricks[1] * bricks[2], 1, [&](int begin, int end) {
+      std::vector<double> sums(components);
+      for (int b = begin; b < end; ++b) {
+        if (canceled && *canceled) {
+          return;
+        }
+        int bx = b % bricks[0];
+        int by = (b / bricks[0]) % bricks[1];
+        int bz = b / (bricks[0] * bricks[1]);
+        int zEnd = std::min(outDims[2], (bz + 1) * brickSize);
+        int yEnd = std::min(outDims[1], (by + 1) * brickSize);
+        int xEnd = std::min(outDims[0], (bx + 1) * brickSize);
+        for (int z = bz * brickSize; z < zEnd; ++z) {
+          // Blocks on the far edges of odd dimensions are only partially
+          // inside the volume, average what is there.
+          int z1 = std::min(2 * z + 1, inDims[2] - 1);
+          for (int y = by * brickSize; y < yEnd; ++y) {
+            int y1 = std::min(2 * y + 1, inDims[1] - 1);
+            T* out = output +
+                     ((static_cast<size_t>(z) * outDims[1] + y) * outDims[0] +
+                      bx * brickSize) *
+                       components;
+            for (int x = bx * brickSize; x < xEnd; ++x) {
+              int x1 = std::min(2 * x + 1, inDims[0] - 1);
+              std::fill(sums.begin(), sums.end(), 0.0);
+              int count = 0;
+              for (int k = 2 * z; k <= z1; ++k) {
+                for (int j = 2 * y; j <= y1; ++j) {
+                  for (int i = 2 * x; i <= x1; ++i) {
+                    const T* in = input + k * inSlice + j * inRow +
+                                  static_cast<size_t>(i) * components;
+                    for (int c = 0; c < components; ++c) {
+                      sums[c] += in[c];
+                    }
+                    ++count;
+                  }
+                }
+              }
+              for (int c = 0; c < components; ++c) {
+                *out++ = static_cast<T>(sums[c] / count);
+              }
+            }
+          }
+        }
+      }
+    });
+}
+}
+
+class ResolutionPyramid::Builder : public QRunnable
+{
+public:
+  Builder(ResolutionPyramid* pyramid, vtkImageData* image, int generation,
+          std::shared_ptr<std::atomic<bool>> canceled)
+    : m_pyramid(pyramid), m_generation(generation), m_canceled(canceled)
+  {
+    m_image.TakeReference(
+      vtkImageData::SafeDownCast(CopyOnWrite::sharedCopy(image)));
+  }
+
+  void run() override
+  {
+    vtkSmartPointer<vtkImageData> image = m_image;
+    for (int level = 1; level <= levelCount && !*m_canceled; ++level) {
+      int dims[3];
+      image->GetDimensions(dims);
+      if (dims[0] < 2 && dims[1] < 2 && dims[2] < 2) {
+        break;
+      }
+      image = downsample(image, m_canceled.get());
+      if (!image) {
+        break;
+      }
+      {
+        QMutexLocker locker(&m_pyramid->m_mutex);
+        m_pyramid->m_built.append({ m_generation, level, image });
+      }
+      // The pyramid waits for builders in its destructor, so it is alive.
+      QMetaObject::invokeMethod(m_pyramid, "levelsBuilt",
+                                Qt::QueuedConnection);
+    }
+  }
+
+private:
+  ResolutionPyramid* m_pyramid;
+  vtkSmartPointer<vtkImageData> m_image;
+  int m_generation;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+};
+
+ResolutionPyramid::ResolutionPyramid(QObject* parentObject)
+  : QObject(parentObject), m_levels(levelCount + 1)
+{
+  // One pyramid at a time, the downsampling itself runs across threads.
+  m_pool.setMaxThreadCount(1);
+}
+
+ResolutionPyramid::~ResolutionPyramid()
+{
+  if (m_canceled) {
+    *m_canceled = true;
+  }
+  m_pool.waitForDone();
+}
+
+void ResolutionPyramid::build(vtkImageData* image)
+{
+  if (m_canceled) {
+    *m_canceled = true;
+  }
+  ++m_generation;
+  std::fill(m_levels.begin(), m_levels.end(), nullptr);
+  emit cleared();
+  if (!image || !image->GetPointData()->GetScalars()) {
+    return;
+  }
+
+  m_levels[0] = image;
+  if (image->GetNumberOfPoints() >= minimumVoxels()) {
+    m_canceled = std::make_shared<std::atomic<bool>>(false);
+    m_pool.start(new Builder(this, image, m_generation, m_canceled));
+  }
+}
+
+vtkImageData* ResolutionPyramid::level(int level) const
+{
+  if (level < 0 || level > levelCount) {
+    return nullptr;
+  }
+  return m_levels[level];
+}
+
+int ResolutionPyramid::levelForBudget(qint64 voxels) const
+{
+  int coarsest = 0;
+  for (int i = 0; i <= levelCount; ++i) {
+    if (m_levels[i]) {
+      if (m_levels[i]->GetNumberOfPoints() <= voxels) {
+        return i;
+      }
+      coarsest = i;
+    }
+  }
+  return coarsest;
+}
+
+vtkSmartPointer<vtkImageData> ResolutionPyramid::downsample(
+  vtkImageData* image, const std::atomic<bool>* canceled)
+{
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  int extent[6];
+  int inDims[3];
+  int outDims[3];
+  double origin[3];
+  double spacing[3];
+  image->GetExtent(extent);
+  image->GetDimensions(inDims);
+  image->GetOrigin(origin);
+  image->GetSpacing(spacing);
+  for (int i = 0; i < 3; ++i) {
+    outDims[i] = (inDims[i] + 1) / 2;
+    // Each output voxel sits at the center of the block it averages.
+    origin[i] += spacing[i] * (extent[2 * i] + (inDims[i] > 1 ? 0.5 : 0.0));
+    spacing[i] *= inDims[i] > 1 ? 2 : 1;
+  }
+
+  auto output = vtkSmartPointer<vtkImageData>::New();
+  output->SetOrigin(origin);
+  output->SetSpacing(spacing);
+  output->SetDimensions(outDims);
+  output->AllocateScalars(scalars->GetDataType(),
+                          scalars->GetNumberOfComponents());
+  output->GetPointData()->GetScalars()->SetName(scalars->GetName());
+
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(downsampleBricks(
+      static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)), inDims,
+      static_cast<VTK_TT*>(output->GetScalarPointer()), outDims,
+      scalars->GetNumberOfComponents(), canceled));
+  }
+  if (canceled && *canceled) {
+    return nullptr;
+  }
+  return output;
+}
+
+void ResolutionPyramid::levelsBuilt()
+{
+  QList<Built> built;
+  {
+    QMutexLocker locker(&m_mutex);
+    built.swap(m_built);
+  }
+  for (const auto& entry : built) {
+    // Levels of images discarded by a later build are dropped.
+    if (entry.generation == m_generation) {
+      m_levels[entry.level] = entry.image;
+      emit levelReady(entry.level);
+    }
+  }
+}
+}
@@ -0,0 +1,99 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizResolutionPyramid_h
+#define tomvizResolutionPyramid_h
+
+#include <QObject>
+
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// Downsampled copies of a volume for rendering while interacting. Level 0
+/// is the volume itself, and each following level halves the resolution
+/// along every axis by averaging blocks of 2x2x2 voxels. The levels are
+/// built in the background after build() is called, each one from the
+/// previous, and levelReady() is emitted as each becomes available.
+class ResolutionPyramid : public QObject
+{
+  Q_OBJECT
+
+public:
+  /// The number of downsampled levels, 2x, 4x and 8x.
+  static const int levelCount = 3;
+
+  ResolutionPyramid(QObject* parent = nullptr);
+  ~ResolutionPyramid() override;
+
+  /// Discards the current levels and starts building those of image. The
+  /// scalars are shared copy-on-write, so the image can be modified while the
+  /// levels are being built. Volumes smaller than minimumVoxels() are not
+  /// worth downsampling and get no levels.
+  void build(vtkImageData* image);
+
+  /// Returns the image of level, or nullptr if it is not available yet.
+  vtkImageData* level(int level) const;
+
+  /// Returns the finest level with at most voxels voxels, or the coarsest
+  /// available level if none is small enough.
+  int levelForBudget(qint64 voxels) const;
+
+  static qint64 minimumVoxels() { return 128 * 128 * 128; }
+
+  /// Averages 2x2x2 blocks of image into a new image of half the resolution.
+  /// The work is split into bricks of the output processed across threads.
+  /// Returns nullptr if canceled becomes true before it finishes.
+  static vtkSmartPointer<vtkImageData> downsample(
+    vtkImageData* image, const std::atomic<bool>* canceled = nullptr);
+
+signals:
+  /// Emitted when the levels are discarded, because of a new build().
+  void cleared();
+  void levelReady(int level);
+
+private slots:
+  void levelsBuilt();
+
+private:
+  class Builder;
+
+  struct Built
+  {
+    int generation;
+    int level;
+    vtkSmartPointer<vtkImageData> image;
+  };
+
+  std::vector<vtkSmartPointer<vtkImageData>> m_levels;
+  int m_generation = 0;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+  QThreadPool m_pool;
+  QMutex m_mutex;
+  QList<Built> m_built;
+};
+}
+
+#endif
@@ -19,12 +19,9 @@
 #include "ActiveObjects.h"
 #include "DataSource.h"
 #include "LoadDataReaction.h"
-#include "TomographyReconstruction.h"
-#include "TomographyTiltSeries.h"
-#define PI 3.14159265359
+#include "TiltAxisPreview.h"
 #include "AddPythonTransformReaction.h"
 #include "Utilities.h"
-#include <math.h>
 
 #include "pqCoreUtilities.h"
 #include "pqPresetDialog.h"
@@ -62,6 +59,7 @@
 #include <QLineEdit>
 #include <QPointer>
 #include <QPushButton>
+#include <QSignalBlocker>
 #include <QSpinBox>
 #include <QTimer>
 #include <QVBoxLayout>
@@ -75,7 +73,6 @@ class RotateAlignWidget::RAWInternal
 public:
   Ui::RotateAlignWidget Ui;
   vtkNew<vtkImageSlice> mainSlice;
-  vtkNew<vtkImageData> reconImage[3];
   vtkNew<vtkImageSlice> reconSlice[3];
   vtkNew<vtkImageSliceMapper> mainSliceMapper;
   vtkNew<vtkImageSliceMapper> reconSliceMapper[3];
@@ -87,16 +84,22 @@ public:
   vtkNew<vtkLineSource> reconSliceLine[3];
   vtkNew<vtkActor> reconSliceLineActor[3];
   vtkSmartPointer<vtkSMProxy> ReconColorMap[3];
-  bool m_reconSliceDirty[3];
+  bool m_reconCameraSet[3];
   QTimer m_updateSlicesTimer;
+  // Reconstructs the slices in the background, drafts while the axis is
+  // changing and full previews once it settles.
+  TiltAxisPreview m_preview;
 
   RAWInternal()
   {
-    m_reconSliceDirty[0] = m_reconSliceDirty[1] = m_reconSliceDirty[2] = true;
-    m_updateSlicesTimer.setInterval(500);
+    m_reconCameraSet[0] = m_reconCameraSet[1] = m_reconCameraSet[2] = false;
+    m_updateSlicesTimer.setInterval(300);
     m_updateSlicesTimer.setSingleShot(true);
-    QObject::connect(&m_updateSlicesTimer, &QTimer::timeout,
-                     [this]() { this->updateDirtyReconSlices(); });
+    QObject::connect(&m_updateSlicesTimer, &QTimer::timeout, [this]() {
+      this->requestReconSlices(TiltAxisPreview::fullSize);
+    });
+    QObject::connect(&m_preview, &TiltAxisPreview::previewReady,
+                     [this](int i) { this->showReconSlice(i); });
   }
 
   void setupCameras()
@@ -192,75 +195,55 @@ public:
     this->Ui.sliceView->GetRenderWindow()->Render();
   }
 
-  void updateDirtyReconSlices()
+  std::vector<int> reconSliceNumbers() const
   {
-    for (int i = 0; i < 3; ++i) {
-      if (m_reconSliceDirty[i]) {
-        this->updateReconSlice(i);
-        m_reconSliceDirty[i] = false;
-      }
-    }
+    return { this->Ui.spinBox_1->value(), this->Ui.spinBox_2->value(),
+             this->Ui.spinBox_3->value() };
   }
 
-  void updateReconSlice(int i)
+  TiltAxisPreview::Axis axis() const
   {
-    vtkTrivialProducer* t = vtkTrivialProducer::SafeDownCast(
-      this->Source->producer()->GetClientSideObject());
-    if (!t) {
+    return { this->Ui.rotationAxis->value(), this->Ui.rotationAngle->value() };
+  }
+
+  void requestReconSlices(int size)
+  {
+    this->m_preview.request(this->reconSliceNumbers(), this->axis(), size);
+  }
+
+  void showReconSlice(int i)
+  {
+    vtkImageData* image = this->m_preview.preview(i);
+    if (!image) {
       return;
     }
-    vtkImageData* imageData =
-      vtkImageData::SafeDownCast(t->GetOutputDataObject(0));
-    if (imageData) {
-      int extent[6];
-      imageData->GetExtent(extent);
-      int dims[3] = { extent[1] - extent[0] + 1, extent[3] - extent[2] + 1,
-                      extent[5] - extent[4] + 1 };
-      QSpinBox* spinBoxes[3] = { this->Ui.spinBox_1, this->Ui.spinBox_2,
-                                 this->Ui.spinBox_3 };
-      int sliceNum = spinBoxes[i]->value();
-
-      int Nray = 256; // Size of 2D reconstruction. Fixed for all tilt series
-      std::vector<float> sinogram(Nray * dims[2]);
-      // Approximate in-plance rotation as a shift in y-direction
-      double shift = -this->Ui.rotationAxis->value() +
-                     sin(-this->Ui.rotationAngle->value() * PI / 180) *
-                       (sliceNum - dims[0] / 2);
-
-      TomographyTiltSeries::getSinogram(
-        imageData, sliceNum, &sinogram[0], Nray,
-        shift); // Get a sinogram from tilt series
-      this->reconImage[i]->SetExtent(0, Nray - 1, 0, Nray - 1, 0, 0);
-      this->reconImage[i]->AllocateScalars(VTK_FLOAT, 1);
-      vtkDataArray* reconArray =
-        this->reconImage[i]->GetPointData()->GetScalars();
-      float* reconPtr = static_cast<float*>(reconArray->GetVoidPointer(0));
-
-      vtkDataArray* tiltAnglesArray =
-        imageData->GetFieldData()->GetArray("tilt_angles");
-      double* tiltAngles =
-        static_cast<double*>(tiltAnglesArray->GetVoidPointer(0));
-
-      TomographyReconstruction::unweightedBackProjection2(
-        &sinogram[0], tiltAngles, reconPtr, dims[2], Nray);
-      this->reconSliceMapper[i]->SetInputData(this->reconImage[i].GetPointer());
-      this->reconSliceMapper[i]->SetSliceNumber(0);
-      this->reconSliceMapper[i]->Update();
-
-      double range[2];
-      reconArray->GetRange(range);
-      vtkSMTransferFunctionProxy::RescaleTransferFunction(
-        this->ReconColorMap[i], range);
-      this->reconSlice[i]->GetProperty()->SetLookupTable(
-        vtkScalarsToColors::SafeDownCast(
-          this->ReconColorMap[i]->GetClientSideObject()));
-
-      tomviz::QVTKGLWidget* sliceView[] = { this->Ui.sliceView_1,
-                                            this->Ui.sliceView_2,
-                                            this->Ui.sliceView_3 };
-
-      sliceView[i]->GetRenderWindow()->Render();
+    // Drafts are spaced out to cover the same area as the full previews, so
+    // the cameras stay put.
+    double spacing =
+      double(TiltAxisPreview::fullSize) / image->GetDimensions()[0];
+    image->SetSpacing(spacing, spacing, 1.0);
+    this->reconSliceMapper[i]->SetInputData(image);
+    this->reconSliceMapper[i]->SetSliceNumber(0);
+    this->reconSliceMapper[i]->Update();
+    if (!this->m_reconCameraSet[i]) {
+      tomviz::setupRenderer(this->reconRenderer[i].Get(),
+                            this->reconSliceMapper[i].Get());
+      this->m_reconCameraSet[i] = true;
     }
+
+    double range[2];
+    image->GetPointData()->GetScalars()->GetRange(range);
+    vtkSMTransferFunctionProxy::RescaleTransferFunction(
+      this->ReconColorMap[i], range);
+    this->reconSlice[i]->GetProperty()->SetLookupTable(
+      vtkScalarsToColors::SafeDownCast(
+        this->ReconColorMap[i]->GetClientSideObject()));
+
+    tomviz::QVTKGLWidget* sliceView[] = { this->Ui.sliceView_1,
+                                          this->Ui.sliceView_2,
+                                          this->Ui.sliceView_3 };
+
+    sliceView[i]->GetRenderWindow()->Render();
   }
 
   void updateSliceLines()
@@ -417,6 +400,19 @@ RotateAlignWidget::RotateAlignWidget(DataSource* source, QWidget* p)
                    this, SLOT(onRotationAxisChanged()));
   this->Internals->Ui.rotationAngle->installEventFilter(this);
 
+  QObject::connect(this->Internals->Ui.rotationAxis,
+                   SIGNAL(valueChanged(double)), this,
+                   SLOT(onRotationAxisChanging()));
+  QObject::connect(this->Internals->Ui.rotationAngle,
+                   SIGNAL(valueChanged(double)), this,
+                   SLOT(onRotationAxisChanging()));
+
+  this->connect(this->Internals->Ui.findAxisButton, SIGNAL(clicked()),
+                SLOT(onFindAxisButtonPressed()));
+  this->connect(&this->Internals->m_preview,
+                SIGNAL(axisFound(double, double)),
+                SLOT(onAxisFound(double, double)));
+
   this->connect(this->Internals->Ui.pushButton, SIGNAL(pressed()),
                 SLOT(onFinalReconButtonPressed()));
 
@@ -488,11 +484,12 @@ void RotateAlignWidget::setDataSource(DataSource* source)
     this->Internals->Ui.spinBox_3->setValue(
       vtkMath::Round(0.75 * (extent[1] - extent[0])));
 
-    // We have to do this here since we need the output to exist so the camera
-    // can be initialized below
-    this->Internals->updateReconSlice(0);
-    this->Internals->updateReconSlice(1);
-    this->Internals->updateReconSlice(2);
+    // The cameras of the slices are set up as their first previews arrive.
+    for (int i = 0; i < 3; ++i) {
+      this->Internals->m_reconCameraSet[i] = false;
+    }
+    this->Internals->m_preview.setTiltSeries(imageData);
+    this->Internals->requestReconSlices(TiltAxisPreview::fullSize);
 
     this->Internals->setupCameras();
     this->Internals->setupRotationAxisLine();
@@ -524,18 +521,47 @@ void RotateAlignWidget::onProjectionNumberChanged()
 void RotateAlignWidget::onRotationAxisChanged()
 {
   this->Internals->moveRotationAxisLine();
-  // Update recon windows
-  this->Internals->m_reconSliceDirty[0] = true;
-  this->Internals->m_reconSliceDirty[1] = true;
-  this->Internals->m_reconSliceDirty[2] = true;
+  this->Internals->m_updateSlicesTimer.stop();
+  this->Internals->requestReconSlices(TiltAxisPreview::fullSize);
+}
+
+void RotateAlignWidget::onRotationAxisChanging()
+{
+  // Drafts follow the axis as it changes, the full previews wait for it to
+  // settle.
+  this->Internals->moveRotationAxisLine();
+  this->Internals->requestReconSlices(TiltAxisPreview::draftSize);
   this->Internals->m_updateSlicesTimer.start();
 }
 
+void RotateAlignWidget::onFindAxisButtonPressed()
+{
+  if (!this->Internals->Source) {
+    return;
+  }
+  this->Internals->Ui.findAxisButton->setEnabled(false);
+  this->Internals->Ui.findAxisButton->setText("Searching...");
+  this->Internals->m_preview.search(this->Internals->reconSliceNumbers(),
+                                    this->Internals->axis());
+}
+
+void RotateAlignWidget::onAxisFound(double shift, double angle)
+{
+  this->Internals->Ui.findAxisButton->setEnabled(true);
+  this->Internals->Ui.findAxisButton->setText("Find Rotation Axis");
+  QSignalBlocker blockShift(this->Internals->Ui.rotationAxis);
+  QSignalBlocker blockAngle(this->Internals->Ui.rotationAngle);
+  this->Internals->Ui.rotationAxis->setValue(shift);
+  this->Internals->Ui.rotationAngle->setValue(angle);
+  this->onRotationAxisChanged();
+}
+
 void RotateAlignWidget::onReconSliceChanged(int idx)
 {
+  Q_UNUSED(idx);
   this->Internals->updateSliceLines();
   this->Internals->Ui.sliceView->GetRenderWindow()->Render();
-  this->Internals->m_reconSliceDirty[idx] = true;
+  // The sinograms of the other slices are cached, so they are cheap to redo.
   this->Internals->m_updateSlicesTimer.start();
 }
 
@@ -43,6 +43,7 @@ signals:
 protected slots:
   void onProjectionNumberChanged();
   void onRotationAxisChanged();
+  void onRotationAxisChanging();
   void onReconSlice0Changed() { this->onReconSliceChanged(0); };
   void onReconSlice1Changed() { this->onReconSliceChanged(1); };
   void onReconSlice2Changed() { this->onReconSliceChanged(2); };
@@ -50,6 +51,8 @@ protected slots:
   void updateWidgets();
 
   void onFinalReconButtonPressed();
+  void onFindAxisButtonPressed();
+  void onAxisFound(double shift, double angle);
 
   void showChangeColorMapDialog0() { this->showChangeColorMapDialog(0); };
   void showChangeColorMapDialog1() { this->showChangeColorMapDialog(1); };
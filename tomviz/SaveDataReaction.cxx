@@ -23,10 +23,12 @@
 #include "DataSource.h"
 #include "ModuleManager.h"
 #include "pqActiveObjects.h"
+#include "pqApplicationCore.h"
 #include "pqCoreUtilities.h"
 #include "pqPipelineSource.h"
 #include "pqProxyWidgetDialog.h"
 #include "pqSaveDataReaction.h"
+#include "pqSettings.h"
 #include "vtkDataArray.h"
 #include "vtkDataObject.h"
 #include "vtkImageData.h"
@@ -132,8 +134,22 @@ bool SaveDataReaction::saveData(const QString& filename)
 
   QFileInfo info(filename);
   if (info.suffix() == "emd") {
+    // Deflate by default, "fast" trades some size for speed and "none" writes
+    // a contiguous block that can be memory-mapped when loaded.
+    EmdFormat::WriteOptions options;
+    options.compression = EmdFormat::WriteOptions::Deflate;
+    if (auto core = pqApplicationCore::instance()) {
+      QString compression =
+        core->settings()->value("EmdCompression", "deflate").toString();
+      if (compression == "none") {
+        options.compression = EmdFormat::WriteOptions::None;
+        options.contiguous = true;
+      } else if (compression == "fast") {
+        options.compression = EmdFormat::WriteOptions::Fast;
+      }
+    }
     EmdFormat writer;
-    if (!writer.write(filename.toLatin1().data(), source)) {
+    if (!writer.write(filename.toLatin1().data(), source, options)) {
       qCritical() << "Failed to write out data.";
       return false;
     } else {
@@ -32,6 +32,7 @@ public:
   QString label() const override { return "Set Tilt Angles"; }
   QIcon icon() const override;
   Operator* clone() const override;
+  bool writesArraysInPlace() const override { return false; }
   bool serialize(pugi::xml_node& ns) const override;
   bool deserialize(const pugi::xml_node& ns) override;
   EditOperatorWidget* getEditorContentsWithData(
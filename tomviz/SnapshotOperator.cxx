@@ -16,6 +16,7 @@
 
 #include "SnapshotOperator.h"
 
+#include "CopyOnWrite.h"
 #include "DataSource.h"
 
 #include "pqSMProxy.h"
@@ -96,7 +97,7 @@ bool SnapshotOperator::applyTransform(vtkDataObject* dataObject)
   }
 
   vtkNew<vtkImageData> cacheImage;
-  cacheImage->DeepCopy(imageData);
+  CopyOnWrite::share(cacheImage.Get(), imageData);
 
   emit newChildDataSource("Snapshot", cacheImage.Get());
   return true;
@@ -34,6 +34,8 @@ public:
 
   Operator* clone() const override;
 
+  bool writesArraysInPlace() const override { return false; }
+
   bool serialize(pugi::xml_node& ns) const override;
   bool deserialize(const pugi::xml_node& ns) override;
 
@@ -0,0 +1,95 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "SpanSpaceIndex.h"
+
+#include <vtkImageData.h>
+
+#include <algorithm>
+
+namespace tomviz {
+
+void SpanSpaceIndex::build(vtkImageData* image, int size)
+{
+  clear();
+  if (!image) {
+    return;
+  }
+
+  // Bricks with nothing but NaNs have an empty range and are left out of the
+  // sorted order, so no value ever reaches them.
+  m_bricks = BrickContour::bricks(image, size);
+  for (size_t i = 0; i < m_bricks.size(); ++i) {
+    if (m_bricks[i].range[0] <= m_bricks[i].range[1]) {
+      m_byMinimum.push_back(static_cast<int>(i));
+    }
+  }
+  std::sort(m_byMinimum.begin(), m_byMinimum.end(), [this](int a, int b) {
+    return m_bricks[a].range[0] < m_bricks[b].range[0];
+  });
+
+  m_minimums.reserve(m_byMinimum.size());
+  for (int i : m_byMinimum) {
+    m_minimums.push_back(m_bricks[i].range[0]);
+  }
+  if (!m_byMinimum.empty()) {
+    m_range[0] = m_minimums.front();
+    m_range[1] = m_bricks[m_byMinimum.front()].range[1];
+    for (int i : m_byMinimum) {
+      m_range[1] = std::max(m_range[1], m_bricks[i].range[1]);
+    }
+  }
+}
+
+void SpanSpaceIndex::clear()
+{
+  m_bricks.clear();
+  m_byMinimum.clear();
+  m_minimums.clear();
+  m_range[0] = m_range[1] = 0.0;
+}
+
+bool SpanSpaceIndex::range(double range[2]) const
+{
+  if (m_byMinimum.empty()) {
+    return false;
+  }
+  range[0] = m_range[0];
+  range[1] = m_range[1];
+  return true;
+}
+
+std::vector<int> SpanSpaceIndex::bricksContaining(double value) const
+{
+  return bricksOverlapping(value, value);
+}
+
+std::vector<int> SpanSpaceIndex::bricksOverlapping(double low,
+                                                   double high) const
+{
+  // Only the bricks starting at or below high can overlap, and of those the
+  // ones ending at or above low do.
+  std::vector<int> result;
+  auto end = std::upper_bound(m_minimums.begin(), m_minimums.end(), high);
+  for (auto it = m_minimums.begin(); it != end; ++it) {
+    int brick = m_byMinimum[it - m_minimums.begin()];
+    if (m_bricks[brick].range[1] >= low) {
+      result.push_back(brick);
+    }
+  }
+  std::sort(result.begin(), result.end());
+  return result;
+}
+}
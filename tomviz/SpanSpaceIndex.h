@@ -0,0 +1,62 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizSpanSpaceIndex_h
+#define tomvizSpanSpaceIndex_h
+
+#include "BrickContour.h"
+
+#include <vector>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// The bricks of a volume with the range of each, sorted by their minimum so
+/// the bricks an isovalue or a threshold range touches are found without
+/// looking at the voxels, or even at every brick. Kept by each DataSource
+/// and shared by the code that only needs part of the volume for a value.
+class SpanSpaceIndex
+{
+public:
+  /// Splits image into bricks of size cells and computes their ranges.
+  void build(vtkImageData* image, int size = BrickContour::brickSize);
+  void clear();
+
+  bool isEmpty() const { return m_bricks.empty(); }
+  const std::vector<BrickContour::Brick>& bricks() const { return m_bricks; }
+
+  /// Range of the first component over the whole volume, NaNs left out.
+  /// Returns false if there are no bricks.
+  bool range(double range[2]) const;
+
+  /// Returns the indices of the bricks whose range contains value, in
+  /// increasing order.
+  std::vector<int> bricksContaining(double value) const;
+
+  /// Returns the indices of the bricks whose range overlaps [low, high], in
+  /// increasing order.
+  std::vector<int> bricksOverlapping(double low, double high) const;
+
+private:
+  std::vector<BrickContour::Brick> m_bricks;
+  /// Indices of the bricks, and their minimums, by increasing minimum.
+  std::vector<int> m_byMinimum;
+  std::vector<double> m_minimums;
+  double m_range[2] = { 0.0, 0.0 };
+};
+}
+
+#endif
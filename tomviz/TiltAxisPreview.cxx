@@ -0,0 +1,427 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "TiltAxisPreview.h"
+
+#include "ImageAlignment.h"
+#include "Parallel.h"
+#include "TomographyReconstruction.h"
+#include "TomographyTiltSeries.h"
+
+#include <vtkDataArray.h>
+#include <vtkFieldData.h>
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tomviz {
+
+namespace {
+
+template <typename T>
+void copySinogram(const T* data, int components, const int dims[3],
+                  int slice, float* values)
+{
+  for (int t = 0; t < dims[2]; ++t) {
+    for (int r = 0; r < dims[1]; ++r) {
+      vtkIdType index = (static_cast<vtkIdType>(t) * dims[1] + r) * dims[0];
+      values[t * dims[1] + r] =
+        static_cast<float>(data[(index + slice) * components]);
+    }
+  }
+}
+
+// Resamples the sinogram to size rays with the axis at position.
+std::vector<float> resample(const TiltAxisPreview::Sinogram& sinogram,
+                            double position, int size)
+{
+  int tilts = static_cast<int>(sinogram.tiltAngles.size());
+  std::vector<float> resampled(static_cast<size_t>(size) * tilts);
+  TomographyTiltSeries::SinogramView view = { sinogram.values.data(), 1,
+                                              sinogram.numberOfRays };
+  TomographyTiltSeries::getSinogram(view, sinogram.numberOfRays, tilts,
+                                    resampled.data(), size, position);
+  return resampled;
+}
+
+void backProject(const TiltAxisPreview::Sinogram& sinogram,
+                 const std::vector<float>& resampled, int size, float* image)
+{
+  TomographyReconstruction::BackProjectionGeometry geometry(
+    sinogram.tiltAngles.data(), static_cast<int>(sinogram.tiltAngles.size()),
+    size);
+  TomographyReconstruction::unweightedBackProjection2(resampled.data(),
+                                                      geometry, image);
+}
+
+// Scores the positions in parallel, returns false if canceled.
+bool score(const TiltAxisPreview::Sinogram& sinogram,
+           const std::vector<double>& positions, int size,
+           std::vector<double>& scores, const std::atomic<bool>* canceled)
+{
+  scores.assign(positions.size(), -std::numeric_limits<double>::max());
+  Parallel::forRange(
+    0, static_cast<int>(positions.size()), 1, [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        if (canceled && *canceled) {
+          return;
+        }
+        scores[i] = TiltAxisPreview::sharpness(sinogram, positions[i], size);
+      }
+    });
+  return !(canceled && *canceled);
+}
+
+size_t best(const std::vector<double>& scores)
+{
+  return std::max_element(scores.begin(), scores.end()) - scores.begin();
+}
+}
+
+class TiltAxisPreview::Task : public QRunnable
+{
+public:
+  Task(TiltAxisPreview* preview, const std::vector<SinogramPtr>& sinograms,
+       const Axis& axis, int generation,
+       std::shared_ptr<std::atomic<bool>> canceled)
+    : m_preview(preview), m_sinograms(sinograms), m_axis(axis),
+      m_generation(generation), m_canceled(canceled)
+  {
+  }
+
+  /// A search when size is zero, previews of that size otherwise.
+  int size = 0;
+
+  void run() override
+  {
+    if (size == 0) {
+      Axis axis = searchAxis(m_sinograms, m_axis, m_canceled.get());
+      if (*m_canceled) {
+        return;
+      }
+      QMutexLocker locker(&m_preview->m_mutex);
+      m_preview->m_axisReady = true;
+      m_preview->m_axisGeneration = m_generation;
+      m_preview->m_axis = axis;
+    } else {
+      int count = static_cast<int>(m_sinograms.size());
+      Parallel::forRange(0, count, 1, [this](int begin, int end) {
+        for (int i = begin; i < end && !*m_canceled; ++i) {
+          if (m_sinograms[i]) {
+            preview(i, *m_sinograms[i]);
+          }
+        }
+      });
+    }
+    // The preview waits for its tasks in its destructor, so it is alive.
+    QMetaObject::invokeMethod(m_preview, "deliver", Qt::QueuedConnection);
+  }
+
+private:
+  void preview(int index, const Sinogram& sinogram)
+  {
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(0, size - 1, 0, size - 1, 0, 0);
+    image->AllocateScalars(VTK_FLOAT, 1);
+    reconstruct(sinogram, axisPosition(sinogram, m_axis), size,
+                static_cast<float*>(image->GetScalarPointer()));
+    QMutexLocker locker(&m_preview->m_mutex);
+    m_preview->m_ready.append({ m_generation, index, image });
+  }
+
+  TiltAxisPreview* m_preview;
+  std::vector<SinogramPtr> m_sinograms;
+  Axis m_axis;
+  int m_generation;
+  std::shared_ptr<std::atomic<bool>> m_canceled;
+};
+
+TiltAxisPreview::TiltAxisPreview(QObject* parentObject)
+  : QObject(parentObject)
+{
+  // A preview and a search may run side by side, each across threads.
+  m_pool.setMaxThreadCount(2);
+}
+
+TiltAxisPreview::~TiltAxisPreview()
+{
+  if (m_previewCanceled) {
+    *m_previewCanceled = true;
+  }
+  if (m_searchCanceled) {
+    *m_searchCanceled = true;
+  }
+  m_pool.waitForDone();
+}
+
+void TiltAxisPreview::setTiltSeries(vtkImageData* tiltSeries)
+{
+  m_tiltSeries = tiltSeries;
+  m_sinograms.clear();
+}
+
+void TiltAxisPreview::request(const std::vector<int>& slices,
+                              const Axis& axis, int size)
+{
+  if (m_previewCanceled) {
+    *m_previewCanceled = true;
+  }
+  ++m_generation;
+  m_previews.resize(slices.size());
+  m_previewCanceled = std::make_shared<std::atomic<bool>>(false);
+  auto task = new Task(this, sinograms(slices), axis, m_generation,
+                       m_previewCanceled);
+  task->size = size;
+  m_pool.start(task);
+}
+
+void TiltAxisPreview::search(const std::vector<int>& slices,
+                             const Axis& axis)
+{
+  if (m_searchCanceled) {
+    *m_searchCanceled = true;
+  }
+  ++m_searchGeneration;
+  m_searchCanceled = std::make_shared<std::atomic<bool>>(false);
+  m_pool.start(new Task(this, sinograms(slices), axis, m_searchGeneration,
+                        m_searchCanceled));
+}
+
+vtkImageData* TiltAxisPreview::preview(int index) const
+{
+  if (index < 0 || index >= static_cast<int>(m_previews.size())) {
+    return nullptr;
+  }
+  return m_previews[index];
+}
+
+void TiltAxisPreview::deliver()
+{
+  QList<Preview> ready;
+  bool axisReady = false;
+  Axis axis;
+  {
+    QMutexLocker locker(&m_mutex);
+    ready.swap(m_ready);
+    axisReady = m_axisReady && m_axisGeneration == m_searchGeneration;
+    axis = m_axis;
+    m_axisReady = false;
+  }
+  foreach (const Preview& preview, ready) {
+    // Stale previews are dropped, a newer request replaces them.
+    if (preview.generation == m_generation) {
+      m_previews[preview.index] = preview.image;
+      emit previewReady(preview.index);
+    }
+  }
+  if (axisReady) {
+    emit axisFound(axis.shift, axis.angle);
+  }
+}
+
+std::vector<TiltAxisPreview::SinogramPtr> TiltAxisPreview::sinograms(
+  const std::vector<int>& slices)
+{
+  // The data may have been modified in place since the sinograms were taken.
+  vtkMTimeType time = 0;
+  if (m_tiltSeries && m_tiltSeries->GetPointData()->GetScalars()) {
+    time = std::max(m_tiltSeries->GetMTime(),
+                    m_tiltSeries->GetPointData()->GetScalars()->GetMTime());
+  }
+  if (time != m_tiltSeriesTime) {
+    m_sinograms.clear();
+    m_tiltSeriesTime = time;
+  }
+
+  // Only the sinograms of the slices asked for last are kept.
+  QHash<int, SinogramPtr> kept;
+  std::vector<SinogramPtr> result;
+  for (int slice : slices) {
+    SinogramPtr sinogram = m_sinograms.value(slice);
+    if (!sinogram && m_tiltSeries) {
+      sinogram = extractSinogram(m_tiltSeries, slice);
+    }
+    kept.insert(slice, sinogram);
+    result.push_back(sinogram);
+  }
+  m_sinograms.swap(kept);
+  return result;
+}
+
+TiltAxisPreview::SinogramPtr TiltAxisPreview::extractSinogram(
+  vtkImageData* tiltSeries, int slice)
+{
+  vtkDataArray* scalars = tiltSeries->GetPointData()->GetScalars();
+  vtkDataArray* angles = tiltSeries->GetFieldData()->GetArray("tilt_angles");
+  int dims[3];
+  tiltSeries->GetDimensions(dims);
+  if (!scalars || !angles || angles->GetNumberOfTuples() < dims[2] ||
+      slice < 0 || slice >= dims[0]) {
+    return nullptr;
+  }
+
+  auto sinogram = std::make_shared<Sinogram>();
+  sinogram->slice = slice;
+  sinogram->numberOfSlices = dims[0];
+  sinogram->numberOfRays = dims[1];
+  sinogram->tiltAngles.resize(dims[2]);
+  for (int t = 0; t < dims[2]; ++t) {
+    sinogram->tiltAngles[t] = angles->GetTuple1(t);
+  }
+  sinogram->values.resize(static_cast<size_t>(dims[1]) * dims[2]);
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(
+      copySinogram(static_cast<const VTK_TT*>(scalars->GetVoidPointer(0)),
+                   scalars->GetNumberOfComponents(), dims, slice,
+                   sinogram->values.data()));
+  }
+  return sinogram;
+}
+
+double TiltAxisPreview::axisPosition(const Sinogram& sinogram,
+                                     const Axis& axis)
+{
+  return -axis.shift +
+         std::sin(vtkMath::RadiansFromDegrees(-axis.angle)) *
+           (sinogram.slice - sinogram.numberOfSlices / 2);
+}
+
+void TiltAxisPreview::reconstruct(const Sinogram& sinogram, double position,
+                                  int size, float* image)
+{
+  backProject(sinogram, resample(sinogram, position, size), size, image);
+}
+
+double TiltAxisPreview::sharpness(const Sinogram& sinogram, double position,
+                                  int size)
+{
+  std::vector<float> resampled = resample(sinogram, position, size);
+  TomographyReconstruction::SinogramFilter filter(
+    TomographyReconstruction::FilterType::SheppLogan, size);
+  filter.apply(resampled.data(), static_cast<int>(sinogram.tiltAngles.size()));
+  std::vector<float> image(static_cast<size_t>(size) * size);
+  backProject(sinogram, resampled, size, image.data());
+
+  // The corners are only crossed by some of the rays, leave them out.
+  double squares = 0.0;
+  double fourthPowers = 0.0;
+  int count = 0;
+  double radius = 0.25 * size * size;
+  for (int y = 0; y < size; ++y) {
+    double ry = y + 0.5 - 0.5 * size;
+    for (int x = 0; x < size; ++x) {
+      double rx = x + 0.5 - 0.5 * size;
+      if (rx * rx + ry * ry > radius) {
+        continue;
+      }
+      double square = double(image[y * size + x]) * image[y * size + x];
+      squares += square;
+      fourthPowers += square * square;
+      ++count;
+    }
+  }
+  return squares > 0.0 ? fourthPowers * count / (squares * squares) : 0.0;
+}
+
+double TiltAxisPreview::searchPosition(const Sinogram& sinogram, double start,
+                                       double range,
+                                       const std::atomic<bool>* canceled)
+{
+  // Coarse candidates one draft pixel apart. Small sinograms are not
+  // upsampled, interpolating between rays would add to the scores.
+  int coarseSize = std::min(draftSize, sinogram.numberOfRays);
+  int fineSize = std::min(fullSize, sinogram.numberOfRays);
+  double step = double(sinogram.numberOfRays) / coarseSize;
+  int steps = static_cast<int>(std::ceil(range / step));
+  std::vector<double> positions;
+  for (int i = -steps; i <= steps; ++i) {
+    positions.push_back(start + i * step);
+  }
+  std::vector<double> scores;
+  if (!score(sinogram, positions, coarseSize, scores, canceled)) {
+    return start;
+  }
+  double coarse = positions[best(scores)];
+
+  // Fine candidates a quarter step apart around the best.
+  step /= 4.0;
+  positions.clear();
+  for (int i = -4; i <= 4; ++i) {
+    positions.push_back(coarse + i * step);
+  }
+  if (!score(sinogram, positions, fineSize, scores, canceled)) {
+    return start;
+  }
+  size_t i = best(scores);
+  if (i == 0 || i + 1 == scores.size()) {
+    return positions[i];
+  }
+  return positions[i] +
+         step * ImageAlignment::apex(scores[i - 1], scores[i], scores[i + 1]);
+}
+
+TiltAxisPreview::Axis TiltAxisPreview::searchAxis(
+  const std::vector<SinogramPtr>& sinograms, const Axis& start,
+  const std::atomic<bool>* canceled)
+{
+  // Each sinogram gives the position of the axis at its slice, measured from
+  // the center slice the positions lie on a line whose slope is the sine of
+  // the rotation.
+  std::vector<double> offsets;
+  std::vector<double> positions;
+  for (const SinogramPtr& sinogram : sinograms) {
+    if (!sinogram || (canceled && *canceled)) {
+      continue;
+    }
+    double position = searchPosition(*sinogram, axisPosition(*sinogram, start),
+                                     sinogram->numberOfRays / 4.0, canceled);
+    offsets.push_back(sinogram->slice - sinogram->numberOfSlices / 2);
+    positions.push_back(position);
+  }
+  if (positions.empty() || (canceled && *canceled)) {
+    return start;
+  }
+
+  double n = static_cast<double>(positions.size());
+  double meanOffset = 0.0;
+  double meanPosition = 0.0;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    meanOffset += offsets[i] / n;
+    meanPosition += positions[i] / n;
+  }
+  double covariance = 0.0;
+  double variance = 0.0;
+  for (size_t i = 0; i < positions.size(); ++i) {
+    covariance += (offsets[i] - meanOffset) * (positions[i] - meanPosition);
+    variance += (offsets[i] - meanOffset) * (offsets[i] - meanOffset);
+  }
+
+  Axis axis = start;
+  if (variance > 0.0) {
+    double slope = std::max(-1.0, std::min(1.0, covariance / variance));
+    axis.angle = -vtkMath::DegreesFromRadians(std::asin(slope));
+  }
+  double slope = std::sin(vtkMath::RadiansFromDegrees(-axis.angle));
+  axis.shift = -(meanPosition - slope * meanOffset);
+  return axis;
+}
+}
@@ -0,0 +1,165 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizTiltAxisPreview_h
+#define tomvizTiltAxisPreview_h
+
+#include <QObject>
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class vtkImageData;
+
+namespace tomviz {
+
+/// Reconstructs slices of a tilt series for a trial tilt axis in the
+/// background, for the previews of RotateAlignWidget, and searches for the
+/// axis that gives the sharpest slices. The sinograms of the previewed slices
+/// are copied out of the tilt series once and kept, so moving the axis only
+/// resamples and back projects them. Each request cancels the one before it
+/// if it has not finished.
+class TiltAxisPreview : public QObject
+{
+  Q_OBJECT
+
+public:
+  /// Edge length of the previews while the axis is changing, and once it
+  /// settles.
+  static const int draftSize = 128;
+  static const int fullSize = 256;
+
+  /// The tilt axis as set in RotateAlignWidget, the shift of the axis from
+  /// the center of the projections in pixels and its rotation in the plane
+  /// of the projections in degrees.
+  struct Axis
+  {
+    double shift;
+    double angle;
+  };
+
+  /// The sinogram of one slice, the rays of each tilt stored contiguously.
+  struct Sinogram
+  {
+    int slice = 0;
+    int numberOfSlices = 0;
+    int numberOfRays = 0;
+    std::vector<double> tiltAngles;
+    std::vector<float> values;
+  };
+  typedef std::shared_ptr<const Sinogram> SinogramPtr;
+
+  TiltAxisPreview(QObject* parent = nullptr);
+  ~TiltAxisPreview() override;
+
+  /// Previews the slices of tiltSeries from now on.
+  void setTiltSeries(vtkImageData* tiltSeries);
+
+  /// Reconstructs the slices in the background at size by size pixels,
+  /// previewReady() is emitted with the index of each in slices.
+  void request(const std::vector<int>& slices, const Axis& axis, int size);
+
+  /// Searches for the axis in the background starting from axis, using the
+  /// slices. axisFound() is emitted unless another search starts first.
+  void search(const std::vector<int>& slices, const Axis& axis);
+
+  /// Returns the last reconstruction delivered for index, or nullptr.
+  vtkImageData* preview(int index) const;
+
+  /// Copies the sinogram of slice out of the tilt series, converting only the
+  /// values it needs to float.
+  static SinogramPtr extractSinogram(vtkImageData* tiltSeries, int slice);
+
+  /// The position of the axis in the sinogram, in rays from its center. The
+  /// rotation is approximated by a shift that varies along the slices.
+  static double axisPosition(const Sinogram& sinogram, const Axis& axis);
+
+  /// Reconstructs the sinogram by unweighted back projection with the axis
+  /// at position, into size by size pixels.
+  static void reconstruct(const Sinogram& sinogram, double position, int size,
+                          float* image);
+
+  /// Scores how sharp a reconstruction of the sinogram is with the axis at
+  /// position, higher is sharper. The sinogram is filtered before it is back
+  /// projected, and with the axis in the wrong place each feature smears
+  /// into an arc. The score is the kurtosis of the values of the slice, which
+  /// is largest when a few of them stand out.
+  static double sharpness(const Sinogram& sinogram, double position,
+                          int size);
+
+  /// Returns the axis position that gives the sharpest reconstruction of the
+  /// sinogram within range rays of start. Candidates are scored in parallel
+  /// at draftSize first, then refined at fullSize, or at the size of the
+  /// sinogram if it is smaller. Returns start if canceled becomes true.
+  static double searchPosition(const Sinogram& sinogram, double start,
+                               double range,
+                               const std::atomic<bool>* canceled = nullptr);
+
+  /// Searches the axis position of each sinogram and fits the axis to them.
+  /// The angle is only fitted when the sinograms are of two or more
+  /// different slices, otherwise the one of start is kept.
+  static Axis searchAxis(const std::vector<SinogramPtr>& sinograms,
+                         const Axis& start,
+                         const std::atomic<bool>* canceled = nullptr);
+
+signals:
+  void previewReady(int index);
+  void axisFound(double shift, double angle);
+
+private slots:
+  void deliver();
+
+private:
+  class Task;
+
+  struct Preview
+  {
+    int generation;
+    int index;
+    vtkSmartPointer<vtkImageData> image;
+  };
+
+  std::vector<SinogramPtr> sinograms(const std::vector<int>& slices);
+
+  vtkSmartPointer<vtkImageData> m_tiltSeries;
+  vtkMTimeType m_tiltSeriesTime = 0;
+  QHash<int, SinogramPtr> m_sinograms;
+  std::vector<vtkSmartPointer<vtkImageData>> m_previews;
+
+  int m_generation = 0;
+  int m_searchGeneration = 0;
+  std::shared_ptr<std::atomic<bool>> m_previewCanceled;
+  std::shared_ptr<std::atomic<bool>> m_searchCanceled;
+  QThreadPool m_pool;
+
+  // Results handed over by the tasks.
+  QMutex m_mutex;
+  QList<Preview> m_ready;
+  bool m_axisReady = false;
+  int m_axisGeneration = 0;
+  Axis m_axis;
+};
+}
+
+#endif
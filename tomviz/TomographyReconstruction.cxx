@@ -14,9 +14,15 @@
 
  ******************************************************************************/
 #include "TomographyReconstruction.h"
+#include "Parallel.h"
 #include "TomographyTiltSeries.h"
 #include <math.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
 #include "vtkDataArray.h"
 #include "vtkFieldData.h"
 #include "vtkImageData.h"
@@ -48,7 +54,8 @@ namespace tomviz {
 namespace TomographyReconstruction {
 
 // 3D Weighted Back Projection reconstruction
-void weightedBackProjection3(vtkImageData* tiltSeries, vtkImageData* recon)
+void weightedBackProjection3(vtkImageData* tiltSeries, vtkImageData* recon,
+                             FilterType filter)
 {
   int extents[6];
   tiltSeries->GetExtent(extents);
@@ -69,70 +76,577 @@ void weightedBackProjection3(vtkImageData* tiltSeries, vtkImageData* recon)
                          1); // 1 is for one component (i.e. not vector)
   float* reconPtr = static_cast<float*>(recon->GetScalarPointer());
 
-  // Reconstruction
-  float* sinogram = new float[yDim * zDim]; // Placeholder for 2D sinogram
-  float* recon2d =
-    new float[yDim * yDim]; // Placeholder for 2D reconstruction (y-z plane)
-  for (int s = 0; s < xDim; ++s) // Loop through slices (x-direction)
-  {
-    // Get sinogram
-    TomographyTiltSeries::getSinogram(tiltSeries, s, sinogram);
-    // 2D back projection
-    TomographyReconstruction::unweightedBackProjection2(sinogram, tiltAngles,
-                                                        recon2d, zDim, yDim);
-    // Put recon into
-    for (int iy = 0; iy < outputSize[1];
-         ++iy) // Loop through all pixels in reconstructed image (y-z plane)
-      for (int iz = 0; iz < outputSize[2]; ++iz) {
-        reconPtr[iz * outputSize[0] * outputSize[1] + iy * outputSize[0] + s] =
-          recon2d[iy * outputSize[1] + iz];
+  // Reconstruction. Each sinogram is stored contiguously, and the slices are
+  // independent so they are reconstructed in parallel.
+  TomographyTiltSeries::SinogramProvider sinograms(
+    tiltSeries, TomographyTiltSeries::SinogramProvider::SliceMajor);
+  BackProjectionGeometry geometry(tiltAngles, zDim, yDim);
+  SinogramFilter sinogramFilter(filter, yDim);
+  Parallel::forRange(0, xDim, 1, [&](int begin, int end) {
+    // Placeholder for the filtered sinogram
+    std::vector<float> sinogram(static_cast<size_t>(yDim) * zDim);
+    // Placeholder for 2D reconstruction (y-z plane)
+    std::vector<float> recon2d(static_cast<size_t>(yDim) * yDim);
+    for (int s = begin; s < end; ++s) // Loop through slices (x-direction)
+    {
+      sinograms.copySinogram(s, sinogram.data());
+      sinogramFilter.apply(sinogram.data(), zDim);
+      // 2D back projection
+      TomographyReconstruction::unweightedBackProjection2(
+        sinogram.data(), geometry, recon2d.data());
+      // Put recon into
+      for (int iy = 0; iy < outputSize[1];
+           ++iy) // Loop through all pixels in reconstructed image (y-z plane)
+        for (int iz = 0; iz < outputSize[2]; ++iz) {
+          reconPtr[(static_cast<size_t>(iz) * outputSize[1] + iy) *
+                     outputSize[0] +
+                   s] = recon2d[iy * outputSize[1] + iz];
+        }
+    }
+  });
+}
+
+StreamingBackProjection::StreamingBackProjection(int numOfSlices,
+                                                 int numOfRays,
+                                                 FilterType filter)
+  : m_numOfSlices(numOfSlices), m_numOfRays(numOfRays),
+    m_filter(filter, numOfRays)
+{
+}
+
+void StreamingBackProjection::addProjection(const float* projection,
+                                            double tiltAngle,
+                                            const float* previous,
+                                            float* recon)
+{
+  const int slices = m_numOfSlices;
+  const int rays = m_numOfRays;
+  const size_t size = static_cast<size_t>(slices) * rays;
+  ++m_numOfProjections;
+  const bool first = m_numOfProjections == 1;
+
+  // The normalization depends on the number of tilts, so the sum of the
+  // earlier projections is rescaled as each one is added.
+  const float decay =
+    static_cast<float>(double(m_numOfProjections - 1) / m_numOfProjections);
+  const float weight = static_cast<float>(PI / double(2 * m_numOfProjections));
+
+  // Filter the rays of each slice, as the sinogram rows are filtered, then
+  // store them by ray so the slices stay contiguous like the reconstruction.
+  std::vector<float> filtered(projection, projection + size);
+  if (m_filter.filterType() != FilterType::None) {
+    std::vector<float> rows(size);
+    Parallel::forRange(0, slices, 16, [&](int begin, int end) {
+      for (int s = begin; s < end; ++s) {
+        for (int r = 0; r < rays; ++r) {
+          rows[static_cast<size_t>(s) * rays + r] =
+            projection[static_cast<size_t>(r) * slices + s];
+        }
+      }
+      m_filter.apply(&rows[static_cast<size_t>(begin) * rays], end - begin);
+      for (int s = begin; s < end; ++s) {
+        for (int r = 0; r < rays; ++r) {
+          filtered[static_cast<size_t>(r) * slices + s] =
+            rows[static_cast<size_t>(s) * rays + r];
+        }
+      }
+    });
+  }
+
+  BackProjectionGeometry geometry(&tiltAngle, 1, rays);
+  const float* yTerms = geometry.yTerms(0);
+  const float* zTerms = geometry.zTerms(0);
+  const int lastRay = rays - 2;
+  Parallel::forRange(0, rays, 1, [&](int begin, int end) {
+    for (int iz = begin; iz < end; ++iz) {
+      for (int iy = 0; iy < rays; ++iy) {
+        size_t offset = (static_cast<size_t>(iz) * rays + iy) * slices;
+        float* out = recon + offset;
+        const float* before = first ? nullptr : previous + offset;
+        float t = yTerms[iy] + zTerms[iz];
+        int rayIndex = static_cast<int>(std::floor(t));
+        // Rays outside the projection don't contribute
+        if (rayIndex < 0 || rayIndex > lastRay) {
+          for (int s = 0; s < slices; ++s) {
+            out[s] = first ? 0.0f : before[s] * decay;
+          }
+          continue;
+        }
+        // Linear interpolation between the two rays, for every slice.
+        float fraction = t - rayIndex;
+        const float* q1 = &filtered[static_cast<size_t>(rayIndex) * slices];
+        const float* q2 = q1 + slices;
+        if (first) {
+          for (int s = 0; s < slices; ++s) {
+            out[s] = weight * (q1[s] + fraction * (q2[s] - q1[s]));
+          }
+        } else {
+          for (int s = 0; s < slices; ++s) {
+            out[s] = before[s] * decay +
+                     weight * (q1[s] + fraction * (q2[s] - q1[s]));
+          }
+        }
+      }
+    }
+  });
+}
+
+SinogramFilter::SinogramFilter(FilterType filter, int numOfRays)
+  : m_filter(filter), m_numOfRays(numOfRays), m_paddedSize(numOfRays)
+{
+  if (filter == FilterType::None || numOfRays < 1) {
+    return;
+  }
+
+  // Zero pad to a power of two, at least twice the number of rays so the
+  // filtered rows don't wrap around into each other.
+  m_paddedSize = 64;
+  while (m_paddedSize < 2 * numOfRays) {
+    m_paddedSize *= 2;
+  }
+  const int n = m_paddedSize;
+
+  m_fft = FFT(n);
+
+  // Build the ramp filter from its band-limited spatial kernel rather than
+  // sampling |f| directly, so the zero frequency is handled correctly
+  // (Kak & Slaney, eq. 61).
+  std::vector<std::complex<double>> kernel(n);
+  kernel[0] = 0.25;
+  for (int i = 1; i < n; ++i) {
+    int k = i <= n / 2 ? i : n - i;
+    if (k % 2 == 1) {
+      kernel[i] = -1.0 / ((PI * k) * (PI * k));
+    }
+  }
+  m_fft.transform(kernel.data(), false);
+
+  m_response.resize(n);
+  for (int i = 0; i < n; ++i) {
+    // Normalized frequency in [0, 0.5]
+    double f = (i <= n / 2 ? i : n - i) / static_cast<double>(n);
+    double window = 1.0;
+    switch (filter) {
+      case FilterType::SheppLogan:
+        window = f > 0 ? sin(PI * f) / (PI * f) : 1.0;
+        break;
+      case FilterType::Cosine:
+        window = cos(PI * f);
+        break;
+      case FilterType::Hamming:
+        window = 0.54 + 0.46 * cos(2.0 * PI * f);
+        break;
+      case FilterType::Hann:
+        window = 0.5 * (1.0 + cos(2.0 * PI * f));
+        break;
+      default:
+        break;
+    }
+    m_response[i] = 2.0 * kernel[i].real() * window;
+  }
+}
+
+void SinogramFilter::apply(float* sinogram, int numOfTilts) const
+{
+  if (m_filter == FilterType::None || m_response.empty()) {
+    return;
+  }
+
+  const int n = m_paddedSize;
+  const double scale = 1.0 / n;
+  std::vector<std::complex<double>> buffer(n);
+  // The response is real and even, so filtering two real rows packed into
+  // the real and imaginary parts of one complex row filters both at once.
+  for (int tt = 0; tt < numOfTilts; tt += 2) {
+    float* first = sinogram + static_cast<size_t>(tt) * m_numOfRays;
+    float* second = tt + 1 < numOfTilts ? first + m_numOfRays : nullptr;
+    for (int i = 0; i < m_numOfRays; ++i) {
+      buffer[i] = std::complex<double>(first[i], second ? second[i] : 0.0);
+    }
+    std::fill(buffer.begin() + m_numOfRays, buffer.end(), 0.0);
+
+    m_fft.transform(buffer.data(), false);
+    for (int i = 0; i < n; ++i) {
+      buffer[i] *= m_response[i] * scale;
+    }
+    m_fft.transform(buffer.data(), true);
+
+    for (int i = 0; i < m_numOfRays; ++i) {
+      first[i] = static_cast<float>(buffer[i].real());
+      if (second) {
+        second[i] = static_cast<float>(buffer[i].imag());
       }
+    }
   }
-  delete[] recon2d;
-  delete[] sinogram;
 }
 
 // 2D WBP recon
 void unweightedBackProjection2(float* sinogram, double* tiltAngles,
                                float* image, int numOfTilts, int numOfRays)
 {
-  for (int i = 0; i < numOfRays * numOfRays; ++i) {
-    image[i] = 0; // Set all pixels to zero
-  }
+  BackProjectionGeometry geometry(tiltAngles, numOfTilts, numOfRays);
+  unweightedBackProjection2(sinogram, geometry, image);
+}
 
-  // 2D unweighted Back Projection
-  for (int tt = 0; tt < numOfTilts; ++tt) // Loop through tilts
-  {
+BackProjectionGeometry::BackProjectionGeometry(const double* tiltAngles,
+                                               int numOfTilts, int numOfRays)
+  : m_numOfTilts(numOfTilts), m_numOfRays(numOfRays),
+    m_yTerms(static_cast<size_t>(numOfTilts) * numOfRays),
+    m_zTerms(static_cast<size_t>(numOfTilts) * numOfRays)
+{
+  // Rays are indexed from the edge of the projection, so fold the offset of
+  // the rotation axis into the y term.
+  double offset = numOfRays / 2;
+  for (int tt = 0; tt < numOfTilts; ++tt) {
     double angle = tiltAngles[tt] * PI / 180;
-    for (int iy = 0; iy < numOfRays; ++iy) // Loop through all pixels in
-                                           // reconstructed image (y-z plane for
-                                           // a tilt series)
+    double c = cos(angle);
+    double s = sin(angle);
+    float* yTerm = &m_yTerms[static_cast<size_t>(tt) * numOfRays];
+    float* zTerm = &m_zTerms[static_cast<size_t>(tt) * numOfRays];
+    for (int i = 0; i < numOfRays; ++i) {
+      // Calculate y,z coord. of the pixel center
+      double coord = i + 0.5 - ((double)numOfRays) / 2.0;
+      yTerm[i] = static_cast<float>(coord * c + offset);
+      zTerm[i] = static_cast<float>(coord * s);
+    }
+  }
+}
+
+void unweightedBackProjection2(const float* sinogram,
+                               const BackProjectionGeometry& geometry,
+                               float* image)
+{
+  const int numOfTilts = geometry.numberOfTilts();
+  const int numOfRays = geometry.numberOfRays();
+  const int lastRay = numOfRays - 2;
+  const float normalizationFactor =
+    static_cast<float>(PI / double(2 * numOfTilts));
+
+  std::fill(image, image + static_cast<size_t>(numOfRays) * numOfRays, 0.0f);
+  if (numOfRays < 2) {
+    return;
+  }
+
+  // Process one output row at a time so it stays in cache while every tilt
+  // is accumulated into it. The inner loop is branch free so the compiler can
+  // vectorize it.
+  for (int iy = 0; iy < numOfRays; ++iy) {
+    float* row = image + static_cast<size_t>(iy) * numOfRays;
+    for (int tt = 0; tt < numOfTilts; ++tt) {
+      const float* projection = sinogram + static_cast<size_t>(tt) * numOfRays;
+      const float* zTerm = geometry.zTerms(tt);
+      const float y = geometry.yTerms(tt)[iy];
       for (int iz = 0; iz < numOfRays; ++iz) {
-        // Calcualte y,z coord.
-        double y = iy + 0.5 - ((double)numOfRays) / 2.0;
-        double z = iz + 0.5 - ((double)numOfRays) / 2.0;
         // Calculate ray coord.
-        double t = y * cos(angle) + z * sin(angle);
-
-        if (t >= -numOfRays / 2 &&
-            t <= numOfRays / 2) // check if ray is inside projection
-        {
-          int rayIndex = floor((t + numOfRays / 2));
-          if (rayIndex >= 0 && rayIndex <= numOfRays - 2) {
-            // Linear interpolation
-            double Q1 = sinogram[tt * numOfRays + rayIndex];
-            double Q2 = sinogram[tt * numOfRays + rayIndex + 1];
-            double QDash =
-              Q1 + (t - double(rayIndex - numOfRays / 2)) * (Q2 - Q1);
-            image[iy * numOfRays + iz] += QDash;
-          }
-        }
+        float t = y + zTerm[iz];
+        int rayIndex = static_cast<int>(std::floor(t));
+        // Rays outside the projection don't contribute
+        bool inside = rayIndex >= 0 && rayIndex <= lastRay;
+        int index = inside ? rayIndex : 0;
+        // Linear interpolation
+        float q1 = projection[index];
+        float q2 = projection[index + 1];
+        float qDash = q1 + (t - rayIndex) * (q2 - q1);
+        row[iz] += inside ? qDash : 0.0f;
       }
+    }
+    for (int iz = 0; iz < numOfRays; ++iz) {
+      row[iz] *= normalizationFactor;
+    }
   }
+}
 
-  double normalizationFactor = PI / double(2 * numOfTilts);
-  for (int i = 0; i < numOfRays * numOfRays; ++i) {
-    image[i] *= normalizationFactor;
+namespace {
+
+// Clips the ray origin + t * direction to the slab [-half, half] along one
+// axis, narrowing [tEnter, tExit]. Returns false if the ray misses the slab.
+bool clipToSlab(double origin, double direction, double half, double& tEnter,
+                double& tExit)
+{
+  if (std::abs(direction) < 1e-12) {
+    return origin >= -half && origin <= half;
+  }
+  double t1 = (-half - origin) / direction;
+  double t2 = (half - origin) / direction;
+  tEnter = std::max(tEnter, std::min(t1, t2));
+  tExit = std::min(tExit, std::max(t1, t2));
+  return tExit > tEnter;
+}
+
+// Index of the pixel containing coordinate x, clamped to the slice.
+int pixelIndex(double x, double half, int numOfPixels)
+{
+  int i = static_cast<int>(std::floor(x + half));
+  return std::min(std::max(i, 0), numOfPixels - 1);
+}
+}
+
+template <typename Visitor>
+void RayProjector::traceRay(int tilt, int ray, Visitor&& visit) const
+{
+  const int n = m_numOfRays;
+  const double half = n / 2.0;
+  const double infinity = std::numeric_limits<double>::infinity();
+
+  // The ray is the line y * cos + z * sin = offset, with rays placed like the
+  // ones unweightedBackProjection2 interpolates.
+  const double offset = ray - n / 2;
+  const double y0 = offset * m_cos[tilt];
+  const double z0 = offset * m_sin[tilt];
+  const double dy = -m_sin[tilt];
+  const double dz = m_cos[tilt];
+
+  double t = -infinity;
+  double tExit = infinity;
+  if (!clipToSlab(y0, dy, half, t, tExit) ||
+      !clipToSlab(z0, dz, half, t, tExit)) {
+    return;
+  }
+
+  // Step from pixel to pixel through the grid, visiting each with the length
+  // of the ray inside it.
+  const double probe = t + 1e-6 * std::min(1.0, tExit - t);
+  int iy = pixelIndex(y0 + probe * dy, half, n);
+  int iz = pixelIndex(z0 + probe * dz, half, n);
+  const int stepY = dy > 0 ? 1 : -1;
+  const int stepZ = dz > 0 ? 1 : -1;
+  const double deltaY = std::abs(dy) < 1e-12 ? infinity : 1.0 / std::abs(dy);
+  const double deltaZ = std::abs(dz) < 1e-12 ? infinity : 1.0 / std::abs(dz);
+  double nextY = std::abs(dy) < 1e-12
+                   ? infinity
+                   : (iy + (dy > 0 ? 1 : 0) - half - y0) / dy;
+  double nextZ = std::abs(dz) < 1e-12
+                   ? infinity
+                   : (iz + (dz > 0 ? 1 : 0) - half - z0) / dz;
+  for (;;) {
+    double tNext = std::min(std::min(nextY, nextZ), tExit);
+    if (tNext > t) {
+      visit(iy * n + iz, static_cast<float>(tNext - t));
+      t = tNext;
+    }
+    if (tNext >= tExit) {
+      break;
+    }
+    if (nextY <= tNext) {
+      iy += stepY;
+      nextY += deltaY;
+    }
+    if (nextZ <= tNext) {
+      iz += stepZ;
+      nextZ += deltaZ;
+    }
+    if (iy < 0 || iy >= n || iz < 0 || iz >= n) {
+      break;
+    }
+  }
+}
+
+RayProjector::RayProjector(const double* tiltAngles, int numOfTilts,
+                           int numOfRays)
+  : m_numOfTilts(numOfTilts), m_numOfRays(numOfRays), m_cos(numOfTilts),
+    m_sin(numOfTilts),
+    m_rowNorms(static_cast<size_t>(numOfTilts) * numOfRays, 0.0f),
+    m_componentWeights(static_cast<size_t>(numOfTilts) * numOfRays, 0.0f),
+    m_normBound(0.0)
+{
+  for (int tt = 0; tt < numOfTilts; ++tt) {
+    double angle = tiltAngles[tt] * PI / 180;
+    m_cos[tt] = cos(angle);
+    m_sin[tt] = sin(angle);
+  }
+
+  // Row and column statistics of the system matrix, gathered by tracing each
+  // ray twice rather than storing the matrix.
+  std::vector<int> raysPerPixel(static_cast<size_t>(numOfRays) * numOfRays, 0);
+  std::vector<double> columnSums(raysPerPixel.size(), 0.0);
+  double maxRowSum = 0.0;
+  for (int tt = 0; tt < numOfTilts; ++tt) {
+    for (int j = 0; j < numOfRays; ++j) {
+      double rowSum = 0.0;
+      double rowNorm = 0.0;
+      traceRay(tt, j, [&](int pixel, float length) {
+        ++raysPerPixel[pixel];
+        columnSums[pixel] += length;
+        rowSum += length;
+        rowNorm += length * length;
+      });
+      maxRowSum = std::max(maxRowSum, rowSum);
+      m_rowNorms[static_cast<size_t>(tt) * numOfRays + j] =
+        static_cast<float>(rowNorm);
+    }
+  }
+  m_normBound =
+    maxRowSum * *std::max_element(columnSums.begin(), columnSums.end());
+
+  for (int tt = 0; tt < numOfTilts; ++tt) {
+    for (int j = 0; j < numOfRays; ++j) {
+      double weight = 0.0;
+      traceRay(tt, j, [&](int pixel, float length) {
+        weight += length * length * raysPerPixel[pixel];
+      });
+      m_componentWeights[static_cast<size_t>(tt) * numOfRays + j] =
+        static_cast<float>(weight);
+    }
+  }
+}
+
+void RayProjector::forward(const float* slice, float* sinogram) const
+{
+  for (int tt = 0; tt < m_numOfTilts; ++tt) {
+    for (int j = 0; j < m_numOfRays; ++j) {
+      double sum = 0.0;
+      traceRay(tt, j,
+               [&](int pixel, float length) { sum += length * slice[pixel]; });
+      sinogram[static_cast<size_t>(tt) * m_numOfRays + j] =
+        static_cast<float>(sum);
+    }
+  }
+}
+
+void RayProjector::back(const float* sinogram, float* slice) const
+{
+  std::fill(slice, slice + static_cast<size_t>(m_numOfRays) * m_numOfRays,
+            0.0f);
+  for (int tt = 0; tt < m_numOfTilts; ++tt) {
+    for (int j = 0; j < m_numOfRays; ++j) {
+      float value = sinogram[static_cast<size_t>(tt) * m_numOfRays + j];
+      if (value != 0.0f) {
+        traceRay(tt, j, [&](int pixel, float length) {
+          slice[pixel] += length * value;
+        });
+      }
+    }
+  }
+}
+
+double RayProjector::artSweep(const float* sinogram, float* slice,
+                              double relaxation) const
+{
+  double residual = 0.0;
+  for (int tt = 0; tt < m_numOfTilts; ++tt) {
+    for (int j = 0; j < m_numOfRays; ++j) {
+      size_t row = static_cast<size_t>(tt) * m_numOfRays + j;
+      if (m_rowNorms[row] <= 0.0f) {
+        continue;
+      }
+      double sum = 0.0;
+      traceRay(tt, j,
+               [&](int pixel, float length) { sum += length * slice[pixel]; });
+      double difference = sinogram[row] - sum;
+      residual += difference * difference;
+      float scale =
+        static_cast<float>(relaxation * difference / m_rowNorms[row]);
+      traceRay(tt, j, [&](int pixel, float length) {
+        slice[pixel] += scale * length;
+      });
+    }
+  }
+  return residual;
+}
+
+IterativeSolver::IterativeSolver(const RayProjector& projector,
+                                 const IterativeOptions& options)
+  : m_projector(projector), m_options(options)
+{
+  size_t numOfRays = static_cast<size_t>(projector.numberOfRays());
+  m_projection.resize(projector.numberOfTilts() * numOfRays);
+  m_update.resize(numOfRays * numOfRays);
+  if (options.tvSteps > 0) {
+    m_previous.resize(numOfRays * numOfRays);
+  }
+}
+
+double IterativeSolver::iterate(const float* sinogram, float* slice,
+                                int iteration)
+{
+  const size_t numOfPixels = m_update.size();
+  const bool minimizeTV = m_options.tvSteps > 0;
+  double relaxation = m_options.relaxation;
+  if (minimizeTV) {
+    relaxation *= std::pow(m_options.tvRelaxationDecay, iteration);
+    std::copy(slice, slice + numOfPixels, m_previous.begin());
+  }
+
+  double residual = 0.0;
+  if (m_options.method == IterativeMethod::ART) {
+    residual = m_projector.artSweep(sinogram, slice, relaxation);
+  } else {
+    // Weight the residual of each ray by the update rule, then back project
+    // it to get the update of every pixel at once.
+    const std::vector<float>& rowNorms = m_projector.rowNorms();
+    const std::vector<float>& weights = m_projector.componentWeights();
+    m_projector.forward(slice, m_projection.data());
+    for (size_t row = 0; row < m_projection.size(); ++row) {
+      double difference = sinogram[row] - m_projection[row];
+      residual += difference * difference;
+      double weight = 1.0;
+      if (m_options.method == IterativeMethod::Cimmino) {
+        weight = rowNorms[row] > 0.0f ? 1.0 / rowNorms[row] : 0.0;
+      } else if (m_options.method == IterativeMethod::ComponentAveraging) {
+        weight = weights[row] > 0.0f ? 1.0 / weights[row] : 0.0;
+      }
+      m_projection[row] = static_cast<float>(difference * weight);
+    }
+    m_projector.back(m_projection.data(), m_update.data());
+
+    double scale = relaxation;
+    if (m_options.method == IterativeMethod::Landweber) {
+      scale /= m_projector.normBound();
+    } else if (m_options.method == IterativeMethod::Cimmino) {
+      scale /= m_projection.size();
+    }
+    for (size_t i = 0; i < numOfPixels; ++i) {
+      slice[i] += static_cast<float>(scale * m_update[i]);
+    }
+  }
+
+  if (minimizeTV) {
+    double distance = 0.0;
+    for (size_t i = 0; i < numOfPixels; ++i) {
+      slice[i] = std::max(slice[i], 0.0f);
+      double change = slice[i] - m_previous[i];
+      distance += change * change;
+    }
+    minimizeTotalVariation(slice, std::sqrt(distance));
+  }
+  return residual;
+}
+
+void IterativeSolver::minimizeTotalVariation(float* slice, double distance)
+{
+  const int n = m_projector.numberOfRays();
+  const double epsilon = 1e-8;
+  float* gradient = m_update.data();
+  auto at = [&](int iy, int iz) -> double { return slice[iy * n + iz]; };
+  auto magnitude = [&](double a, double b) {
+    return std::sqrt(epsilon + a * a + b * b);
+  };
+
+  for (int step = 0; step < m_options.tvSteps; ++step) {
+    // Gradient of the isotropic total variation with backward differences,
+    // leaving the border of the slice fixed.
+    std::fill(m_update.begin(), m_update.end(), 0.0f);
+    double norm = 0.0;
+    for (int iy = 1; iy < n - 1; ++iy) {
+      for (int iz = 1; iz < n - 1; ++iz) {
+        double f = at(iy, iz);
+        double v = (2 * f - at(iy - 1, iz) - at(iy, iz - 1)) /
+                   magnitude(f - at(iy - 1, iz), f - at(iy, iz - 1));
+        v += (f - at(iy + 1, iz)) /
+             magnitude(at(iy + 1, iz) - f, at(iy + 1, iz) - at(iy + 1, iz - 1));
+        v += (f - at(iy, iz + 1)) /
+             magnitude(at(iy, iz + 1) - at(iy - 1, iz + 1), at(iy, iz + 1) - f);
+        gradient[iy * n + iz] = static_cast<float>(v);
+        norm += v * v;
+      }
+    }
+    if (norm <= 0.0) {
+      break;
+    }
+    double scale = m_options.tvWeight * distance / std::sqrt(norm);
+    for (size_t i = 0; i < m_update.size(); ++i) {
+      slice[i] -= static_cast<float>(scale * gradient[i]);
+    }
   }
 }
 }
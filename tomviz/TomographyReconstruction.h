@@ -17,18 +17,125 @@
 #ifndef tomvizTomographyReconstruction_h
 #define tomvizTomographyReconstruction_h
 
+#include "FFT.h"
+
 #include <pqReaction.h>
 #include <vtkImageData.h>
 
+#include <vector>
+
 namespace tomviz {
 class DataSource;
 
 namespace TomographyReconstruction {
 
+/// Frequency filters applied to the sinogram rows before back projection.
+/// Ramp is the plain Ram-Lak filter, the others apodize it to reduce noise.
+enum class FilterType
+{
+  None,
+  Ramp,
+  SheppLogan,
+  Cosine,
+  Hamming,
+  Hann
+};
+
+/// Filters the rows of sinograms in the frequency domain. The rows are zero
+/// padded to a power of two at least twice their length to avoid wrap around,
+/// and two real rows are transformed with each complex FFT. The filter
+/// response and FFT tables are computed once, so one SinogramFilter can be
+/// shared by every slice of a reconstruction and used from several threads.
+class SinogramFilter
+{
+public:
+  SinogramFilter(FilterType filter, int numOfRays);
+
+  FilterType filterType() const { return m_filter; }
+  int numberOfRays() const { return m_numOfRays; }
+  int paddedSize() const { return m_paddedSize; }
+
+  /// Filter each of the numOfTilts rows of the sinogram in place.
+  void apply(float* sinogram, int numOfTilts) const;
+
+private:
+  FilterType m_filter;
+  int m_numOfRays;
+  int m_paddedSize;
+  std::vector<double> m_response;
+  FFT m_fft;
+};
+
+/// Geometry shared by every slice of a back projection. The ray coordinate of
+/// reconstruction pixel (iy, iz) at tilt tt is yTerms(tt)[iy] + zTerms(tt)[iz],
+/// measured from the first ray of the projection. Building this once per
+/// reconstruction avoids evaluating cos/sin for every pixel of every slice.
+class BackProjectionGeometry
+{
+public:
+  BackProjectionGeometry(const double* tiltAngles, int numOfTilts,
+                         int numOfRays);
+
+  int numberOfTilts() const { return m_numOfTilts; }
+  int numberOfRays() const { return m_numOfRays; }
+
+  const float* yTerms(int tilt) const
+  {
+    return &m_yTerms[static_cast<size_t>(tilt) * m_numOfRays];
+  }
+  const float* zTerms(int tilt) const
+  {
+    return &m_zTerms[static_cast<size_t>(tilt) * m_numOfRays];
+  }
+
+private:
+  int m_numOfTilts;
+  int m_numOfRays;
+  std::vector<float> m_yTerms;
+  std::vector<float> m_zTerms;
+};
+
 // This takes an image tiltSeries and a vtkImageData in which to place the
-// output (recon)
-void weightedBackProjection3(vtkImageData* tiltSeries,
-                             vtkImageData* recon); // 3D WBP recon
+// output (recon). The sinograms are filtered with the given filter before
+// they are back projected.
+void weightedBackProjection3(
+  vtkImageData* tiltSeries, vtkImageData* recon,
+  FilterType filter = FilterType::Ramp); // 3D WBP recon
+
+/// Weighted back projection of a tilt series whose projections arrive one at
+/// a time, as they are acquired. After each projection is added the
+/// reconstruction is the one weightedBackProjection3 makes of the projections
+/// added so far, at the cost of back projecting the new projection alone.
+class StreamingBackProjection
+{
+public:
+  StreamingBackProjection(int numOfSlices, int numOfRays,
+                          FilterType filter = FilterType::Ramp);
+
+  int numberOfSlices() const { return m_numOfSlices; }
+  int numberOfRays() const { return m_numOfRays; }
+  int numberOfProjections() const { return m_numOfProjections; }
+
+  /// Number of values in the reconstruction, numOfSlices by numOfRays by
+  /// numOfRays laid out as the output of weightedBackProjection3.
+  size_t reconstructionSize() const
+  {
+    return static_cast<size_t>(m_numOfSlices) * m_numOfRays * m_numOfRays;
+  }
+
+  /// Adds a numOfSlices by numOfRays projection, the slices varying fastest,
+  /// taken at tiltAngle degrees. previous holds the reconstruction of the
+  /// projections added before and the new one is written to recon, which may
+  /// be previous. previous is not read for the first projection.
+  void addProjection(const float* projection, double tiltAngle,
+                     const float* previous, float* recon);
+
+private:
+  int m_numOfSlices;
+  int m_numOfRays;
+  int m_numOfProjections = 0;
+  SinogramFilter m_filter;
+};
 
 // This function takes a y-z slice (sinogram) and the tilt angles as input and
 // creates a slice throught the reconstruction space.  The numOfTilts parameter
@@ -42,6 +149,117 @@ void weightedBackProjection3(vtkImageData* tiltSeries,
 void unweightedBackProjection2(float* sinogram, double* tiltAngles,
                                float* recon, int numOfTilts,
                                int numOfRays); // 2D WBP recon
+
+// Same as above, using precomputed geometry. This is safe to call from several
+// threads at once as long as each thread uses its own sinogram and recon.
+void unweightedBackProjection2(const float* sinogram,
+                               const BackProjectionGeometry& geometry,
+                               float* recon);
+
+/// Update rules of the iterative reconstruction. ART updates the slice after
+/// each ray, the others are SIRT variants that update it once per iteration
+/// from the residual of every ray: Landweber steps along the gradient,
+/// Cimmino averages the projections onto each ray and component averaging
+/// weights them by how many rays cross each pixel (Censor et al. 2001).
+enum class IterativeMethod
+{
+  ART,
+  Landweber,
+  Cimmino,
+  ComponentAveraging
+};
+
+/// Parallel beam projector for the iterative methods. The length of each ray
+/// inside each pixel of the slice is computed as the ray is traced (Siddon's
+/// method), so the system matrix is never stored. The slice and sinogram use
+/// the same layout and ray positions as unweightedBackProjection2, and only
+/// the per ray norms the update rules need are kept. This is safe to use
+/// from several threads at once.
+class RayProjector
+{
+public:
+  RayProjector(const double* tiltAngles, int numOfTilts, int numOfRays);
+
+  int numberOfTilts() const { return m_numOfTilts; }
+  int numberOfRays() const { return m_numOfRays; }
+
+  /// Projects a numOfRays by numOfRays slice into a sinogram with the rays of
+  /// each tilt stored contiguously.
+  void forward(const float* slice, float* sinogram) const;
+
+  /// Applies the transpose of forward, overwriting the slice.
+  void back(const float* sinogram, float* slice) const;
+
+  /// One ART sweep over every ray, updating the slice in place. Returns the
+  /// sum of the squared residuals of the rays as they were visited.
+  double artSweep(const float* sinogram, float* slice,
+                  double relaxation) const;
+
+  /// Squared norm of the row of the system matrix for each ray.
+  const std::vector<float>& rowNorms() const { return m_rowNorms; }
+
+  /// Sum over the pixels of a ray of the squared length times the number of
+  /// rays crossing the pixel, the row weights of component averaging.
+  const std::vector<float>& componentWeights() const
+  {
+    return m_componentWeights;
+  }
+
+  /// Upper bound of the squared spectral norm of the system matrix, the
+  /// product of its largest row and column sums.
+  double normBound() const { return m_normBound; }
+
+private:
+  template <typename Visitor>
+  void traceRay(int tilt, int ray, Visitor&& visit) const;
+
+  int m_numOfTilts;
+  int m_numOfRays;
+  std::vector<double> m_cos;
+  std::vector<double> m_sin;
+  std::vector<float> m_rowNorms;
+  std::vector<float> m_componentWeights;
+  double m_normBound;
+};
+
+/// Settings of an iterative reconstruction. The relaxation should be in
+/// (0, 2); Landweber scales it by the inverse of RayProjector::normBound so
+/// the same range applies. When tvSteps is positive each iteration is
+/// followed by a positivity constraint and that many steepest descent steps
+/// on the total variation of the slice, sized by tvWeight times the change
+/// the data update made (ASD-POCS, Sidky & Pan 2008), and the relaxation is
+/// reduced by tvRelaxationDecay every iteration.
+struct IterativeOptions
+{
+  IterativeMethod method = IterativeMethod::ComponentAveraging;
+  int iterations = 10;
+  double relaxation = 1.0;
+  int tvSteps = 0;
+  double tvWeight = 0.2;
+  double tvRelaxationDecay = 0.995;
+};
+
+/// Iterates the reconstruction of one slice. The solver owns the scratch
+/// space of an iteration, so use one solver per thread.
+class IterativeSolver
+{
+public:
+  IterativeSolver(const RayProjector& projector,
+                  const IterativeOptions& options);
+
+  /// Performs the given iteration (counting from zero) on the slice in place.
+  /// Returns the sum of the squared residuals of the sinogram.
+  double iterate(const float* sinogram, float* slice, int iteration);
+
+private:
+  void minimizeTotalVariation(float* slice, double distance);
+
+  const RayProjector& m_projector;
+  IterativeOptions m_options;
+  std::vector<float> m_projection;
+  std::vector<float> m_update;
+  std::vector<float> m_previous;
+};
 }
 }
 
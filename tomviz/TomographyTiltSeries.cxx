@@ -14,42 +14,56 @@
 
  ******************************************************************************/
 #include "TomographyTiltSeries.h"
+#include "Parallel.h"
 #include "vtkDataArray.h"
 #include "vtkFieldData.h"
 #include "vtkImageData.h"
 #include <math.h>
 #define PI 3.14159265359
 #include "vtkFloatArray.h"
+#include "vtkNew.h"
 #include "vtkPointData.h"
 #include "vtkSmartPointer.h"
 
 #include <QDebug>
 
+#include <algorithm>
+#include <vector>
+
 namespace {
 
-// conversion code
+// conversion code, keeping the layout of the tilt series
 template <typename T>
-vtkSmartPointer<vtkFloatArray> convertToFloatT(T* data, int len)
+void convertToFloatT(const T* data, float* f, int xDim, int yDim, int zDim)
 {
-  vtkSmartPointer<vtkFloatArray> array = vtkSmartPointer<vtkFloatArray>::New();
-  array->SetNumberOfTuples(len);
-  float* f = static_cast<float*>(array->GetVoidPointer(0));
-  for (int i = 0; i < len; ++i) {
-    f[i] = (float)data[i];
-  }
-  return array;
+  tomviz::Parallel::forRange(0, zDim, 1, [=](int begin, int end) {
+    size_t first = static_cast<size_t>(begin) * xDim * yDim;
+    size_t last = static_cast<size_t>(end) * xDim * yDim;
+    for (size_t i = first; i < last; ++i) {
+      f[i] = static_cast<float>(data[i]);
+    }
+  });
 }
 
-vtkSmartPointer<vtkFloatArray> convertToFloat(vtkImageData* image)
+// conversion code, storing each sinogram contiguously ([slice][tilt][ray])
+template <typename T>
+void convertToSliceMajorT(const T* data, float* f, int xDim, int yDim,
+                          int zDim)
 {
-  vtkDataArray* scalars = image->GetPointData()->GetScalars();
-  int len = scalars->GetNumberOfTuples();
-  vtkSmartPointer<vtkFloatArray> array;
-  switch (scalars->GetDataType()) {
-    vtkTemplateMacro(array = convertToFloatT(
-                       static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), len););
-  }
-  return array;
+  // Each thread handles whole tilts so the writes never overlap. The reads
+  // stream along x, the writes are strided by one sinogram.
+  size_t sinogramSize = static_cast<size_t>(yDim) * zDim;
+  tomviz::Parallel::forRange(0, zDim, 1, [=](int begin, int end) {
+    for (int t = begin; t < end; ++t) {
+      for (int r = 0; r < yDim; ++r) {
+        const T* row = data + (static_cast<size_t>(t) * yDim + r) * xDim;
+        float* out = f + static_cast<size_t>(t) * yDim + r;
+        for (int x = 0; x < xDim; ++x) {
+          out[x * sinogramSize] = static_cast<float>(row[x]);
+        }
+      }
+    }
+  });
 }
 } // end of namespace
 
@@ -57,88 +71,145 @@ namespace tomviz {
 
 namespace TomographyTiltSeries {
 
-void getSinogram(vtkImageData* tiltSeries, int sliceNumber, float* sinogram)
+SinogramProvider::SinogramProvider(vtkImageData* tiltSeries, Layout layout)
+  : m_layout(layout)
 {
   int extents[6];
   tiltSeries->GetExtent(extents);
-  int xDim = extents[1] - extents[0] + 1; // Number of slices
-  int yDim = extents[3] - extents[2] + 1; // Number of rays
-  int zDim = extents[5] - extents[4] + 1; // Number of tilts
+  m_dims[0] = extents[1] - extents[0] + 1; // Number of slices
+  m_dims[1] = extents[3] - extents[2] + 1; // Number of rays
+  m_dims[2] = extents[5] - extents[4] + 1; // Number of tilts
+
+  vtkDataArray* scalars = tiltSeries->GetPointData()->GetScalars();
+  if (layout == Native && scalars->GetDataType() == VTK_FLOAT &&
+      scalars->GetNumberOfComponents() == 1) {
+    // Nothing to convert, view the data in place.
+    m_array = scalars;
+    m_data = static_cast<float*>(scalars->GetVoidPointer(0));
+    return;
+  }
 
-  // Convert tiltSeries type to float
-  vtkSmartPointer<vtkFloatArray> dataAsFloats = convertToFloat(tiltSeries);
-  float* dataPtr = static_cast<float*>(dataAsFloats->GetVoidPointer(
-    0)); // Get pointer to tilt series (of type float)
+  vtkNew<vtkFloatArray> array;
+  array->SetNumberOfTuples(static_cast<vtkIdType>(m_dims[0]) * m_dims[1] *
+                           m_dims[2]);
+  float* f = static_cast<float*>(array->GetVoidPointer(0));
+  if (layout == SliceMajor) {
+    switch (scalars->GetDataType()) {
+      vtkTemplateMacro(convertToSliceMajorT(
+        static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), f, m_dims[0],
+        m_dims[1], m_dims[2]));
+    }
+  } else {
+    switch (scalars->GetDataType()) {
+      vtkTemplateMacro(
+        convertToFloatT(static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), f,
+                        m_dims[0], m_dims[1], m_dims[2]));
+    }
+  }
+  m_array = array.Get();
+  m_data = f;
+}
 
-  // Extract sinograms from tilt series. Make a deep copy
+SinogramProvider::~SinogramProvider()
+{
+}
+
+SinogramView SinogramProvider::sinogram(int slice) const
+{
+  SinogramView view;
+  if (m_layout == SliceMajor) {
+    view.data = m_data + static_cast<size_t>(slice) * m_dims[1] * m_dims[2];
+    view.rayStride = 1;
+    view.tiltStride = m_dims[1];
+  } else {
+    view.data = m_data + slice;
+    view.rayStride = m_dims[0];
+    view.tiltStride = static_cast<std::ptrdiff_t>(m_dims[0]) * m_dims[1];
+  }
+  return view;
+}
+
+void SinogramProvider::copySinogram(int slice, float* sinogram) const
+{
+  int yDim = numberOfRays();
+  int zDim = numberOfTilts();
+  SinogramView view = this->sinogram(slice);
+  if (view.isContiguous(yDim)) {
+    std::copy(view.data, view.data + static_cast<size_t>(yDim) * zDim,
+              sinogram);
+    return;
+  }
   for (int t = 0; t < zDim; ++t) // Loop through tilts (z-direction)
   {
     for (int r = 0; r < yDim; ++r) // Loop through rays (y-direction)
     {
-      sinogram[t * yDim + r] =
-        dataPtr[t * xDim * yDim + r * xDim + sliceNumber];
+      sinogram[t * yDim + r] = view(t, r);
     }
   }
 }
 
+void getSinogram(vtkImageData* tiltSeries, int sliceNumber, float* sinogram)
+{
+  SinogramProvider provider(tiltSeries);
+  provider.copySinogram(sliceNumber, sinogram);
+}
+
 // Extract sinograms from tilt series
 void getSinogram(vtkImageData* tiltSeries, int sliceNumber, float* sinogram,
                  int Nray, double axisPosition)
 {
-  int extents[6];
-  tiltSeries->GetExtent(extents);
-  int xDim = extents[1] - extents[0] + 1; // number of slices
-  int yDim = extents[3] - extents[2] + 1; // number of rays in tilt series
-  int zDim = extents[5] - extents[4] + 1; // number of tilts
+  SinogramProvider provider(tiltSeries);
+  getSinogram(provider, sliceNumber, sinogram, Nray, axisPosition);
+}
 
-  // Convert tiltSeries type to float
-  vtkSmartPointer<vtkFloatArray> dataAsFloats = convertToFloat(tiltSeries);
-  float* dataPtr = static_cast<float*>(dataAsFloats->GetVoidPointer(
-    0)); // Get pointer to tilt series (of type float)
+void getSinogram(const SinogramProvider& provider, int sliceNumber,
+                 float* sinogram, int Nray, double axisPosition)
+{
+  getSinogram(provider.sinogram(sliceNumber), provider.numberOfRays(),
+              provider.numberOfTilts(), sinogram, Nray, axisPosition);
+}
 
+void getSinogram(const SinogramView& view, int yDim, int zDim,
+                 float* sinogram, int Nray, double axisPosition)
+{
   double rayWidth = (double)yDim / (double)Nray;
   std::vector<float> weight1(Nray); // Store weights for linear interpolation
   std::vector<float> weight2(Nray); // Store weights for linear interpolation
   std::vector<int> index1(Nray);    // Store indices for linear interpolation
   std::vector<int> index2(Nray);    // Store indices for linear interpolation
 
+  // Initialize weights and indicies
+  for (int r = 0; r < Nray; ++r) {
+    double rayCoord = (double)(r - Nray / 2) * rayWidth + axisPosition;
+    index1[r] = floor(rayCoord) + yDim / 2;
+    index2[r] = index1[r] + 1;
+    weight1[r] = fabs(rayCoord - floor(rayCoord));
+    weight2[r] = 1 - weight1[r];
+  }
+
   // Extract sinograms from tilt series. Make a deep copy
   for (int z = 0; z < zDim; ++z) // Loop through tilts (z-direction)
   {
     for (int r = 0; r < Nray; ++r) // Loop through rays (y-direction)
     {
-      if (z == 0) { // Initialize weights and indicies
-        double rayCoord = (double)(r - Nray / 2) * rayWidth + axisPosition;
-        index1[r] = floor(rayCoord) + yDim / 2;
-        index2[r] = index1[r] + 1;
-        weight1[r] = fabs(rayCoord - floor(rayCoord));
-        weight2[r] = 1 - weight1[r];
-      }
       sinogram[z * Nray + r] = 0;
       if (index1[r] >= 0 && index1[r] < yDim)
-        sinogram[z * Nray + r] +=
-          dataPtr[z * xDim * yDim + index1[r] * xDim + sliceNumber] *
-          weight1[r];
+        sinogram[z * Nray + r] += view(z, index1[r]) * weight1[r];
       if (index2[r] >= 0 && index2[r] < yDim)
-        sinogram[z * Nray + r] +=
-          dataPtr[z * xDim * yDim + index2[r] * xDim + sliceNumber] *
-          weight2[r];
+        sinogram[z * Nray + r] += view(z, index2[r]) * weight2[r];
     }
   }
 }
 
 void averageTiltSeries(vtkImageData* tiltSeries, float* average)
 {
-  int extents[6];
-  tiltSeries->GetExtent(extents);
-  int xDim = extents[1] - extents[0] + 1; // Number of slices
-  int yDim = extents[3] - extents[2] + 1; // Number of rays in tilt series
-  int zDim = extents[5] - extents[4] + 1; // Number of tilts
-
-  // Convert tiltSeries type to float
-  vtkSmartPointer<vtkFloatArray> dataAsFloats = convertToFloat(tiltSeries);
-  float* dataPtr = static_cast<float*>(dataAsFloats->GetVoidPointer(
-    0)); // Get pointer to tilt series (of type float)
+  SinogramProvider provider(tiltSeries);
+  int xDim = provider.numberOfSlices(); // Number of slices
+  int yDim = provider.numberOfRays();   // Number of rays in tilt series
+  int zDim = provider.numberOfTilts();  // Number of tilts
+
+  // Get pointer to tilt series (of type float)
+  const float* dataPtr = provider.data();
 
   for (int z = 0; z < zDim; ++z) {
     for (int y = 0; y < yDim; ++y) {
@@ -20,12 +20,85 @@
 #include "pqReaction.h"
 #include "vtkImageData.h"
 
+#include <cstddef>
+
+#include <vtkSmartPointer.h>
+
+class vtkDataArray;
+
 namespace tomviz {
 
 class DataSource;
 
 namespace TomographyTiltSeries {
 
+/// Strided, read-only view of one sinogram. Element (tilt, ray) lives at
+/// data[tilt * tiltStride + ray * rayStride]. The view does not own the
+/// memory, which stays valid as long as the SinogramProvider it came from.
+struct SinogramView
+{
+  const float* data;
+  std::ptrdiff_t rayStride;
+  std::ptrdiff_t tiltStride;
+
+  float operator()(int tilt, int ray) const
+  {
+    return data[tilt * tiltStride + ray * rayStride];
+  }
+
+  /// Returns true if the rays of each tilt are contiguous and the tilts are
+  /// packed one after another, i.e. data can be passed to the back
+  /// projection directly.
+  bool isContiguous(int numOfRays) const
+  {
+    return rayStride == 1 && tiltStride == numOfRays;
+  }
+};
+
+/// Gives access to the sinogram of any slice of a tilt series, converting the
+/// tilt series to float at most once. Float tilt series are viewed in place
+/// without any copy. Use SliceMajor when every sinogram is going to be
+/// visited, so that each one is stored contiguously.
+class SinogramProvider
+{
+public:
+  enum Layout
+  {
+    /// Keep the layout of the tilt series (slices vary fastest). Float data
+    /// is not copied.
+    Native,
+    /// Store the sinograms one after another, [slice][tilt][ray].
+    SliceMajor
+  };
+
+  SinogramProvider(vtkImageData* tiltSeries, Layout layout = Native);
+  ~SinogramProvider();
+
+  int numberOfSlices() const { return m_dims[0]; }
+  int numberOfRays() const { return m_dims[1]; }
+  int numberOfTilts() const { return m_dims[2]; }
+  Layout layout() const { return m_layout; }
+
+  /// Zero-copy view of the sinogram for the given slice.
+  SinogramView sinogram(int slice) const;
+
+  /// Copy the sinogram for the given slice into a [tilt][ray] buffer.
+  void copySinogram(int slice, float* sinogram) const;
+
+  /// Pointer to the float data in the provider's layout.
+  const float* data() const { return m_data; }
+
+private:
+  SinogramProvider(const SinogramProvider&) = delete;
+  SinogramProvider& operator=(const SinogramProvider&) = delete;
+
+  Layout m_layout;
+  int m_dims[3];
+  const float* m_data = nullptr;
+  // Keeps the viewed scalars alive, or owns the converted copy.
+  vtkSmartPointer<vtkDataArray> m_array;
+};
+
 /// Extract sinogram from tilt series. This takes as input an image and a slice
 /// number.  If the input image has dimensions [x, y, z] the slice number must
 /// be in the interval [0,y-1].  The output is stored in the sinogram pointer,
@@ -38,6 +111,16 @@ void getSinogram(vtkImageData* tiltSeries, int, float* sinogram);
 void getSinogram(vtkImageData* tiltSeries, int, float* sinogram, int Nray,
                  double axisPosition = 0);
 
+/// Same as above, reading from a provider so that extracting many sinograms
+/// does not convert the tilt series each time.
+void getSinogram(const SinogramProvider& provider, int, float* sinogram,
+                 int Nray, double axisPosition = 0);
+
+/// Same as above, reading a view of a sinogram with numOfRays rays and
+/// numOfTilts tilts.
+void getSinogram(const SinogramView& view, int numOfRays, int numOfTilts,
+                 float* sinogram, int Nray, double axisPosition = 0);
+
 // void getSinogram(vtkImageData *tiltSeries, int, float* sinogram,  int Nray,
 // double axisPosition = 0, double axisAngle = 0);
 
@@ -18,66 +18,190 @@
 
 #include "AlignWidget.h"
 #include "DataSource.h"
+#include "ImageAlignment.h"
+#include "Parallel.h"
 
 #include "vtkImageData.h"
-#include "vtkNew.h"
+#include "vtkMath.h"
+#include "vtkPointData.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 namespace {
 
-// We are assuming an image that begins at 0, 0, 0.
-vtkIdType imageIndex(const vtkVector3i& incs, const vtkVector3i& pos)
+typedef tomviz::TranslateAlignOperator::Interpolation Interpolation;
+
+// The taps of the kernel shifting a row or column by an offset. Output
+// sample i is the sum of weights[j] times input sample i - whole - first - j.
+struct Kernel
+{
+  int whole = 0;
+  int first = 0;
+  std::vector<double> weights;
+
+  bool isWholePixel() const { return weights.size() == 1; }
+};
+
+double lanczos3(double x)
+{
+  x = std::abs(x);
+  if (x < 1e-8) {
+    return 1.0;
+  } else if (x >= 3.0) {
+    return 0.0;
+  }
+  double px = vtkMath::Pi() * x;
+  return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+}
+
+Kernel shiftKernel(float offset, Interpolation interpolation)
 {
-  return pos[0] * incs[0] + pos[1] * incs[1] + pos[2] * incs[2];
+  Kernel kernel;
+  kernel.whole = static_cast<int>(std::floor(offset));
+  double fraction = offset - kernel.whole;
+  // Offsets within a thousandth of a pixel are moved by whole rows.
+  if (fraction < 1e-3 || fraction > 1.0 - 1e-3) {
+    kernel.whole += fraction < 0.5 ? 0 : 1;
+    kernel.weights.push_back(1.0);
+    return kernel;
+  }
+
+  if (interpolation == Interpolation::Linear) {
+    kernel.weights.push_back(1.0 - fraction);
+    kernel.weights.push_back(fraction);
+    return kernel;
+  }
+  kernel.first = -2;
+  double sum = 0.0;
+  for (int j = kernel.first; j <= 3; ++j) {
+    kernel.weights.push_back(lanczos3(j - fraction));
+    sum += kernel.weights.back();
+  }
+  for (double& weight : kernel.weights) {
+    weight /= sum;
+  }
+  return kernel;
 }
 
 template <typename T>
-void applyImageOffsets(T* in, T* out, vtkImageData* image,
-                       const QVector<vtkVector2i>& offsets)
-{
-  // We know that the input and output images are the same size, with the
-  // supplied offsets applied to each slice. Copy the pixels, applying offsets.
-  int* extents = image->GetExtent();
-  vtkVector3i extent(extents[1] - extents[0] + 1, extents[3] - extents[2] + 1,
-                     extents[5] - extents[4] + 1);
-  vtkVector3i incs(1, 1 * extent[0], 1 * extent[0] * extent[1]);
-
-  // Zero out our output array, we should do this more intelligently in future.
-  T* ptr = out;
-  for (int i = 0; i < extent[0] * extent[1] * extent[2]; ++i) {
-    *ptr++ = 0;
-  }
-
-  // We need to go slice by slice, applying the pixel offsets to the new image.
-  for (int i = 0; i < extent[2]; ++i) {
-    vtkVector2i offset = offsets[i];
-    int idx = imageIndex(incs, vtkVector3i(0, 0, i));
-    T* inPtr = in + idx;
-    T* outPtr = out + idx;
-    for (int y = 0; y < extent[1]; ++y) {
-      if (y + offset[1] >= extent[1]) {
-        break;
-      } else if (y + offset[1] < 0) {
-        inPtr += incs[1];
-        outPtr += incs[1];
+T toScalar(double value)
+{
+  if (std::numeric_limits<T>::is_integer) {
+    value = std::round(value);
+    value = std::min(value, static_cast<double>(std::numeric_limits<T>::max()));
+    value =
+      std::max(value, static_cast<double>(std::numeric_limits<T>::lowest()));
+  }
+  return static_cast<T>(value);
+}
+
+// Moves a slice by whole pixels in place, one row at a time. Rows are visited
+// so that each is read before it is overwritten.
+template <typename T>
+void moveSlice(T* slice, int nx, int ny, int components, int dx, int dy)
+{
+  const size_t row = static_cast<size_t>(nx) * components;
+  const int begin = std::max(0, dx);
+  const int end = std::min(nx, nx + dx);
+  for (int i = 0; i < ny; ++i) {
+    const int y = dy > 0 ? ny - 1 - i : i;
+    const int source = y - dy;
+    T* out = slice + y * row;
+    if (source < 0 || source >= ny || begin >= end) {
+      std::memset(out, 0, row * sizeof(T));
+      continue;
+    }
+    std::memmove(out + begin * components,
+                 slice + source * row + (begin - dx) * components,
+                 (end - begin) * components * sizeof(T));
+    std::memset(out, 0, begin * components * sizeof(T));
+    std::memset(out + end * components, 0,
+                (nx - end) * components * sizeof(T));
+  }
+}
+
+// Resamples a slice in place by a fractional offset, first along the rows
+// into the scratch slice, then along the columns back into the slice.
+template <typename T, typename Sample>
+void resampleSlice(T* slice, Sample* scratch, int nx, int ny, int components,
+                   const Kernel& kx, const Kernel& ky)
+{
+  const int row = nx * components;
+  for (int y = 0; y < ny; ++y) {
+    const T* in = slice + static_cast<size_t>(y) * row;
+    Sample* out = scratch + static_cast<size_t>(y) * row;
+    for (int x = 0; x < nx; ++x) {
+      for (int c = 0; c < components; ++c) {
+        double sum = 0.0;
+        for (size_t j = 0; j < kx.weights.size(); ++j) {
+          int source = x - kx.whole - kx.first - static_cast<int>(j);
+          if (source >= 0 && source < nx) {
+            sum += kx.weights[j] * in[source * components + c];
+          }
+        }
+        out[x * components + c] = static_cast<Sample>(sum);
+      }
+    }
+  }
+
+  std::vector<double> sums(row);
+  for (int y = 0; y < ny; ++y) {
+    std::fill(sums.begin(), sums.end(), 0.0);
+    for (size_t j = 0; j < ky.weights.size(); ++j) {
+      int source = y - ky.whole - ky.first - static_cast<int>(j);
+      if (source < 0 || source >= ny) {
         continue;
       }
-      for (int x = 0; x < extent[0]; ++x) {
-        if (x + offset[0] >= extent[0]) {
-          inPtr += offset[0];
-          outPtr += offset[0];
-          break;
-        } else if (x + offset[0] < 0) {
-          ++inPtr;
-          ++outPtr;
-          continue;
-        }
-        *(outPtr + offset[0] + incs[1] * offset[1]) = *inPtr;
-        ++inPtr;
-        ++outPtr;
+      const Sample* in = scratch + static_cast<size_t>(source) * row;
+      const double weight = ky.weights[j];
+      for (int i = 0; i < row; ++i) {
+        sums[i] += weight * in[i];
       }
     }
+    T* out = slice + static_cast<size_t>(y) * row;
+    for (int i = 0; i < row; ++i) {
+      out[i] = toScalar<T>(sums[i]);
+    }
   }
 }
+
+// Applies the offsets to the slices of the image in place. Slices are shifted
+// in parallel, those that need resampling with a scratch slice.
+template <typename T>
+void applyImageOffsets(T* data, const int dims[3], int components,
+                       const QVector<vtkVector2f>& offsets,
+                       Interpolation interpolation)
+{
+  typedef typename std::conditional<(sizeof(T) > sizeof(float)), double,
+                                    float>::type Sample;
+  const size_t sliceSize = static_cast<size_t>(dims[0]) * dims[1] * components;
+  const int slices = std::min(dims[2], offsets.size());
+
+  tomviz::Parallel::forRange(0, slices, 1, [&](int begin, int end) {
+    std::vector<Sample> scratch;
+    for (int i = begin; i < end; ++i) {
+      Kernel kx = shiftKernel(offsets[i][0], interpolation);
+      Kernel ky = shiftKernel(offsets[i][1], interpolation);
+      T* slice = data + i * sliceSize;
+      if (kx.isWholePixel() && ky.isWholePixel()) {
+        if (kx.whole != 0 || ky.whole != 0) {
+          moveSlice(slice, dims[0], dims[1], components, kx.whole, ky.whole);
+        }
+        continue;
+      }
+      scratch.resize(sliceSize);
+      resampleSlice(slice, scratch.data(), dims[0], dims[1], components, kx,
+                    ky);
+    }
+  });
+}
 }
 
 namespace tomviz {
@@ -86,6 +210,11 @@ TranslateAlignOperator::TranslateAlignOperator(DataSource* ds, QObject* p)
 {
 }
 
+QString TranslateAlignOperator::label() const
+{
+  return m_automatic ? "Auto Tilt Image Align (XCORR)" : "Translation Align";
+}
+
 QIcon TranslateAlignOperator::icon() const
 {
   return QIcon("");
@@ -93,48 +222,96 @@ QIcon TranslateAlignOperator::icon() const
 
 bool TranslateAlignOperator::applyTransform(vtkDataObject* data)
 {
-  vtkNew<vtkImageData> outImage;
-  vtkImageData* inImage = vtkImageData::SafeDownCast(data);
-  assert(inImage);
-  outImage->DeepCopy(data);
-  switch (inImage->GetScalarType()) {
-    vtkTemplateMacro(
-      applyImageOffsets(reinterpret_cast<VTK_TT*>(inImage->GetScalarPointer()),
-                        reinterpret_cast<VTK_TT*>(outImage->GetScalarPointer()),
-                        inImage, offsets));
-  }
-  data->ShallowCopy(outImage.Get());
+  vtkImageData* image = vtkImageData::SafeDownCast(data);
+  assert(image);
+  vtkDataArray* scalars = image->GetPointData()->GetScalars();
+  if (!scalars) {
+    return false;
+  }
+
+  int dims[3];
+  image->GetDimensions(dims);
+  QVector<vtkVector2f> appliedOffsets = getAlignOffsets();
+  if (m_automatic) {
+    setTotalProgressSteps(dims[2] - 1);
+    std::vector<vtkVector2d> shifts = ImageAlignment::alignTiltSeries(
+      image, -1, [this](int done) {
+        setProgressStep(done);
+        return !isCanceled();
+      });
+    if (shifts.empty()) {
+      return false;
+    }
+    appliedOffsets.resize(static_cast<int>(shifts.size()));
+    for (int i = 0; i < appliedOffsets.size(); ++i) {
+      appliedOffsets[i] = vtkVector2f(static_cast<float>(shifts[i][0]),
+                                      static_cast<float>(shifts[i][1]));
+    }
+    // Keep them, so they show when the operator is edited.
+    QMutexLocker locker(&m_mutex);
+    this->offsets = appliedOffsets;
+  }
+
+  // The pipeline hands over arrays of our own, see writesArraysInPlace(), so
+  // the slices are shifted where they are.
+  switch (scalars->GetDataType()) {
+    vtkTemplateMacro(applyImageOffsets(
+      static_cast<VTK_TT*>(scalars->GetVoidPointer(0)), dims,
+      scalars->GetNumberOfComponents(), appliedOffsets, m_interpolation));
+  }
+  scalars->Modified();
   return true;
 }
 
 Operator* TranslateAlignOperator::clone() const
 {
   TranslateAlignOperator* op = new TranslateAlignOperator(this->dataSource);
-  op->setAlignOffsets(this->offsets);
+  op->setAlignOffsets(getAlignOffsets());
+  op->setAutomatic(m_automatic);
+  op->setInterpolation(m_interpolation);
   return op;
 }
 
 bool TranslateAlignOperator::serialize(pugi::xml_node& ns) const
 {
-  ns.append_attribute("number_of_offsets").set_value(this->offsets.size());
-  for (int i = 0; i < this->offsets.size(); ++i) {
+  if (m_interpolation == Interpolation::Sinc) {
+    ns.append_attribute("interpolation").set_value("sinc");
+  }
+  // Computed offsets are not saved, they depend on the input alone.
+  if (m_automatic) {
+    ns.append_attribute("automatic").set_value(true);
+    return true;
+  }
+  QVector<vtkVector2f> offsets = getAlignOffsets();
+  ns.append_attribute("number_of_offsets").set_value(offsets.size());
+  for (int i = 0; i < offsets.size(); ++i) {
     pugi::xml_node node = ns.append_child("offset");
     node.append_attribute("slice_number").set_value(i);
-    node.append_attribute("x_offset").set_value(this->offsets[i][0]);
-    node.append_attribute("y_offset").set_value(this->offsets[i][1]);
+    node.append_attribute("x_offset").set_value(offsets[i][0]);
+    node.append_attribute("y_offset").set_value(offsets[i][1]);
   }
   return true;
 }
 
 bool TranslateAlignOperator::deserialize(const pugi::xml_node& ns)
 {
+  m_interpolation = strcmp(ns.attribute("interpolation").value(), "sinc") == 0
+                      ? Interpolation::Sinc
+                      : Interpolation::Linear;
+  if (ns.attribute("automatic").as_bool()) {
+    setAutomatic(true);
+    return true;
+  }
+  m_automatic = false;
+  setSupportsCancel(false);
+  QMutexLocker locker(&m_mutex);
   int numOffsets = ns.attribute("number_of_offsets").as_int();
   this->offsets.resize(numOffsets);
   for (pugi::xml_node node = ns.child("offset"); node;
        node = node.next_sibling("offset")) {
     int sliceNum = node.attribute("slice_number").as_int();
-    int xOffset = node.attribute("x_offset").as_int();
-    int yOffset = node.attribute("y_offset").as_int();
+    float xOffset = node.attribute("x_offset").as_float();
+    float yOffset = node.attribute("y_offset").as_float();
     this->offsets[sliceNum][0] = xOffset;
     this->offsets[sliceNum][1] = yOffset;
   }
@@ -148,10 +325,42 @@ EditOperatorWidget* TranslateAlignOperator::getEditorContentsWithData(
 }
 
 void TranslateAlignOperator::setAlignOffsets(
-  const QVector<vtkVector2i>& newOffsets)
+  const QVector<vtkVector2f>& newOffsets)
 {
-  this->offsets.resize(newOffsets.size());
-  std::copy(newOffsets.begin(), newOffsets.end(), this->offsets.begin());
+  {
+    QMutexLocker locker(&m_mutex);
+    this->offsets.resize(newOffsets.size());
+    std::copy(newOffsets.begin(), newOffsets.end(), this->offsets.begin());
+  }
+  m_automatic = false;
+  setSupportsCancel(false);
+  emit this->labelModified();
+  emit this->transformModified();
+}
+
+QVector<vtkVector2f> TranslateAlignOperator::getAlignOffsets() const
+{
+  QMutexLocker locker(&m_mutex);
+  return this->offsets;
+}
+
+void TranslateAlignOperator::setAutomatic(bool automatic)
+{
+  if (m_automatic == automatic) {
+    return;
+  }
+  m_automatic = automatic;
+  setSupportsCancel(automatic);
+  emit this->labelModified();
+  emit this->transformModified();
+}
+
+void TranslateAlignOperator::setInterpolation(Interpolation interpolation)
+{
+  if (m_interpolation == interpolation) {
+    return;
+  }
+  m_interpolation = interpolation;
   emit this->transformModified();
 }
 }
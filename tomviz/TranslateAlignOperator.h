@@ -20,6 +20,7 @@
 
 #include "vtkVector.h"
 
+#include <QMutex>
 #include <QPointer>
 #include <QVector>
 
@@ -34,7 +35,7 @@ class TranslateAlignOperator : public Operator
 public:
   TranslateAlignOperator(DataSource* dataSource, QObject* parent = nullptr);
 
-  QString label() const override { return "Translation Align"; }
+  QString label() const override;
   QIcon icon() const override;
   Operator* clone() const override;
 
@@ -44,8 +45,26 @@ public:
   EditOperatorWidget* getEditorContentsWithData(
     QWidget* parent, vtkSmartPointer<vtkImageData> data) override;
 
-  void setAlignOffsets(const QVector<vtkVector2i>& offsets);
-  const QVector<vtkVector2i>& getAlignOffsets() const { return offsets; }
+  /// Setting offsets turns off automatic alignment. Offsets are in pixels
+  /// and may be fractional.
+  void setAlignOffsets(const QVector<vtkVector2f>& offsets);
+  QVector<vtkVector2f> getAlignOffsets() const;
+
+  /// How images are resampled for offsets that are not whole pixels, whole
+  /// pixel offsets are applied by moving rows. Sinc is a Lanczos window of
+  /// three pixels, which keeps more detail but may ring at sharp edges.
+  enum class Interpolation
+  {
+    Linear,
+    Sinc
+  };
+  void setInterpolation(Interpolation interpolation);
+  Interpolation interpolation() const { return m_interpolation; }
+
+  /// In automatic mode the offsets are computed by cross-correlation of
+  /// neighboring slices each time the operator runs, see ImageAlignment.
+  void setAutomatic(bool automatic);
+  bool automatic() const { return m_automatic; }
 
   DataSource* getDataSource() const { return this->dataSource; }
 
@@ -55,8 +74,13 @@ protected:
   bool applyTransform(vtkDataObject* data) override;
 
 private:
-  QVector<vtkVector2i> offsets;
+  // Guards offsets, which are written from the pipeline thread in automatic
+  // mode.
+  mutable QMutex m_mutex;
+  QVector<vtkVector2f> offsets;
   const QPointer<DataSource> dataSource;
+  bool m_automatic = false;
+  Interpolation m_interpolation = Interpolation::Linear;
 };
 }
 
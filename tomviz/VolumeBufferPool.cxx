@@ -0,0 +1,307 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#include "VolumeBufferPool.h"
+
+#include "Parallel.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkNew.h>
+#include <vtksys/SystemInformation.hxx>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#if defined(Q_OS_WIN)
+#include <malloc.h>
+#elif defined(Q_OS_LINUX)
+#include <sys/mman.h>
+#endif
+
+namespace tomviz {
+
+namespace VolumeBufferPool {
+
+namespace {
+
+const qint64 alignment = 2 << 20;
+
+// Copies are split into chunks of this many bytes across threads.
+const qint64 copyChunk = 16 << 20;
+
+struct Buffer
+{
+  void* data;
+  qint64 size;
+};
+
+// Rounds bytes up to its size class, a multiple of an eighth of the largest
+// power of two not above it, so at most an eighth of the buffer goes unused.
+// Classes from 16 MiB up are whole numbers of huge pages. Smaller ones are
+// not rounded to huge pages, which would waste up to half of a 1 MiB buffer.
+qint64 sizeClass(qint64 bytes)
+{
+  qint64 step = 1;
+  while (step <= bytes / 2) {
+    step *= 2;
+  }
+  step = std::max<qint64>(step / 8, 1);
+  return (bytes + step - 1) / step * step;
+}
+
+void* allocate(qint64 size)
+{
+#if defined(Q_OS_WIN)
+  return _aligned_malloc(static_cast<size_t>(size), alignment);
+#else
+  void* data = nullptr;
+  if (posix_memalign(&data, alignment, static_cast<size_t>(size)) != 0) {
+    return nullptr;
+  }
+#if defined(Q_OS_LINUX) && defined(MADV_HUGEPAGE)
+  madvise(data, static_cast<size_t>(size), MADV_HUGEPAGE);
+#endif
+  return data;
+#endif
+}
+
+void deallocate(void* data)
+{
+#if defined(Q_OS_WIN)
+  _aligned_free(data);
+#else
+  free(data);
+#endif
+}
+
+class Pool
+{
+public:
+  Pool()
+  {
+    vtksys::SystemInformation info;
+    info.RunMemoryCheck();
+    m_capacity =
+      static_cast<qint64>(info.GetTotalPhysicalMemory()) / 4 * 1024 * 1024;
+  }
+
+  void* acquire(qint64 size)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      ++m_statistics.requests;
+      auto buffer =
+        std::find_if(m_free.begin(), m_free.end(),
+                     [=](const Buffer& b) { return b.size == size; });
+      if (buffer != m_free.end()) {
+        void* data = buffer->data;
+        m_free.erase(buffer);
+        ++m_statistics.hits;
+        m_statistics.bytesCached -= size;
+        addInUse(size);
+        return data;
+      }
+    }
+
+    // None of the class is free, make room for it from the other classes
+    // if the allocation fails.
+    void* data = allocate(size);
+    if (!data) {
+      trim();
+      data = allocate(size);
+    }
+    if (data) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      addInUse(size);
+    }
+    return data;
+  }
+
+  void release(void* data, qint64 size)
+  {
+    std::vector<void*> evicted;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_statistics.bytesInUse -= size;
+      m_free.push_front({ data, size });
+      m_statistics.bytesCached += size;
+      evict(m_capacity, evicted);
+    }
+    for (void* buffer : evicted) {
+      deallocate(buffer);
+    }
+  }
+
+  void setCapacity(qint64 bytes)
+  {
+    std::vector<void*> evicted;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_capacity = bytes;
+      evict(m_capacity, evicted);
+    }
+    for (void* buffer : evicted) {
+      deallocate(buffer);
+    }
+  }
+
+  qint64 capacity()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_capacity;
+  }
+
+  void trim()
+  {
+    std::vector<void*> evicted;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      evict(0, evicted);
+    }
+    for (void* buffer : evicted) {
+      deallocate(buffer);
+    }
+  }
+
+  Statistics statistics()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+  }
+
+private:
+  void addInUse(qint64 size)
+  {
+    m_statistics.bytesInUse += size;
+    m_statistics.peakBytesInUse =
+      std::max(m_statistics.peakBytesInUse, m_statistics.bytesInUse);
+  }
+
+  // Takes the least recently returned buffers out of the pool until at
+  // most bytes are cached, they are freed once the lock is released.
+  void evict(qint64 bytes, std::vector<void*>& evicted)
+  {
+    while (m_statistics.bytesCached > bytes && !m_free.empty()) {
+      evicted.push_back(m_free.back().data);
+      m_statistics.bytesCached -= m_free.back().size;
+      m_free.pop_back();
+    }
+  }
+
+  std::mutex m_mutex;
+  // Most recently returned first.
+  std::list<Buffer> m_free;
+  qint64 m_capacity;
+  Statistics m_statistics;
+};
+
+// Never destroyed, arrays may return their buffers during static
+// destruction.
+Pool& pool()
+{
+  static Pool* instance = new Pool;
+  return *instance;
+}
+
+void release(vtkObject*, unsigned long, void* clientData, void*)
+{
+  auto buffer = static_cast<Buffer*>(clientData);
+  pool().release(buffer->data, buffer->size);
+  delete buffer;
+}
+}
+
+vtkDataArray* newArray(int scalarType, int components, vtkIdType tuples)
+{
+  vtkDataArray* array = vtkDataArray::CreateDataArray(scalarType);
+  if (!array) {
+    return nullptr;
+  }
+  array->SetNumberOfComponents(components);
+  vtkIdType values = tuples * components;
+  qint64 bytes = static_cast<qint64>(values) * array->GetDataTypeSize();
+  void* data = nullptr;
+  qint64 size = sizeClass(bytes);
+  if (bytes >= minimumSize) {
+    data = pool().acquire(size);
+  }
+  if (!data) {
+    array->SetNumberOfTuples(tuples);
+    return array;
+  }
+
+  // Save is set so VTK never frees the buffer, it goes back to the pool
+  // when the array is deleted.
+  array->SetVoidArray(data, values, 1);
+  vtkNew<vtkCallbackCommand> giveBack;
+  giveBack->SetCallback(release);
+  giveBack->SetClientData(new Buffer{ data, size });
+  array->AddObserver(vtkCommand::DeleteEvent, giveBack.Get());
+  return array;
+}
+
+vtkDataArray* newCopy(vtkDataArray* array)
+{
+  if (!array->HasStandardMemoryLayout()) {
+    vtkDataArray* copy = array->NewInstance();
+    copy->DeepCopy(array);
+    return copy;
+  }
+
+  vtkDataArray* copy =
+    newArray(array->GetDataType(), array->GetNumberOfComponents(),
+             array->GetNumberOfTuples());
+  copy->SetName(array->GetName());
+  copy->CopyComponentNames(array);
+  qint64 bytes = static_cast<qint64>(array->GetNumberOfValues()) *
+                 array->GetDataTypeSize();
+  auto from = static_cast<const char*>(array->GetVoidPointer(0));
+  auto to = static_cast<char*>(copy->GetVoidPointer(0));
+  int chunks = static_cast<int>((bytes + copyChunk - 1) / copyChunk);
+  Parallel::forRange(0, chunks, 1, [&](int begin, int end) {
+    qint64 first = begin * copyChunk;
+    qint64 last = std::min(end * copyChunk, bytes);
+    memcpy(to + first, from + first, static_cast<size_t>(last - first));
+  });
+  return copy;
+}
+
+Statistics statistics()
+{
+  return pool().statistics();
+}
+
+void setCapacity(qint64 bytes)
+{
+  pool().setCapacity(bytes);
+}
+
+qint64 capacity()
+{
+  return pool().capacity();
+}
+
+void trim()
+{
+  pool().trim();
+}
+}
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+
+  This source file is part of the tomviz project.
+
+  Copyright Kitware, Inc.
+
+  This source code is released under the New BSD License, (the "License").
+
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+
+******************************************************************************/
+#ifndef tomvizVolumeBufferPool_h
+#define tomvizVolumeBufferPool_h
+
+#include <QtGlobal>
+
+#include <vtkType.h>
+
+class vtkDataArray;
+
+namespace tomviz {
+
+/// A pool of the large buffers that hold the scalars of volumes. Operators
+/// that produce new arrays, and the copies made when the pipeline detaches
+/// shared arrays, draw their storage from here. When an array is deleted
+/// its buffer goes back to the pool instead of the heap, so running a
+/// pipeline again reuses the memory, and its pages, of the last run.
+///
+/// Buffers are grouped in size classes, each an eighth of a power of two
+/// apart, so a buffer serves any request of its class and at most an eighth
+/// of it goes unused. They are aligned to 2 MiB, the size of a huge page, and
+/// on Linux are advised to be backed by huge pages. Only buffers of 16 MiB or
+/// more fill whole huge pages.
+namespace VolumeBufferPool {
+
+/// Arrays smaller than this are allocated by VTK as usual.
+const qint64 minimumSize = 1 << 20;
+
+/// Returns a new array of scalarType with storage for tuples of the given
+/// number of components, the caller takes ownership. The values are left
+/// uninitialized.
+vtkDataArray* newArray(int scalarType, int components, vtkIdType tuples);
+
+/// Returns a new array with the same type, name and values as array, the
+/// caller takes ownership.
+vtkDataArray* newCopy(vtkDataArray* array);
+
+struct Statistics
+{
+  /// Buffers requested, and how many of them were reused from the pool.
+  qint64 requests = 0;
+  qint64 hits = 0;
+  /// Bytes held by arrays now and at most so far, and bytes of the buffers
+  /// kept for reuse.
+  qint64 bytesInUse = 0;
+  qint64 peakBytesInUse = 0;
+  qint64 bytesCached = 0;
+
+  double hitRate() const
+  {
+    return requests > 0 ? static_cast<double>(hits) / requests : 0.0;
+  }
+};
+
+Statistics statistics();
+
+/// Sets the most bytes of buffers kept for reuse, the least recently
+/// returned are freed first. Defaults to a quarter of the physical memory.
+void setCapacity(qint64 bytes);
+qint64 capacity();
+
+/// Frees all buffers kept for reuse.
+void trim();
+}
+}
+
+#endif
@@ -23,13 +23,18 @@
 #include "vtkPointData.h"
 #include "vtkSmartPointer.h"
 #include "vtkStringArray.h"
+#include "vtkTimerLog.h"
 
 #include "vtksys/SystemTools.hxx"
 #include "vtk_pugixml.h"
 
 #include <sys/stat.h>
-#include <string>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 extern "C" {
 #include "vtk_tiff.h"
@@ -39,109 +44,99 @@ namespace tomviz
 {
 
 namespace {
-struct FlipTrue {};
-struct FlipFalse {};
-
-int GetFileRow(int row, int height, FlipTrue)
-{
-  return height - row - 1;
-}
-
-int GetFileRow(int row, int, FlipFalse)
-{
-  return row;
-}
-
-// This is inverse of GetFileRow(), which is same as calling GetFileRow()
-// again.
-template <class Flip>
-int GetImageRow(int file_row, int height, Flip flip)
-{
-  return GetFileRow(file_row, height, flip);
-}
-
-bool SupportsRandomAccess(TIFF* image)
-{
-  unsigned int rowsPerStrip;
-  unsigned short compression;
-  TIFFGetFieldDefaulted(image, TIFFTAG_COMPRESSION, &compression);
-  TIFFGetFieldDefaulted(image, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
-  return (compression == COMPRESSION_NONE || rowsPerStrip == 1);
-}
 
-bool PurgeInitialScanLinesIfNeeded(int fileStartRow, TIFF* image)
+// Decodes the strips, or tiles, of the current directory of image that hold
+// the columns extent[0] to extent[1] of the rows extent[2] to extent[3], and
+// copies that region into out, rows rowBytes apart. Strips and tiles are
+// decoded whole, so only those holding rows of the extent are read, in any
+// order, whatever the compression.
+bool DecodeRegion(TIFF* image, unsigned char* out, const int extent[6],
+                  vtkIdType rowBytes, size_t pixelBytes, bool flip,
+                  std::vector<unsigned char>& block, vtkTypeInt64& decoded)
 {
-  if (fileStartRow == 0 || SupportsRandomAccess(image))
+  uint32 width = 0;
+  uint32 height = 0;
+  if (!TIFFGetField(image, TIFFTAG_IMAGEWIDTH, &width) ||
+      !TIFFGetField(image, TIFFTAG_IMAGELENGTH, &height) ||
+      extent[1] >= static_cast<int>(width) ||
+      extent[3] >= static_cast<int>(height))
   {
-    return true;
+    return false;
   }
 
-  // File doesn't support random access and we want to start at a non-0 row. We
-  // read (and discard) initial scanlines.
-  unsigned int isize = TIFFScanlineSize(image);
-  tdata_t buf = _TIFFmalloc(isize);
-  for (int i = 0; i < fileStartRow; ++i)
+  // The file rows holding the rows of the extent, flipped from a lower left
+  // origin if necessary.
+  const uint32 firstRow = flip ? height - extent[3] - 1 : extent[2];
+  const uint32 lastRow = flip ? height - extent[2] - 1 : extent[3];
+  const uint32 firstColumn = extent[0];
+  const uint32 lastColumn = extent[1];
+
+  // Copies the part of the extent in the decoded block, whose top left pixel
+  // is at column x and file row y and whose rows are stride bytes apart.
+  auto copy = [&](uint32 x, uint32 y, uint32 blockWidth, uint32 blockRows,
+                  size_t stride)
   {
-    if (TIFFReadScanline(image, buf, i, 0) <= 0)
+    const uint32 x0 = std::max(x, firstColumn);
+    const uint32 x1 = std::min(x + blockWidth - 1, lastColumn);
+    const uint32 y0 = std::max(y, firstRow);
+    const uint32 y1 = std::min(y + blockRows - 1, lastRow);
+    for (uint32 fileRow = y0; fileRow <= y1; ++fileRow)
     {
-      _TIFFfree(buf);
-      return false;
+      const uint32 row = flip ? height - fileRow - 1 : fileRow;
+      memcpy(out + (row - extent[2]) * rowBytes +
+               (x0 - firstColumn) * pixelBytes,
+             &block[(fileRow - y) * stride + (x0 - x) * pixelBytes],
+             (x1 - x0 + 1) * pixelBytes);
     }
-  }
-  _TIFFfree(buf);
-  return true;
-}
-
-// Simple scan line copy of a slice in a volume with tightly packed memory.
-template<typename T, typename Flip>
-bool ReadTemplatedImage(T* out, Flip flip,
-                        int startCol, int endCol,
-                        int startRow, int endRow,
-                        int yIncrements,
-                        unsigned int height,
-                        TIFF *image)
-{
-  int fileStartRow = GetFileRow(startRow, height, flip);
-  int fileEndRow = GetFileRow(endRow, height, flip);
-  int minFileRow = std::min(fileStartRow, fileEndRow);
-  int maxFileRow = std::max(fileStartRow, fileEndRow);
-
-  if (!PurgeInitialScanLinesIfNeeded(minFileRow, image))
-  {
-    return false;
-  }
+  };
 
-  unsigned int isize = TIFFScanlineSize(image);
-  size_t scanLineSize = endCol - startCol + 1;
-  if (scanLineSize * sizeof(T) == isize)
+  if (TIFFIsTiled(image))
   {
-    // We can copy straight into the image data output.
-    for (int fi = minFileRow; fi <= maxFileRow; ++fi)
+    uint32 tileWidth = 0;
+    uint32 tileHeight = 0;
+    if (!TIFFGetField(image, TIFFTAG_TILEWIDTH, &tileWidth) ||
+        !TIFFGetField(image, TIFFTAG_TILELENGTH, &tileHeight) ||
+        tileWidth == 0 || tileHeight == 0)
     {
-      int i = GetImageRow(fi, height, flip);
-      T* tmp = out + (i - startRow) * yIncrements;
-      if (TIFFReadScanline(image, tmp, fi, 0) <= 0)
+      return false;
+    }
+    block.resize(TIFFTileSize(image));
+    for (uint32 y = firstRow - firstRow % tileHeight; y <= lastRow;
+         y += tileHeight)
+    {
+      for (uint32 x = firstColumn - firstColumn % tileWidth; x <= lastColumn;
+           x += tileWidth)
       {
-        return false;
+        tsize_t bytes = TIFFReadEncodedTile(image,
+                                            TIFFComputeTile(image, x, y, 0, 0),
+                                            &block[0], block.size());
+        if (bytes < 0)
+        {
+          return false;
+        }
+        decoded += bytes;
+        copy(x, y, tileWidth, tileHeight, tileWidth * pixelBytes);
       }
     }
+    return true;
   }
-  else
+
+  uint32 rowsPerStrip = height;
+  TIFFGetFieldDefaulted(image, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip);
+  rowsPerStrip = std::max<uint32>(std::min(rowsPerStrip, height), 1);
+  const size_t stride = TIFFScanlineSize(image);
+  block.resize(TIFFStripSize(image));
+  for (uint32 y = firstRow - firstRow % rowsPerStrip; y <= lastRow;
+       y += rowsPerStrip)
   {
-    // Copy into a buffer of the appropriate size, then subset into the output.
-    tdata_t buf = _TIFFmalloc(isize);
-    for (int fi = minFileRow; fi <= maxFileRow; ++fi)
+    tsize_t bytes = TIFFReadEncodedStrip(image, TIFFComputeStrip(image, y, 0),
+                                         &block[0], block.size());
+    if (bytes < 0)
     {
-      int i = GetImageRow(fi, height, flip);
-      T* tmp = out + (i - startRow) * yIncrements;
-      if (TIFFReadScanline(image, buf, fi, 0) <= 0)
-      {
-        _TIFFfree(buf);
-        return false;
-      }
-      memcpy(tmp, static_cast<T*>(buf) + startCol, sizeof(T) * scanLineSize);
+      return false;
     }
-    _TIFFfree(buf);
+    decoded += bytes;
+    copy(0, y, width, rowsPerStrip, stride);
   }
   return true;
 }
@@ -193,6 +188,8 @@ public:
   double OmePhysicalPixelSize[3];
   std::string OmePhysicalPixelUnits[3];
   bool OmeBigEndian;
+  // The offsets of the directories of the pages that are slices, in order.
+  std::vector<toff_t> SliceOffsets;
   static void ErrorHandler(const char* module, const char* fmt, va_list ap);
 };
 
@@ -261,6 +258,7 @@ void vtkOMETiffReader::vtkOMETiffReaderInternal::Clean()
   this->SampleFormat = 1;
   this->ResolutionUnit = 1; // none
   this->IsOpen = false;
+  this->SliceOffsets.clear();
   if (this->OmeXmlRaw) {
     delete [] this->OmeXmlRaw;
     this->OmeXmlRaw = NULL;
@@ -331,13 +329,18 @@ bool vtkOMETiffReader::vtkOMETiffReaderInternal::Initialize()
       }
     }
 
-    // Checking if the TIFF contains subfiles
+    // Checking if the TIFF contains subfiles, and where the directory of
+    // each page is so that the slices can be read in any order.
     if (this->NumberOfPages > 1)
     {
       this->SubFiles = 0;
 
+      std::vector<toff_t> offsets;
+      std::vector<bool> reduced;
       for (unsigned int page = 0; page<this->NumberOfPages; ++page)
       {
+        offsets.push_back(TIFFCurrentDirOffset(this->Image));
+        reduced.push_back(false);
         long subfiletype = 6;
         if (TIFFGetField(this->Image, TIFFTAG_SUBFILETYPE, &subfiletype))
         {
@@ -345,13 +348,30 @@ bool vtkOMETiffReader::vtkOMETiffReaderInternal::Initialize()
           {
             this->SubFiles += 1;
           }
+          else
+          {
+            reduced.back() = true;
+          }
         }
         TIFFReadDirectory(this->Image);
       }
 
+      // Reduced resolution pages are skipped when there are subfiles.
+      for (size_t page = 0; page < offsets.size(); ++page)
+      {
+        if (this->SubFiles == 0 || !reduced[page])
+        {
+          this->SliceOffsets.push_back(offsets[page]);
+        }
+      }
+
       // Set the directory to the first image
       TIFFSetDirectory(this->Image, 0);
     }
+    else
+    {
+      this->SliceOffsets.push_back(TIFFCurrentDirOffset(this->Image));
+    }
 
     this->OmeXmlRaw = new char*[255];
     if (!TIFFGetField(this->Image, TIFFTAG_IMAGEDESCRIPTION, this->OmeXmlRaw))
@@ -497,6 +517,11 @@ vtkOMETiffReader::vtkOMETiffReader()
   this->OriginSpecifiedFlag = false;
   this->SpacingSpecifiedFlag = false;
 
+  this->NumberOfThreads = 0;
+  this->ReadBytes = 0;
+  this->DecodedBytes = 0;
+  this->ReadTime = 0;
+
   //Make the default orientation type to be ORIENTATION_BOTLEFT
   this->OrientationType = 4;
 }
@@ -626,6 +651,19 @@ void vtkOMETiffReader::Process2(OT *outPtr, int *)
 template <class OT>
 void vtkOMETiffReader::Process(OT *outPtr, int outExtent[6], vtkIdType outIncr[3])
 {
+  // pages that can be decoded straight into the output, strips or tiles
+  if ((this->InternalImage->NumberOfPages > 1 ||
+       this->InternalImage->NumberOfTiles > 0) &&
+      this->CanDecodeDirectly() &&
+      this->InternalImage->SliceOffsets.size() >
+        static_cast<size_t>(outExtent[5]))
+  {
+    this->ReadPages(outPtr);
+    // close the TIFF file
+    this->InternalImage->Clean();
+    return;
+  }
+
   // multiple number of pages
   if (this->InternalImage->NumberOfPages > 1)
   {
@@ -687,6 +725,8 @@ void vtkOMETiffReader::ExecuteDataWithInformation(vtkDataObject *output,
   // Call the correct templated function for the input
   void *outPtr = data->GetScalarPointer();
 
+  this->DecodedBytes = 0;
+  double start = vtkTimerLog::GetUniversalTime();
   switch (data->GetScalarType())
   {
     vtkTemplateMacro(this->Process((VTK_TT *)(outPtr),
@@ -694,7 +734,17 @@ void vtkOMETiffReader::ExecuteDataWithInformation(vtkDataObject *output,
     default:
       vtkErrorMacro("UpdateFromFile: Unknown data type");
   }
-  data->GetPointData()->GetScalars()->SetName("Tiff Scalars");
+  vtkDataArray* scalars = data->GetPointData()->GetScalars();
+  this->ReadTime = vtkTimerLog::GetUniversalTime() - start;
+  this->ReadBytes = static_cast<vtkTypeInt64>(scalars->GetDataSize()) *
+                    scalars->GetDataTypeSize();
+  vtkDebugMacro(<< "Read " << this->ReadBytes / 1048576.0 << " MiB in "
+                << this->ReadTime << " s, "
+                << this->ReadBytes / 1048576.0 / std::max(this->ReadTime, 1e-6)
+                << " MiB/s, decoding "
+                << this->DecodedBytes / 1048576.0 << " MiB");
+
+  scalars->SetName("Tiff Scalars");
   vtkSmartPointer<vtkFieldData> fd = data->GetFieldData();
   if (!fd) {
     fd = vtkSmartPointer<vtkFieldData>::New();
@@ -832,6 +882,113 @@ void vtkOMETiffReader::Initialize()
   this->ImageFormat = vtkOMETiffReader::NOFORMAT;
 }
 
+//-------------------------------------------------------------------------
+bool vtkOMETiffReader::CanDecodeDirectly()
+{
+  // The samples of these are stored as they are in the output.
+  unsigned int format = this->GetFormat();
+  return this->InternalImage->CanRead() &&
+         this->InternalImage->PlanarConfig == PLANARCONFIG_CONTIG &&
+         this->OutputIncrements[0] == this->InternalImage->SamplesPerPixel &&
+         ((format == vtkOMETiffReader::GRAYSCALE &&
+           this->InternalImage->Photometrics == PHOTOMETRIC_MINISBLACK &&
+           this->InternalImage->SamplesPerPixel == 1) ||
+          (format == vtkOMETiffReader::RGB &&
+           this->InternalImage->SamplesPerPixel == 3 &&
+           this->InternalImage->BitsPerSample == 8));
+}
+
+//-------------------------------------------------------------------------
+void vtkOMETiffReader::ReadPages(void* buffer)
+{
+  vtkOMETiffReaderInternal* internal = this->InternalImage;
+  const int* extent = this->OutputExtent;
+  const int slices = extent[5] - extent[4] + 1;
+  const size_t sampleBytes = internal->BitsPerSample / 8;
+  const size_t pixelBytes = internal->SamplesPerPixel * sampleBytes;
+  const vtkIdType rowBytes = this->OutputIncrements[1] * sampleBytes;
+  const vtkIdType sliceBytes = this->OutputIncrements[2] * sampleBytes;
+  const bool flip = internal->Orientation != ORIENTATION_TOPLEFT;
+  const std::string fileName = this->GetInternalFileName();
+
+  int threads = this->NumberOfThreads;
+  if (threads <= 0)
+  {
+    threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  threads = std::max(1, std::min(threads, slices));
+
+  std::atomic<int> next(0);
+  std::atomic<int> done(0);
+  std::atomic<bool> failed(false);
+  std::mutex mutex;
+  vtkTypeInt64 decoded = 0;
+  int failedSlice = -1;
+
+  // Each thread takes the next slice until there are none left. They read
+  // through a handle of their own, as libtiff handles are not shared, only
+  // this one reports progress as events go to the thread of the pipeline.
+  auto decodeSlices = [&](bool main)
+  {
+    TIFF* image = main ? internal->Image : TIFFOpen(fileName.c_str(), "r");
+    if (!image)
+    {
+      failed = true;
+      return;
+    }
+    std::vector<unsigned char> block;
+    vtkTypeInt64 bytes = 0;
+    for (int slice = next++; slice < slices && !failed && !this->AbortExecute;
+         slice = next++)
+    {
+      unsigned char* out = static_cast<unsigned char*>(buffer) +
+                           slice * sliceBytes;
+      if (!TIFFSetSubDirectory(image,
+                               internal->SliceOffsets[extent[4] + slice]) ||
+          !DecodeRegion(image, out, extent, rowBytes, pixelBytes, flip, block,
+                        bytes))
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed = true;
+        failedSlice = extent[4] + slice;
+        break;
+      }
+      ++done;
+      if (main)
+      {
+        this->UpdateProgress(static_cast<double>(done) / slices);
+      }
+    }
+    if (!main)
+    {
+      TIFFClose(image);
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    decoded += bytes;
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; ++i)
+  {
+    workers.push_back(std::thread(decodeSlices, false));
+  }
+  decodeSlices(true);
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  this->DecodedBytes += decoded;
+  if (failedSlice >= 0)
+  {
+    vtkErrorMacro(<< "Cannot read slice " << failedSlice << " from file");
+  }
+  else if (failed)
+  {
+    vtkErrorMacro(<< "Cannot open file " << fileName << " to read slices");
+  }
+}
+
 //-------------------------------------------------------------------------
 template<typename T>
 void vtkOMETiffReader::ReadVolume(T* buffer)
@@ -1224,36 +1381,18 @@ template<typename T>
 void vtkOMETiffReader::ReadGenericImage(T* out, unsigned int, unsigned int height)
 {
   // Fast path for simple images
-  unsigned int format = this->GetFormat();
-  if (this->InternalImage->PlanarConfig == PLANARCONFIG_CONTIG &&
-      this->OutputIncrements[0] == 1 &&
-      (format == vtkOMETiffReader::GRAYSCALE &&
-       this->InternalImage->Photometrics == PHOTOMETRIC_MINISBLACK &&
-       this->InternalImage->SamplesPerPixel ==  1))
+  if (this->CanDecodeDirectly())
   {
-    if (this->InternalImage->Orientation == ORIENTATION_TOPLEFT)
-    {
-      FlipFalse flip;
-      if (!ReadTemplatedImage(out, flip,
-                              this->OutputExtent[0], this->OutputExtent[1],
-                              this->OutputExtent[2], this->OutputExtent[3],
-                              this->OutputIncrements[1],
-                              height, this->InternalImage->Image))
-      {
-        vtkErrorMacro(<< "Problem reading slice of volume in TIFF file.");
-      }
-    }
-    else
+    std::vector<unsigned char> block;
+    if (!DecodeRegion(this->InternalImage->Image,
+                      reinterpret_cast<unsigned char*>(out),
+                      this->OutputExtent,
+                      this->OutputIncrements[1] * sizeof(T),
+                      this->InternalImage->SamplesPerPixel * sizeof(T),
+                      this->InternalImage->Orientation != ORIENTATION_TOPLEFT,
+                      block, this->DecodedBytes))
     {
-      FlipTrue flip;
-      if (!ReadTemplatedImage(out, flip,
-                              this->OutputExtent[0], this->OutputExtent[1],
-                              this->OutputExtent[2], this->OutputExtent[3],
-                              this->OutputIncrements[1],
-                              height, this->InternalImage->Image))
-      {
-        vtkErrorMacro(<< "Problem reading slice of volume in TIFF file.");
-      }
+      vtkErrorMacro(<< "Problem reading slice of volume in TIFF file.");
     }
     return;
   }
@@ -1489,5 +1628,9 @@ void vtkOMETiffReader::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "OrientationTypeSpecifiedFlag: " << this->OrientationTypeSpecifiedFlag << endl;
   os << indent << "OriginSpecifiedFlag: " << this->OriginSpecifiedFlag << endl;
   os << indent << "SpacingSpecifiedFlag: " << this->SpacingSpecifiedFlag << endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << endl;
+  os << indent << "ReadBytes: " << this->ReadBytes << endl;
+  os << indent << "DecodedBytes: " << this->DecodedBytes << endl;
+  os << indent << "ReadTime: " << this->ReadTime << endl;
 }
 }
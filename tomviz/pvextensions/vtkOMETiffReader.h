@@ -53,6 +53,27 @@ public:
     return "TIFF";
   }
 
+  //@{
+  /**
+   * Set/Get the number of threads the slices of a multi-page or tiled file
+   * are decoded on, each through its own handle to the file. The default, 0,
+   * uses one per core.
+   */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+  //@}
+
+  //@{
+  /**
+   * Statistics of the last read: the bytes of the extent that was read, the
+   * bytes decoded from the strips or tiles holding it, and the seconds it
+   * took.
+   */
+  vtkGetMacro(ReadBytes, vtkTypeInt64);
+  vtkGetMacro(DecodedBytes, vtkTypeInt64);
+  vtkGetMacro(ReadTime, double);
+  //@}
+
 protected:
   vtkOMETiffReader();
   ~vtkOMETiffReader() VTK_OVERRIDE;
@@ -85,6 +106,18 @@ private:
 
   unsigned int GetFormat();
 
+  /**
+   * Whether the samples are stored in the file as they are in the output,
+   * so strips and tiles can be decoded straight into it.
+   */
+  bool CanDecodeDirectly();
+
+  /**
+   * Decodes the slices of the output extent concurrently, strip by strip or
+   * tile by tile.
+   */
+  void ReadPages(void* buffer);
+
   /**
    * Auxiliary methods used by the reader internally.
    */
@@ -139,6 +172,10 @@ private:
   bool OrientationTypeSpecifiedFlag;
   bool OriginSpecifiedFlag;
   bool SpacingSpecifiedFlag;
+  int NumberOfThreads;
+  vtkTypeInt64 ReadBytes;
+  vtkTypeInt64 DecodedBytes;
+  double ReadTime;
 };
 
 }
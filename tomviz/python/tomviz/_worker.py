@@ -0,0 +1,383 @@
+# -*- coding: utf-8 -*-
+
+###############################################################################
+#
+#  This source file is part of the tomviz project.
+#
+#  Copyright Kitware, Inc.
+#
+#  This source code is released under the New BSD License, (the "License").
+#
+#  Unless required by applicable law or agreed to in writing, software
+#  distributed under the License is distributed on an "AS IS" BASIS,
+#  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#  See the License for the specific language governing permissions and
+#  limitations under the License.
+#
+###############################################################################
+
+# Worker process running Python operators outside of the interpreter embedded
+# in the application, see PythonService.h. Requests and replies are exchanged
+# as one JSON object per line on stdin and stdout. The scalars of the volume
+# are exchanged in files both processes map, in memory where the system
+# provides it, so only their description goes through the pipe. The rest of
+# the volume is exchanged as a VTK XML image, results and child data sources
+# as binary legacy VTK files, in a directory given by the application.
+#
+# A request looks like:
+#
+#   {"id": 1, "label": "...", "script": "...", "arguments": {...},
+#    "argument_types": {"name": "float", ...},
+#    "input": "in.vti", "output": "out.vti", "directory": "...",
+#    "scalars": {"path": "in.raw", "type": 10, "components": 1,
+#                "tuples": 1000, "name": "..."},
+#    "output_scalars": "out.raw",
+#    "results": ["name", ...], "children": ["name", ...]}
+#
+# and is answered with {"id": 1, "ok": true, "results": {"name": "file"},
+# "scalars": {...}}, where results is null unless the script returned a
+# dictionary and scalars describes the transformed scalars, which are left
+# in the input file when they were transformed in place and written to the
+# output_scalars file otherwise. A failure is answered with
+# {"id": 1, "ok": false, "canceled": false, "error": "..."}, canceled is set
+# when the script failed after it was canceled. While it runs the worker sends
+# {"id": 1, "progress": {...}} and accepts {"cancel": 1}.
+
+import json
+import os
+import sys
+import threading
+import traceback
+import types
+
+try:
+    import queue
+except ImportError:
+    import Queue as queue
+
+
+def worker_command():
+    """
+    Returns the program, arguments and Python path the application uses to
+    start a worker, as a JSON string. This is called in the embedded
+    interpreter, so the worker runs the Python installation VTK was built
+    against, with the same modules available.
+    """
+    version = '%d.%d' % sys.version_info[:2]
+    if sys.platform == 'win32':
+        candidates = [os.path.join(sys.prefix, 'python.exe')]
+    else:
+        bindir = os.path.join(sys.prefix, 'bin')
+        candidates = [os.path.join(bindir, 'python' + version),
+                      os.path.join(bindir, 'python%d' % sys.version_info[0]),
+                      os.path.join(bindir, 'python')]
+    # The embedded interpreter reports the application as sys.executable, so
+    # only use it when it really is Python.
+    name = os.path.basename(sys.executable or '').lower()
+    if name.startswith('python'):
+        candidates.insert(0, sys.executable)
+
+    program = ''
+    for candidate in candidates:
+        if os.path.isfile(candidate) and os.access(candidate, os.X_OK):
+            program = candidate
+            break
+
+    return json.dumps({
+        'program': program,
+        'arguments': ['-u', '-m', 'tomviz._worker'],
+        'pythonpath': os.pathsep.join(p for p in sys.path if p)
+    })
+
+
+class _Channel(object):
+    """
+    Writes replies to the original stdout. Operators print to stdout, so
+    sys.stdout is pointed at stderr for them to keep the protocol intact.
+    """
+
+    def __init__(self):
+        self._stream = sys.stdout
+        self._lock = threading.Lock()
+        sys.stdout = sys.stderr
+
+    def send(self, message):
+        line = json.dumps(message) + '\n'
+        with self._lock:
+            self._stream.write(line)
+            self._stream.flush()
+
+
+class _Task(object):
+    """
+    Stands in for the OperatorPython of the application, progress is sent
+    back as it changes and cancellation arrives from the reader thread.
+    """
+
+    def __init__(self, channel, request):
+        self.id = request['id']
+        self.canceled = False
+        self._channel = channel
+
+    def progress(self, **kwargs):
+        self._channel.send({'id': self.id, 'progress': kwargs})
+
+
+class OperatorPythonWrapper(object):
+    """
+    Replaces tomviz._wrapping.OperatorPythonWrapper, which wraps a C++
+    operator and is only available in the embedded interpreter.
+    """
+
+    def __init__(self, task):
+        self._task = task
+        self._maximum = 0
+        self._value = 0
+        self._message = ''
+
+    @property
+    def canceled(self):
+        return self._task.canceled
+
+    @property
+    def progress_maximum(self):
+        return self._maximum
+
+    @progress_maximum.setter
+    def progress_maximum(self, value):
+        self._maximum = value
+        self._task.progress(maximum=value)
+
+    @property
+    def progress_value(self):
+        return self._value
+
+    @progress_value.setter
+    def progress_value(self, value):
+        self._value = value
+        self._task.progress(value=value)
+
+    @property
+    def progress_message(self):
+        return self._message
+
+    @progress_message.setter
+    def progress_message(self, value):
+        self._message = value
+        self._task.progress(message=value)
+
+
+def _install_wrapping():
+    import tomviz
+    wrapping = types.ModuleType('tomviz._wrapping')
+    wrapping.OperatorPythonWrapper = OperatorPythonWrapper
+    sys.modules['tomviz._wrapping'] = wrapping
+    tomviz._wrapping = wrapping
+
+
+def _map(description, mode='r+'):
+    import numpy as np
+    from vtk.util import numpy_support
+    dtype = numpy_support.get_numpy_array_type(description['type'])
+    # Counts are whole, but may arrive as floats from JSON.
+    tuples = int(description['tuples'])
+    components = int(description['components'])
+    shape = (tuples,)
+    if components > 1:
+        shape += (components,)
+    return np.memmap(description['path'], dtype=dtype, mode=mode, shape=shape)
+
+
+def _read(request):
+    from vtk import vtkImageData, vtkXMLImageDataReader
+    from vtk.util import numpy_support
+    reader = vtkXMLImageDataReader()
+    reader.SetFileName(request['input'])
+    reader.Update()
+    data = vtkImageData()
+    data.ShallowCopy(reader.GetOutput())
+
+    # The scalars stay in the shared file, so operators modifying them in
+    # place modify them for the application as well.
+    shared = _map(request['scalars'])
+    scalars = numpy_support.numpy_to_vtk(shared, deep=0,
+                                         array_type=request['scalars']['type'])
+    if request['scalars']['name']:
+        scalars.SetName(request['scalars']['name'])
+    data.GetPointData().SetScalars(scalars)
+    return data, shared
+
+
+def _write(data, path):
+    # The scalars are written by _write_scalars, the file only holds the rest
+    # of the image.
+    from vtk import vtkImageData, vtkXMLImageDataWriter
+    scalars = data.GetPointData().GetScalars()
+    structure = vtkImageData()
+    structure.CopyStructure(data)
+    structure.GetFieldData().ShallowCopy(data.GetFieldData())
+    point_data = data.GetPointData()
+    for index in range(point_data.GetNumberOfArrays()):
+        array = point_data.GetAbstractArray(index)
+        if array is not scalars:
+            structure.GetPointData().AddArray(array)
+
+    writer = vtkXMLImageDataWriter()
+    writer.SetFileName(path)
+    writer.SetInputData(structure)
+    writer.SetDataModeToAppended()
+    writer.EncodeAppendedDataOff()
+    writer.SetCompressorTypeToNone()
+    if not writer.Write():
+        raise IOError('Unable to write %s' % path)
+
+
+def _write_scalars(data, shared, request):
+    from vtk.util import numpy_support
+    scalars = data.GetPointData().GetScalars()
+    if scalars is None:
+        return None
+
+    values = numpy_support.vtk_to_numpy(scalars)
+    description = {
+        'type': scalars.GetDataType(),
+        'components': scalars.GetNumberOfComponents(),
+        'tuples': scalars.GetNumberOfTuples(),
+        'name': scalars.GetName() or ''
+    }
+    shared_input = request['scalars']
+    if (values.ctypes.data == shared.ctypes.data and
+            values.nbytes == shared.nbytes and
+            description['type'] == shared_input['type'] and
+            description['components'] == shared_input['components']):
+        description['path'] = shared_input['path']
+        return description
+
+    # The file is allocated before it is mapped, a sparse file in a full
+    # tmpfs would fault on the first write instead of failing here.
+    description['path'] = request['output_scalars']
+    with open(description['path'], 'w+b') as f:
+        if hasattr(os, 'posix_fallocate'):
+            os.posix_fallocate(f.fileno(), 0, values.nbytes)
+        else:
+            f.truncate(values.nbytes)
+    output = _map(description)
+    output[...] = values.reshape(output.shape)
+    del output
+    return description
+
+
+def _typed(value, kind):
+    if kind == 'float':
+        return float(value)
+    elif kind == 'int':
+        return int(value)
+    elif isinstance(kind, list) and isinstance(value, list):
+        return [_typed(v, k) for v, k in zip(value, kind)]
+    return value
+
+
+def _arguments(request):
+    # JSON writes whole floats such as 3.0 as 3, the application sends the
+    # types along to restore them.
+    types = request.get('argument_types', {})
+    return dict((name, _typed(value, types.get(name)))
+                for name, value in request.get('arguments', {}).items())
+
+
+def _write_result(data, path):
+    # Results may be tables or meshes as well as images, which the legacy
+    # writer handles alike.
+    from vtk import vtkGenericDataObjectWriter
+    writer = vtkGenericDataObjectWriter()
+    writer.SetFileName(path)
+    writer.SetInputData(data)
+    writer.SetFileTypeToBinary()
+    if not writer.Write():
+        raise IOError('Unable to write %s' % path)
+
+
+def _run(task, request):
+    from tomviz import _internal
+
+    name = 'tomviz_worker_%d' % task.id
+    module = types.ModuleType(name)
+    module.__file__ = request['label']
+    code = compile(request['script'], request['label'], 'exec')
+    exec(code, module.__dict__)
+
+    transform = _internal.find_transform_scalars(module, task)
+    dataset, shared = _read(request)
+    result = transform(dataset, **_arguments(request))
+    _write(dataset, request['output'])
+    scalars = _write_scalars(dataset, shared, request)
+
+    # Results and child data sources are named in the operator description,
+    # any the script did not return are reported by the application.
+    if not isinstance(result, dict):
+        return None, scalars
+
+    files = {}
+    names = request.get('results', []) + request.get('children', [])
+    for index, key in enumerate(names):
+        if result.get(key) is None:
+            continue
+        path = os.path.join(request['directory'], 'result%d.vtk' % index)
+        _write_result(result[key], path)
+        files[key] = path
+
+    return files, scalars
+
+
+def main():
+    channel = _Channel()
+    _install_wrapping()
+
+    requests = queue.Queue()
+    current = {}
+
+    def read():
+        for line in iter(sys.stdin.readline, ''):
+            try:
+                message = json.loads(line)
+            except ValueError:
+                continue
+            if 'cancel' in message:
+                task = current.get(message['cancel'])
+                if task is not None:
+                    task.canceled = True
+            else:
+                requests.put(message)
+        requests.put(None)
+
+    reader = threading.Thread(target=read)
+    reader.daemon = True
+    reader.start()
+
+    # Import the heavy modules once, before telling the application the
+    # worker is ready for requests.
+    import vtk  # noqa
+    import tomviz.utils  # noqa
+    channel.send({'ready': True})
+
+    while True:
+        request = requests.get()
+        if request is None:
+            break
+
+        task = _Task(channel, request)
+        current[task.id] = task
+        try:
+            files, scalars = _run(task, request)
+            channel.send({'id': task.id, 'ok': True, 'results': files,
+                          'scalars': scalars})
+        except Exception:
+            channel.send({'id': task.id, 'ok': False,
+                          'canceled': task.canceled,
+                          'error': traceback.format_exc()})
+        finally:
+            del current[task.id]
+
+
+if __name__ == '__main__':
+    main()
@@ -23,6 +23,8 @@ import vtk.util.numpy_support as np_s
 
 
 def get_scalars(dataobject):
+    # The array returned is a view of the VTK memory, nothing is copied and
+    # writing into it modifies the data object directly.
     do = dsa.WrapDataObject(dataobject)
     # get the first
     rawarray = do.PointData.GetScalars()
@@ -41,20 +43,51 @@ def is_numpy_vtk_type(newscalars):
         return True
 
 
-def set_scalars(dataobject, newscalars):
+def _as_vtk_type(array):
+    # Convert to a type VTK can hold, booleans have the same layout as
+    # unsigned chars so they are reinterpreted rather than copied.
+    if is_numpy_vtk_type(array):
+        return array
+    if array.dtype == np.bool_:
+        return array.view(np.uint8)
+    return array.astype(np.float32)
+
+
+def _is_current_scalars(do, array):
+    # Indicate whether array is a flat view of all of the current scalars, as
+    # happens when an operator writes into the array from get_array.
+    scalars = do.PointData.GetScalars()
+    if scalars is None or isinstance(scalars, dsa.VTKNoneArray):
+        return False
+    return (array.dtype == scalars.dtype and array.size == scalars.size and
+            array.__array_interface__['data'][0] ==
+            scalars.__array_interface__['data'][0])
+
+
+def _replace_scalars(dataobject, arr):
+    # Adopt arr as the scalars. Contiguous arrays are wrapped by VTK without
+    # a copy, and arrays that already are the scalars are left in place.
     do = dsa.WrapDataObject(dataobject)
+    if _is_current_scalars(do, arr):
+        do.PointData.GetScalars().VTKObject.Modified()
+        return
+
     oldscalars = do.PointData.GetScalars()
-    name = oldscalars.GetName()
+    arrayname = "Scalars"
+    if oldscalars is not None:
+        arrayname = oldscalars.GetName()
     del oldscalars
+    do.PointData.append(arr, arrayname)
+    do.PointData.SetActiveScalars(arrayname)
 
-    if not is_numpy_vtk_type(newscalars):
-        newscalars = newscalars.astype(np.float32)
 
-    do.PointData.append(newscalars, name)
-    do.PointData.SetActiveScalars(name)
+def set_scalars(dataobject, newscalars):
+    _replace_scalars(dataobject, _as_vtk_type(newscalars))
 
 
 def get_array(dataobject, order='F'):
+    # Returns a writable view of the scalars shaped as the volume, no data is
+    # copied. Passing the view back to set_array costs nothing.
     scalars_array = get_scalars(dataobject)
     if order == 'F':
         scalars_array3d = np.reshape(scalars_array,
@@ -74,6 +107,8 @@ def set_array(dataobject, newarray, minextent=None, isFortran=True):
     # isFortran indicates whether the NumPy array has Fortran-order indexing,
     # i.e. i,j,k indexing. If isFortran is False, then the NumPy array uses
     # C-order indexing, i.e. k,j,i indexing.
+    # The memory of the array is used directly by VTK whenever its layout
+    # allows, that is anything but an i,j,k indexed array in C order.
 
     if isFortran is False:
         # Flatten according to array.flags
@@ -82,19 +117,16 @@ def set_array(dataobject, newarray, minextent=None, isFortran=True):
             vtkshape = newarray.shape
         else:
             vtkshape = newarray.shape[::-1]
-    elif np.isfortran(newarray):
-        arr = newarray.reshape(-1, order='F')
+    elif newarray.flags.f_contiguous:
+        arr = newarray.ravel(order='F')
         vtkshape = newarray.shape
     else:
-        print('Warning, array does not have Fortran order, making deep copy '
-              'and fixing...')
+        # Operators commonly return C-ordered i,j,k arrays, VTK needs a
+        # Fortran ordered copy of those.
         vtkshape = newarray.shape
-        tmp = np.asfortranarray(newarray)
-        arr = tmp.reshape(-1, order='F')
-        print('...done.')
+        arr = newarray.ravel(order='F')
 
-    if not is_numpy_vtk_type(arr):
-        arr = arr.astype(np.float32)
+    arr = _as_vtk_type(arr)
 
     if minextent is None:
         minextent = dataobject.GetExtent()[::2]
@@ -108,16 +140,7 @@ def set_array(dataobject, newarray, minextent=None, isFortran=True):
         dataobject.SetExtent(extent)
 
     # Now replace the scalars array with the new array.
-    vtkarray = np_s.numpy_to_vtk(arr)
-    vtkarray.Association = dsa.ArrayAssociation.POINT
-    do = dsa.WrapDataObject(dataobject)
-    oldscalars = do.PointData.GetScalars()
-    arrayname = "Scalars"
-    if oldscalars is not None:
-        arrayname = oldscalars.GetName()
-    del oldscalars
-    do.PointData.append(arr, arrayname)
-    do.PointData.SetActiveScalars(arrayname)
+    _replace_scalars(dataobject, arr)
 
 
 def get_tilt_angles(dataobject):